@@ -0,0 +1,318 @@
+// Benchmarks the game archive and reads archive partitions dumped from a board
+//
+// Usage: archive_tool bench [games]               size and speed of the encoding, then an archive partition
+//                                                 filled with engine and random games, listed, searched and replayed
+//        archive_tool list <archive.bin>          every game of a partition dump
+//        archive_tool find <archive.bin> <fen>    games reaching a position after the opening plies
+//        archive_tool pgn <archive.bin> <n>       game n of the list as PGN
+//
+// A dump is read with: esptool.py read_flash <archive offset> <archive size> archive.bin
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "archive.h"
+#include "flash_file.h"
+#include "pgn.h"
+#include "search.h"
+#include "host_util.h"
+
+#define BENCH_DEFAULT_GAMES 100
+#define BENCH_MAX_PLIES 300
+#define BENCH_RANDOM_PLIES 4         // Random moves before the engine plays, so games differ
+#define BENCH_NODES 3000             // Per engine move, enough for sensible moves
+#define BENCH_PARTITION_SIZE 0x40000 // As in partitions.csv
+
+static Archive_t archive;
+static Search_t search;
+
+static int64_t clock_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// A game played to its end or BENCH_MAX_PLIES, by the engine after a few random moves or all random
+static void play_game(Game_record_t *record, bool engine, uint64_t *seed)
+{
+    Chess_position_t pos;
+    position_set_start(&pos);
+    game_record_init(record, &pos);
+    Move_list_t list;
+    while (record->count < BENCH_MAX_PLIES && generate_legal_moves(&pos, &list) > 0 && pos.halfmove_clock < 100 &&
+            game_record_repetitions(record, &pos) < 2) {
+        Chess_move_t move = list.moves[host_random(seed) % list.count];
+        if (engine && record->count >= BENCH_RANDOM_PLIES) {
+            uint64_t keys[SEARCH_HISTORY_MAX];
+            Search_limits_t limits = {.node_limit = BENCH_NODES};
+            search_init(&search, &limits);
+            search.clock_us = clock_us;
+            search_set_history(&search, keys, game_record_recent_keys(record, &pos, keys, SEARCH_HISTORY_MAX));
+            move = search_run(&search, &pos)->best_move;
+        }
+        make_move(&pos, move);
+        game_record_append(record, move, pos.key);
+    }
+}
+
+typedef struct {
+    const char *name;
+    int games;
+    uint64_t plies;
+    uint64_t bytes;                  // Moves only, without the headers
+    int64_t encode_us;
+    int64_t decode_us;
+} Codec_stats_t;
+
+static bool bench_codec(Game_record_t *games, int count, Codec_stats_t *stats)
+{
+    bool ok = true;
+    for (int i = 0; i < count; i++) {
+        Game_record_t decoded;
+        int64_t start = clock_us();
+        size_t size = archive_encode(&games[i], archive_result_from_pgn(pgn_result(&games[i])), 0,
+                                     archive.buffer, sizeof(archive.buffer));
+        int64_t encoded = clock_us();
+        bool decoded_ok = size > 0 && archive_decode(archive.buffer, size, &decoded, NULL);
+        stats->decode_us += clock_us() - encoded;
+        stats->encode_us += encoded - start;
+        if (!decoded_ok || !host_same_moves(&games[i], &decoded)) {
+            printf("FAIL %s game %d does not round trip\n", stats->name, i + 1);
+            ok = false;
+        }
+        game_record_clear(&decoded);
+        stats->games++;
+        stats->plies += games[i].count;
+        stats->bytes += size - ARCHIVE_GAME_HEADER_SIZE;
+    }
+    printf("%-10s %6d %7lu %7lu %8.2f %8.2f %10.2f %10.2f\n", stats->name, stats->games,
+           (unsigned long)stats->plies, (unsigned long)stats->bytes, 8.0 * stats->bytes / stats->plies,
+           100.0 * stats->bytes / (2.0 * stats->plies), (double)stats->encode_us / stats->plies,
+           (double)stats->decode_us / stats->plies);
+    return ok;
+}
+
+static bool open_archive(Flash_file_t *flash, const char *path, uint32_t size)
+{
+    Flash_ring_io_t access;
+    if (!flash_file_open(flash, path, size)) {
+        return false;
+    }
+    flash_file_io(flash, &access);
+    archive_init(&archive, &access);
+    return true;
+}
+
+// Fill an archive partition again and again, then list, search and replay what it kept
+static bool bench_store(Game_record_t *games, int count)
+{
+    char path[] = "/tmp/archive_bench_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        perror(path);
+        return false;
+    }
+    close(fd);
+    Flash_file_t flash;
+    bool ok = open_archive(&flash, path, BENCH_PARTITION_SIZE);
+    int written = 0;
+    uint64_t bytes = 0;
+    int64_t start = clock_us();
+    // Around the ring three times, the oldest sectors are erased for the new games
+    while (ok && bytes < 3 * BENCH_PARTITION_SIZE) {
+        const Game_record_t *game = &games[written % count];
+        size_t size = archive_encode(game, archive_result_from_pgn(pgn_result(game)), (uint32_t)written,
+                                     archive.buffer, sizeof(archive.buffer));
+        ok = size > 0 && archive_write(&archive, archive.buffer, size) == ESP_OK;
+        bytes += size;
+        written++;
+    }
+    int64_t write_us = clock_us() - start;
+    // Reopen as after a reboot
+    flash_file_close(&flash);
+    ok = ok && open_archive(&flash, path, BENCH_PARTITION_SIZE);
+
+    Archive_iter_t iter;
+    Archive_entry_t entry;
+    int listed = 0, matches = 0;
+    uint32_t last_date = 0;
+    start = clock_us();
+    archive_iter_init(&archive, &iter);
+    while (ok && archive_next(&archive, &iter, &entry)) {
+        ok = listed == 0 || entry.date == last_date + 1;
+        last_date = entry.date;
+        listed++;
+    }
+    int64_t list_us = clock_us() - start;
+    if (!ok || listed == 0 || last_date != (uint32_t)written - 1) {
+        printf("FAIL the archive does not list the newest games in order\n");
+        ok = false;
+    }
+
+    // Every game with the opening of the newest one
+    start = clock_us();
+    Archive_entry_t newest = entry;
+    archive_iter_init(&archive, &iter);
+    while (ok && archive_next(&archive, &iter, &entry)) {
+        matches += entry.opening_key == newest.opening_key;
+    }
+    int64_t find_us = clock_us() - start;
+
+    int replayed = 0;
+    start = clock_us();
+    archive_iter_init(&archive, &iter);
+    while (ok && archive_next(&archive, &iter, &entry)) {
+        Game_record_t record;
+        ok = archive_load(&archive, &entry, &record) == ESP_OK && host_same_moves(&record, &games[entry.date % count]);
+        if (!ok) {
+            printf("FAIL game %u does not replay\n", (unsigned int)entry.date);
+        }
+        game_record_clear(&record);
+        replayed++;
+    }
+    int64_t replay_us = clock_us() - start;
+
+    if (ok) {
+        printf("%d KB partition: %d of %d games kept, %.1f ms to encode and write them all\n",
+               BENCH_PARTITION_SIZE / 1024, listed, written, write_us / 1000.0);
+        printf("list %.2f ms, find an opening %.2f ms (%d games), replay all %.2f ms\n", list_us / 1000.0,
+               find_us / 1000.0, matches, replay_us / 1000.0);
+    }
+    flash_file_close(&flash);
+    unlink(path);
+    return ok;
+}
+
+static int bench(int count)
+{
+    Game_record_t *engine_games = calloc(count, sizeof(Game_record_t));
+    Game_record_t *random_games = calloc(count, sizeof(Game_record_t));
+    uint64_t seed = 0x9E3779B97F4A7C15ull;
+    for (int i = 0; i < count; i++) {
+        play_game(&engine_games[i], true, &seed);
+        play_game(&random_games[i], false, &seed);
+    }
+
+    Codec_stats_t engine_stats = {.name = "engine"}, random_stats = {.name = "random"};
+    printf("games       count   plies   bytes bits/ply  %% of raw  enc us/ply  dec us/ply\n");
+    bool ok = bench_codec(engine_games, count, &engine_stats);
+    ok &= bench_codec(random_games, count, &random_stats);
+    ok &= bench_store(engine_games, count);
+
+    for (int i = 0; i < count; i++) {
+        game_record_clear(&engine_games[i]);
+        game_record_clear(&random_games[i]);
+    }
+    free(engine_games);
+    free(random_games);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static bool open_dump(Flash_file_t *flash, const char *path)
+{
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        perror(path);
+        return false;
+    }
+    uint32_t size = (uint32_t)st.st_size / FLASH_RING_SECTOR_SIZE * FLASH_RING_SECTOR_SIZE;
+    if (size == 0) {
+        fprintf(stderr, "%s: not an archive partition\n", path);
+        return false;
+    }
+    return open_archive(flash, path, size);
+}
+
+static void print_entry(int index, const Archive_entry_t *entry)
+{
+    char date[24] = "-";
+    time_t seconds = entry->date;
+    if (entry->date) {
+        strftime(date, sizeof(date), "%Y-%m-%d %H:%M", gmtime(&seconds));
+    }
+    printf("%4d  %-16s  %-7s  %5u  %5u  %016llx%s\n", index, date, archive_result_pgn(entry->result),
+           (unsigned int)entry->plies, (unsigned int)entry->size, (unsigned long long)entry->opening_key,
+           entry->custom_start ? "  (setup)" : "");
+}
+
+static int list(const char *path, const char *fen)
+{
+    Flash_file_t flash;
+    Chess_position_t pos;
+    if (fen && !position_from_fen(&pos, fen)) {
+        fprintf(stderr, "bad FEN\n");
+        return EXIT_FAILURE;
+    }
+    if (!open_dump(&flash, path)) {
+        return EXIT_FAILURE;
+    }
+    Archive_iter_t iter;
+    Archive_entry_t entry;
+    int index = 0, shown = 0;
+    printf("   #  date              result   plies  bytes  opening\n");
+    archive_iter_init(&archive, &iter);
+    while (archive_next(&archive, &iter, &entry)) {
+        index++;
+        if (!fen || entry.opening_key == pos.key) {
+            print_entry(index, &entry);
+            shown++;
+        }
+    }
+    printf("%d of %d games\n", shown, index);
+    flash_file_close(&flash);
+    return EXIT_SUCCESS;
+}
+
+static int export_pgn(const char *path, int wanted)
+{
+    Flash_file_t flash;
+    if (!open_dump(&flash, path)) {
+        return EXIT_FAILURE;
+    }
+    Archive_iter_t iter;
+    Archive_entry_t entry;
+    int index = 0, status = EXIT_FAILURE;
+    archive_iter_init(&archive, &iter);
+    while (archive_next(&archive, &iter, &entry)) {
+        if (++index != wanted) {
+            continue;
+        }
+        Game_record_t record;
+        if (archive_load(&archive, &entry, &record) == ESP_OK) {
+            pgn_write(stdout, &record, archive_result_pgn(entry.result));
+            game_record_clear(&record);
+            status = EXIT_SUCCESS;
+        } else {
+            fprintf(stderr, "game %d is damaged\n", wanted);
+        }
+        break;
+    }
+    if (index < wanted) {
+        fprintf(stderr, "only %d games\n", index);
+    }
+    flash_file_close(&flash);
+    return status;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc >= 2 && argc <= 3 && strcmp(argv[1], "bench") == 0) {
+        int games = argc == 3 ? atoi(argv[2]) : BENCH_DEFAULT_GAMES;
+        return bench(games > 0 ? games : BENCH_DEFAULT_GAMES);
+    }
+    if (argc == 3 && strcmp(argv[1], "list") == 0) {
+        return list(argv[2], NULL);
+    }
+    if (argc == 4 && strcmp(argv[1], "find") == 0) {
+        return list(argv[2], argv[3]);
+    }
+    if (argc == 4 && strcmp(argv[1], "pgn") == 0) {
+        return export_pgn(argv[2], atoi(argv[3]));
+    }
+    fprintf(stderr, "usage: %s bench [games] | list <archive.bin> | find <archive.bin> <fen> | pgn <archive.bin> <n>\n",
+            argv[0]);
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,157 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bitbase_gen.h"
+#include "moves.h"
+
+// Work tables cover every placement with white as the strong side, no symmetry
+#define FULL_POSITIONS (2 * 64 * 64 * 64)
+
+typedef enum {
+    RESULT_UNKNOWN = 0,
+    RESULT_ILLEGAL,
+    RESULT_WIN,
+} Result_t;
+
+static int full_index(Side_t side_to_move, int strong_king, int weak_king, int piece)
+{
+    return ((side_to_move * 64 + strong_king) * 64 + weak_king) * 64 + piece;
+}
+
+static bool set_up(Chess_position_t *pos, Piece_type_t type, Side_t side_to_move, int strong_king, int weak_king,
+                   int piece)
+{
+    if (strong_king == weak_king || piece == strong_king || piece == weak_king ||
+            (king_attack_table[strong_king] & BB_SQUARE(weak_king))) {
+        return false;
+    }
+    if (type == PIECE_PAWN && (SQUARE_RANK(piece) == 0 || SQUARE_RANK(piece) == 7)) {
+        return false;
+    }
+    memset(pos, 0, sizeof(*pos));
+    pos->ep_square = SQUARE_NONE;
+    pos->fullmove_number = 1;
+    position_put_piece(pos, strong_king, SIDE_WHITE, PIECE_KING);
+    position_put_piece(pos, weak_king, SIDE_BLACK, PIECE_KING);
+    position_put_piece(pos, piece, SIDE_WHITE, type);
+
+    // The side that just moved cannot be in check
+    pos->side_to_move = !side_to_move;
+    bool illegal = is_in_check(pos);
+    pos->side_to_move = side_to_move;
+    return !illegal;
+}
+
+// Result of a position reached by a move, looked up in the work tables
+static bool child_wins(uint8_t *const results[], const Chess_position_t *child)
+{
+    Bitboard_t strong_pieces = child->colors[SIDE_WHITE] & ~child->pieces[PIECE_KING];
+    if (!strong_pieces) {
+        return false;   // The piece was captured
+    }
+    int piece = bb_lsb(strong_pieces);
+    Bitbase_ending_t ending;
+    switch (position_piece_at(child, piece)) {
+    case PIECE_PAWN: ending = BITBASE_KPK; break;
+    case PIECE_ROOK: ending = BITBASE_KRK; break;
+    case PIECE_QUEEN: ending = BITBASE_KQK; break;
+    default: return false;   // Knight or bishop underpromotion
+    }
+    int index = full_index(child->side_to_move, bb_lsb(position_bb(child, SIDE_WHITE, PIECE_KING)),
+                           bb_lsb(position_bb(child, SIDE_BLACK, PIECE_KING)), piece);
+    return results[ending][index] == RESULT_WIN;
+}
+
+// Iterate until no position changes: white wins if one move wins, black loses if every move loses
+static void solve(uint8_t *const results[], Bitbase_ending_t ending, Piece_type_t type, bool verbose)
+{
+    uint8_t *result = results[ending];
+    Chess_position_t pos;
+    for (int side = 0; side < 2; side++) {
+        for (int wk = 0; wk < 64; wk++) {
+            for (int bk = 0; bk < 64; bk++) {
+                for (int piece = 0; piece < 64; piece++) {
+                    bool legal = set_up(&pos, type, (Side_t)side, wk, bk, piece);
+                    result[full_index((Side_t)side, wk, bk, piece)] = legal ? RESULT_UNKNOWN : RESULT_ILLEGAL;
+                }
+            }
+        }
+    }
+
+    int pass = 0, changed;
+    do {
+        changed = 0;
+        for (int index = 0; index < FULL_POSITIONS; index++) {
+            if (result[index] != RESULT_UNKNOWN) {
+                continue;
+            }
+            Side_t side = (Side_t)(index >> 18);
+            set_up(&pos, type, side, (index >> 12) & 63, (index >> 6) & 63, index & 63);
+            Move_list_t list;
+            generate_legal_moves(&pos, &list);
+
+            bool win;
+            if (side == SIDE_WHITE) {
+                win = false;
+                for (int i = 0; i < list.count && !win; i++) {
+                    Chess_position_t child = pos;
+                    make_move(&child, list.moves[i]);
+                    win = child_wins(results, &child);
+                }
+            } else {
+                // Checkmate is a win, stalemate is not
+                win = list.count > 0 || is_in_check(&pos);
+                for (int i = 0; i < list.count && win; i++) {
+                    Chess_position_t child = pos;
+                    make_move(&child, list.moves[i]);
+                    win = child_wins(results, &child);
+                }
+            }
+            if (win) {
+                result[index] = RESULT_WIN;
+                changed++;
+            }
+        }
+        pass++;
+        if (verbose) {
+            fprintf(stderr, "%s pass %d: %d new wins\n", ending == BITBASE_KPK ? "KPK" : ending == BITBASE_KRK ? "KRK" : "KQK",
+                    pass, changed);
+        }
+    } while (changed);
+}
+
+// Copy the wins into the reduced table, every full position maps onto one bit
+static void pack(const uint8_t *result, Bitbase_ending_t ending, uint8_t *table)
+{
+    for (int index = 0; index < FULL_POSITIONS; index++) {
+        if (result[index] == RESULT_WIN) {
+            int bit = bitbase_index(ending, (Side_t)(index >> 18), (index >> 12) & 63, (index >> 6) & 63, index & 63);
+            table[bit >> 3] |= (uint8_t)(1 << (bit & 7));
+        }
+    }
+}
+
+void bitbase_generate(uint8_t *image, bool verbose)
+{
+    bitboard_init();
+    zobrist_init();
+    uint8_t *results[BITBASE_ENDING_NB];
+    for (int i = 0; i < BITBASE_ENDING_NB; i++) {
+        results[i] = malloc(FULL_POSITIONS);
+    }
+
+    // Promotions need the piece endings first
+    solve(results, BITBASE_KQK, PIECE_QUEEN, verbose);
+    solve(results, BITBASE_KRK, PIECE_ROOK, verbose);
+    solve(results, BITBASE_KPK, PIECE_PAWN, verbose);
+
+    memset(image, 0, BITBASE_SIZE);
+    memcpy(image, BITBASE_MAGIC, strlen(BITBASE_MAGIC));
+    uint8_t *table = image + BITBASE_HEADER_SIZE;
+    pack(results[BITBASE_KPK], BITBASE_KPK, table);
+    pack(results[BITBASE_KRK], BITBASE_KRK, table + BITBASE_KPK_BITS / 8);
+    pack(results[BITBASE_KQK], BITBASE_KQK, table + (BITBASE_KPK_BITS + BITBASE_PIECE_BITS) / 8);
+    for (int i = 0; i < BITBASE_ENDING_NB; i++) {
+        free(results[i]);
+    }
+}
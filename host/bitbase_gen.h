@@ -0,0 +1,16 @@
+// Retrograde generation of the KPK, KRK and KQK bitbases
+#ifndef BITBASE_GEN_H
+#define BITBASE_GEN_H
+
+#include <stdint.h>
+#include "bitbase.h"
+
+/**
+ * @brief Solve the endings and write a bitbase image
+ *
+ * @param image BITBASE_SIZE bytes
+ * @param verbose Print progress to stderr
+ */
+void bitbase_generate(uint8_t *image, bool verbose);
+
+#endif
@@ -0,0 +1,75 @@
+// Generates and probes the endgame bitbases
+//
+// Usage: bitbase_tool build <bitbase.bin>          solve KPK, KRK and KQK
+//        bitbase_tool probe <bitbase.bin> <fen>    result of a position and of each move
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bitbase_gen.h"
+#include "moves.h"
+
+static const char *result_names[] = {"not covered", "loss", "draw", "win"};
+
+static int build(const char *path)
+{
+    static uint8_t image[BITBASE_SIZE];
+    bitbase_generate(image, true);
+    FILE *out = fopen(path, "wb");
+    if (!out || fwrite(image, sizeof(image), 1, out) != 1) {
+        perror(path);
+        return EXIT_FAILURE;
+    }
+    fclose(out);
+    printf("%d bytes\n", BITBASE_SIZE);
+    return EXIT_SUCCESS;
+}
+
+static int probe(const char *path, const char *fen)
+{
+    static uint8_t image[BITBASE_SIZE];
+    FILE *in = fopen(path, "rb");
+    if (!in) {
+        perror(path);
+        return EXIT_FAILURE;
+    }
+    size_t size = fread(image, 1, sizeof(image), in);
+    fclose(in);
+
+    Bitbase_t bitbase;
+    Chess_position_t pos;
+    if (!bitbase_open_memory(&bitbase, image, size)) {
+        fprintf(stderr, "%s: not a bitbase image\n", path);
+        return EXIT_FAILURE;
+    }
+    if (!position_from_fen(&pos, fen)) {
+        fprintf(stderr, "invalid FEN: %s\n", fen);
+        return EXIT_FAILURE;
+    }
+    printf("%s to move: %s\n", pos.side_to_move == SIDE_WHITE ? "white" : "black",
+           result_names[bitbase_probe(&bitbase, &pos)]);
+
+    // Results are for the opponent after the move
+    Move_list_t list;
+    generate_legal_moves(&pos, &list);
+    for (int i = 0; i < list.count; i++) {
+        char san[MOVE_SAN_MAX];
+        Chess_position_t child = pos;
+        make_move(&child, list.moves[i]);
+        Bitbase_result_t result = bitbase_probe(&bitbase, &child);
+        const char *name = result == BITBASE_WIN ? "loss" : result == BITBASE_LOSS ? "win" : result_names[result];
+        printf("  %-7s %s\n", move_to_san(&pos, list.moves[i], san), name);
+    }
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc == 3 && strcmp(argv[1], "build") == 0) {
+        return build(argv[2]);
+    }
+    if (argc == 4 && strcmp(argv[1], "probe") == 0) {
+        return probe(argv[2], argv[3]);
+    }
+    fprintf(stderr, "usage: %s build <bitbase.bin> | probe <bitbase.bin> <fen>\n", argv[0]);
+    return EXIT_FAILURE;
+}
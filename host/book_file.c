@@ -0,0 +1,46 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "book_file.h"
+
+bool book_open_file(Opening_book_t *book, const char *path)
+{
+    book->data = NULL;
+    book->size = 0;
+    book->count = 0;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror(path);
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        perror(path);
+        close(fd);
+        return false;
+    }
+    if (st.st_size == 0) {
+        close(fd);
+        return true;
+    }
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        perror(path);
+        return false;
+    }
+    book_open_memory(book, data, st.st_size);
+    return true;
+}
+
+void book_close_file(Opening_book_t *book)
+{
+    if (book->data) {
+        munmap((void *)book->data, book->size);
+    }
+    book->data = NULL;
+    book->size = 0;
+    book->count = 0;
+}
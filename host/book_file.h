@@ -0,0 +1,24 @@
+// Opening books read from files on the host, mapped like the flash partition
+#ifndef BOOK_FILE_H
+#define BOOK_FILE_H
+
+#include <stdbool.h>
+#include "book.h"
+
+/**
+ * @brief Map a book file read only
+ *
+ * @param book The book
+ * @param path The file
+ * @return true on success, the error is printed otherwise
+ */
+bool book_open_file(Opening_book_t *book, const char *path);
+
+/**
+ * @brief Unmap a book opened with book_open_file()
+ *
+ * @param book The book
+ */
+void book_close_file(Opening_book_t *book);
+
+#endif
@@ -0,0 +1,218 @@
+// Builds, inspects and benchmarks opening books
+//
+// Usage: book_tool build <lines.txt> <book.bin> [plies]   one line of UCI moves per opening, '#' comments
+//        book_tool probe <book.bin> [fen]                  book moves of a position, the start by default
+//        book_tool bench <book.bin>                        lookups per second
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "book_file.h"
+
+#define BUILD_DEFAULT_PLIES 16
+#define BENCH_LOOKUPS 2000000
+
+static int64_t clock_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static Chess_move_t parse_uci(const Chess_position_t *pos, const char *uci)
+{
+    if (strlen(uci) < 4 || uci[0] < 'a' || uci[0] > 'h' || uci[1] < '1' || uci[1] > '8' ||
+            uci[2] < 'a' || uci[2] > 'h' || uci[3] < '1' || uci[3] > '8') {
+        return MOVE_NONE;
+    }
+    Piece_type_t promotion = PIECE_QUEEN;
+    switch (uci[4]) {
+    case 'n': promotion = PIECE_KNIGHT; break;
+    case 'b': promotion = PIECE_BISHOP; break;
+    case 'r': promotion = PIECE_ROOK; break;
+    default: break;
+    }
+    return find_legal_move(pos, SQUARE(uci[1] - '1', uci[0] - 'a'), SQUARE(uci[3] - '1', uci[2] - 'a'), promotion);
+}
+
+static int compare_entries(const void *a, const void *b)
+{
+    const Book_entry_t *x = a, *y = b;
+    if (x->key != y->key) {
+        return x->key < y->key ? -1 : 1;
+    }
+    if (x->move != y->move) {
+        return x->move < y->move ? -1 : 1;
+    }
+    return 0;
+}
+
+// Heaviest move first within a key, as Polyglot tools write them
+static int compare_weights(const void *a, const void *b)
+{
+    const Book_entry_t *x = a, *y = b;
+    if (x->key != y->key) {
+        return x->key < y->key ? -1 : 1;
+    }
+    return (int)y->weight - (int)x->weight;
+}
+
+static int build(const char *in_path, const char *out_path, int plies)
+{
+    FILE *in = fopen(in_path, "r");
+    if (!in) {
+        perror(in_path);
+        return EXIT_FAILURE;
+    }
+
+    size_t count = 0, capacity = 1024;
+    Book_entry_t *entries = malloc(capacity * sizeof(entries[0]));
+    char line[4096];
+    int line_number = 0, openings = 0, errors = 0;
+    while (fgets(line, sizeof(line), in)) {
+        line_number++;
+        char *comment = strchr(line, '#');
+        if (comment) {
+            *comment = '\0';
+        }
+
+        Chess_position_t pos;
+        position_set_start(&pos);
+        int ply = 0;
+        for (char *token = strtok(line, " \t\r\n"); token && ply < plies; token = strtok(NULL, " \t\r\n"), ply++) {
+            Chess_move_t move = parse_uci(&pos, token);
+            if (move == MOVE_NONE) {
+                fprintf(stderr, "%s:%d: illegal move %s\n", in_path, line_number, token);
+                errors++;
+                break;
+            }
+            if (count == capacity) {
+                capacity *= 2;
+                entries = realloc(entries, capacity * sizeof(entries[0]));
+            }
+            entries[count++] = (Book_entry_t){.key = pos.key, .move = book_move_from_chess(move), .weight = 1};
+            make_move(&pos, move);
+        }
+        openings += ply > 0;
+    }
+    fclose(in);
+
+    // Merge duplicates, the weight is how many openings play the move
+    size_t merged = 0;
+    qsort(entries, count, sizeof(entries[0]), compare_entries);
+    for (size_t i = 0; i < count; i++) {
+        if (merged > 0 && compare_entries(&entries[merged - 1], &entries[i]) == 0) {
+            if (entries[merged - 1].weight < UINT16_MAX) {
+                entries[merged - 1].weight++;
+            }
+        } else {
+            entries[merged++] = entries[i];
+        }
+    }
+    qsort(entries, merged, sizeof(entries[0]), compare_weights);
+
+    FILE *out = fopen(out_path, "wb");
+    if (!out) {
+        perror(out_path);
+        free(entries);
+        return EXIT_FAILURE;
+    }
+    for (size_t i = 0; i < merged; i++) {
+        uint8_t bytes[BOOK_ENTRY_SIZE];
+        book_write_entry(bytes, &entries[i]);
+        fwrite(bytes, sizeof(bytes), 1, out);
+    }
+    fclose(out);
+    free(entries);
+    printf("%d openings, %zu entries, %zu bytes\n", openings, merged, merged * BOOK_ENTRY_SIZE);
+    return errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+static int probe(const Opening_book_t *book, const char *fen)
+{
+    Chess_position_t pos;
+    if (!position_from_fen(&pos, fen)) {
+        fprintf(stderr, "invalid FEN: %s\n", fen);
+        return EXIT_FAILURE;
+    }
+
+    uint32_t total = 0;
+    Book_entry_t entry;
+    size_t first = book_find(book, pos.key);
+    for (size_t i = first; i < book->count; i++) {
+        book_read_entry(book, i, &entry);
+        if (entry.key != pos.key) {
+            break;
+        }
+        total += entry.weight;
+    }
+    printf("key %016llx, %s\n", (unsigned long long)pos.key, total ? "in book" : "not in book");
+    for (size_t i = first; i < book->count; i++) {
+        book_read_entry(book, i, &entry);
+        if (entry.key != pos.key) {
+            break;
+        }
+        char san[MOVE_SAN_MAX];
+        Chess_move_t move = book_move_to_chess(&pos, entry.move);
+        printf("  %-7s weight %5u %5.1f%%\n", move == MOVE_NONE ? "illegal" : move_to_san(&pos, move, san),
+               entry.weight, 100.0 * entry.weight / total);
+    }
+    return EXIT_SUCCESS;
+}
+
+static int bench(const Opening_book_t *book)
+{
+    if (book->count == 0) {
+        fprintf(stderr, "empty book\n");
+        return EXIT_FAILURE;
+    }
+
+    // Half of the lookups hit a book key, the other half miss
+    uint64_t *keys = malloc(BENCH_LOOKUPS * sizeof(keys[0]));
+    uint64_t seed = 0x9E3779B97F4A7C15ULL;
+    for (int i = 0; i < BENCH_LOOKUPS; i++) {
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        if (i % 2 == 0) {
+            Book_entry_t entry;
+            book_read_entry(book, seed % book->count, &entry);
+            keys[i] = entry.key;
+        } else {
+            keys[i] = seed;
+        }
+    }
+
+    size_t hits = 0;
+    int64_t start = clock_us();
+    for (int i = 0; i < BENCH_LOOKUPS; i++) {
+        hits += book_find(book, keys[i]) != book->count;
+    }
+    int64_t elapsed = clock_us() - start;
+    free(keys);
+    printf("%zu entries, %d lookups, %zu hits in %.3f s, %.1f M lookups/s\n", book->count, BENCH_LOOKUPS, hits,
+           elapsed / 1e6, BENCH_LOOKUPS / (double)elapsed);
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc >= 4 && strcmp(argv[1], "build") == 0) {
+        int plies = argc > 4 ? atoi(argv[4]) : BUILD_DEFAULT_PLIES;
+        return build(argv[2], argv[3], plies > 0 ? plies : BUILD_DEFAULT_PLIES);
+    }
+    if (argc >= 3 && (strcmp(argv[1], "probe") == 0 || strcmp(argv[1], "bench") == 0)) {
+        Opening_book_t book;
+        if (!book_open_file(&book, argv[2])) {
+            return EXIT_FAILURE;
+        }
+        int result = strcmp(argv[1], "bench") == 0
+                     ? bench(&book)
+                     : probe(&book, argc > 3 ? argv[3] : "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+        book_close_file(&book);
+        return result;
+    }
+    fprintf(stderr, "usage: %s build <lines.txt> <book.bin> [plies] | probe <book.bin> [fen] | bench <book.bin>\n",
+            argv[0]);
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,537 @@
+// Runs the firmware logic on a simulated board, from scripts or random games
+//
+// Usage: chessy_sim [options] script...       play scripted lifts and places, checking their expectations
+//        chessy_sim [options] --random N [seed]   play N random games and check every move is recorded
+// Options:
+//        --frames file          write every LED frame, "<ms> <64 pixel chars, a1 to h8>"
+//        --console file         firmware console output, discarded by default
+//        --max-latency-ms n     fail if a change takes longer to reach the LEDs
+//        --scan adaptive|fixed  scan policy, fixed scans back to back like before adaptive scanning
+//        --idle-after-ms n      quiet time before the adaptive policy goes idle
+//
+// Script lines, times in milliseconds (fractions allowed) and increasing:
+//        board start|empty|game magnets at time zero, game is the position of the resumed game
+//        setup check|skip       wait for the starting position or not
+//        resume e2e4 e7e5 ...   continue a journaled game
+//        <ms> -e2 +e4           lift and place pieces
+//        <ms> glitch e5         misread a square in one frame
+//        <ms> expect moves e2e4 ... | none
+//        <ms> expect state setup|playing|resume|takeback
+//        <ms> expect led e4 + e2 S ...     see sim_led()
+//        <ms> expect errors e2 e4 ... | none
+//        <ms> expect scan burst|active|idle
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "sim.h"
+
+#define SIM_MAX_PLIES 160
+
+static Sim_t sim;
+static FILE *report;
+static FILE *frames_out;
+static int64_t worst_latency_us;  // Over every game and script
+static bool fixed_scan;
+static int64_t idle_after_us = -1;  // -1 keeps the Kconfig default
+static const uint32_t fixed_gap_us = 0;
+static const char *mode_names[] = {
+    [SCAN_MODE_BURST] = "burst",
+    [SCAN_MODE_ACTIVE] = "active",
+    [SCAN_MODE_IDLE] = "idle",
+};
+
+static void write_frame(const Sim_led_frame_t *frame, void *ctx)
+{
+    (void)ctx;
+    fprintf(frames_out, "%lld ", (long long)(frame->time_us / 1000));
+    for (int sq = 0; sq < SQUARE_NB; sq++) {
+        fputc(sim_led(&sim, sq), frames_out);
+    }
+    fputc('\n', frames_out);
+}
+
+static int parse_square(const char *name)
+{
+    if (name[0] < 'a' || name[0] > 'h' || name[1] < '1' || name[1] > '8' || name[2] != '\0') {
+        return -1;
+    }
+    return SQUARE(name[1] - '1', name[0] - 'a');
+}
+
+static Chess_move_t parse_move(const Chess_position_t *pos, const char *uci)
+{
+    if (strlen(uci) < 4) {
+        return MOVE_NONE;
+    }
+    char from[3] = {uci[0], uci[1], '\0'}, to[3] = {uci[2], uci[3], '\0'};
+    if (parse_square(from) < 0 || parse_square(to) < 0) {
+        return MOVE_NONE;
+    }
+    return find_legal_move(pos, parse_square(from), parse_square(to), PIECE_QUEEN);
+}
+
+static void start_sim(Bitboard_t physical, bool check_setup, Game_record_t *resumed)
+{
+    sim_init(&sim, physical, check_setup, resumed);
+    if (fixed_scan) {
+        sim_set_policy(&sim, scan_fixed_policy(&fixed_gap_us));
+    } else if (idle_after_us >= 0) {
+        Scan_adaptive_config_t config = sim.adaptive.config;
+        config.idle_after_us = idle_after_us;
+        sim_set_policy(&sim, scan_adaptive_init(&sim.adaptive, &config, 0));
+    }
+    if (frames_out) {
+        sim.on_led_frame = write_frame;
+    }
+}
+
+static const char *moves_string(const Game_record_t *record, char *buf, size_t size)
+{
+    Game_record_iter_t iter;
+    Chess_move_t move;
+    size_t length = 0;
+    buf[0] = '\0';
+    game_record_iter_init(record, &iter);
+    while (game_record_next(record, &iter, &move) && length + 7 < size) {
+        char uci[6];
+        length += snprintf(buf + length, size - length, "%s%s", length ? " " : "", move_to_uci(move, uci));
+    }
+    return length ? buf : "none";
+}
+
+// Checks the rest of an expect line, returns false with a message on mismatch
+static bool check_expect(char *what, char *message, size_t size)
+{
+    char *kind = strtok(what, " \t\n");
+    if (!kind) {
+        snprintf(message, size, "empty expect");
+        return false;
+    }
+    if (strcmp(kind, "moves") == 0) {
+        char expected[1024] = "", actual[1024];
+        for (char *token = strtok(NULL, " \t\n"); token; token = strtok(NULL, " \t\n")) {
+            if (strlen(expected) + strlen(token) + 2 < sizeof(expected)) {
+                strcat(strcat(expected, expected[0] ? " " : ""), token);
+            }
+        }
+        const char *played = moves_string(&sim.game.record, actual, sizeof(actual));
+        if (strcmp(expected, played) != 0) {
+            snprintf(message, size, "expected moves %s, got %s", expected, played);
+            return false;
+        }
+        return true;
+    }
+    if (strcmp(kind, "state") == 0) {
+        static const char *names[] = {
+            [GAME_STATE_SETUP] = "setup",
+            [GAME_STATE_PLAYING] = "playing",
+            [GAME_STATE_RESUME] = "resume",
+            [GAME_STATE_TAKEBACK] = "takeback",
+        };
+        char *state = strtok(NULL, " \t\n");
+        if (!state || strcmp(state, names[sim.game.state]) != 0) {
+            snprintf(message, size, "expected state %s, got %s", state ? state : "?", names[sim.game.state]);
+            return false;
+        }
+        return true;
+    }
+    if (strcmp(kind, "led") == 0) {
+        char *name, *led;
+        while ((name = strtok(NULL, " \t\n")) && (led = strtok(NULL, " \t\n"))) {
+            int sq = parse_square(name);
+            if (sq < 0 || sim_led(&sim, sq) != led[0]) {
+                snprintf(message, size, "expected led %s %c, got %c", name, led[0], sq < 0 ? '?' : sim_led(&sim, sq));
+                return false;
+            }
+        }
+        return true;
+    }
+    if (strcmp(kind, "errors") == 0) {
+        Bitboard_t expected = 0;
+        for (char *token = strtok(NULL, " \t\n"); token; token = strtok(NULL, " \t\n")) {
+            if (strcmp(token, "none") != 0 && parse_square(token) >= 0) {
+                expected |= BB_SQUARE(parse_square(token));
+            }
+        }
+        if (sim.game.scene.errors != expected) {
+            snprintf(message, size, "expected errors %016llx, got %016llx", (unsigned long long)expected,
+                     (unsigned long long)sim.game.scene.errors);
+            return false;
+        }
+        return true;
+    }
+    if (strcmp(kind, "scan") == 0) {
+        char *mode = strtok(NULL, " \t\n");
+        if (!mode || strcmp(mode, mode_names[sim.mode]) != 0) {
+            snprintf(message, size, "expected scan %s, got %s", mode ? mode : "?", mode_names[sim.mode]);
+            return false;
+        }
+        return true;
+    }
+    snprintf(message, size, "unknown expect %s", kind);
+    return false;
+}
+
+static Bitboard_t board_occupancy(const char *board, const Chess_position_t *start, const Chess_position_t *game)
+{
+    if (strcmp(board, "empty") == 0) {
+        return 0;
+    }
+    return position_occupied(strcmp(board, "game") == 0 ? game : start);
+}
+
+static int run_script(const char *path)
+{
+    FILE *in = fopen(path, "r");
+    if (!in) {
+        perror(path);
+        return 1;
+    }
+
+    Chess_position_t start;
+    position_set_start(&start);
+    const char *board = "start";
+    bool check_setup = !CONFIG_CHESSY_SKIP_SETUP_CHECK;
+    bool started = false;
+    static Game_record_t resumed;
+    bool resuming = false;
+    Chess_position_t resumed_pos = start;
+    game_record_init(&resumed, &start);
+
+    char line[1024];
+    int line_number = 0, failures = 0;
+    while (fgets(line, sizeof(line), in)) {
+        line_number++;
+        char *comment = strchr(line, '#');
+        if (comment) {
+            *comment = '\0';
+        }
+        char *token = strtok(line, " \t\n");
+        if (!token) {
+            continue;
+        }
+
+        if (!started && strcmp(token, "board") == 0) {
+            char *name = strtok(NULL, " \t\n");
+            board = !name ? "start" : strcmp(name, "empty") == 0 ? "empty" : strcmp(name, "game") == 0 ? "game" : "start";
+            continue;
+        }
+        if (!started && strcmp(token, "setup") == 0) {
+            char *setup = strtok(NULL, " \t\n");
+            check_setup = setup && strcmp(setup, "check") == 0;
+            continue;
+        }
+        if (!started && strcmp(token, "resume") == 0) {
+            for (char *uci = strtok(NULL, " \t\n"); uci; uci = strtok(NULL, " \t\n")) {
+                Chess_move_t move = parse_move(&resumed_pos, uci);
+                if (move == MOVE_NONE) {
+                    fprintf(report, "%s:%d: illegal move %s\n", path, line_number, uci);
+                    failures++;
+                    break;
+                }
+                make_move(&resumed_pos, move);
+                game_record_append(&resumed, move, resumed_pos.key);
+            }
+            resuming = true;
+            continue;
+        }
+
+        char *end;
+        double ms = strtod(token, &end);
+        if (*end != '\0') {
+            fprintf(report, "%s:%d: unknown line %s\n", path, line_number, token);
+            failures++;
+            continue;
+        }
+        if (!started) {
+            start_sim(board_occupancy(board, &start, &resumed_pos), check_setup, resuming ? &resumed : NULL);
+            started = true;
+        }
+        sim_advance(&sim, (int64_t)(ms * 1000));
+
+        char *rest = strtok(NULL, "\n");
+        while (rest) {
+            char *word = strtok(rest, " \t");
+            rest = strtok(NULL, "\n");
+            if (!word) {
+                break;
+            }
+            if (strcmp(word, "expect") == 0) {
+                char message[2200];
+                if (!check_expect(rest ? rest : "", message, sizeof(message))) {
+                    fprintf(report, "%s:%d: %s\n", path, line_number, message);
+                    failures++;
+                }
+                break;
+            }
+            int sq = parse_square(word[0] == '+' || word[0] == '-' ? word + 1 : "");
+            if (strcmp(word, "glitch") == 0 && rest && (sq = parse_square(strtok(rest, " \t"))) >= 0) {
+                sim_glitch(&sim, sq);
+                rest = strtok(NULL, "\n");
+            } else if (sq >= 0 && word[0] == '-') {
+                sim_lift(&sim, sq);
+            } else if (sq >= 0 && word[0] == '+') {
+                sim_place(&sim, sq);
+            } else {
+                fprintf(report, "%s:%d: unknown action %s\n", path, line_number, word);
+                failures++;
+                break;
+            }
+        }
+    }
+    fclose(in);
+    if (!started) {
+        start_sim(board_occupancy(board, &start, &resumed_pos), check_setup, resuming ? &resumed : NULL);
+    }
+    game_record_clear(&resumed);
+    if (sim.latency_max_us > worst_latency_us) {
+        worst_latency_us = sim.latency_max_us;
+    }
+    fprintf(report, "%s: %s, %llu events, %llu LED frames, latency max %.1f ms\n", path,
+            failures ? "FAILED" : "ok", (unsigned long long)sim.events, (unsigned long long)sim.led_frames,
+            sim.latency_max_us / 1000.0);
+    sim_free(&sim);
+    return failures;
+}
+
+static uint64_t rng_state;
+
+static uint64_t rng_next(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+// Uniform in [low, high]
+static int64_t rng_range(int64_t low, int64_t high)
+{
+    return low + (int64_t)(rng_next() % (uint64_t)(high - low + 1));
+}
+
+static void at(int64_t *now_us, int64_t low_ms, int64_t high_ms)
+{
+    *now_us += rng_range(low_ms * 1000, high_ms * 1000);
+    sim_advance(&sim, *now_us);
+}
+
+// A piece landing can bounce off its sensor for a fraction of a frame
+static void place(int64_t *now_us, int sq)
+{
+    sim_place(&sim, sq);
+    if (rng_next() % 4 == 0) {
+        sim_advance(&sim, *now_us += 200);
+        sim_lift(&sim, sq);
+        sim_advance(&sim, *now_us += 300);
+        sim_place(&sim, sq);
+    }
+}
+
+// The lifts and places of a move, in one of the orders a player may use
+static void play_move(const Chess_position_t *pos, Chess_move_t move, int64_t *now_us)
+{
+    int from = MOVE_FROM(move), to = MOVE_TO(move);
+    int variant = (int)(rng_next() % 2);
+
+    at(now_us, 300, 3000);
+    if (rng_next() % 40 == 0) {
+        // The player walked away for a while
+        at(now_us, 20000, 120000);
+    }
+    if (rng_next() % 2) {
+        // Noise while the player thinks
+        sim_glitch(&sim, (int)(rng_next() % SQUARE_NB));
+        at(now_us, 50, 500);
+    }
+    if (MOVE_IS_CASTLE(move)) {
+        int rook_from = MOVE_FLAGS(move) == MOVE_FLAG_KING_CASTLE ? to + 1 : to - 2;
+        int rook_to = MOVE_FLAGS(move) == MOVE_FLAG_KING_CASTLE ? to - 1 : to + 1;
+        // The king goes first, a rook moved first is a rook move
+        sim_lift(&sim, from);
+        at(now_us, 100, 500);
+        if (variant) {
+            sim_lift(&sim, rook_from);
+            at(now_us, 100, 500);
+        }
+        place(now_us, to);
+        at(now_us, 100, 500);
+        if (!variant) {
+            sim_lift(&sim, rook_from);
+            at(now_us, 100, 500);
+        }
+        place(now_us, rook_to);
+    } else if (MOVE_FLAGS(move) == MOVE_FLAG_EN_PASSANT) {
+        int taken = pos->side_to_move == SIDE_WHITE ? to - 8 : to + 8;
+        if (variant) {
+            sim_lift(&sim, taken);
+            at(now_us, 100, 500);
+        }
+        sim_lift(&sim, from);
+        at(now_us, 100, 500);
+        place(now_us, to);
+        if (!variant) {
+            at(now_us, 100, 500);
+            sim_lift(&sim, taken);
+        }
+    } else if (MOVE_IS_CAPTURE(move)) {
+        sim_lift(&sim, variant ? to : from);
+        at(now_us, 100, 500);
+        sim_lift(&sim, variant ? from : to);
+        at(now_us, 100, 500);
+        place(now_us, to);
+    } else {
+        sim_lift(&sim, from);
+        at(now_us, 100, 800);
+        place(now_us, to);
+    }
+}
+
+// One random game, every move must come out of the firmware as it was played
+static bool random_game(int index, uint64_t *plies)
+{
+    Chess_position_t pos;
+    position_set_start(&pos);
+    start_sim(position_occupied(&pos), false, NULL);
+
+    Chess_move_t played[SIM_MAX_PLIES];
+    int count = 0;
+    int64_t now_us = 0;
+    Move_list_t list;
+    while (count < SIM_MAX_PLIES && generate_legal_moves(&pos, &list) > 0) {
+        // The board cannot see which piece a pawn promotes to, it is a queen
+        Chess_move_t move;
+        do {
+            move = list.moves[rng_next() % (uint64_t)list.count];
+        } while (MOVE_IS_PROMOTION(move) && MOVE_PROMOTION_PIECE(move) != PIECE_QUEEN);
+        play_move(&pos, move, &now_us);
+        make_move(&pos, move);
+        played[count++] = move;
+    }
+    sim_advance(&sim, now_us + 1000000);
+
+    bool ok = sim.game.state == GAME_STATE_PLAYING && sim.game.record.count == (uint32_t)count &&
+              sim.game.pos.key == pos.key;
+    for (int i = 0; ok && i < count; i++) {
+        ok = game_record_get(&sim.game.record, i) == played[i];
+    }
+    if (!ok) {
+        char actual[2048];
+        fprintf(report, "game %d: %d moves played, recorded %s\n", index, count,
+                moves_string(&sim.game.record, actual, sizeof(actual)));
+    }
+    *plies += count;
+    return ok;
+}
+
+static double seconds_since(const struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static int run_random(int games, uint64_t seed)
+{
+    struct timespec start;
+    uint64_t plies = 0, events = 0, led_frames = 0, latency_count = 0, frames = 0;
+    int64_t virtual_us = 0, latency_sum = 0, mode_us[SCAN_MODE_NB] = {0};
+    int failures = 0;
+
+    rng_state = seed ? seed : 1;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < games; i++) {
+        failures += !random_game(i, &plies);
+        virtual_us += sim.now_us;
+        events += sim.events;
+        led_frames += sim.led_frames;
+        frames += sim.frames;
+        for (int mode = 0; mode < SCAN_MODE_NB; mode++) {
+            mode_us[mode] += sim.mode_us[mode];
+        }
+        latency_count += sim.latency_count;
+        latency_sum += sim.latency_sum_us;
+        if (sim.latency_max_us > worst_latency_us) {
+            worst_latency_us = sim.latency_max_us;
+        }
+        sim_free(&sim);
+    }
+    double seconds = seconds_since(&start);
+
+    fprintf(report, "%d games, %llu plies, %llu events, %llu LED frames, %d failed\n", games,
+            (unsigned long long)plies, (unsigned long long)events, (unsigned long long)led_frames, failures);
+    fprintf(report, "%.0f s of play in %.2f s, %.0fx real time\n", virtual_us / 1e6, seconds,
+            virtual_us / 1e6 / seconds);
+    fprintf(report, "%.0f scan frames per second, %.1f%% burst, %.1f%% active, %.1f%% idle\n",
+            frames / (virtual_us / 1e6), 100.0 * mode_us[SCAN_MODE_BURST] / virtual_us,
+            100.0 * mode_us[SCAN_MODE_ACTIVE] / virtual_us, 100.0 * mode_us[SCAN_MODE_IDLE] / virtual_us);
+    fprintf(report, "change to LED latency avg %.1f ms, max %.1f ms\n",
+            latency_count ? latency_sum / 1000.0 / latency_count : 0.0, worst_latency_us / 1000.0);
+    return failures;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *console = "/dev/null";
+    double max_latency_ms = 0;
+    int random_games = 0;
+    uint64_t seed = 1;
+    int arg = 1;
+
+    for (; arg < argc && strncmp(argv[arg], "--", 2) == 0; arg++) {
+        if (strcmp(argv[arg], "--frames") == 0 && arg + 1 < argc) {
+            frames_out = fopen(argv[++arg], "w");
+            if (!frames_out) {
+                perror(argv[arg]);
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[arg], "--console") == 0 && arg + 1 < argc) {
+            console = argv[++arg];
+        } else if (strcmp(argv[arg], "--max-latency-ms") == 0 && arg + 1 < argc) {
+            max_latency_ms = atof(argv[++arg]);
+        } else if (strcmp(argv[arg], "--scan") == 0 && arg + 1 < argc) {
+            fixed_scan = strcmp(argv[++arg], "fixed") == 0;
+        } else if (strcmp(argv[arg], "--idle-after-ms") == 0 && arg + 1 < argc) {
+            idle_after_us = (int64_t)atof(argv[++arg]) * 1000;
+        } else if (strcmp(argv[arg], "--random") == 0 && arg + 1 < argc) {
+            random_games = atoi(argv[++arg]);
+            if (arg + 1 < argc) {
+                seed = strtoull(argv[++arg], NULL, 0);
+            }
+        } else {
+            fprintf(stderr, "unknown option %s\n", argv[arg]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (!random_games && arg == argc) {
+        fprintf(stderr, "usage: %s [--frames file] [--console file] [--max-latency-ms n] [--scan adaptive|fixed] "
+                "[--idle-after-ms n] script... | --random games [seed]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    // The firmware prints to stdout, the report keeps the original one
+    report = fdopen(dup(STDOUT_FILENO), "w");
+    if (!report || !freopen(console, "w", stdout)) {
+        perror(console);
+        return EXIT_FAILURE;
+    }
+
+    int failures = 0;
+    if (random_games) {
+        failures = run_random(random_games, seed);
+    }
+    for (; arg < argc; arg++) {
+        failures += run_script(argv[arg]);
+    }
+    if (max_latency_ms > 0 && worst_latency_us > max_latency_ms * 1000) {
+        fprintf(report, "latency %.1f ms over the %.1f ms limit\n", worst_latency_us / 1000.0, max_latency_ms);
+        failures++;
+    }
+    if (frames_out) {
+        fclose(frames_out);
+    }
+    fclose(report);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,283 @@
+// Engine strength and speed benchmark
+//
+// Usage: engine_bench                  tactical suite at a fixed depth
+//        engine_bench nnue             the same suite evaluated with the network
+//        engine_bench mates [threads]  check forced mates are found, for ctest
+//        engine_bench smp [threads]    suite on 1, 2, 4 ... threads, time to depth speedup
+//        engine_bench <ms> [fen]       search one position for a time, printing every report
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include "search.h"
+#include "search_threads.h"
+
+#define BENCH_DEPTH 7
+#define BENCH_SMP_DEPTH 8
+#define BENCH_TT_ENTRIES (1 << 20)  // 16 MB
+
+typedef struct {
+    const char *name;
+    const char *fen;
+    const char *best;   // UCI, any move is fine if NULL
+} Bench_case_t;
+
+static const Bench_case_t bench_suite[] = {
+    {"start", "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", NULL},
+    {"kiwipete", "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", NULL},
+    {"WAC.001", "2rr3k/pp3pp1/1nnqbN1p/3pN3/2pP4/2P3Q1/PPB4P/R4RK1 w - - 0 1", "g3g6"},
+    {"WAC.002", "8/7p/5k2/5p2/p1p2P2/Pr1pPK2/1P1R3P/8 b - - 0 1", "b3b2"},
+    {"WAC.004", "r1bq2rk/pp3pbp/2p1p1pQ/7P/3P4/2PB1N2/PP3PPR/2KR4 w - - 0 1", "h6h7"},
+    {"WAC.005", "5k2/6pp/p1qN4/1p1p4/3P4/2PKP2Q/PP3r2/3R4 b - - 0 1", "c6c4"},
+    {"back rank", "6k1/5ppp/8/8/8/8/8/R5K1 w - - 0 1", "a1a8"},
+};
+
+typedef struct {
+    const char *fen;
+    int moves;          // Mate in this many moves for the side to move
+} Mate_case_t;
+
+static const Mate_case_t mate_suite[] = {
+    {"6k1/5ppp/8/8/8/8/8/R5K1 w - - 0 1", 1},
+    {"rnbqkbnr/ppppp2p/5p2/6p1/4P3/8/PPPP1PPP/RNBQKBNR w KQkq g6 0 3", 1},
+    {"r1bqkb1r/pppp1ppp/2n2n2/4p2Q/2B1P3/8/PPPP1PPP/RNB1K1NR w KQkq - 4 4", 1},
+    {"k7/8/2K5/8/8/8/8/7R w - - 0 1", 2},
+    {"6k1/8/6K1/8/8/8/8/3R4 w - - 0 1", 1},
+    {"r5rk/5p1p/5R2/4B3/8/8/7P/7K w - - 0 1", 3},
+};
+
+static int64_t clock_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void print_report(const Search_report_t *report, void *ctx)
+{
+    (void)ctx;
+    char uci[6];
+    printf("info depth %d score %d nodes %llu time %lld pv", report->depth, report->score,
+           (unsigned long long)report->nodes, (long long)(report->elapsed_us / 1000));
+    for (int i = 0; i < report->pv_length; i++) {
+        printf(" %s", move_to_uci(report->pv[i], uci));
+    }
+    printf("%s\n", report->done ? " (done)" : "");
+}
+
+static Tt_t tt;
+
+static void tt_setup(void)
+{
+    Tt_entry_t *entries = calloc(BENCH_TT_ENTRIES, sizeof(Tt_entry_t));
+    if (!entries) {
+        fprintf(stderr, "out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    tt_init(&tt, entries, BENCH_TT_ENTRIES);
+}
+
+static Search_t *searches_new(int count)
+{
+    Search_t *searches = calloc(count, sizeof(Search_t));
+    if (!searches) {
+        fprintf(stderr, "out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    searches[0].clock_us = clock_us;
+    searches[0].tt = &tt;
+    return searches;
+}
+
+static int thread_count(const char *arg)
+{
+    int threads = arg ? atoi(arg) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    return threads < 1 ? 1 : threads > SEARCH_THREADS_MAX ? SEARCH_THREADS_MAX : threads;
+}
+
+// Brute force check that the side to move can force mate within the given moves
+static bool forces_mate(const Chess_position_t *pos, int moves)
+{
+    Move_list_t list;
+    generate_legal_moves(pos, &list);
+    for (int i = 0; i < list.count; i++) {
+        Chess_position_t child = *pos;
+        make_move(&child, list.moves[i]);
+        Move_list_t replies;
+        int count = generate_legal_moves(&child, &replies);
+        if (count == 0) {
+            if (is_in_check(&child)) {
+                return true;
+            }
+            continue;
+        }
+        if (moves == 1) {
+            continue;
+        }
+        bool all_mated = true;
+        for (int j = 0; j < count && all_mated; j++) {
+            Chess_position_t grandchild = child;
+            make_move(&grandchild, replies.moves[j]);
+            all_mated = forces_mate(&grandchild, moves - 1);
+        }
+        if (all_mated) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static int run_mates(int threads)
+{
+    Search_t *searches = searches_new(threads);
+    int failures = 0;
+
+    for (size_t i = 0; i < sizeof(mate_suite) / sizeof(mate_suite[0]); i++) {
+        const Mate_case_t *test = &mate_suite[i];
+        Chess_position_t pos;
+        position_from_fen(&pos, test->fen);
+        Search_limits_t limits = {.max_depth = 2 * test->moves + 1};
+        search_init(&searches[0], &limits);
+        tt_clear(&tt);
+        const Search_report_t *report = search_threads_run(searches, threads, &pos, NULL);
+
+        // The move has to keep a forced mate in one move less for every reply
+        char uci[6];
+        Chess_position_t child = pos;
+        make_move(&child, report->best_move);
+        Move_list_t replies;
+        bool mates = generate_legal_moves(&child, &replies) == 0 && is_in_check(&child);
+        for (int j = 0; j < replies.count && test->moves > 1; j++) {
+            Chess_position_t grandchild = child;
+            make_move(&grandchild, replies.moves[j]);
+            mates = forces_mate(&grandchild, test->moves - 1);
+            if (!mates) {
+                break;
+            }
+        }
+        bool ok = mates && report->score == SEARCH_MATE - (2 * test->moves - 1);
+        printf("%s mate in %d: %s score %d nodes %llu\n", ok ? "ok  " : "FAIL", test->moves,
+               move_to_uci(report->best_move, uci), report->score, (unsigned long long)report->nodes);
+        failures += !ok;
+    }
+    free(searches);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+static int run_suite(bool use_nnue)
+{
+    Search_t *search = searches_new(1);
+    search->use_nnue = use_nnue;
+    uint64_t total_nodes = 0;
+    int64_t total_us = 0;
+    int solved = 0, tactics = 0;
+
+    for (size_t i = 0; i < sizeof(bench_suite) / sizeof(bench_suite[0]); i++) {
+        const Bench_case_t *test = &bench_suite[i];
+        Chess_position_t pos;
+        position_from_fen(&pos, test->fen);
+        Search_limits_t limits = {.max_depth = BENCH_DEPTH};
+        search_init(search, &limits);
+        tt_clear(&tt);
+        const Search_report_t *report = search_run(search, &pos);
+
+        char uci[6];
+        move_to_uci(report->best_move, uci);
+        const char *verdict = "    ";
+        if (test->best) {
+            tactics++;
+            bool ok = strcmp(uci, test->best) == 0;
+            solved += ok;
+            verdict = ok ? "ok  " : "miss";
+        }
+        printf("%s %-10s depth %d %-5s score %6d %10llu nodes %7.3f s %7.0f knps\n", verdict, test->name,
+               report->depth, uci, report->score, (unsigned long long)report->nodes, report->elapsed_us / 1e6,
+               report->nodes / (report->elapsed_us / 1e3));
+        total_nodes += report->nodes;
+        total_us += report->elapsed_us;
+    }
+    printf("%d of %d tactics solved, %llu nodes in %.3f s, %.0f knps\n", solved, tactics,
+           (unsigned long long)total_nodes, total_us / 1e6, total_nodes / (total_us / 1e3));
+    free(search);
+    return EXIT_SUCCESS;
+}
+
+// Lazy SMP gains little in node rate per thread, it shows as the time to reach the same depth
+static int run_smp(int max_threads)
+{
+    Search_t *searches = searches_new(max_threads);
+    double seconds[SEARCH_THREADS_MAX];
+    uint64_t nodes[SEARCH_THREADS_MAX];
+    int counts[SEARCH_THREADS_MAX], runs = 0;
+
+    for (int threads = 1;; threads = threads * 2 < max_threads ? threads * 2 : max_threads) {
+        int64_t total_us = 0;
+        uint64_t total_nodes = 0;
+        int solved = 0;
+        for (size_t i = 0; i < sizeof(bench_suite) / sizeof(bench_suite[0]); i++) {
+            const Bench_case_t *test = &bench_suite[i];
+            Chess_position_t pos;
+            position_from_fen(&pos, test->fen);
+            Search_limits_t limits = {.max_depth = BENCH_SMP_DEPTH};
+            search_init(&searches[0], &limits);
+            tt_clear(&tt);
+            uint64_t position_nodes;
+            int64_t start_us = clock_us();
+            const Search_report_t *report = search_threads_run(searches, threads, &pos, &position_nodes);
+            total_us += clock_us() - start_us;
+            total_nodes += position_nodes;
+            char uci[6];
+            solved += test->best && strcmp(move_to_uci(report->best_move, uci), test->best) == 0;
+        }
+        printf("%2d threads: %d tactics solved, %llu nodes in %.3f s, %.0f knps\n", threads, solved,
+               (unsigned long long)total_nodes, total_us / 1e6, total_nodes / (total_us / 1e3));
+        seconds[runs] = total_us / 1e6;
+        nodes[runs] = total_nodes;
+        counts[runs++] = threads;
+        if (threads == max_threads) {
+            break;
+        }
+    }
+
+    printf("threads  seconds  speedup  nps scaling\n");
+    for (int i = 0; i < runs; i++) {
+        double nps_ratio = (nodes[i] / seconds[i]) / (nodes[0] / seconds[0]);
+        printf("%7d %8.3f %8.2f %12.2f\n", counts[i], seconds[i], seconds[0] / seconds[i], nps_ratio);
+    }
+    free(searches);
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+    tt_setup();
+    if (argc < 2) {
+        return run_suite(false);
+    }
+    if (strcmp(argv[1], "nnue") == 0) {
+        return run_suite(true);
+    }
+    if (strcmp(argv[1], "mates") == 0) {
+        return run_mates(argc > 2 ? thread_count(argv[2]) : 1);
+    }
+    if (strcmp(argv[1], "smp") == 0) {
+        return run_smp(thread_count(argc > 2 ? argv[2] : NULL));
+    }
+
+    static Search_t search;
+    Chess_position_t pos;
+    int ms = atoi(argv[1]);
+    if (ms <= 0 || !position_from_fen(&pos, argc > 2 ? argv[2] : bench_suite[0].fen)) {
+        fprintf(stderr, "usage: %s [nnue | mates [threads] | smp [threads] | <ms> [fen]]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    Search_limits_t limits = {.time_limit_us = (int64_t)ms * 1000};
+    search.clock_us = clock_us;
+    search.tt = &tt;
+    search.on_report = print_report;
+    search_init(&search, &limits);
+    char uci[6];
+    printf("bestmove %s\n", move_to_uci(search_run(&search, &pos)->best_move, uci));
+    return EXIT_SUCCESS;
+}
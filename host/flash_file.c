@@ -0,0 +1,128 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "flash_file.h"
+
+bool flash_file_open(Flash_file_t *flash, const char *path, uint32_t size)
+{
+    memset(flash, 0, sizeof(*flash));
+    flash->budget = -1;
+    flash->size = size;
+    flash->fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (flash->fd < 0) {
+        perror(path);
+        return false;
+    }
+    struct stat st;
+    if (fstat(flash->fd, &st) != 0) {
+        perror(path);
+        close(flash->fd);
+        return false;
+    }
+    // Flash comes erased
+    uint8_t erased[FLASH_RING_SECTOR_SIZE];
+    memset(erased, 0xFF, sizeof(erased));
+    for (uint32_t offset = (uint32_t)st.st_size; offset < size; offset += sizeof(erased)) {
+        size_t chunk = size - offset < sizeof(erased) ? size - offset : sizeof(erased);
+        if (pwrite(flash->fd, erased, chunk, offset) != (ssize_t)chunk) {
+            perror(path);
+            close(flash->fd);
+            return false;
+        }
+    }
+    flash->erase_counts = calloc(size / FLASH_RING_SECTOR_SIZE, sizeof(flash->erase_counts[0]));
+    return true;
+}
+
+void flash_file_close(Flash_file_t *flash)
+{
+    close(flash->fd);
+    free(flash->erase_counts);
+    flash->erase_counts = NULL;
+}
+
+static esp_err_t file_read(void *ctx, uint32_t offset, void *data, size_t size)
+{
+    Flash_file_t *flash = ctx;
+    if (flash->cut) {
+        return ESP_FAIL;
+    }
+    if (offset + size > flash->size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    return pread(flash->fd, data, size, offset) == (ssize_t)size ? ESP_OK : ESP_FAIL;
+}
+
+static esp_err_t file_write(void *ctx, uint32_t offset, const void *data, size_t size)
+{
+    Flash_file_t *flash = ctx;
+    uint8_t bytes[FLASH_RING_SECTOR_SIZE];
+    if (flash->cut) {
+        return ESP_FAIL;
+    }
+    if (offset + size > flash->size || size > sizeof(bytes)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    size_t done = size;
+    if (flash->budget >= 0 && (int64_t)size > flash->budget) {
+        done = (size_t)flash->budget;
+        flash->cut = true;
+    }
+    // Programming only clears bits
+    if (pread(flash->fd, bytes, done, offset) != (ssize_t)done) {
+        return ESP_FAIL;
+    }
+    for (size_t i = 0; i < done; i++) {
+        bytes[i] &= ((const uint8_t *)data)[i];
+    }
+    if (pwrite(flash->fd, bytes, done, offset) != (ssize_t)done) {
+        return ESP_FAIL;
+    }
+    flash->written += done;
+    if (flash->budget >= 0) {
+        flash->budget -= done;
+    }
+    return flash->cut ? ESP_FAIL : ESP_OK;
+}
+
+static esp_err_t file_erase_sector(void *ctx, uint32_t offset)
+{
+    Flash_file_t *flash = ctx;
+    uint8_t erased[FLASH_RING_SECTOR_SIZE];
+    if (flash->cut) {
+        return ESP_FAIL;
+    }
+    if (offset % FLASH_RING_SECTOR_SIZE || offset + FLASH_RING_SECTOR_SIZE > flash->size) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    // A cut erase leaves the second half as it was
+    size_t size = FLASH_RING_SECTOR_SIZE;
+    if (flash->budget == 0) {
+        size /= 2;
+        flash->cut = true;
+    }
+    memset(erased, 0xFF, size);
+    if (pwrite(flash->fd, erased, size, offset) != (ssize_t)size) {
+        return ESP_FAIL;
+    }
+    flash->written++;
+    flash->erase_counts[offset / FLASH_RING_SECTOR_SIZE]++;
+    if (flash->budget > 0) {
+        flash->budget--;
+    }
+    return flash->cut ? ESP_FAIL : ESP_OK;
+}
+
+void flash_file_io(Flash_file_t *flash, Flash_ring_io_t *out)
+{
+    *out = (Flash_ring_io_t) {
+        .read = file_read,
+        .write = file_write,
+        .erase_sector = file_erase_sector,
+        .ctx = flash,
+        .size = flash->size,
+    };
+}
@@ -0,0 +1,53 @@
+// NOR flash emulated in a file on the host, with power cuts on demand
+#ifndef FLASH_FILE_H
+#define FLASH_FILE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "flash_ring.h"
+
+/**
+ * @brief A file behaving like a NOR flash area
+ *
+ * Writes can only clear bits and erases set whole sectors to 0xFF. Once
+ * the write budget is used up the power is cut: the write or erase in
+ * progress is left half done and every access fails until the budget is
+ * reset, as after a reboot.
+ */
+typedef struct {
+    int fd;
+    uint32_t size;
+    int64_t budget;                 // Bytes that can still be written, an erase costs one, negative for no limit
+    bool cut;                       // The power was cut
+    uint64_t written;               // Bytes written and erases, power cuts included
+    uint32_t *erase_counts;         // Per sector
+} Flash_file_t;
+
+/**
+ * @brief Open or create an emulated flash file
+ *
+ * A new or shorter file is extended with erased bytes.
+ *
+ * @param flash The flash
+ * @param path The file
+ * @param size Size of the area, a multiple of FLASH_RING_SECTOR_SIZE
+ * @return true on success, the error is printed otherwise
+ */
+bool flash_file_open(Flash_file_t *flash, const char *path, uint32_t size);
+
+/**
+ * @brief Close an emulated flash file
+ *
+ * @param flash The flash
+ */
+void flash_file_close(Flash_file_t *flash);
+
+/**
+ * @brief Get ring access to an emulated flash
+ *
+ * @param flash The flash
+ * @param out Set to read, write and erase the file
+ */
+void flash_file_io(Flash_file_t *flash, Flash_ring_io_t *out);
+
+#endif
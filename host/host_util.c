@@ -0,0 +1,22 @@
+#include "host_util.h"
+
+uint64_t host_random(uint64_t *seed)
+{
+    *seed ^= *seed << 13;
+    *seed ^= *seed >> 7;
+    *seed ^= *seed << 17;
+    return *seed;
+}
+
+bool host_same_moves(const Game_record_t *a, const Game_record_t *b)
+{
+    if (a->count != b->count || a->start.key != b->start.key) {
+        return false;
+    }
+    for (uint32_t i = 0; i < a->count; i++) {
+        if (game_record_get(a, i) != game_record_get(b, i)) {
+            return false;
+        }
+    }
+    return true;
+}
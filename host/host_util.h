@@ -0,0 +1,26 @@
+// Helpers shared by the host tests and tools
+#ifndef HOST_UTIL_H
+#define HOST_UTIL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "game_record.h"
+
+/**
+ * @brief Next number of a xorshift generator
+ *
+ * @param seed The state, not 0
+ * @return uint64_t The number
+ */
+uint64_t host_random(uint64_t *seed);
+
+/**
+ * @brief Compare two recorded games
+ *
+ * @param a A game
+ * @param b Another game
+ * @return true if both start from the same position and play the same moves
+ */
+bool host_same_moves(const Game_record_t *a, const Game_record_t *b);
+
+#endif
@@ -0,0 +1,20 @@
+// Kconfig defaults for host builds of firmware code, see main/Kconfig.projbuild
+#ifndef SDKCONFIG_H
+#define SDKCONFIG_H
+
+#define CONFIG_IDF_TARGET_LINUX 1
+#define CONFIG_CHESSY_HALL_SETTLE_US 100
+#define CONFIG_CHESSY_HALL_ACTIVE_LOW 1
+#define CONFIG_CHESSY_HALL_DEBOUNCE_DEPTH 4
+#define CONFIG_CHESSY_HALL_DEBOUNCE_VOTES 3
+#define CONFIG_CHESSY_SCAN_ACTIVE_GAP_US 4200
+#define CONFIG_CHESSY_SCAN_SETTLE_MS 300
+#define CONFIG_CHESSY_SCAN_IDLE_AFTER_S 60
+#define CONFIG_CHESSY_SCAN_IDLE_GAP_MS 100
+#define CONFIG_CHESSY_LED_FPS 50
+#define CONFIG_CHESSY_LED_BRIGHTNESS 255
+#define CONFIG_CHESSY_SKIP_SETUP_CHECK 1
+#define CONFIG_CHESSY_PUZZLE_TABLE_LOG2 11
+#define CONFIG_CHESSY_PUZZLE_NODE_LIMIT 500000
+
+#endif
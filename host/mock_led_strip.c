@@ -0,0 +1,51 @@
+#include <string.h>
+#include "mock_led_strip.h"
+
+struct led_strip_t {
+    Mock_led_strip_t *state;
+};
+
+static struct led_strip_t mock_strip;
+
+led_strip_handle_t mock_led_strip_new(Mock_led_strip_t *state)
+{
+    memset(state, 0, sizeof(*state));
+    mock_strip.state = state;
+    return &mock_strip;
+}
+
+esp_err_t led_strip_new_rmt_device(const led_strip_config_t *led_config, const led_strip_rmt_config_t *rmt_config,
+                                   led_strip_handle_t *ret_strip)
+{
+    (void)led_config;
+    (void)rmt_config;
+    *ret_strip = &mock_strip;
+    return ESP_OK;
+}
+
+esp_err_t led_strip_set_pixel(led_strip_handle_t strip, uint32_t index, uint32_t red, uint32_t green, uint32_t blue)
+{
+    if (index >= MOCK_LED_STRIP_MAX_LEDS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    strip->state->pixels[index][0] = red;
+    strip->state->pixels[index][1] = green;
+    strip->state->pixels[index][2] = blue;
+    strip->state->set_pixel_calls++;
+    return ESP_OK;
+}
+
+esp_err_t led_strip_refresh(led_strip_handle_t strip)
+{
+    strip->state->refresh_calls++;
+    if (strip->state->on_refresh) {
+        strip->state->on_refresh(strip->state->ctx);
+    }
+    return ESP_OK;
+}
+
+esp_err_t led_strip_clear(led_strip_handle_t strip)
+{
+    memset(strip->state->pixels, 0, sizeof(strip->state->pixels));
+    return led_strip_refresh(strip);
+}
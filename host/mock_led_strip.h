@@ -0,0 +1,26 @@
+// Recording led_strip implementation for host tests
+#ifndef MOCK_LED_STRIP_H
+#define MOCK_LED_STRIP_H
+
+#include <stdint.h>
+#include "led_strip.h"
+
+#define MOCK_LED_STRIP_MAX_LEDS 64
+
+typedef struct {
+    uint8_t pixels[MOCK_LED_STRIP_MAX_LEDS][3];
+    unsigned int set_pixel_calls;
+    unsigned int refresh_calls;
+    void (*on_refresh)(void *ctx);  // Optional, called after every refresh to record the frame
+    void *ctx;
+} Mock_led_strip_t;
+
+/**
+ * @brief Create a strip whose calls are recorded in state
+ *
+ * @param state Pixel buffer and call counters
+ * @return led_strip_handle_t The strip
+ */
+led_strip_handle_t mock_led_strip_new(Mock_led_strip_t *state);
+
+#endif
@@ -0,0 +1,134 @@
+// Network evaluation benchmark: full recomputation against incremental updates, scalar and vector kernels
+//
+// Usage: nnue_bench [games]   random games, 200 by default
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "evaluate.h"
+#include "moves.h"
+#include "nnue.h"
+
+#define MAX_PLIES 120
+#define ROUNDS 20
+
+typedef struct {
+    Chess_position_t pos;   // Before the move
+    Chess_move_t move;
+} Ply_t;
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint32_t rng_state = 12345;
+
+static uint32_t rng_next(void)
+{
+    rng_state = rng_state * 1664525 + 1013904223;
+    return rng_state >> 8;
+}
+
+// Random games, so the positions have the usual mix of quiet moves and captures
+static int play_games(Ply_t *plies, int games, int *game_starts)
+{
+    int count = 0;
+    for (int g = 0; g < games; g++) {
+        Chess_position_t pos;
+        position_set_start(&pos);
+        game_starts[g] = count;
+        for (int i = 0; i < MAX_PLIES; i++) {
+            Move_list_t list;
+            if (generate_legal_moves(&pos, &list) == 0) {
+                break;
+            }
+            plies[count].pos = pos;
+            plies[count].move = list.moves[rng_next() % list.count];
+            make_move(&pos, plies[count++].move);
+        }
+    }
+    game_starts[games] = count;
+    return count;
+}
+
+static double bench_full(const Ply_t *plies, int count, int64_t *checksum)
+{
+    Nnue_accumulator_t acc;
+    double start = now_seconds();
+    for (int r = 0; r < ROUNDS; r++) {
+        for (int i = 0; i < count; i++) {
+            nnue_refresh(&acc, &plies[i].pos);
+            *checksum += nnue_evaluate(&acc, plies[i].pos.side_to_move);
+        }
+    }
+    return count * (double)ROUNDS / (now_seconds() - start);
+}
+
+// Each game is refreshed once, then follows its moves
+static double bench_incremental(const Ply_t *plies, const int *game_starts, int games, int64_t *checksum)
+{
+    Nnue_accumulator_t acc[2];
+    int count = game_starts[games];
+    double start = now_seconds();
+    for (int r = 0; r < ROUNDS; r++) {
+        for (int g = 0; g < games; g++) {
+            nnue_refresh(&acc[0], &plies[game_starts[g]].pos);
+            for (int i = game_starts[g]; i < game_starts[g + 1]; i++) {
+                const Ply_t *ply = &plies[i];
+                *checksum += nnue_evaluate(&acc[i & 1], ply->pos.side_to_move);
+                nnue_update(&acc[!(i & 1)], &acc[i & 1], &ply->pos, ply->move);
+            }
+        }
+    }
+    return count * (double)ROUNDS / (now_seconds() - start);
+}
+
+static double bench_tables(const Ply_t *plies, int count, int64_t *checksum)
+{
+    double start = now_seconds();
+    for (int r = 0; r < ROUNDS; r++) {
+        for (int i = 0; i < count; i++) {
+            *checksum += evaluate(&plies[i].pos);
+        }
+    }
+    return count * (double)ROUNDS / (now_seconds() - start);
+}
+
+int main(int argc, char *argv[])
+{
+    int games = argc > 1 ? atoi(argv[1]) : 200;
+    if (games <= 0) {
+        fprintf(stderr, "usage: %s [games]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    Ply_t *plies = malloc((size_t)games * MAX_PLIES * sizeof(Ply_t));
+    int *game_starts = malloc((games + 1) * sizeof(int));
+    if (!plies || !game_starts) {
+        fprintf(stderr, "out of memory\n");
+        return EXIT_FAILURE;
+    }
+    int count = play_games(plies, games, game_starts);
+    printf("%d positions from %d random games, %zu bytes of weights\n", count, games, sizeof(nnue_net));
+
+    static const char *names[] = {"scalar", "vector"};
+    int64_t checksums[2] = {0, 0};
+    printf("kernels  full Meval/s  incremental Meval/s  gain\n");
+    for (int k = NNUE_KERNELS_SCALAR; k <= NNUE_KERNELS_VECTOR; k++) {
+        nnue_set_kernels((Nnue_kernels_t)k);
+        double full = bench_full(plies, count, &checksums[k]);
+        double incremental = bench_incremental(plies, game_starts, games, &checksums[k]);
+        printf("%-7s %13.2f %20.2f %5.1fx\n", names[k], full / 1e6, incremental / 1e6, incremental / full);
+    }
+    int64_t table_checksum = 0;
+    printf("piece-square tables %.2f Meval/s\n", bench_tables(plies, count, &table_checksum) / 1e6);
+
+    free(plies);
+    free(game_starts);
+    if (checksums[0] != checksums[1]) {
+        printf("FAIL scalar and vector kernels disagree\n");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,143 @@
+// Generates the evaluation network weights and compares it with the hand tuned evaluation
+//
+// Usage: nnue_tool gen <nnue_weights.c>   write the weights distilled from the piece-square tables
+//        nnue_tool eval <fen>              network and table scores of a position
+//
+// There is no training pipeline yet: the generated network reproduces the
+// material and piece-square tables (middle game king) to NNUE_CP_PER_UNIT,
+// as the starting point a trained set of weights would replace.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "evaluate.h"
+#include "nnue.h"
+
+#define SIDE_OFFSET 16   // Keeps a side's sum above 0 even with a bare king on a bad square
+
+static Nnue_net_t net;
+
+// Accumulator neuron k holds clamp(own sum - 127 k), so together they add up to the whole sum.
+// The first half of L1 counts up the side to move's lead, the second half the opponent's,
+// L2 passes them on and the output takes the difference.
+static void distill(void)
+{
+    memset(&net, 0, sizeof(net));
+    for (int type = PIECE_PAWN; type < PIECE_TYPE_NB; type++) {
+        for (int sq = 0; sq < SQUARE_NB; sq++) {
+            int value = evaluate_piece_square((Piece_type_t)type, sq);
+            int units = (value + (value >= 0 ? 1 : -1) * NNUE_CP_PER_UNIT / 2) / NNUE_CP_PER_UNIT;
+            // Own pieces only, the other perspective counts the enemy ones
+            for (int k = 0; k < NNUE_HIDDEN; k++) {
+                net.ft_weights[type * SQUARE_NB + sq][k] = (int16_t)units;
+            }
+        }
+    }
+    for (int k = 0; k < NNUE_HIDDEN; k++) {
+        net.ft_biases[k] = (int16_t)(SIDE_OFFSET - NNUE_CLAMP * k);
+    }
+
+    int one = 1 << NNUE_WEIGHT_SHIFT;
+    for (int o = 0; o < NNUE_L1; o++) {
+        int sign = o < NNUE_L1 / 2 ? 1 : -1;
+        int k = o % (NNUE_L1 / 2);
+        for (int i = 0; i < NNUE_HIDDEN; i++) {
+            net.l1_weights[o][i] = (int8_t)(sign * one);
+            net.l1_weights[o][NNUE_HIDDEN + i] = (int8_t)(-sign * one);
+        }
+        net.l1_biases[o] = -NNUE_CLAMP * k * one;
+    }
+    for (int o = 0; o < NNUE_L2; o++) {
+        net.l2_weights[o][o] = (int8_t)one;
+        net.out_weights[o] = (int8_t)(o < NNUE_L2 / 2 ? one : -one);
+    }
+}
+
+static void write_int16s(FILE *out, const int16_t *values, int count)
+{
+    for (int i = 0; i < count; i++) {
+        fprintf(out, "%s%d", i ? "," : "", values[i]);
+    }
+}
+
+static void write_int8s(FILE *out, const int8_t *values, int count)
+{
+    for (int i = 0; i < count; i++) {
+        fprintf(out, "%s%d", i ? "," : "", values[i]);
+    }
+}
+
+static void write_int32s(FILE *out, const int32_t *values, int count)
+{
+    for (int i = 0; i < count; i++) {
+        fprintf(out, "%s%ld", i ? "," : "", (long)values[i]);
+    }
+}
+
+static int gen(const char *path)
+{
+    distill();
+    FILE *out = fopen(path, "w");
+    if (!out) {
+        perror(path);
+        return EXIT_FAILURE;
+    }
+    fprintf(out, "// Generated by host/nnue_tool gen, do not edit\n#include \"nnue.h\"\n\n");
+    fprintf(out, "const Nnue_net_t nnue_net = {\n    .ft_weights = {\n");
+    for (int f = 0; f < NNUE_FEATURES; f++) {
+        fprintf(out, "        {");
+        write_int16s(out, net.ft_weights[f], NNUE_HIDDEN);
+        fprintf(out, "},\n");
+    }
+    fprintf(out, "    },\n    .ft_biases = {");
+    write_int16s(out, net.ft_biases, NNUE_HIDDEN);
+    fprintf(out, "},\n    .l1_weights = {\n");
+    for (int o = 0; o < NNUE_L1; o++) {
+        fprintf(out, "        {");
+        write_int8s(out, net.l1_weights[o], 2 * NNUE_HIDDEN);
+        fprintf(out, "},\n");
+    }
+    fprintf(out, "    },\n    .l1_biases = {");
+    write_int32s(out, net.l1_biases, NNUE_L1);
+    fprintf(out, "},\n    .l2_weights = {\n");
+    for (int o = 0; o < NNUE_L2; o++) {
+        fprintf(out, "        {");
+        write_int8s(out, net.l2_weights[o], NNUE_L1);
+        fprintf(out, "},\n");
+    }
+    fprintf(out, "    },\n    .l2_biases = {");
+    write_int32s(out, net.l2_biases, NNUE_L2);
+    fprintf(out, "},\n    .out_weights = {");
+    write_int8s(out, net.out_weights, NNUE_L2);
+    fprintf(out, "},\n    .out_bias = %ld,\n};\n", (long)net.out_bias);
+    if (fclose(out) != 0) {
+        perror(path);
+        return EXIT_FAILURE;
+    }
+    printf("%zu bytes of weights\n", sizeof(net));
+    return EXIT_SUCCESS;
+}
+
+static int eval(const char *fen)
+{
+    Chess_position_t pos;
+    if (!position_from_fen(&pos, fen)) {
+        fprintf(stderr, "bad FEN\n");
+        return EXIT_FAILURE;
+    }
+    Nnue_accumulator_t acc;
+    nnue_refresh(&acc, &pos);
+    printf("network %d, tables %d\n", nnue_evaluate(&acc, pos.side_to_move), evaluate(&pos));
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc == 3 && strcmp(argv[1], "gen") == 0) {
+        return gen(argv[2]);
+    }
+    if (argc == 3 && strcmp(argv[1], "eval") == 0) {
+        return eval(argv[2]);
+    }
+    fprintf(stderr, "usage: %s gen <nnue_weights.c> | eval <fen>\n", argv[0]);
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,283 @@
+// Perft correctness suite and move generator benchmark
+//
+// Usage: perft                   run the standard suite
+//        perft -t <threads>      run the suite on several threads
+//        perft -u                run the suite making and unmaking moves in place instead of copying
+//        perft scaling [threads] run the suite on 1, 2, 4 ... threads and print the speedup
+//        perft <depth> [fen]     print the divide breakdown of one position
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <time.h>
+#include "moves.h"
+
+#define MAX_THREADS 64
+
+static bool in_place;   // make_move_undo()/unmake_move() on one position instead of a copy per move
+
+typedef struct {
+    const char *name;
+    const char *fen;
+    int depth;
+    uint64_t nodes;
+} Perft_case_t;
+
+static const Perft_case_t perft_suite[] = {
+    {"start", "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 6, 119060324ULL},
+    {"kiwipete", "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 5, 193690690ULL},
+    {"position 3", "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 7, 178633661ULL},
+    {"position 4", "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", 5, 15833292ULL},
+    {"position 5", "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", 5, 89941194ULL},
+    {"position 6", "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10", 5, 164075551ULL},
+    {"illegal ep 1", "3k4/3p4/8/K1P4r/8/8/8/8 b - - 0 1", 6, 1134888ULL},
+    {"illegal ep 2", "8/8/4k3/8/2p5/8/B2P2K1/8 w - - 0 1", 6, 1015133ULL},
+    {"ep gives check", "8/8/1k6/2b5/2pP4/8/5K2/8 b - d3 0 1", 6, 1440467ULL},
+    {"castle gives check", "5k2/8/8/8/8/8/8/4K2R w K - 0 1", 6, 661072ULL},
+    {"long castle gives check", "3k4/8/8/8/8/8/8/R3K3 w Q - 0 1", 6, 803711ULL},
+    {"castle rights", "r3k2r/1b4bq/8/8/8/8/7B/R3K2R w KQkq - 0 1", 4, 1274206ULL},
+    {"castle prevented", "r3k2r/8/3Q4/8/8/5q2/8/R3K2R b KQkq - 0 1", 4, 1720476ULL},
+    {"promote out of check", "2K2r2/4P3/8/8/8/8/8/3k4 w - - 0 1", 6, 3821001ULL},
+    {"discovered check", "8/8/1P2K3/8/2n5/1q6/8/5k2 b - - 0 1", 5, 1004658ULL},
+    {"promote to check", "4k3/1P6/8/8/8/8/K7/8 w - - 0 1", 6, 217342ULL},
+    {"underpromote to check", "8/P1k5/K7/8/8/8/8/8 w - - 0 1", 6, 92683ULL},
+    {"self stalemate", "K1k5/8/P7/8/8/8/8/8 w - - 0 1", 6, 2217ULL},
+    {"stalemate and mate", "8/k1P5/8/1K6/8/8/8/8 w - - 0 1", 7, 567584ULL},
+    {"stalemate and mate 2", "8/8/2k5/5q2/5n2/8/5K2/8 b - - 0 1", 4, 23527ULL},
+};
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint64_t perft(const Chess_position_t *pos, int depth)
+{
+    Move_list_t list;
+    generate_legal_moves(pos, &list);
+    // Counting the leaves without playing them is the usual bulk counting shortcut
+    if (depth <= 1) {
+        return depth == 1 ? (uint64_t)list.count : 1;
+    }
+
+    uint64_t nodes = 0;
+    for (int i = 0; i < list.count; i++) {
+        Chess_position_t child = *pos;
+        make_move(&child, list.moves[i]);
+        nodes += perft(&child, depth - 1);
+    }
+    return nodes;
+}
+
+static uint64_t perft_unmake(Chess_position_t *pos, int depth)
+{
+    Move_list_t list;
+    generate_legal_moves(pos, &list);
+    if (depth <= 1) {
+        return depth == 1 ? (uint64_t)list.count : 1;
+    }
+
+    uint64_t nodes = 0;
+    for (int i = 0; i < list.count; i++) {
+        Move_undo_t undo;
+        make_move_undo(pos, list.moves[i], &undo);
+        nodes += perft_unmake(pos, depth - 1);
+        unmake_move(pos, list.moves[i], &undo);
+    }
+    return nodes;
+}
+
+static uint64_t perft_tree(const Chess_position_t *pos, int depth)
+{
+    if (in_place) {
+        Chess_position_t copy = *pos;
+        return perft_unmake(&copy, depth);
+    }
+    return perft(pos, depth);
+}
+
+typedef struct {
+    const Chess_position_t *tasks;
+    int count;
+    int depth;
+    atomic_int next;
+    atomic_uint_fast64_t nodes;
+} Perft_work_t;
+
+// Threads take the next task until none is left, so a slow subtree does not hold the others up
+static void *perft_worker(void *arg)
+{
+    Perft_work_t *work = arg;
+    uint64_t nodes = 0;
+    for (int i; (i = atomic_fetch_add(&work->next, 1)) < work->count;) {
+        nodes += perft_tree(&work->tasks[i], work->depth);
+    }
+    atomic_fetch_add(&work->nodes, nodes);
+    return NULL;
+}
+
+// Every position two plies down is a task, hundreds of them keep every thread busy to the end
+static uint64_t perft_parallel(const Chess_position_t *pos, int depth, int threads)
+{
+    if (threads <= 1 || depth < 4) {
+        return perft_tree(pos, depth);
+    }
+
+    Move_list_t list;
+    generate_legal_moves(pos, &list);
+    Chess_position_t *tasks = malloc(list.count * MAX_MOVES * sizeof(tasks[0]));
+    if (!tasks) {
+        return perft_tree(pos, depth);
+    }
+    int count = 0;
+    for (int i = 0; i < list.count; i++) {
+        Chess_position_t child = *pos;
+        make_move(&child, list.moves[i]);
+        Move_list_t replies;
+        generate_legal_moves(&child, &replies);
+        for (int j = 0; j < replies.count; j++) {
+            tasks[count] = child;
+            make_move(&tasks[count++], replies.moves[j]);
+        }
+    }
+
+    Perft_work_t work = {.tasks = tasks, .count = count, .depth = depth - 2};
+    atomic_init(&work.next, 0);
+    atomic_init(&work.nodes, 0);
+    pthread_t ids[MAX_THREADS];
+    for (int i = 1; i < threads; i++) {
+        pthread_create(&ids[i], NULL, perft_worker, &work);
+    }
+    perft_worker(&work);
+    for (int i = 1; i < threads; i++) {
+        pthread_join(ids[i], NULL);
+    }
+    free(tasks);
+    return atomic_load(&work.nodes);
+}
+
+static uint64_t divide(const Chess_position_t *pos, int depth)
+{
+    Move_list_t list;
+    generate_legal_moves(pos, &list);
+
+    uint64_t total = 0;
+    for (int i = 0; i < list.count; i++) {
+        Chess_position_t child = *pos;
+        char uci[6];
+        make_move(&child, list.moves[i]);
+        uint64_t nodes = perft_tree(&child, depth - 1);
+        printf("  %s: %llu\n", move_to_uci(list.moves[i], uci), (unsigned long long)nodes);
+        total += nodes;
+    }
+    printf("  moves: %d, nodes: %llu\n", list.count, (unsigned long long)total);
+    return total;
+}
+
+static int run_suite(int threads, double *seconds)
+{
+    int failures = 0;
+    uint64_t total_nodes = 0;
+    double total_time = 0;
+
+    for (size_t i = 0; i < sizeof(perft_suite) / sizeof(perft_suite[0]); i++) {
+        const Perft_case_t *test = &perft_suite[i];
+        Chess_position_t pos;
+        if (!position_from_fen(&pos, test->fen)) {
+            printf("FAIL %-24s bad FEN\n", test->name);
+            failures++;
+            continue;
+        }
+
+        double start = now_seconds();
+        uint64_t nodes = perft_parallel(&pos, test->depth, threads);
+        double elapsed = now_seconds() - start;
+        total_nodes += nodes;
+        total_time += elapsed;
+
+        bool ok = nodes == test->nodes;
+        printf("%s %-24s depth %d: %12llu nodes %8.3f s %8.2f Mnps\n", ok ? "ok  " : "FAIL",
+               test->name, test->depth, (unsigned long long)nodes, elapsed, nodes / elapsed / 1e6);
+        if (!ok) {
+            printf("  expected %llu, divide:\n", (unsigned long long)test->nodes);
+            divide(&pos, test->depth);
+            failures++;
+        }
+    }
+
+    printf("%llu nodes in %.3f s, %.2f Mnps", (unsigned long long)total_nodes, total_time,
+           total_nodes / total_time / 1e6);
+    printf(threads > 1 ? " on %d threads\n" : "\n", threads);
+    if (failures) {
+        printf("%d of %zu positions failed\n", failures, sizeof(perft_suite) / sizeof(perft_suite[0]));
+    }
+    if (seconds) {
+        *seconds = total_time;
+    }
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+// Thread counts double up to the limit, which is also measured when it is not a power of two
+static int run_scaling(int max_threads)
+{
+    double seconds[MAX_THREADS + 1];
+    int counts[MAX_THREADS + 1], runs = 0;
+    for (int threads = 1;; threads = threads * 2 < max_threads ? threads * 2 : max_threads) {
+        printf("-- %d thread%s\n", threads, threads > 1 ? "s" : "");
+        if (run_suite(threads, &seconds[runs]) != EXIT_SUCCESS) {
+            return EXIT_FAILURE;
+        }
+        counts[runs++] = threads;
+        if (threads == max_threads) {
+            break;
+        }
+    }
+    printf("threads  seconds  speedup  efficiency\n");
+    for (int i = 0; i < runs; i++) {
+        double speedup = seconds[0] / seconds[i];
+        printf("%7d %8.3f %8.2f %10.0f%%\n", counts[i], seconds[i], speedup, 100 * speedup / counts[i]);
+    }
+    return EXIT_SUCCESS;
+}
+
+static int thread_count(const char *arg)
+{
+    int threads = arg ? atoi(arg) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    return threads < 1 ? 1 : threads > MAX_THREADS ? MAX_THREADS : threads;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2) {
+        return run_suite(1, NULL);
+    }
+    if (strcmp(argv[1], "-t") == 0) {
+        return run_suite(thread_count(argc > 2 ? argv[2] : NULL), NULL);
+    }
+    if (strcmp(argv[1], "-u") == 0) {
+        in_place = true;
+        return run_suite(1, NULL);
+    }
+    if (strcmp(argv[1], "scaling") == 0) {
+        return run_scaling(thread_count(argc > 2 ? argv[2] : NULL));
+    }
+
+    int depth = atoi(argv[1]);
+    const char *fen = argc > 2 ? argv[2] : perft_suite[0].fen;
+    Chess_position_t pos;
+    if (depth < 1 || !position_from_fen(&pos, fen)) {
+        fprintf(stderr, "usage: %s [-t <threads> | -u | scaling [threads] | <depth> [fen]]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    double start = now_seconds();
+    uint64_t nodes = divide(&pos, depth);
+    double elapsed = now_seconds() - start;
+    printf("%.3f s, %.2f Mnps\n", elapsed, nodes / elapsed / 1e6);
+    return EXIT_SUCCESS;
+}
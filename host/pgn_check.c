@@ -0,0 +1,297 @@
+// Validates PGN files by replaying every game with the firmware's move generator
+//
+// Usage: pgn_check [-t threads] [--fen] <file.pgn>...  report invalid games with their byte offset
+//        pgn_check gen <games> <out.pgn> [seed]         write random legal games, to benchmark with
+//
+// Files are memory mapped and cut into chunks that threads take in turn. A
+// chunk's games are those starting in it, so no game is split. Each thread
+// keeps its reports in its own arena, nothing is allocated per game or move
+// otherwise, and the reports are sorted by offset at the end.
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "game_record.h"
+#include "pgn.h"
+
+#define MAX_THREADS 64
+#define CHUNK_BYTES (4 << 20)
+#define ARENA_BLOCK_BYTES (1 << 20)
+#define ARENA_ROUND(size) (((size) + sizeof(max_align_t) - 1) & ~(sizeof(max_align_t) - 1))
+
+typedef struct Arena_block {
+    struct Arena_block *next;
+    size_t used;
+    _Alignas(max_align_t) char data[ARENA_BLOCK_BYTES];
+} Arena_block_t;
+
+// Bump allocator, freed all at once
+typedef struct {
+    Arena_block_t *head;
+} Arena_t;
+
+typedef struct {
+    size_t game_offset;
+    size_t error_offset;       // In the file
+    int plies;
+    Pgn_status_t status;
+    char fen[POSITION_FEN_MAX];
+} Report_t;
+
+typedef struct {
+    Arena_t arena;
+    int report_count;
+    uint64_t games;
+    uint64_t plies;
+    uint64_t invalid;
+} Worker_t;
+
+typedef struct {
+    const char *text;
+    size_t size;
+    bool all_fens;              // Report every game with its final position
+    atomic_size_t next_chunk;
+    Worker_t workers[MAX_THREADS];
+} Job_t;
+
+static void *arena_alloc(Arena_t *arena, size_t size)
+{
+    size = ARENA_ROUND(size);
+    if (!arena->head || arena->head->used + size > ARENA_BLOCK_BYTES) {
+        Arena_block_t *block = malloc(sizeof(Arena_block_t));
+        if (!block) {
+            fprintf(stderr, "out of memory\n");
+            exit(EXIT_FAILURE);
+        }
+        block->next = arena->head;
+        block->used = 0;
+        arena->head = block;
+    }
+    void *p = arena->head->data + arena->head->used;
+    arena->head->used += size;
+    return p;
+}
+
+static void arena_free(Arena_t *arena)
+{
+    while (arena->head) {
+        Arena_block_t *next = arena->head->next;
+        free(arena->head);
+        arena->head = next;
+    }
+}
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void check_chunk(Job_t *job, Worker_t *worker, size_t chunk)
+{
+    size_t chunk_end = (chunk + 1) * (size_t)CHUNK_BYTES;
+    size_t start = pgn_next_game(job->text, job->size, chunk * (size_t)CHUNK_BYTES);
+    while (start < chunk_end && start < job->size) {
+        size_t next = pgn_next_game(job->text, job->size, start + 1);
+        Pgn_game_t game;
+        pgn_read_game(job->text + start, next - start, &game);
+        worker->games++;
+        worker->plies += game.plies;
+        worker->invalid += game.status != PGN_OK;
+        if (game.status != PGN_OK || job->all_fens) {
+            Report_t *report = arena_alloc(&worker->arena, sizeof(Report_t));
+            report->game_offset = start;
+            report->error_offset = start + game.error_offset;
+            report->plies = game.plies;
+            report->status = game.status;
+            position_to_fen(&game.pos, report->fen);
+            worker->report_count++;
+        }
+        start = next;
+    }
+}
+
+typedef struct {
+    Job_t *job;
+    Worker_t *worker;
+} Worker_arg_t;
+
+static void *worker_thread(void *arg)
+{
+    Job_t *job = ((Worker_arg_t *)arg)->job;
+    Worker_t *worker = ((Worker_arg_t *)arg)->worker;
+    size_t chunks = (job->size + CHUNK_BYTES - 1) / CHUNK_BYTES;
+    for (size_t chunk; (chunk = atomic_fetch_add(&job->next_chunk, 1)) < chunks;) {
+        check_chunk(job, worker, chunk);
+    }
+    return NULL;
+}
+
+static int compare_reports(const void *a, const void *b)
+{
+    const Report_t *x = *(const Report_t *const *)a, *y = *(const Report_t *const *)b;
+    return x->game_offset < y->game_offset ? -1 : x->game_offset > y->game_offset;
+}
+
+static void print_reports(const char *path, Job_t *job, int threads)
+{
+    int count = 0;
+    for (int t = 0; t < threads; t++) {
+        count += job->workers[t].report_count;
+    }
+    if (count == 0) {
+        return;
+    }
+    const Report_t **reports = malloc(count * sizeof(reports[0]));
+    if (!reports) {
+        fprintf(stderr, "out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    int n = 0;
+    for (int t = 0; t < threads; t++) {
+        for (Arena_block_t *block = job->workers[t].arena.head; block; block = block->next) {
+            for (size_t used = 0; used < block->used; used += ARENA_ROUND(sizeof(Report_t))) {
+                reports[n++] = (const Report_t *)(block->data + used);
+            }
+        }
+    }
+    qsort(reports, count, sizeof(reports[0]), compare_reports);
+    for (int i = 0; i < count; i++) {
+        const Report_t *report = reports[i];
+        if (report->status == PGN_OK) {
+            printf("%s:%zu: ok, %d plies, %s\n", path, report->game_offset, report->plies, report->fen);
+        } else {
+            printf("%s:%zu: %s, game at %zu after %d plies, %s\n", path, report->error_offset,
+                   pgn_status_name(report->status), report->game_offset, report->plies, report->fen);
+        }
+    }
+    free(reports);
+}
+
+static int check_file(const char *path, int threads, bool all_fens)
+{
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        perror(path);
+        return -1;
+    }
+    size_t size = (size_t)st.st_size;
+    const char *text = size ? mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0) : "";
+    close(fd);
+    if (text == MAP_FAILED) {
+        perror(path);
+        return -1;
+    }
+
+    static Job_t job;
+    memset(&job, 0, sizeof(job));
+    job.text = text;
+    job.size = size;
+    job.all_fens = all_fens;
+    atomic_init(&job.next_chunk, 0);
+
+    double start = now_seconds();
+    pthread_t ids[MAX_THREADS];
+    Worker_arg_t args[MAX_THREADS];
+    for (int t = 0; t < threads; t++) {
+        args[t] = (Worker_arg_t){&job, &job.workers[t]};
+        if (t > 0) {
+            pthread_create(&ids[t], NULL, worker_thread, &args[t]);
+        }
+    }
+    worker_thread(&args[0]);
+    for (int t = 1; t < threads; t++) {
+        pthread_join(ids[t], NULL);
+    }
+    double elapsed = now_seconds() - start;
+
+    print_reports(path, &job, threads);
+    uint64_t games = 0, plies = 0, invalid = 0;
+    for (int t = 0; t < threads; t++) {
+        games += job.workers[t].games;
+        plies += job.workers[t].plies;
+        invalid += job.workers[t].invalid;
+        arena_free(&job.workers[t].arena);
+    }
+    if (size) {
+        munmap((void *)text, size);
+    }
+    printf("%s: %llu games, %llu moves, %llu invalid in %.3f s on %d threads: %.0f games/s, %.0f moves/s, %.1f MB/s\n",
+           path, (unsigned long long)games, (unsigned long long)plies, (unsigned long long)invalid, elapsed, threads,
+           games / elapsed, plies / elapsed, size / elapsed / 1e6);
+    return invalid > 0;
+}
+
+// Random legal games written by the firmware's PGN writer
+static int generate(int games, const char *path, uint32_t seed)
+{
+    FILE *out = fopen(path, "w");
+    if (!out) {
+        perror(path);
+        return EXIT_FAILURE;
+    }
+    uint32_t state = seed;
+    for (int g = 0; g < games; g++) {
+        Chess_position_t pos;
+        Game_record_t record;
+        position_set_start(&pos);
+        game_record_init(&record, &pos);
+        for (int ply = 0; ply < 160; ply++) {
+            Move_list_t list;
+            if (generate_legal_moves(&pos, &list) == 0 || pos.halfmove_clock >= 100) {
+                break;
+            }
+            state = state * 1664525 + 1013904223;
+            Chess_move_t move = list.moves[(state >> 8) % list.count];
+            make_move(&pos, move);
+            game_record_append(&record, move, pos.key);
+        }
+        pgn_write(out, &record, NULL);
+        game_record_clear(&record);
+    }
+    if (fclose(out) != 0) {
+        perror(path);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc >= 4 && strcmp(argv[1], "gen") == 0) {
+        return generate(atoi(argv[2]), argv[3], argc > 4 ? (uint32_t)strtoul(argv[4], NULL, 0) : 1);
+    }
+
+    int threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    bool all_fens = false;
+    int arg = 1;
+    for (; arg < argc && argv[arg][0] == '-'; arg++) {
+        if (strcmp(argv[arg], "-t") == 0 && arg + 1 < argc) {
+            threads = atoi(argv[++arg]);
+        } else if (strcmp(argv[arg], "--fen") == 0) {
+            all_fens = true;
+        } else {
+            break;
+        }
+    }
+    if (arg >= argc) {
+        fprintf(stderr, "usage: %s [-t threads] [--fen] <file.pgn>... | gen <games> <out.pgn> [seed]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    threads = threads < 1 ? 1 : threads > MAX_THREADS ? MAX_THREADS : threads;
+
+    int failed = 0;
+    for (; arg < argc; arg++) {
+        failed |= check_file(argv[arg], threads, all_fens) != 0;
+    }
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
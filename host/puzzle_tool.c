@@ -0,0 +1,236 @@
+// Builds and benchmarks mate puzzle packs
+//
+// Usage: puzzle_tool build <puzzles.txt> <pack.bin>   check every mate and write the pack
+//        puzzle_tool bench <puzzles.txt | pack.bin>    solve time of every puzzle and judge time of its solution
+//        puzzle_tool solve <moves> <fen>               shortest mate of a position
+//
+// Text puzzles are "<moves> <fen>" lines, # starts a comment. The solver
+// runs with the firmware's table size and node limit, so the bench shows
+// how the board would do, scaled by the CPU.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "sdkconfig.h"
+#include "puzzle.h"
+
+#define MAX_PUZZLES 4096
+#define TABLE_ENTRIES (1 << CONFIG_CHESSY_PUZZLE_TABLE_LOG2)
+
+static Mate_entry_t table[TABLE_ENTRIES];
+static Mate_solver_t solver;
+static Puzzle_t puzzles[MAX_PUZZLES];
+static uint8_t pack_bytes[PUZZLE_HEADER_SIZE + MAX_PUZZLES * PUZZLE_RECORD_SIZE];
+
+static int64_t clock_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static char *read_file(const char *path, size_t *size)
+{
+    FILE *in = fopen(path, "rb");
+    if (!in) {
+        perror(path);
+        return NULL;
+    }
+    fseek(in, 0, SEEK_END);
+    long length = ftell(in);
+    fseek(in, 0, SEEK_SET);
+    char *text = malloc(length + 1);
+    if (!text || fread(text, 1, length, in) != (size_t)length) {
+        fprintf(stderr, "%s: read failed\n", path);
+        fclose(in);
+        free(text);
+        return NULL;
+    }
+    fclose(in);
+    text[length] = '\0';
+    *size = length;
+    return text;
+}
+
+// Solves every text puzzle, the mate must be exactly as long as stated
+static int load_text(const char *path, char *text)
+{
+    int count = 0, line_number = 0, failures = 0;
+    for (char *line = text, *next; line; line = next) {
+        next = strchr(line, '\n');
+        if (next) {
+            *next++ = '\0';
+        }
+        line_number++;
+        char *hash = strchr(line, '#');
+        if (hash) {
+            *hash = '\0';
+        }
+        int moves, length;
+        if (sscanf(line, "%d %n", &moves, &length) != 1) {
+            continue;
+        }
+        if (count == MAX_PUZZLES) {
+            fprintf(stderr, "%s:%d: too many puzzles\n", path, line_number);
+            return -1;
+        }
+        Puzzle_t *puzzle = &puzzles[count];
+        Mate_result_t result;
+        if (moves < 1 || moves > MATE_MAX_MOVES || !position_from_fen(&puzzle->pos, line + length)) {
+            fprintf(stderr, "%s:%d: bad puzzle\n", path, line_number);
+            failures++;
+            continue;
+        }
+        mate_solver_clear(&solver);
+        mate_search(&solver, &puzzle->pos, moves, &result);
+        if (result.status != MATE_FOUND || result.moves != moves) {
+            fprintf(stderr, "%s:%d: %s\n", path, line_number,
+                    result.status == MATE_UNKNOWN ? "node limit reached" :
+                    result.status == MATE_NONE ? "no forced mate" : "shorter mate");
+            failures++;
+            continue;
+        }
+        puzzle->mate_in = (uint8_t)moves;
+        puzzle->solution = result.move;
+        // The record must read back, which also rejects a side left in check by the last move
+        uint8_t record[PUZZLE_RECORD_SIZE];
+        Puzzle_pack_t pack = {record, 1};
+        Puzzle_t decoded;
+        puzzle_encode(record, puzzle);
+        if (!puzzle_pack_read(&pack, 0, &decoded) || decoded.pos.key != puzzle->pos.key) {
+            fprintf(stderr, "%s:%d: position cannot be stored\n", path, line_number);
+            failures++;
+            continue;
+        }
+        count++;
+    }
+    return failures ? -1 : count;
+}
+
+static int load(const char *path)
+{
+    size_t size;
+    char *text = read_file(path, &size);
+    if (!text) {
+        return -1;
+    }
+    int count = 0;
+    Puzzle_pack_t pack;
+    if (size >= strlen(PUZZLE_MAGIC) && memcmp(text, PUZZLE_MAGIC, strlen(PUZZLE_MAGIC)) == 0) {
+        if (!puzzle_pack_open_memory(&pack, text, size) || pack.count > MAX_PUZZLES) {
+            fprintf(stderr, "%s: not a valid pack\n", path);
+            count = -1;
+        }
+        for (size_t i = 0; count >= 0 && i < pack.count; i++) {
+            if (!puzzle_pack_read(&pack, i, &puzzles[count++])) {
+                fprintf(stderr, "%s: bad record %zu\n", path, i);
+                count = -1;
+            }
+        }
+    } else {
+        count = load_text(path, text);
+    }
+    free(text);
+    return count;
+}
+
+static int build(const char *in_path, const char *out_path)
+{
+    int count = load(in_path);
+    if (count < 0) {
+        return EXIT_FAILURE;
+    }
+    uint8_t *records = pack_bytes + PUZZLE_HEADER_SIZE;
+    for (int i = 0; i < count; i++) {
+        puzzle_encode(records + i * PUZZLE_RECORD_SIZE, &puzzles[i]);
+    }
+    puzzle_pack_header(pack_bytes, records, count);
+    size_t size = PUZZLE_HEADER_SIZE + (size_t)count * PUZZLE_RECORD_SIZE;
+    FILE *out = fopen(out_path, "wb");
+    if (!out || fwrite(pack_bytes, 1, size, out) != size || fclose(out) != 0) {
+        perror(out_path);
+        return EXIT_FAILURE;
+    }
+    printf("%d puzzles, %zu bytes\n", count, size);
+    return EXIT_SUCCESS;
+}
+
+// Solving is what the pack builder does once, judging the solution is what the board does on every move
+static int bench(const char *path)
+{
+    int count = load(path);
+    if (count < 0) {
+        return EXIT_FAILURE;
+    }
+    int64_t solve_total = 0, judge_worst = 0;
+    uint64_t nodes_total = 0;
+    int failures = 0;
+    printf("  #  mate  solve ms     nodes  judge ms  fen\n");
+    for (int i = 0; i < count; i++) {
+        const Puzzle_t *puzzle = &puzzles[i];
+        Mate_result_t result;
+        mate_solver_clear(&solver);
+        int64_t start = clock_us();
+        mate_search(&solver, &puzzle->pos, puzzle->mate_in, &result);
+        int64_t solve_us = clock_us() - start;
+        bool ok = result.status == MATE_FOUND && result.moves == puzzle->mate_in;
+
+        // The first move judged as on the board, with a fresh table
+        Puzzle_session_t session;
+        Chess_move_t reply;
+        puzzle_session_start(&session, puzzle, &solver);
+        start = clock_us();
+        Puzzle_verdict_t verdict = puzzle_session_judge(&session, &puzzle->pos, puzzle->solution, &reply);
+        int64_t judge_us = clock_us() - start;
+        ok &= verdict == PUZZLE_MOVE_CORRECT || verdict == PUZZLE_MOVE_SOLVED;
+
+        char fen[POSITION_FEN_MAX];
+        printf("%3d %5d %9.3f %9lu %9.3f  %s%s\n", i + 1, puzzle->mate_in, solve_us / 1000.0,
+               (unsigned long)result.nodes, judge_us / 1000.0, position_to_fen(&puzzle->pos, fen), ok ? "" : "  FAIL");
+        failures += !ok;
+        solve_total += solve_us;
+        nodes_total += result.nodes;
+        judge_worst = judge_us > judge_worst ? judge_us : judge_worst;
+    }
+    printf("%d puzzles solved in %.3f ms, %.0f nodes/s, slowest judgement %.3f ms\n", count - failures,
+           solve_total / 1000.0, solve_total ? nodes_total * 1e6 / solve_total : 0.0, judge_worst / 1000.0);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+static int solve(int moves, const char *fen)
+{
+    Chess_position_t pos;
+    if (!position_from_fen(&pos, fen)) {
+        fprintf(stderr, "bad FEN\n");
+        return EXIT_FAILURE;
+    }
+    Mate_result_t result;
+    int64_t start = clock_us();
+    mate_search(&solver, &pos, moves, &result);
+    int64_t elapsed = clock_us() - start;
+    char uci[6];
+    if (result.status == MATE_FOUND) {
+        printf("mate in %d: %s", result.moves, move_to_uci(result.move, uci));
+    } else {
+        printf(result.status == MATE_NONE ? "no mate in %d" : "node limit reached within %d moves", moves);
+    }
+    printf(", %lu nodes in %.3f ms\n", (unsigned long)result.nodes, elapsed / 1000.0);
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+    mate_solver_init(&solver, table, TABLE_ENTRIES, CONFIG_CHESSY_PUZZLE_NODE_LIMIT);
+    if (argc == 4 && strcmp(argv[1], "build") == 0) {
+        return build(argv[2], argv[3]);
+    }
+    if (argc == 3 && strcmp(argv[1], "bench") == 0) {
+        return bench(argv[2]);
+    }
+    if (argc == 4 && strcmp(argv[1], "solve") == 0) {
+        return solve(atoi(argv[2]), argv[3]);
+    }
+    fprintf(stderr, "usage: %s build <puzzles.txt> <pack.bin> | bench <puzzles.txt | pack.bin> | solve <moves> <fen>\n",
+            argv[0]);
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,52 @@
+#include <pthread.h>
+#include "search_threads.h"
+
+typedef struct {
+    Search_t *search;
+    const Chess_position_t *pos;
+} Helper_arg_t;
+
+static void *helper_thread(void *arg)
+{
+    Helper_arg_t *helper = arg;
+    search_run(helper->search, helper->pos);
+    return NULL;
+}
+
+const Search_report_t *search_threads_run(Search_t *searches, int count, const Chess_position_t *pos,
+                                          uint64_t *nodes)
+{
+    static const Search_limits_t no_limits;
+    Search_t *main_search = &searches[0];
+    pthread_t threads[SEARCH_THREADS_MAX];
+    Helper_arg_t args[SEARCH_THREADS_MAX];
+    if (count > SEARCH_THREADS_MAX) {
+        count = SEARCH_THREADS_MAX;
+    }
+
+    for (int i = 1; i < count; i++) {
+        Search_t *helper = &searches[i];
+        search_init(helper, &no_limits);
+        search_set_history(helper, main_search->keys, main_search->key_count);
+        helper->on_report = NULL;
+        helper->poll = NULL;
+        helper->clock_us = main_search->clock_us;
+        helper->bitbase = main_search->bitbase;
+        helper->tt = main_search->tt;
+        helper->use_nnue = main_search->use_nnue;
+        helper->helper = i;
+        args[i] = (Helper_arg_t){.search = helper, .pos = pos};
+        pthread_create(&threads[i], NULL, helper_thread, &args[i]);
+    }
+    const Search_report_t *report = search_run(main_search, pos);
+    uint64_t total = main_search->nodes;
+    for (int i = 1; i < count; i++) {
+        searches[i].stop = true;
+        pthread_join(threads[i], NULL);
+        total += searches[i].nodes;
+    }
+    if (nodes) {
+        *nodes = total;
+    }
+    return report;
+}
@@ -0,0 +1,24 @@
+// Lazy SMP on the host: a search with helper searches on pthreads, as the engine task does on two cores
+#ifndef SEARCH_THREADS_H
+#define SEARCH_THREADS_H
+
+#include <stdint.h>
+#include "search.h"
+
+#define SEARCH_THREADS_MAX 64
+
+/**
+ * @brief Run a search with helpers sharing its transposition table
+ *
+ * The helpers are set up from the main search and stopped once it is done.
+ *
+ * @param searches The main search, set up as for search_run() with a table, then count - 1 helpers
+ * @param count Number of searches, the main one included, at most SEARCH_THREADS_MAX
+ * @param pos The root position
+ * @param nodes Filled with the nodes of every search if not NULL
+ * @return const Search_report_t* The final report of the main search
+ */
+const Search_report_t *search_threads_run(Search_t *searches, int count, const Chess_position_t *pos,
+                                          uint64_t *nodes);
+
+#endif
@@ -0,0 +1,20 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <termios.h>
+#include "serial_port.h"
+
+int serial_port_open(const char *path, int flags)
+{
+    int fd = open(path, flags | O_NOCTTY);
+    if (fd < 0) {
+        perror(path);
+        return -1;
+    }
+    // Raw bytes from a serial port, the baud rate does not matter over USB
+    struct termios tio;
+    if (tcgetattr(fd, &tio) == 0) {
+        cfmakeraw(&tio);
+        tcsetattr(fd, TCSANOW, &tio);
+    }
+    return fd;
+}
@@ -0,0 +1,16 @@
+// Serial ports of the boards, opened by the host tools
+#ifndef SERIAL_PORT_H
+#define SERIAL_PORT_H
+
+/**
+ * @brief Open a serial port for raw bytes
+ *
+ * Files and FIFOs open too, they are left as they are.
+ *
+ * @param path The port
+ * @param flags O_RDONLY or O_RDWR
+ * @return int The file descriptor, -1 after printing why it failed
+ */
+int serial_port_open(const char *path, int flags);
+
+#endif
@@ -0,0 +1,219 @@
+#include <string.h>
+#include "led_compositor.h"
+#include "led_display.h"
+#include "sim.h"
+
+#ifdef CONFIG_CHESSY_HALL_ACTIVE_LOW
+#define SIM_ACTIVE_LOW true
+#else
+#define SIM_ACTIVE_LOW false
+#endif
+
+// Row pins of the board, see hall_scan.c
+static const uint8_t row_pins[HALL_ROW_NUM] = {14, 13, 21, 8, 15, 16, 17, 18};
+
+static void record_led_frame(void *ctx)
+{
+    Sim_t *sim = ctx;
+    sim->led_frames++;
+    if (sim->on_led_frame) {
+        Sim_led_frame_t frame = {.time_us = sim->now_us, .pixels = sim->strip.pixels};
+        sim->on_led_frame(&frame, sim->ctx);
+    }
+}
+
+// The GPIO input word while a column is driven, with the other pins left floating
+static uint32_t column_in_reg(Bitboard_t raw, int col, uint32_t floating)
+{
+    uint32_t in_reg = floating;
+    for (int row = 0; row < HALL_ROW_NUM; row++) {
+        bool magnet = raw & BB_SQUARE(SQUARE(row, col));
+        if (magnet != SIM_ACTIVE_LOW) {
+            in_reg |= 1UL << row_pins[row];
+        } else {
+            in_reg &= ~(1UL << row_pins[row]);
+        }
+    }
+    return in_reg;
+}
+
+static void scan_step(Sim_t *sim, bool changed)
+{
+    Scan_sample_t sample = {.timestamp_us = sim->now_us, .changed = changed};
+    Scan_step_t step = scan_policy_next(&sim->policy, &sample);
+    sim->mode = step.mode;
+    sim->mode_us[step.mode] += step.gap_us + SIM_FRAME_US;
+    sim->next_frame_us = sim->now_us + step.gap_us + SIM_FRAME_US;
+}
+
+// What the scan task and the game task do with one frame
+static void scan_frame(Sim_t *sim)
+{
+    sim->frames++;
+    // Once the debouncer has seen the same frame throughout, more of it changes nothing
+    if (sim->quiet_frames >= CONFIG_CHESSY_HALL_DEBOUNCE_DEPTH && sim->physical == sim->last_raw &&
+            !sim->glitches) {
+        scan_step(sim, false);
+        return;
+    }
+
+    Bitboard_t raw = sim->physical ^ sim->glitches;
+    sim->glitches = 0;
+    uint64_t columns = 0;
+    uint32_t floating = (uint32_t)(sim->frames * 0x9E3779B97F4A7C15ULL >> 32);
+    for (int col = 0; col < HALL_COL_NUM; col++) {
+        columns |= (uint64_t)hall_decode_rows(&sim->decoder, column_in_reg(raw, col, floating)) << (8 * col);
+    }
+    Bitboard_t occupancy = hall_columns_to_occupancy(columns);
+    bool changed = occupancy != sim->last_raw;
+    sim->quiet_frames = changed ? 0 : sim->quiet_frames + 1;
+    sim->last_raw = occupancy;
+
+    Hall_event_t events[SQUARE_NB];
+    int event_count = hall_debouncer_update(&sim->debouncer, occupancy, sim->now_us, events);
+    scan_step(sim, changed || occupancy != sim->debouncer.stable);
+    if (event_count == 0) {
+        return;
+    }
+    for (int i = 0; i < event_count; i++) {
+        int64_t changed_us = sim->changed_us[events[i].square];
+        if (sim->unshown_us < 0 || changed_us < sim->unshown_us) {
+            sim->unshown_us = changed_us;
+        }
+        game_handle_event(&sim->game, &events[i]);
+    }
+    sim->events += event_count;
+    game_verify_setup(&sim->game);
+    game_take_scene(&sim->game, &sim->scene);
+    sim->scene_pending = true;
+}
+
+// What the LED task does every frame period
+static void led_frame(Sim_t *sim)
+{
+    if (sim->scene_pending) {
+        led_display_set_scene(&sim->scene, sim->now_us);
+        sim->scene_pending = false;
+        if (sim->unshown_us >= 0) {
+            int64_t latency = sim->now_us - sim->unshown_us;
+            sim->latency_count++;
+            sim->latency_sum_us += latency;
+            if (latency > sim->latency_max_us) {
+                sim->latency_max_us = latency;
+            }
+            sim->unshown_us = -1;
+        }
+    }
+    led_display_show(sim->now_us);
+}
+
+void sim_init(Sim_t *sim, Bitboard_t physical, bool check_setup, Game_record_t *resumed)
+{
+    memset(sim, 0, sizeof(*sim));
+    sim->physical = physical;
+    sim->unshown_us = -1;
+    hall_decoder_init(&sim->decoder, row_pins, SIM_ACTIVE_LOW);
+    // Start from an empty board so the first frames report every piece as placed
+    hall_debouncer_init(&sim->debouncer, CONFIG_CHESSY_HALL_DEBOUNCE_DEPTH, CONFIG_CHESSY_HALL_DEBOUNCE_VOTES, 0);
+
+    static const Scan_adaptive_config_t scan_config = {
+        .burst_gap_us = 0,
+        .active_gap_us = CONFIG_CHESSY_SCAN_ACTIVE_GAP_US,
+        .idle_gap_us = CONFIG_CHESSY_SCAN_IDLE_GAP_MS * 1000,
+        .settle_us = (int64_t)CONFIG_CHESSY_SCAN_SETTLE_MS * 1000,
+        .idle_after_us = (int64_t)CONFIG_CHESSY_SCAN_IDLE_AFTER_S * 1000000,
+    };
+    sim->policy = scan_adaptive_init(&sim->adaptive, &scan_config, 0);
+    sim->next_frame_us = SIM_FRAME_US;
+
+    mock_led_strip_new(&sim->strip);
+    sim->strip.on_refresh = record_led_frame;
+    sim->strip.ctx = sim;
+    sim->white_level = (uint8_t)((255 * CONFIG_CHESSY_LED_BRIGHTNESS + 127) / 255);
+    led_display_init();
+
+    game_init(&sim->game, check_setup);
+    if (resumed) {
+        game_resume(&sim->game, resumed);
+    }
+    game_take_scene(&sim->game, &sim->scene);
+    sim->scene_pending = true;
+    led_frame(sim);
+    sim->next_led_us = SIM_LED_PERIOD_US;
+}
+
+void sim_free(Sim_t *sim)
+{
+    game_free(&sim->game);
+}
+
+void sim_set_policy(Sim_t *sim, Scan_policy_t policy)
+{
+    sim->policy = policy;
+}
+
+void sim_advance(Sim_t *sim, int64_t time_us)
+{
+    // Scan and LED frames in time order, a scan frame first when they coincide
+    for (;;) {
+        bool scan = sim->next_frame_us <= sim->next_led_us;
+        int64_t next_us = scan ? sim->next_frame_us : sim->next_led_us;
+        if (next_us > time_us) {
+            break;
+        }
+        sim->now_us = next_us;
+        if (scan) {
+            scan_frame(sim);
+        } else {
+            led_frame(sim);
+            sim->next_led_us += SIM_LED_PERIOD_US;
+        }
+    }
+    sim->now_us = time_us;
+}
+
+void sim_lift(Sim_t *sim, int sq)
+{
+    sim->physical &= ~BB_SQUARE(sq);
+    sim->changed_us[sq] = sim->now_us;
+}
+
+void sim_place(Sim_t *sim, int sq)
+{
+    sim->physical |= BB_SQUARE(sq);
+    sim->changed_us[sq] = sim->now_us;
+}
+
+void sim_glitch(Sim_t *sim, int sq)
+{
+    sim->glitches |= BB_SQUARE(sq);
+}
+
+// Colors are gamma corrected and scaled, so they are told apart by their channels
+char sim_led(const Sim_t *sim, int sq)
+{
+    const uint8_t *rgb = sim->strip.pixels[led_strip_index(sq)];
+    bool red = rgb[0], green = rgb[1], blue = rgb[2];
+    if (!red && !green && !blue) {
+        return '.';
+    }
+    if (rgb[0] == rgb[1] && rgb[1] == rgb[2]) {
+        return rgb[0] == sim->white_level ? 'W' : 'B';
+    }
+    if (red && green && !blue) {
+        return 'S';
+    }
+    if (green && !red && !blue) {
+        return '+';
+    }
+    if (red && !green && !blue) {
+        return 'X';
+    }
+    if (green && blue && !red) {
+        return 'h';
+    }
+    if (blue && !red && !green) {
+        return 'H';
+    }
+    return '?';
+}
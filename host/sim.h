@@ -0,0 +1,144 @@
+// Firmware simulator: the scan, game and LED task logic on a virtual board and clock
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "sdkconfig.h"
+#include "hall_matrix.h"
+#include "hall_events.h"
+#include "game.h"
+#include "scan_policy.h"
+#include "mock_led_strip.h"
+
+#define SIM_FRAME_US (HALL_COL_NUM * CONFIG_CHESSY_HALL_SETTLE_US)  // One scan of every column
+#define SIM_LED_PERIOD_US (1000000 / CONFIG_CHESSY_LED_FPS)
+
+/**
+ * @brief A frame sent to the virtual LED strip
+ *
+ */
+typedef struct {
+    int64_t time_us;
+    const uint8_t (*pixels)[3];  // Strip order, see led_strip_index()
+} Sim_led_frame_t;
+
+typedef void (*Sim_led_frame_cb_t)(const Sim_led_frame_t *frame, void *ctx);
+
+/**
+ * @brief The simulated board
+ *
+ * Virtual time advances from one scan frame or LED frame to the next. Each
+ * scan frame drives the virtual sensor matrix one column after the other,
+ * decodes the GPIO words it produces with the firmware's row decoder and
+ * feeds the occupancy to the debouncer, and the scan policy sets the pause
+ * before the next one. Debounced events go to the game as in the game task,
+ * and the scene is drawn at the LED frame rate as in the LED task, into a
+ * recording strip. Frames that read what the debouncer already agrees with
+ * are only counted, so hours of play take milliseconds.
+ *
+ * Only one simulator can exist at a time, the LED display is a singleton.
+ */
+typedef struct {
+    int64_t now_us;                 // Virtual time
+    Bitboard_t physical;            // Magnets on the board
+    Bitboard_t glitches;            // Squares misread by the next frame only
+    Bitboard_t last_raw;            // Occupancy read by the last frame
+    int quiet_frames;               // Frames in a row that read last_raw
+    Scan_adaptive_t adaptive;       // State of the default policy
+    Scan_policy_t policy;
+    uint8_t mode;                   // Scan_mode_t of the last step
+    int64_t next_frame_us;          // End of the next scan frame
+    Hall_row_decoder_t decoder;
+    Hall_debouncer_t debouncer;
+    Game_t game;
+    Led_scene_t scene;              // Scene waiting for the next LED frame
+    bool scene_pending;
+    int64_t next_led_us;
+    Mock_led_strip_t strip;
+    uint8_t white_level;            // Strip level of a white piece
+    int64_t changed_us[SQUARE_NB];  // When each square last changed on the board
+    int64_t unshown_us;             // Oldest change handled by the game but not drawn yet, -1 if none
+    Sim_led_frame_cb_t on_led_frame;
+    void *ctx;
+
+    uint64_t frames;                // Scan frames
+    int64_t mode_us[SCAN_MODE_NB];  // Time spent in each scan mode
+    uint64_t events;                // Debounced events
+    uint64_t led_frames;            // Strip refreshes
+    uint64_t latency_count;         // Changes drawn
+    int64_t latency_sum_us;
+    int64_t latency_max_us;         // From a piece moving to the LED frame showing it
+} Sim_t;
+
+/**
+ * @brief Start the firmware on a board
+ *
+ * The debouncer starts empty like the scan task, so the first frames place
+ * every piece of the board.
+ *
+ * @param sim The simulator, sim_free() releases it
+ * @param physical Magnets on the board at time zero
+ * @param check_setup Wait for the starting position before accepting moves
+ * @param resumed Moves of a game resumed from the journal, NULL for none, its chunks are taken over
+ */
+void sim_init(Sim_t *sim, Bitboard_t physical, bool check_setup, Game_record_t *resumed);
+
+/**
+ * @brief Replace the scan policy, the adaptive one with the Kconfig defaults until then
+ *
+ * @param sim The simulator
+ * @param policy The policy, its state must outlive the simulator
+ */
+void sim_set_policy(Sim_t *sim, Scan_policy_t policy);
+
+/**
+ * @brief Release the game record
+ *
+ * @param sim The simulator
+ */
+void sim_free(Sim_t *sim);
+
+/**
+ * @brief Run the firmware up to a time
+ *
+ * @param sim The simulator
+ * @param time_us Virtual time to reach, frames up to it are processed
+ */
+void sim_advance(Sim_t *sim, int64_t time_us);
+
+/**
+ * @brief Take a piece off a square at the current time
+ *
+ * @param sim The simulator
+ * @param sq The square
+ */
+void sim_lift(Sim_t *sim, int sq);
+
+/**
+ * @brief Put a piece on a square at the current time
+ *
+ * @param sim The simulator
+ * @param sq The square
+ */
+void sim_place(Sim_t *sim, int sq);
+
+/**
+ * @brief Misread a square in the next frame, like electrical noise would
+ *
+ * @param sim The simulator
+ * @param sq The square
+ */
+void sim_glitch(Sim_t *sim, int sq);
+
+/**
+ * @brief What the LED of a square shows
+ *
+ * @param sim The simulator
+ * @param sq The square
+ * @return char W white piece, B black piece, S selected, + target or valid move,
+ *         X error or invalid move, h/H hint from/to, . off, ? anything else
+ */
+char sim_led(const Sim_t *sim, int sq);
+
+#endif
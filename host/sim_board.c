@@ -0,0 +1,90 @@
+#include <string.h>
+#include "sim_board.h"
+#include "host_util.h"
+
+static void snapshot(Sim_board_t *sim)
+{
+    Telemetry_board_t *board = &sim->board;
+    board->pos = sim->positions[sim->plies];
+    board->start_key = sim->positions[0].key;
+    board->plies = sim->plies;
+    for (uint32_t ply = 0; ply < sim->plies; ply++) {
+        board->recent[ply % TELEMETRY_RECENT_MOVES] = sim->moves[ply];
+    }
+}
+
+static void new_game(Sim_board_t *sim, uint64_t *seed)
+{
+    static const char *starts[] = {
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+        "r3k2r/1P4P1/8/3pP3/8/8/1p4p1/R3K2R w KQkq d6 0 30",
+    };
+    position_from_fen(&sim->positions[0], starts[host_random(seed) % 2]);
+    sim->plies = 0;
+    sim->board.occupancy = position_occupied(&sim->positions[0]);
+    snapshot(sim);
+}
+
+void sim_board_init(Sim_board_t *sim, const Sim_board_mix_t *mix, uint64_t *seed)
+{
+    memset(sim, 0, sizeof(*sim));
+    sim->mix = *mix;
+    new_game(sim, seed);
+}
+
+void sim_board_step(Sim_board_t *sim, uint64_t *seed)
+{
+    const Sim_board_mix_t *mix = &sim->mix;
+    uint64_t moves_end = 6 + mix->move_percent;
+    uint64_t r = host_random(seed) % 100;
+    if (r < 2) {
+        new_game(sim, seed);
+    } else if (r < 6) {
+        uint32_t back = (uint32_t)(host_random(seed) % 3 + 1);
+        sim->plies = sim->plies > back ? sim->plies - back : 0;
+    } else if (r < moves_end) {
+        int count = r < moves_end - 2 ? 1 : (int)(host_random(seed) % 12 + 1);
+        for (int i = 0; i < count && sim->plies < SIM_BOARD_MAX_PLIES; i++) {
+            Move_list_t list;
+            Chess_position_t pos = sim->positions[sim->plies];
+            if (generate_legal_moves(&pos, &list) == 0) {
+                new_game(sim, seed);
+                break;
+            }
+            Chess_move_t move = list.moves[host_random(seed) % list.count];
+            make_move(&pos, move);
+            sim->moves[sim->plies++] = move;
+            sim->positions[sim->plies] = pos;
+        }
+    } else if (r < moves_end + mix->lift_percent) {
+        sim->board.occupancy ^= BB_SQUARE(host_random(seed) % SQUARE_NB);
+    }
+    if (r % 5 == 0) {
+        if (mix->any_state) {
+            sim->board.state = (uint8_t)(host_random(seed) % 4);
+        } else {
+            sim->board.state = host_random(seed) % 4 == 0 ? GAME_STATE_TAKEBACK : GAME_STATE_PLAYING;
+        }
+    }
+    if (mix->leds) {
+        for (int i = (int)(host_random(seed) % 4); i > 0; i--) {
+            uint8_t *pixel = sim->leds[host_random(seed) % SQUARE_NB];
+            pixel[host_random(seed) % 3] = (uint8_t)host_random(seed);
+        }
+        if (r % 10 == 0) {
+            sim->stats.uptime_ms += 1000;
+            sim->stats.scan_frames += 200;
+            sim->stats.led_frames += (uint32_t)(host_random(seed) % 50);
+        }
+    }
+    snapshot(sim);
+}
+
+void sim_board_move(Sim_board_t *sim, Chess_move_t move)
+{
+    Chess_position_t pos = sim->positions[sim->plies];
+    make_move(&pos, move);
+    sim->moves[sim->plies++] = move;
+    sim->positions[sim->plies] = pos;
+    snapshot(sim);
+}
@@ -0,0 +1,64 @@
+// A random game published the way the game task does, for the telemetry and UCI tests
+#ifndef SIM_BOARD_H
+#define SIM_BOARD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "telemetry.h"
+
+#define SIM_BOARD_MAX_PLIES 400
+
+/**
+ * @brief What a step of the game does, out of 100
+ *
+ * 2 steps start a new game and 4 take back up to three plies, then come
+ * move_percent steps playing moves and lift_percent steps lifting or
+ * dropping a piece off the game. The game state changes every fifth step.
+ */
+typedef struct {
+    uint32_t move_percent;      // The last two of these play up to a dozen plies, more than a snapshot carries
+    uint32_t lift_percent;      // Flip the occupancy of a square
+    bool any_state;             // Any game state, else only playing or taking back
+    bool leds;                  // LED colors and stats change too
+} Sim_board_mix_t;
+
+/**
+ * @brief A game that moves on, takes back and starts over
+ *
+ */
+typedef struct {
+    Sim_board_mix_t mix;
+    Chess_position_t positions[SIM_BOARD_MAX_PLIES + 1];
+    Chess_move_t moves[SIM_BOARD_MAX_PLIES];
+    uint32_t plies;
+    Telemetry_board_t board;    // As published after the last step
+    uint8_t leds[SQUARE_NB][3];
+    Telemetry_stats_t stats;
+} Sim_board_t;
+
+/**
+ * @brief Clear the board and start a random game
+ *
+ * @param sim The board
+ * @param mix What the steps do
+ * @param seed Random state
+ */
+void sim_board_init(Sim_board_t *sim, const Sim_board_mix_t *mix, uint64_t *seed);
+
+/**
+ * @brief Change the game at random, then publish it
+ *
+ * @param sim The board
+ * @param seed Random state
+ */
+void sim_board_step(Sim_board_t *sim, uint64_t *seed);
+
+/**
+ * @brief Play a move, then publish the game
+ *
+ * @param sim The board
+ * @param move A legal move of the current position
+ */
+void sim_board_move(Sim_board_t *sim, Chess_move_t move);
+
+#endif
@@ -0,0 +1,244 @@
+// Follows boards over their telemetry streams
+//
+// Usage: telemetry_decode <port>...          one line per change of each board, serial ports, files or FIFOs
+//        telemetry_decode bench [boards]     bytes per move against the text console, and decoding speed
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "telemetry.h"
+#include "telemetry_decoder.h"
+#include "board.h"
+#include "host_util.h"
+#include "serial_port.h"
+
+#define MAX_BOARDS 64
+#define BENCH_MOVES 200
+
+static const char *state_names[] = {"setup", "playing", "resume", "takeback"};
+
+static void print_frame(const Telemetry_decoder_t *decoder, uint8_t type, void *ctx)
+{
+    int board = (int)(intptr_t)ctx;
+    char text[POSITION_FEN_MAX];
+    const Telemetry_stats_t *stats = &decoder->stats;
+    const char *state = decoder->state < 4 ? state_names[decoder->state] : "?";
+    switch (type) {
+    case TELEMETRY_FRAME_KEYFRAME:
+        printf("[%d] keyframe\n", board);
+        break;
+    case TELEMETRY_SECTION_POSITION:
+        printf("[%d] %s ply %u %s\n", board, state, (unsigned int)decoder->plies, position_to_fen(&decoder->pos, text));
+        break;
+    case TELEMETRY_SECTION_MOVE:
+        printf("[%d] ply %u %s\n", board, (unsigned int)decoder->plies, move_to_uci(decoder->last_move, text));
+        break;
+    case TELEMETRY_SECTION_STATE:
+        printf("[%d] %s\n", board, state);
+        break;
+    case TELEMETRY_SECTION_SQUARES:
+    case TELEMETRY_SECTION_OCCUPANCY:
+        printf("[%d] occupancy %016llx\n", board, (unsigned long long)decoder->occupancy);
+        break;
+    case TELEMETRY_SECTION_PIXELS:
+    case TELEMETRY_SECTION_LEDS: {
+        int lit = 0;
+        for (int sq = 0; sq < SQUARE_NB; sq++) {
+            lit += (decoder->leds[sq][0] | decoder->leds[sq][1] | decoder->leds[sq][2]) != 0;
+        }
+        printf("[%d] leds %d lit\n", board, lit);
+        break;
+    }
+    case TELEMETRY_SECTION_STATS:
+        printf("[%d] up %u ms, %u scans, %u hall events (%u dropped), %u LED frames, game %u us max, %u tx dropped\n",
+               board, (unsigned int)stats->uptime_ms, (unsigned int)stats->scan_frames,
+               (unsigned int)stats->hall_events, (unsigned int)stats->hall_dropped, (unsigned int)stats->led_frames,
+               (unsigned int)stats->game_max_us, (unsigned int)stats->tx_dropped);
+        break;
+    }
+    fflush(stdout);
+}
+
+static int follow(int count, char *paths[])
+{
+    static Telemetry_decoder_t decoders[MAX_BOARDS];
+    struct pollfd fds[MAX_BOARDS];
+    int open_count = 0;
+    for (int i = 0; i < count; i++) {
+        fds[i].fd = serial_port_open(paths[i], O_RDONLY);
+        fds[i].events = POLLIN;
+        if (fds[i].fd < 0) {
+            return EXIT_FAILURE;
+        }
+        telemetry_decoder_init(&decoders[i]);
+        open_count++;
+    }
+
+    uint8_t buffer[4096];
+    while (open_count > 0) {
+        if (poll(fds, (nfds_t)count, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("poll");
+            return EXIT_FAILURE;
+        }
+        for (int i = 0; i < count; i++) {
+            if (fds[i].fd < 0 || !(fds[i].revents & (POLLIN | POLLHUP | POLLERR))) {
+                continue;
+            }
+            ssize_t n = read(fds[i].fd, buffer, sizeof(buffer));
+            if (n <= 0) {
+                close(fds[i].fd);
+                fds[i].fd = -1;
+                open_count--;
+                continue;
+            }
+            telemetry_decoder_feed(&decoders[i], buffer, (size_t)n, print_frame, (void *)(intptr_t)i);
+        }
+    }
+    for (int i = 0; i < count; i++) {
+        const Telemetry_decoder_t *d = &decoders[i];
+        fprintf(stderr, "[%d] %llu bytes, %llu frames, %llu keyframes, %llu bad, %llu lost, %llu desyncs\n", i,
+                (unsigned long long)d->bytes, (unsigned long long)d->frames, (unsigned long long)d->keyframes,
+                (unsigned long long)d->bad_frames, (unsigned long long)d->lost_frames, (unsigned long long)d->desyncs);
+    }
+    return EXIT_SUCCESS;
+}
+
+static double now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+// Bytes the text console prints for a move: the move line and the board
+static size_t text_bytes_per_move(void)
+{
+    char *text;
+    size_t size;
+    char board[8][8];
+    Chess_position_t pos;
+    FILE *out = open_memstream(&text, &size);
+    init_board(&pos, board);
+    fprintf(out, "moving P from e2 to e4\n");
+    FILE *saved = stdout;
+    stdout = out;
+    print_board(board);
+    stdout = saved;
+    fclose(out);
+    free(text);
+    return size;
+}
+
+// Append what a board sends for a move: the piece lifted and its LED, then the piece put down and the move
+static void bench_move(Telemetry_encoder_t *enc, Telemetry_board_t *board, uint8_t leds[SQUARE_NB][3],
+                       Telemetry_stats_t *stats, uint64_t *seed)
+{
+    Move_list_t list;
+    if (generate_legal_moves(&board->pos, &list) == 0 || board->plies >= 300) {
+        position_set_start(&board->pos);
+        board->start_key = board->pos.key;
+        board->plies = 0;
+    }
+    generate_legal_moves(&board->pos, &list);
+    Chess_move_t move = list.moves[host_random(seed) % list.count];
+    board->occupancy &= ~BB_SQUARE(MOVE_FROM(move));
+    memset(leds[MOVE_FROM(move)], 0xFF, 3);
+    telemetry_encode(enc, board, leds, stats);
+    board->occupancy |= BB_SQUARE(MOVE_TO(move));
+    memset(leds[MOVE_FROM(move)], 0, 3);
+    make_move(&board->pos, move);
+    board->recent[board->plies++ % TELEMETRY_RECENT_MOVES] = move;
+    // Stats go out once a second, a move takes a few
+    if (board->plies % 4 == 0) {
+        stats->uptime_ms += 4000;
+        stats->scan_frames += 800;
+        stats->hall_events += 8;
+        stats->led_frames += 8;
+    }
+    telemetry_encode(enc, board, leds, stats);
+}
+
+static int bench(int boards)
+{
+    static Telemetry_encoder_t enc;
+    static Telemetry_decoder_t decoder;
+    size_t capacity = (size_t)boards * BENCH_MOVES * 256 + 65536, size = 0;
+    uint8_t *stream = malloc(capacity);
+    size_t *ends = malloc(sizeof(size_t) * (size_t)boards);
+    uint64_t seed = 1;
+    if (!stream || !ends) {
+        return EXIT_FAILURE;
+    }
+
+    // Every board's stream, one after the other
+    double encode_us = 0;
+    for (int b = 0; b < boards; b++) {
+        Telemetry_board_t board = {0};
+        uint8_t leds[SQUARE_NB][3] = {{0}};
+        Telemetry_stats_t stats = {0};
+        position_set_start(&board.pos);
+        board.start_key = board.pos.key;
+        board.occupancy = board.pos.colors[SIDE_WHITE] | board.pos.colors[SIDE_BLACK];
+        board.state = 1;
+        telemetry_encoder_init(&enc);
+        for (int i = 0; i < BENCH_MOVES; i++) {
+            double start = now_us();
+            bench_move(&enc, &board, leds, &stats, &seed);
+            encode_us += now_us() - start;
+            const uint8_t *data;
+            size_t n;
+            while ((n = telemetry_ring_peek(&enc.ring, &data)) > 0 && size + n <= capacity) {
+                memcpy(stream + size, data, n);
+                size += n;
+                telemetry_ring_consume(&enc.ring, n);
+            }
+        }
+        ends[b] = size;
+    }
+
+    // A decoder per board, as when following them all
+    uint64_t frames = 0;
+    bool ok = true;
+    double start = now_us();
+    for (int b = 0; b < boards; b++) {
+        size_t from = b > 0 ? ends[b - 1] : 0;
+        telemetry_decoder_init(&decoder);
+        telemetry_decoder_feed(&decoder, stream + from, ends[b] - from, NULL, NULL);
+        frames += decoder.frames;
+        ok &= decoder.synced && decoder.bad_frames == 0 && decoder.lost_frames == 0 && decoder.desyncs == 0;
+    }
+    double decode_us = now_us() - start;
+    double moves = (double)boards * BENCH_MOVES;
+    size_t text = text_bytes_per_move();
+
+    printf("%d boards, %.0f moves, %zu bytes\n", boards, moves, size);
+    printf("%.1f bytes per move, the text console prints %zu (%.1f%%)\n", size / moves, text,
+           100.0 * size / moves / text);
+    printf("encode %.2f us per move\n", encode_us / moves);
+    printf("decode %.1f MB/s, %.0f frames/s, %.2f us per move\n", size / decode_us,
+           frames / decode_us * 1e6, decode_us / moves);
+    free(stream);
+    free(ends);
+    printf("%s\n", ok ? "all boards decoded" : "decode errors");
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc >= 2 && strcmp(argv[1], "bench") == 0) {
+        int boards = argc > 2 ? atoi(argv[2]) : 16;
+        return bench(boards > 0 ? boards : 16);
+    }
+    if (argc >= 2 && argc - 1 <= MAX_BOARDS) {
+        return follow(argc - 1, argv + 1);
+    }
+    fprintf(stderr, "usage: %s <port>... | bench [boards]\n", argv[0]);
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,237 @@
+#include <string.h>
+#include "telemetry_decoder.h"
+#include "crc32.h"
+
+static uint16_t get_u16(const uint8_t *bytes)
+{
+    return (uint16_t)(bytes[0] | bytes[1] << 8);
+}
+
+static uint32_t get_u32(const uint8_t *bytes)
+{
+    return bytes[0] | (uint32_t)bytes[1] << 8 | (uint32_t)bytes[2] << 16 | (uint32_t)bytes[3] << 24;
+}
+
+static uint64_t get_u64(const uint8_t *bytes)
+{
+    return get_u32(bytes) | (uint64_t)get_u32(bytes + 4) << 32;
+}
+
+void telemetry_decoder_init(Telemetry_decoder_t *decoder)
+{
+    memset(decoder, 0, sizeof(*decoder));
+}
+
+static void keyframe(Telemetry_decoder_t *decoder)
+{
+    decoder->synced = true;
+    decoder->has_position = false;
+    decoder->state = 0;
+    decoder->plies = 0;
+    decoder->occupancy = 0;
+    decoder->last_move = MOVE_NONE;
+    memset(decoder->leds, 0, sizeof(decoder->leds));
+    memset(&decoder->stats, 0, sizeof(decoder->stats));
+    decoder->keyframes++;
+}
+
+static bool apply_move(Telemetry_decoder_t *decoder, const uint8_t *data, size_t size)
+{
+    if (size != 6 || !decoder->has_position) {
+        return false;
+    }
+    Chess_move_t move = get_u16(data);
+    Move_list_t list;
+    int i = 0, count = generate_legal_moves(&decoder->pos, &list);
+    while (i < count && list.moves[i] != move) {
+        i++;
+    }
+    if (i == count) {
+        return false;
+    }
+    make_move(&decoder->pos, move);
+    decoder->plies++;
+    decoder->last_move = move;
+    return (uint32_t)decoder->pos.key == get_u32(data + 2);
+}
+
+static bool apply_position(Telemetry_decoder_t *decoder, const uint8_t *data, size_t size)
+{
+    char fen[POSITION_FEN_MAX];
+    if (size < 4 || size - 3 >= sizeof(fen)) {
+        return false;
+    }
+    memcpy(fen, data + 3, size - 3);
+    fen[size - 3] = '\0';
+    if (!position_from_fen(&decoder->pos, fen)) {
+        return false;
+    }
+    decoder->state = data[0];
+    decoder->plies = get_u16(data + 1);
+    decoder->has_position = true;
+    return true;
+}
+
+static bool apply_squares(Telemetry_decoder_t *decoder, const uint8_t *data, size_t size)
+{
+    for (size_t i = 0; i < size; i++) {
+        if (data[i] >= SQUARE_NB) {
+            return false;
+        }
+        decoder->occupancy ^= BB_SQUARE(data[i]);
+    }
+    return true;
+}
+
+static bool apply_pixels(Telemetry_decoder_t *decoder, const uint8_t *data, size_t size)
+{
+    if (size % 4 != 0) {
+        return false;
+    }
+    for (size_t i = 0; i < size; i += 4) {
+        if (data[i] >= SQUARE_NB) {
+            return false;
+        }
+        memcpy(decoder->leds[data[i]], data + i + 1, 3);
+    }
+    return true;
+}
+
+static bool apply_leds(Telemetry_decoder_t *decoder, const uint8_t *data, size_t size)
+{
+    if (size < 8) {
+        return false;
+    }
+    Bitboard_t changed = get_u64(data);
+    if (size != 8 + 3 * (size_t)bb_popcount(changed)) {
+        return false;
+    }
+    const uint8_t *rgb = data + 8;
+    while (changed) {
+        memcpy(decoder->leds[bb_pop_lsb(&changed)], rgb, 3);
+        rgb += 3;
+    }
+    return true;
+}
+
+static bool apply_stats(Telemetry_decoder_t *decoder, const uint8_t *data, size_t size)
+{
+    if (size < 1) {
+        return false;
+    }
+    uint8_t changed = data[0];
+    uint32_t *stats = (uint32_t *)&decoder->stats;
+    size_t at = 1;
+    for (int i = 0; i < TELEMETRY_STATS_NB; i++) {
+        if (changed & (1 << i)) {
+            if (at + 4 > size) {
+                return false;
+            }
+            stats[i] = get_u32(data + at);
+            at += 4;
+        }
+    }
+    return at == size;
+}
+
+static bool apply_section(Telemetry_decoder_t *decoder, uint8_t tag, const uint8_t *data, size_t size)
+{
+    switch (tag) {
+    case TELEMETRY_SECTION_POSITION:
+        return apply_position(decoder, data, size);
+    case TELEMETRY_SECTION_MOVE:
+        return apply_move(decoder, data, size);
+    case TELEMETRY_SECTION_STATE:
+        if (size != 1) {
+            return false;
+        }
+        decoder->state = data[0];
+        return true;
+    case TELEMETRY_SECTION_SQUARES:
+        return apply_squares(decoder, data, size);
+    case TELEMETRY_SECTION_OCCUPANCY:
+        if (size != 8) {
+            return false;
+        }
+        decoder->occupancy ^= get_u64(data);
+        return true;
+    case TELEMETRY_SECTION_PIXELS:
+        return apply_pixels(decoder, data, size);
+    case TELEMETRY_SECTION_LEDS:
+        return apply_leds(decoder, data, size);
+    case TELEMETRY_SECTION_STATS:
+        return apply_stats(decoder, data, size);
+    default:
+        return true;   // From a newer version, skipped
+    }
+}
+
+// Apply one frame, without its delimiters
+static void decode_frame(Telemetry_decoder_t *decoder, Telemetry_frame_cb_t on_frame, void *ctx)
+{
+    uint8_t raw[TELEMETRY_ENCODED_MAX];
+    size_t size = telemetry_cobs_decode(decoder->frame, decoder->frame_size, raw, sizeof(raw));
+    if (size < 6 || crc32_update(0, raw, size - 4) != get_u32(raw + size - 4)) {
+        decoder->bad_frames++;
+        return;
+    }
+    uint8_t type = raw[0], seq = raw[1];
+    const uint8_t *data = raw + 2, *end = raw + size - 4;
+
+    // Any gap means a change was missed, only a keyframe brings the state back
+    if (decoder->synced && seq != decoder->next_seq) {
+        decoder->lost_frames += (uint8_t)(seq - decoder->next_seq);
+        decoder->synced = false;
+    }
+    decoder->next_seq = (uint8_t)(seq + 1);
+    if (type == TELEMETRY_FRAME_KEYFRAME) {
+        if (data == end || *data++ != TELEMETRY_VERSION) {
+            decoder->bad_frames++;
+            decoder->synced = false;
+            return;
+        }
+        keyframe(decoder);
+        if (on_frame) {
+            on_frame(decoder, type, ctx);
+        }
+    } else if (type != TELEMETRY_FRAME_DELTA || !decoder->synced) {
+        return;
+    }
+
+    while (data < end) {
+        if (end - data < 2 || end - data - 2 < data[1] || !apply_section(decoder, data[0], data + 2, data[1])) {
+            decoder->desyncs++;
+            decoder->synced = false;
+            return;
+        }
+        if (on_frame) {
+            on_frame(decoder, data[0], ctx);
+        }
+        data += 2 + data[1];
+    }
+    decoder->frames++;
+}
+
+void telemetry_decoder_feed(Telemetry_decoder_t *decoder, const uint8_t *bytes, size_t size,
+                            Telemetry_frame_cb_t on_frame, void *ctx)
+{
+    decoder->bytes += size;
+    for (size_t i = 0; i < size; i++) {
+        if (bytes[i] != 0) {
+            if (decoder->frame_size < sizeof(decoder->frame)) {
+                decoder->frame[decoder->frame_size++] = bytes[i];
+            } else {
+                decoder->frame_overflow = true;
+            }
+            continue;
+        }
+        // Two zeros in a row are the end of a frame and the start of the next
+        if (decoder->frame_overflow) {
+            decoder->bad_frames++;
+        } else if (decoder->frame_size > 0) {
+            decode_frame(decoder, on_frame, ctx);
+        }
+        decoder->frame_size = 0;
+        decoder->frame_overflow = false;
+    }
+}
@@ -0,0 +1,67 @@
+// Rebuilds the live state of a board from its telemetry stream
+#ifndef TELEMETRY_DECODER_H
+#define TELEMETRY_DECODER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "telemetry.h"
+
+/**
+ * @brief The board as the frames received so far describe it
+ *
+ */
+typedef struct {
+    bool synced;              // A keyframe was received and no frame was missed since
+    bool has_position;        // A position section followed the keyframe
+    uint8_t next_seq;
+    uint8_t state;            // Game_state_t
+    Chess_position_t pos;
+    uint32_t plies;
+    Bitboard_t occupancy;
+    uint8_t leds[SQUARE_NB][3];
+    Telemetry_stats_t stats;
+    Chess_move_t last_move;   // Of the last move section
+    uint8_t frame[TELEMETRY_ENCODED_MAX];   // Bytes since the last zero
+    size_t frame_size;
+    bool frame_overflow;
+    uint64_t bytes;
+    uint64_t frames;          // Applied whole
+    uint64_t bad_frames;      // Not COBS, bad CRC or malformed: console text lands here
+    uint64_t lost_frames;     // Sequence gaps
+    uint64_t keyframes;
+    uint64_t desyncs;         // Malformed sections, moves that did not reach the key they were sent with
+} Telemetry_decoder_t;
+
+/**
+ * @brief Called after a keyframe resets the state and after each section is applied
+ *
+ * @param decoder The decoder, with the section applied
+ * @param type TELEMETRY_FRAME_KEYFRAME, or the Telemetry_section_t
+ * @param ctx As passed to telemetry_decoder_feed()
+ */
+typedef void (*Telemetry_frame_cb_t)(const Telemetry_decoder_t *decoder, uint8_t type, void *ctx);
+
+/**
+ * @brief Start waiting for a keyframe
+ *
+ * @param decoder The decoder
+ */
+void telemetry_decoder_init(Telemetry_decoder_t *decoder);
+
+/**
+ * @brief Decode bytes from the serial port
+ *
+ * Bytes can come in chunks of any size. Until the next keyframe, frames
+ * after a missed or damaged one are not applied.
+ *
+ * @param decoder The decoder
+ * @param bytes The bytes
+ * @param size Number of bytes
+ * @param on_frame Called for each keyframe and section applied, may be NULL
+ * @param ctx Passed to on_frame
+ */
+void telemetry_decoder_feed(Telemetry_decoder_t *decoder, const uint8_t *bytes, size_t size,
+                            Telemetry_frame_cb_t on_frame, void *ctx);
+
+#endif
@@ -0,0 +1,259 @@
+// Checks the game archive: move coding round trips, damage detection, the sector ring and power cuts
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "archive.h"
+#include "flash_file.h"
+#include "host_util.h"
+#include "test_check.h"
+
+#define FLASH_SECTORS 4
+#define RANDOM_GAMES 200
+#define GAME_MAX_PLIES 400
+#define CUT_STEP 29
+
+static char path[] = "/tmp/test_archive_XXXXXX";
+static Archive_t archive;
+
+// Random moves to the end of the game or GAME_MAX_PLIES, underpromotions and all
+static void random_game(Game_record_t *record, const Chess_position_t *start, uint64_t *seed)
+{
+    Chess_position_t pos = *start;
+    Move_list_t list;
+    game_record_init(record, start);
+    while (record->count < GAME_MAX_PLIES && generate_legal_moves(&pos, &list) > 0) {
+        Chess_move_t move = list.moves[host_random(seed) % list.count];
+        make_move(&pos, move);
+        game_record_append(record, move, pos.key);
+    }
+}
+
+static bool round_trip(const Game_record_t *record)
+{
+    static uint8_t data[ARCHIVE_GAME_MAX];
+    Game_record_t decoded;
+    Archive_entry_t entry;
+    size_t size = archive_encode(record, ARCHIVE_RESULT_DRAW, 1700000000, data, sizeof(data));
+    bool ok = size > 0 && archive_decode(data, size, &decoded, &entry) && host_same_moves(record, &decoded) &&
+              entry.plies == record->count && entry.result == ARCHIVE_RESULT_DRAW && entry.date == 1700000000 &&
+              entry.size == size;
+    game_record_clear(&decoded);
+    return ok;
+}
+
+static void check_codec(void)
+{
+    Chess_position_t start, pos;
+    Game_record_t record;
+    uint64_t seed = 42;
+    int bad = 0;
+    position_set_start(&start);
+
+    game_record_init(&record, &start);
+    check(round_trip(&record), "empty game");
+    for (int i = 0; i < RANDOM_GAMES; i++) {
+        random_game(&record, &start, &seed);
+        bad += !round_trip(&record);
+        game_record_clear(&record);
+    }
+    check(bad == 0, "random games round trip");
+
+    // Castling, en passant and promotions from a set up position
+    static const char *fens[] = {
+        "r3k2r/1P4P1/8/3pP3/8/8/1p4p1/R3K2R w KQkq d6 0 30",
+        "8/8/8/8/8/5k2/8/4K2R w K - 0 1",
+    };
+    for (size_t i = 0; i < sizeof(fens) / sizeof(fens[0]); i++) {
+        position_from_fen(&pos, fens[i]);
+        for (int j = 0; j < 20; j++) {
+            random_game(&record, &pos, &seed);
+            bad += !round_trip(&record);
+            game_record_clear(&record);
+        }
+    }
+    check(bad == 0, "set up games round trip");
+
+    // The opening key is the position after the opening plies
+    static uint8_t data[ARCHIVE_GAME_MAX];
+    Archive_entry_t entry;
+    Game_record_t decoded;
+    random_game(&record, &start, &seed);
+    pos = start;
+    for (int i = 0; i < ARCHIVE_OPENING_PLIES; i++) {
+        make_move(&pos, game_record_get(&record, i));
+    }
+    size_t size = archive_encode(&record, ARCHIVE_RESULT_WHITE_WINS, 0, data, sizeof(data));
+    check(archive_decode(data, size, &decoded, &entry) && entry.opening_key == pos.key && !entry.custom_start,
+          "opening key");
+    game_record_clear(&decoded);
+
+    // Damage anywhere is caught
+    data[size - 1] ^= 0x10;
+    check(!archive_decode(data, size, &decoded, NULL), "damaged moves are rejected");
+    game_record_clear(&decoded);
+    data[size - 1] ^= 0x10;
+    data[4] ^= 0x01;
+    check(!archive_decode(data, size, &decoded, NULL), "damaged header is rejected");
+    game_record_clear(&decoded);
+    check(archive_encode(&record, ARCHIVE_RESULT_WHITE_WINS, 0, data, ARCHIVE_GAME_HEADER_SIZE + 40) == 0,
+          "a game too long for the room is not encoded");
+    game_record_clear(&record);
+
+    check(archive_result_from_pgn("0-1") == ARCHIVE_RESULT_BLACK_WINS &&
+          strcmp(archive_result_pgn(archive_result_from_pgn("1/2-1/2")), "1/2-1/2") == 0 &&
+          archive_result_from_pgn("*") == ARCHIVE_RESULT_UNFINISHED, "results");
+}
+
+static void open_flash(Flash_file_t *flash)
+{
+    Flash_ring_io_t access;
+    flash_file_open(flash, path, FLASH_SECTORS * FLASH_RING_SECTOR_SIZE);
+    flash_file_io(flash, &access);
+    archive_init(&archive, &access);
+}
+
+// The dates of the listed games, which the tests number in order
+static int list_dates(uint32_t *dates, int max)
+{
+    Archive_iter_t iter;
+    Archive_entry_t entry;
+    int count = 0;
+    archive_iter_init(&archive, &iter);
+    while (archive_next(&archive, &iter, &entry) && count < max) {
+        dates[count++] = entry.date;
+    }
+    return count;
+}
+
+static bool consecutive(const uint32_t *dates, int count, uint32_t last)
+{
+    for (int i = 0; i < count; i++) {
+        if (dates[i] != last - (uint32_t)(count - 1 - i)) {
+            return false;
+        }
+    }
+    return count > 0;
+}
+
+// Games are listed oldest first, the oldest sector goes when the ring is full, and a reboot appends after the last
+static void check_ring(void)
+{
+    Flash_file_t flash;
+    Game_record_t games[8], record;
+    Chess_position_t start;
+    static uint32_t dates[1024];
+    uint64_t seed = 7;
+    position_set_start(&start);
+    for (int i = 0; i < 8; i++) {
+        random_game(&games[i], &start, &seed);
+    }
+
+    truncate(path, 0);
+    open_flash(&flash);
+    check(list_dates(dates, 1024) == 0, "empty archive");
+    uint32_t written = 0;
+    bool ok = true;
+    for (; written < 30; written++) {
+        ok &= archive_append(&archive, &games[written % 8], ARCHIVE_RESULT_DRAW, written) == ESP_OK;
+    }
+    flash_file_close(&flash);
+    open_flash(&flash);
+    int count = list_dates(dates, 1024);
+    check(ok && count == 30 && consecutive(dates, count, 29), "games listed in order");
+    for (; written < 300; written++) {
+        ok &= archive_append(&archive, &games[written % 8], ARCHIVE_RESULT_DRAW, written) == ESP_OK;
+    }
+    count = list_dates(dates, 1024);
+    check(ok && count > 30 && count < 300 && consecutive(dates, count, 299), "oldest games dropped");
+    check(flash.erase_counts[0] > 1 && flash.erase_counts[FLASH_SECTORS - 1] > 0, "every sector in turn");
+
+    // Search by opening, then replay
+    Archive_iter_t iter;
+    Archive_entry_t entry;
+    int matches = 0, replayed = 0;
+    uint64_t opening = 0;
+    archive_iter_init(&archive, &iter);
+    while (archive_next(&archive, &iter, &entry)) {
+        if (opening == 0) {
+            opening = entry.opening_key;
+        }
+        matches += entry.opening_key == opening;
+        if (archive_load(&archive, &entry, &record) == ESP_OK) {
+            replayed += host_same_moves(&record, &games[entry.date % 8]);
+            game_record_clear(&record);
+        }
+    }
+    check(matches > 0 && matches * 8 <= count + 8, "find by opening");
+    check(replayed == count, "every listed game replays");
+    flash_file_close(&flash);
+    for (int i = 0; i < 8; i++) {
+        game_record_clear(&games[i]);
+    }
+}
+
+// A power cut during a write loses that game at most, and the next one is stored after the rest
+static void check_power_cuts(void)
+{
+    Flash_file_t flash;
+    Game_record_t games[4];
+    Chess_position_t start;
+    static uint32_t dates[1024];
+    uint64_t seed = 99;
+    position_set_start(&start);
+    for (int i = 0; i < 4; i++) {
+        random_game(&games[i], &start, &seed);
+    }
+
+    truncate(path, 0);
+    open_flash(&flash);
+    uint64_t total_start = flash.written;
+    for (uint32_t i = 0; i < 40; i++) {
+        archive_append(&archive, &games[i % 4], ARCHIVE_RESULT_DRAW, i);
+    }
+    uint64_t total = flash.written - total_start;
+    flash_file_close(&flash);
+
+    int runs = 0, bad = 0;
+    for (uint64_t cut = 0; cut < total; cut += CUT_STEP, runs++) {
+        truncate(path, 0);
+        open_flash(&flash);
+        flash.budget = (int64_t)cut;
+        uint32_t stored = 0;
+        while (stored < 40 && archive_append(&archive, &games[stored % 4], ARCHIVE_RESULT_DRAW, stored) == ESP_OK) {
+            stored++;
+        }
+        flash_file_close(&flash);
+
+        // After the reboot every game written before the cut is there, the torn one is not
+        open_flash(&flash);
+        int count = list_dates(dates, 1024);
+        bool ok = count == 0 ? stored == 0 : consecutive(dates, count, stored - 1);
+        ok &= archive_append(&archive, &games[0], ARCHIVE_RESULT_DRAW, 1000) == ESP_OK;
+        count = list_dates(dates, 1024);
+        ok &= count > 0 && dates[count - 1] == 1000;
+        bad += !ok;
+        flash_file_close(&flash);
+    }
+    printf("%d power cuts, %d bad archives\n", runs, bad);
+    check(bad == 0, "archive after a power cut");
+    for (int i = 0; i < 4; i++) {
+        game_record_clear(&games[i]);
+    }
+}
+
+int main(void)
+{
+    close(mkstemp(path));
+    check_codec();
+    check_ring();
+    check_power_cuts();
+    unlink(path);
+
+    if (failures) {
+        printf("%d checks failed\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("archive ok\n");
+    return EXIT_SUCCESS;
+}
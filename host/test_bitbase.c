@@ -0,0 +1,168 @@
+// Checks the generated bitbases against known positions and against their own moves, for both colors
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bitbase_gen.h"
+#include "game_record.h"
+#include "search.h"
+#include "test_check.h"
+
+#define CONVERSION_PLIES 120
+
+typedef struct {
+    const char *fen;
+    Bitbase_result_t result;
+} Bitbase_case_t;
+
+static const Bitbase_case_t known[] = {
+    // King two squares in front of the pawn wins, one square in front needs the opposition
+    {"4k3/8/4K3/4P3/8/8/8/8 b - - 0 1", BITBASE_LOSS},
+    {"8/4k3/8/4K3/4P3/8/8/8 w - - 0 1", BITBASE_DRAW},
+    {"8/4k3/8/4K3/4P3/8/8/8 b - - 0 1", BITBASE_LOSS},
+    {"8/8/8/4p3/4k3/8/4K3/8 b - - 0 1", BITBASE_DRAW},
+    {"8/8/8/4p3/4k3/8/4K3/8 w - - 0 1", BITBASE_LOSS},
+    // Rook pawns with the defender in the corner
+    {"k7/8/K7/P7/8/8/8/8 w - - 0 1", BITBASE_DRAW},
+    {"7k/8/8/8/8/8/P7/K7 w - - 0 1", BITBASE_WIN},
+    // Mates, stalemates and hanging pieces
+    {"8/8/8/8/8/2k5/1q6/K7 w - - 0 1", BITBASE_LOSS},
+    {"k7/2Q5/1K6/8/8/8/8/8 b - - 0 1", BITBASE_DRAW},
+    {"8/8/8/8/8/8/1r6/K1k5 w - - 0 1", BITBASE_DRAW},
+    {"8/8/8/3k4/8/8/8/R3K3 w - - 0 1", BITBASE_WIN},
+    {"8/8/8/8/8/8/8/K1k4q w - - 0 1", BITBASE_LOSS},
+    // Not covered
+    {"8/8/8/3k4/8/8/8/N3K3 w - - 0 1", BITBASE_NONE},
+    {"8/8/8/3k4/8/8/8/R3K2R w K - 0 1", BITBASE_NONE},
+};
+
+// The result the moves of a position prove, probing every child
+static Bitbase_result_t expected_result(const Bitbase_t *bitbase, const Chess_position_t *pos)
+{
+    Move_list_t list;
+    if (generate_legal_moves(pos, &list) == 0) {
+        return is_in_check(pos) ? BITBASE_LOSS : BITBASE_DRAW;
+    }
+    Bitbase_result_t best = BITBASE_LOSS;
+    for (int i = 0; i < list.count && best != BITBASE_WIN; i++) {
+        Chess_position_t child = *pos;
+        make_move(&child, list.moves[i]);
+        Bitbase_result_t result = bitbase_probe(bitbase, &child);
+        if (result == BITBASE_LOSS) {
+            best = BITBASE_WIN;
+        } else if (result != BITBASE_WIN) {
+            best = BITBASE_DRAW;   // Drawn, or a bare king or minor piece left
+        }
+    }
+    return best;
+}
+
+static bool set_up(Chess_position_t *pos, Piece_type_t type, Side_t strong, Side_t side_to_move, int strong_king,
+                   int weak_king, int piece)
+{
+    if (strong_king == weak_king || piece == strong_king || piece == weak_king ||
+            (king_attack_table[strong_king] & BB_SQUARE(weak_king)) ||
+            (type == PIECE_PAWN && (SQUARE_RANK(piece) == 0 || SQUARE_RANK(piece) == 7))) {
+        return false;
+    }
+    memset(pos, 0, sizeof(*pos));
+    pos->ep_square = SQUARE_NONE;
+    position_put_piece(pos, strong_king, strong, PIECE_KING);
+    position_put_piece(pos, weak_king, !strong, PIECE_KING);
+    position_put_piece(pos, piece, strong, type);
+    pos->side_to_move = !side_to_move;
+    bool illegal = is_in_check(pos);
+    pos->side_to_move = side_to_move;
+    return !illegal;
+}
+
+// Every legal position, with either color as the strong side, agrees with its moves and its mirror image
+static void check_ending(const Bitbase_t *bitbase, Piece_type_t type, const char *name)
+{
+    int wins = 0, draws = 0, mismatches = 0, mirrors = 0;
+    for (int side = 0; side < 2; side++) {
+        for (int sk = 0; sk < 64; sk++) {
+            for (int wk = 0; wk < 64; wk++) {
+                for (int piece = 0; piece < 64; piece++) {
+                    Chess_position_t white, black;
+                    if (!set_up(&white, type, SIDE_WHITE, (Side_t)side, sk, wk, piece)) {
+                        continue;
+                    }
+                    set_up(&black, type, SIDE_BLACK, (Side_t)!side, sk ^ 56, wk ^ 56, piece ^ 56);
+                    Bitbase_result_t result = bitbase_probe(bitbase, &white);
+                    mismatches += result != expected_result(bitbase, &white);
+                    mirrors += result != bitbase_probe(bitbase, &black);
+                    if (side == SIDE_WHITE) {
+                        wins += result == BITBASE_WIN;
+                        draws += result == BITBASE_DRAW;
+                    }
+                }
+            }
+        }
+    }
+    printf("%s: white to move %d wins %d draws, %d mismatches, %d color mismatches\n", name, wins, draws,
+           mismatches, mirrors);
+    check(mismatches == 0, "results agree with the moves");
+    check(mirrors == 0, "results agree with colors swapped");
+    // With the move the piece can always be saved, so only pawns draw
+    check(type == PIECE_PAWN || draws == 0, "white to move always wins with a rook or queen");
+}
+
+// Both sides search a few plies with the bitbase, the strong side has to deliver mate
+static void check_conversion(const Bitbase_t *bitbase, const char *fen)
+{
+    static Search_t search;
+    Chess_position_t pos;
+    Game_record_t record;
+    const Search_limits_t limits = {.max_depth = 4};
+    position_from_fen(&pos, fen);
+    game_record_init(&record, &pos);
+    search.bitbase = bitbase;
+
+    int ply;
+    Move_list_t list;
+    for (ply = 0; ply < CONVERSION_PLIES && generate_legal_moves(&pos, &list) > 0; ply++) {
+        uint64_t keys[SEARCH_HISTORY_MAX];
+        search_init(&search, &limits);
+        search_set_history(&search, keys, game_record_recent_keys(&record, &pos, keys, SEARCH_HISTORY_MAX));
+        make_move(&pos, search_run(&search, &pos)->best_move);
+        game_record_append(&record, search.report.best_move, pos.key);
+    }
+    game_record_clear(&record);
+    bool mated = list.count == 0 && is_in_check(&pos);
+    printf("%s %s mated after %d plies\n", mated ? "ok  " : "FAIL", fen, ply);
+    failures += !mated;
+}
+
+int main(void)
+{
+    static uint8_t image[BITBASE_SIZE];
+    Bitbase_t bitbase;
+    bitbase_generate(image, false);
+    check(bitbase_open_memory(&bitbase, image, sizeof(image)), "image opens");
+    check(!bitbase_open_memory(&bitbase, image + 1, sizeof(image) - 1), "bad image is refused");
+    bitbase_open_memory(&bitbase, image, sizeof(image));
+
+    for (size_t i = 0; i < sizeof(known) / sizeof(known[0]); i++) {
+        Chess_position_t pos;
+        position_from_fen(&pos, known[i].fen);
+        if (bitbase_probe(&bitbase, &pos) != known[i].result) {
+            printf("FAIL %s\n", known[i].fen);
+            failures++;
+        }
+    }
+
+    check_ending(&bitbase, PIECE_PAWN, "KPK");
+    check_ending(&bitbase, PIECE_ROOK, "KRK");
+    check_ending(&bitbase, PIECE_QUEEN, "KQK");
+
+    check_conversion(&bitbase, "8/8/8/3k4/8/8/8/2Q1K3 w - - 0 1");
+    check_conversion(&bitbase, "8/8/8/3k4/8/8/8/R3K3 w - - 0 1");
+    check_conversion(&bitbase, "8/8/3k4/8/8/3K4/3P4/8 w - - 0 1");
+
+    if (failures) {
+        printf("%d checks failed\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("bitbase ok\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,108 @@
+// Checks opening book lookups, move decoding and weighted picks on a mapped file
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "book_file.h"
+#include "test_check.h"
+
+static Chess_move_t uci_move(const Chess_position_t *pos, const char *uci)
+{
+    return find_legal_move(pos, SQUARE(uci[1] - '1', uci[0] - 'a'), SQUARE(uci[3] - '1', uci[2] - 'a'),
+                           PIECE_QUEEN);
+}
+
+static bool is_move(Chess_move_t move, const char *uci)
+{
+    char buf[6];
+    return move != MOVE_NONE && strcmp(move_to_uci(move, buf), uci) == 0;
+}
+
+int main(void)
+{
+    // Every legal move survives the Polyglot encoding, castling and promotions included
+    static const char *fens[] = {
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 b kq - 0 1",
+        "rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3",
+    };
+    for (size_t i = 0; i < sizeof(fens) / sizeof(fens[0]); i++) {
+        Chess_position_t pos;
+        Move_list_t list;
+        position_from_fen(&pos, fens[i]);
+        generate_legal_moves(&pos, &list);
+        for (int j = 0; j < list.count; j++) {
+            check(book_move_to_chess(&pos, book_move_from_chess(list.moves[j])) == list.moves[j], "move round trip");
+        }
+    }
+
+    // Polyglot writes castling as the king taking its rook
+    Chess_position_t start, castle;
+    position_set_start(&start);
+    position_from_fen(&castle, "r3k2r/pppppppp/8/8/8/8/PPPPPPPP/R3K2R w KQkq - 0 1");
+    check(book_move_from_chess(uci_move(&castle, "e1g1")) == (7 | 0 << 3 | 4 << 6 | 0 << 9), "e1g1 is e1h1");
+    check(book_move_from_chess(uci_move(&castle, "e1c1")) == (0 | 0 << 3 | 4 << 6 | 0 << 9), "e1c1 is e1a1");
+
+    // Entries of the start position and the castling position in key order, then erased flash
+    Book_entry_t start_entries[] = {
+        {start.key, book_move_from_chess(uci_move(&start, "e2e4")), 3, 0},
+        {start.key, book_move_from_chess(uci_move(&start, "d2d4")), 1, 0},
+        {start.key, book_move_from_chess(uci_move(&start, "g1f3")), 0, 0},
+    };
+    Book_entry_t castle_entry = {castle.key, book_move_from_chess(uci_move(&castle, "e1g1")), 1, 0};
+    char path[] = "/tmp/test_book_XXXXXX";
+    FILE *file = fdopen(mkstemp(path), "wb");
+    uint8_t bytes[BOOK_ENTRY_SIZE];
+    if (castle.key < start.key) {
+        book_write_entry(bytes, &castle_entry);
+        fwrite(bytes, sizeof(bytes), 1, file);
+    }
+    for (size_t i = 0; i < sizeof(start_entries) / sizeof(start_entries[0]); i++) {
+        book_write_entry(bytes, &start_entries[i]);
+        fwrite(bytes, sizeof(bytes), 1, file);
+    }
+    if (castle.key > start.key) {
+        book_write_entry(bytes, &castle_entry);
+        fwrite(bytes, sizeof(bytes), 1, file);
+    }
+    uint8_t erased[3 * BOOK_ENTRY_SIZE];
+    memset(erased, 0xFF, sizeof(erased));
+    fwrite(erased, sizeof(erased), 1, file);
+    fclose(file);
+
+    Opening_book_t book;
+    check(book_open_file(&book, path), "book opens");
+    unlink(path);
+    check(book.count == 4, "erased entries are not counted");
+
+    Book_entry_t entry;
+    size_t first = book_find(&book, start.key);
+    check(first < book.count, "start position found");
+    book_read_entry(&book, first, &entry);
+    check(entry.key == start.key && entry.weight == 3, "first entry of the key");
+    check(book_find(&book, castle.key) == (castle.key < start.key ? 0 : 3), "castling position found");
+
+    // Weights 3 and 1: randoms 0-2 pick e4, 3 picks d4, the zero weight move never
+    check(is_move(book_probe(&book, &start, 0), "e2e4"), "random 0 picks e2e4");
+    check(is_move(book_probe(&book, &start, 2), "e2e4"), "random 2 picks e2e4");
+    check(is_move(book_probe(&book, &start, 3), "d2d4"), "random 3 picks d2d4");
+    check(is_move(book_probe(&book, &start, 7), "d2d4"), "random 7 picks d2d4");
+    Chess_move_t move = book_probe(&book, &castle, 12345);
+    check(is_move(move, "e1g1") && MOVE_FLAGS(move) == MOVE_FLAG_KING_CASTLE, "book castling");
+
+    Chess_position_t out;
+    position_from_fen(&out, "4k3/8/8/8/8/8/8/4K3 w - - 0 1");
+    check(book_probe(&book, &out, 0) == MOVE_NONE, "position out of book");
+    book_close_file(&book);
+
+    Opening_book_t empty;
+    book_open_memory(&empty, erased, sizeof(erased));
+    check(empty.count == 0 && book_probe(&empty, &start, 0) == MOVE_NONE, "erased partition is an empty book");
+
+    if (failures) {
+        printf("%d checks failed\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("book ok\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,24 @@
+// The failure count and check of the host tests, each test includes it once
+#ifndef TEST_CHECK_H
+#define TEST_CHECK_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+static int failures;
+
+/**
+ * @brief Count a failed check and print what it was
+ *
+ * @param ok Result of the check
+ * @param what What was checked
+ */
+static inline void check(bool ok, const char *what)
+{
+    if (!ok) {
+        printf("FAIL %s\n", what);
+        failures++;
+    }
+}
+
+#endif
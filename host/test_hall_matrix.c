@@ -0,0 +1,50 @@
+// Checks the hall matrix row decoding and column transpose against a naive reference
+#include <stdio.h>
+#include <stdlib.h>
+#include "hall_matrix.h"
+#include "host_util.h"
+
+// Row pins of the board, see hall_scan.c
+static const uint8_t row_pins[HALL_ROW_NUM] = {14, 13, 21, 8, 15, 16, 17, 18};
+
+int main(void)
+{
+    Hall_row_decoder_t active_high, active_low;
+    hall_decoder_init(&active_high, row_pins, false);
+    hall_decoder_init(&active_low, row_pins, true);
+
+    uint64_t seed = 0x9E3779B97F4A7C15ULL;
+    int failures = 0;
+    for (int i = 0; i < 100000; i++) {
+        uint32_t in_reg = (uint32_t)host_random(&seed);
+        uint8_t expected = 0;
+        for (int row = 0; row < HALL_ROW_NUM; row++) {
+            if (in_reg & (1UL << row_pins[row])) {
+                expected |= 1 << row;
+            }
+        }
+        uint8_t inverted = (uint8_t)~expected;
+        if (hall_decode_rows(&active_high, in_reg) != expected ||
+                hall_decode_rows(&active_low, in_reg) != inverted) {
+            printf("FAIL decode 0x%08lx\n", (unsigned long)in_reg);
+            failures++;
+        }
+
+        uint64_t columns = host_random(&seed);
+        Bitboard_t occupancy = 0;
+        for (int col = 0; col < HALL_COL_NUM; col++) {
+            for (int row = 0; row < HALL_ROW_NUM; row++) {
+                if ((columns >> (col * 8 + row)) & 1) {
+                    occupancy |= BB_SQUARE(SQUARE(row, col));
+                }
+            }
+        }
+        if (hall_columns_to_occupancy(columns) != occupancy) {
+            printf("FAIL transpose 0x%016llx\n", (unsigned long long)columns);
+            failures++;
+        }
+    }
+
+    printf("%s\n", failures ? "hall matrix: FAIL" : "hall matrix: ok");
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,335 @@
+// Checks the game journal on an emulated flash file: round trips, sector changes, wear and power cuts
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "flash_file.h"
+#include "journal.h"
+#include "game.h"
+#include "host_util.h"
+#include "test_check.h"
+
+#define FLASH_SECTORS 4
+#define SESSION_PLIES 1500
+#define GAME_MAX_PLIES 400
+#define WINDOW_MAX (SESSION_PLIES + 16)
+#define CUT_STEP 7
+
+static char path[] = "/tmp/test_journal_XXXXXX";
+
+static void open_flash(Flash_file_t *flash, Journal_t *journal)
+{
+    Flash_ring_io_t access;
+    flash_file_open(flash, path, FLASH_SECTORS * FLASH_RING_SECTOR_SIZE);
+    flash_file_io(flash, &access);
+    journal_init(journal, &access);
+}
+
+static void erase_flash(void)
+{
+    truncate(path, 0);
+}
+
+// A state replay may find: the position reached, or no game in progress
+typedef struct {
+    bool active;
+    uint64_t key;
+} Journal_state_t;
+
+/**
+ * Random games with flushes every few moves. Stops at the first failed flush, as a power cut would,
+ * and leaves the states a replay may find in window: the one at the last good flush and every later one.
+ */
+static bool run_session(Journal_t *journal, uint64_t seed, Journal_state_t *window, int *window_count,
+                        Chess_position_t *pos)
+{
+    int game_plies = 0;
+    bool active = false;
+    window[0] = (Journal_state_t){.active = false};
+    *window_count = 1;
+
+    for (int ply = 0; ply < SESSION_PLIES; ply++) {
+        Move_list_t list;
+        if (!active || game_plies >= GAME_MAX_PLIES || generate_legal_moves(pos, &list) == 0) {
+            position_set_start(pos);
+            journal_new_game(journal, pos);
+            game_plies = 0;
+            active = true;
+            window[(*window_count)++] = (Journal_state_t){.active = true, .key = pos->key};
+            generate_legal_moves(pos, &list);
+        }
+        Chess_move_t move = list.moves[host_random(&seed) % list.count];
+        journal_add_move(journal, move);
+        make_move(pos, move);
+        game_plies++;
+        Move_list_t replies;
+        window[(*window_count)++] = (Journal_state_t){.active = generate_legal_moves(pos, &replies) > 0, .key = pos->key};
+
+        if (host_random(&seed) % 4 == 0 || ply == SESSION_PLIES - 1) {
+            if (journal_flush(journal) != ESP_OK) {
+                return false;
+            }
+            window[0] = window[*window_count - 1];
+            *window_count = 1;
+        }
+    }
+    return true;
+}
+
+static bool in_window(const Journal_state_t *window, int count, bool active, uint64_t key)
+{
+    for (int i = 0; i < count; i++) {
+        if (window[i].active == active && (!active || window[i].key == key)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Replays with a fresh journal, as after a reboot
+static bool replay(Flash_file_t *flash, Journal_t *journal, Game_record_t *record, Chess_position_t *pos)
+{
+    flash_file_close(flash);
+    open_flash(flash, journal);
+    game_record_clear(record);
+    return journal_replay(journal, record, pos);
+}
+
+static void check_round_trip(void)
+{
+    static const char *moves[] = {"e2e4", "e7e5", "g1f3", "b8c6", "f1b5", "a7a6", "b5a4", "g8f6", "e1g1", "f8e7",
+                                  "f1e1", "b7b5", "a4b3", "d7d6", "c2c3", "e8g8", "h2h3", "c6a5", "b3c2", "c7c5"};
+    Flash_file_t flash;
+    static Journal_t journal;
+    Game_record_t record;
+    Chess_position_t pos, live;
+
+    erase_flash();
+    open_flash(&flash, &journal);
+    check(!journal_replay(&journal, &record, &pos), "empty flash holds no game");
+    game_record_clear(&record);
+
+    position_set_start(&live);
+    journal_new_game(&journal, &live);
+    for (size_t i = 0; i < sizeof(moves) / sizeof(moves[0]); i++) {
+        Chess_move_t move = find_legal_move(&live, SQUARE(moves[i][1] - '1', moves[i][0] - 'a'),
+                                            SQUARE(moves[i][3] - '1', moves[i][2] - 'a'), PIECE_QUEEN);
+        journal_add_move(&journal, move);
+        make_move(&live, move);
+        if (i % 3 == 2) {
+            check(journal_flush(&journal) == ESP_OK, "flush");
+        }
+    }
+    uint64_t before_flush = flash.written;
+    check(journal_flush(&journal) == ESP_OK, "last flush");
+    check(flash.written - before_flush == 2 * 8, "a batch is one write of 8 bytes per move");
+
+    check(replay(&flash, &journal, &record, &pos), "game found");
+    check(pos.key == live.key && record.count == 20, "game replayed");
+    char uci[6];
+    check(strcmp(move_to_uci(game_record_get(&record, 8), uci), "e1g1") == 0, "moves replayed");
+
+    // Recording goes on after the replay, in the same sector
+    Chess_move_t move = find_legal_move(&live, SQUARE(1, 3), SQUARE(3, 3), PIECE_QUEEN);
+    journal_add_move(&journal, move);
+    make_move(&live, move);
+    check(journal_flush(&journal) == ESP_OK && journal.erases == 0, "appended after replay");
+    check(replay(&flash, &journal, &record, &pos) && pos.key == live.key, "appended move replayed");
+
+    // A damaged last record is dropped, and the next write goes to a new sector
+    uint8_t byte;
+    uint32_t last = journal.sector * FLASH_RING_SECTOR_SIZE + journal.offset - 6;
+    pread(flash.fd, &byte, 1, last);
+    byte ^= 0x10;
+    pwrite(flash.fd, &byte, 1, last);
+    check(replay(&flash, &journal, &record, &pos) && record.count == 20, "torn record dropped");
+    journal_add_move(&journal, move);
+    check(journal_flush(&journal) == ESP_OK && journal.erases == 1, "new sector after a torn record");
+    check(replay(&flash, &journal, &record, &pos) && pos.key == live.key, "rewritten move replayed");
+
+    // Mate ends the game, the next boot starts a new one
+    Chess_position_t mate;
+    position_from_fen(&mate, "6k1/5ppp/8/8/8/8/5PPP/R5K1 w - - 0 1");
+    journal_new_game(&journal, &mate);
+    journal_add_move(&journal, find_legal_move(&mate, SQUARE(0, 0), SQUARE(7, 0), PIECE_QUEEN));
+    check(journal_flush(&journal) == ESP_OK, "mate flushed");
+    check(!replay(&flash, &journal, &record, &pos), "finished game not resumed");
+
+    game_record_clear(&record);
+    flash_file_close(&flash);
+}
+
+// Long sessions wrap around the sectors, every replay has the live position and its repetition history
+static void check_sessions(void)
+{
+    Flash_file_t flash;
+    static Journal_t journal;
+    static Journal_state_t window[WINDOW_MAX];
+    Game_record_t record;
+    Chess_position_t pos, live;
+    int window_count;
+
+    erase_flash();
+    open_flash(&flash, &journal);
+    position_set_start(&live);
+    game_record_init(&record, &live);
+    run_session(&journal, 0x9E3779B97F4A7C15ULL, window, &window_count, &live);
+    uint32_t min = UINT32_MAX, max = 0;
+    for (int i = 0; i < FLASH_SECTORS; i++) {
+        min = flash.erase_counts[i] < min ? flash.erase_counts[i] : min;
+        max = flash.erase_counts[i] > max ? flash.erase_counts[i] : max;
+    }
+    printf("%d plies: %llu bytes written, sectors erased %u to %u times\n", SESSION_PLIES,
+           (unsigned long long)flash.written, (unsigned int)min, (unsigned int)max);
+    check(max - min <= 1, "erases spread over every sector");
+    check(replay(&flash, &journal, &record, &pos) == window[0].active && (!window[0].active || pos.key == live.key),
+          "long session replayed");
+
+    // The keys a repetition can come back to survive a sector change
+    uint64_t keys[JOURNAL_HISTORY_MAX];
+    int count = game_record_recent_keys(&record, &pos, keys, JOURNAL_HISTORY_MAX);
+    check(count == (pos.halfmove_clock < JOURNAL_HISTORY_MAX ? pos.halfmove_clock : JOURNAL_HISTORY_MAX),
+          "repetition history replayed");
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    replay(&flash, &journal, &record, &pos);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    printf("replay of %u moves: %.0f us\n", (unsigned int)record.count,
+           ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / 1e3);
+
+    game_record_clear(&record);
+    flash_file_close(&flash);
+}
+
+// Power cut after every few bytes of a session: the replay finds the state of the last good flush or a
+// later one, and recording goes on from there
+static void check_power_cuts(void)
+{
+    Flash_file_t flash;
+    static Journal_t journal;
+    static Journal_state_t window[WINDOW_MAX];
+    Game_record_t record;
+    Chess_position_t pos, live;
+    int window_count;
+
+    erase_flash();
+    open_flash(&flash, &journal);
+    run_session(&journal, 12345, window, &window_count, &live);
+    uint64_t total = flash.written;
+    flash_file_close(&flash);
+    position_set_start(&live);
+    game_record_init(&record, &live);
+
+    int runs = 0, bad = 0, bad_resume = 0;
+    for (uint64_t cut = 0; cut < total; cut += CUT_STEP, runs++) {
+        erase_flash();
+        open_flash(&flash, &journal);
+        flash.budget = (int64_t)cut;
+        run_session(&journal, 12345, window, &window_count, &live);
+
+        bool active = replay(&flash, &journal, &record, &pos);
+        if (!in_window(window, window_count, active, pos.key)) {
+            bad++;
+        }
+
+        // After the reboot moves are recorded on top of what was found
+        if (active) {
+            Move_list_t list;
+            for (int i = 0; i < 5 && generate_legal_moves(&pos, &list) > 0; i++) {
+                journal_add_move(&journal, list.moves[i % list.count]);
+                make_move(&pos, list.moves[i % list.count]);
+            }
+            journal_flush(&journal);
+            Chess_position_t resumed;
+            bool still_active = replay(&flash, &journal, &record, &resumed);
+            Move_list_t replies;
+            bad_resume += resumed.key != pos.key || still_active != (generate_legal_moves(&pos, &replies) > 0);
+        }
+        flash_file_close(&flash);
+    }
+    printf("%d power cuts, %d bad replays, %d bad resumes\n", runs, bad, bad_resume);
+    check(bad == 0, "replay after a power cut");
+    check(bad_resume == 0, "recording after a power cut");
+    game_record_clear(&record);
+}
+
+static void place_pieces(Game_t *game, Bitboard_t occupancy)
+{
+    for (int sq = 0; sq < SQUARE_NB; sq++) {
+        if (occupancy & BB_SQUARE(sq)) {
+            Hall_event_t event = {.type = HALL_EVENT_PLACE, .square = (uint8_t)sq};
+            game_handle_event(game, &event);
+        }
+    }
+}
+
+// A resumed game waits for its position on the board, the starting position starts a new game instead
+static void check_resume(void)
+{
+    static Game_t game;
+    Game_record_t record;
+    Chess_position_t start, pos;
+    position_set_start(&start);
+    pos = start;
+    game_record_init(&record, &start);
+    static const int moves[][2] = {{SQUARE(1, 4), SQUARE(3, 4)}, {SQUARE(6, 4), SQUARE(4, 4)}};
+    for (int i = 0; i < 2; i++) {
+        Chess_move_t move = find_legal_move(&pos, moves[i][0], moves[i][1], PIECE_QUEEN);
+        make_move(&pos, move);
+        game_record_append(&record, move, pos.key);
+    }
+
+    game_init(&game, false);
+    game_resume(&game, &record);
+    check(game.state == GAME_STATE_RESUME && game.pos.key == pos.key && game.record.count == 2, "game resumed");
+    place_pieces(&game, position_occupied(&pos) & ~BB_SQUARE(SQUARE(0, 0)));
+    check(!game_verify_setup(&game), "resumed game waits for its position");
+    place_pieces(&game, BB_SQUARE(SQUARE(0, 0)));
+    check(game_verify_setup(&game) && game.record.count == 2, "resumed game playing");
+    game_free(&game);
+
+    game_record_init(&record, &start);
+    game_record_append(&record, find_legal_move(&start, SQUARE(1, 4), SQUARE(3, 4), PIECE_QUEEN), pos.key);
+    game_init(&game, false);
+    game_resume(&game, &record);
+    place_pieces(&game, position_occupied(&start));
+    check(game_verify_setup(&game) && game.record.count == 0 && game.pos.key == start.key, "new game set up instead");
+    game_free(&game);
+}
+
+// Snapshots are packed positions, a piece code out of range must not reach the board
+static void check_snapshot_codes(void)
+{
+    Chess_position_t pos;
+    uint8_t packed[POSITION_PACK_SIZE];
+    position_set_start(&pos);
+    position_pack(&pos, packed);
+    check(position_unpack(&pos, packed) && pos.key == position_compute_key(&pos), "snapshot round trip");
+    for (int code = PIECE_TYPE_NB; code < 16; code++) {
+        if ((code & 7) < PIECE_TYPE_NB) {
+            continue;
+        }
+        packed[8] = (uint8_t)((packed[8] & 0xF0) | code);
+        check(!position_unpack(&pos, packed), "bad piece code rejected");
+    }
+}
+
+int main(void)
+{
+    close(mkstemp(path));
+    check_round_trip();
+    check_sessions();
+    check_power_cuts();
+    check_resume();
+    check_snapshot_codes();
+    unlink(path);
+
+    if (failures) {
+        printf("%d checks failed\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("journal ok\n");
+    return EXIT_SUCCESS;
+}
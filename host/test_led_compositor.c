@@ -0,0 +1,88 @@
+// Checks layer ordering, gamma correction and dirty frame diffing of the LED compositor
+#include <stdio.h>
+#include <stdlib.h>
+#include "led_compositor.h"
+#include "mock_led_strip.h"
+
+static int failures;
+
+#define CHECK(cond)                                                       \
+    do {                                                                  \
+        if (!(cond)) {                                                    \
+            printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond);        \
+            failures++;                                                   \
+        }                                                                 \
+    } while (0)
+
+static const uint8_t *pixel(const Mock_led_strip_t *strip, int sq)
+{
+    return strip->pixels[led_strip_index(sq)];
+}
+
+int main(void)
+{
+    static Led_compositor_t comp;
+    Mock_led_strip_t state;
+    led_strip_handle_t strip = mock_led_strip_new(&state);
+
+    // Zigzag wiring: rank 1 left to right, rank 2 right to left
+    CHECK(led_strip_index(SQUARE(0, 0)) == 0);
+    CHECK(led_strip_index(SQUARE(0, 7)) == 7);
+    CHECK(led_strip_index(SQUARE(1, 0)) == 15);
+    CHECK(led_strip_index(SQUARE(1, 7)) == 8);
+    CHECK(led_strip_index(SQUARE(7, 0)) == 63);
+
+    // Full brightness keeps the ends of the gamma curve and darkens the middle
+    led_compositor_init(&comp, 255);
+    CHECK(comp.levels[0] == 0 && comp.levels[255] == 255);
+    CHECK(comp.levels[0x80] < 0x80);
+    for (int i = 1; i < 256; i++) {
+        CHECK(comp.levels[i] >= comp.levels[i - 1]);
+    }
+    led_compositor_set_brightness(&comp, 64);
+    CHECK(comp.levels[255] == 64);
+    led_compositor_set_brightness(&comp, 255);
+
+    // The first frame writes every pixel, even if black
+    CHECK(led_compositor_show(&comp, strip));
+    CHECK(state.refresh_calls == 1 && state.set_pixel_calls == SQUARE_NB);
+
+    // Higher layers win, black on a higher layer still hides what is below
+    int e2 = SQUARE(1, 4), e4 = SQUARE(3, 4), d5 = SQUARE(4, 3);
+    led_compositor_fill(&comp, LED_LAYER_PIECES, BB_SQUARE(e2) | BB_SQUARE(d5), 0xFFFFFF);
+    led_compositor_fill(&comp, LED_LAYER_SELECTION, BB_SQUARE(e2), 0xFFFF00);
+    led_compositor_fill(&comp, LED_LAYER_TARGETS, BB_SQUARE(e4), 0x00FF00);
+    led_compositor_fill(&comp, LED_LAYER_ANIMATION, BB_SQUARE(d5), 0x000000);
+    state.set_pixel_calls = 0;
+    CHECK(led_compositor_show(&comp, strip));
+    CHECK(state.refresh_calls == 2 && state.set_pixel_calls == 2);
+    CHECK(pixel(&state, e2)[0] == 255 && pixel(&state, e2)[1] == 255 && pixel(&state, e2)[2] == 0);
+    CHECK(pixel(&state, e4)[0] == 0 && pixel(&state, e4)[1] == 255 && pixel(&state, e4)[2] == 0);
+    CHECK(pixel(&state, d5)[0] == 0 && pixel(&state, d5)[1] == 0 && pixel(&state, d5)[2] == 0);
+
+    // An unchanged frame is not sent, even if layers were rebuilt
+    led_compositor_clear_layer(&comp, LED_LAYER_TARGETS);
+    led_compositor_fill(&comp, LED_LAYER_TARGETS, BB_SQUARE(e4), 0x00FF00);
+    CHECK(!led_compositor_compose(&comp));
+    CHECK(!led_compositor_show(&comp, strip));
+    CHECK(state.refresh_calls == 2);
+
+    // Removing a layer uncovers the one below, only that pixel is written
+    led_compositor_clear_layer(&comp, LED_LAYER_ANIMATION);
+    state.set_pixel_calls = 0;
+    CHECK(led_compositor_show(&comp, strip));
+    CHECK(state.refresh_calls == 3 && state.set_pixel_calls == 1);
+    CHECK(pixel(&state, d5)[0] == 255 && pixel(&state, d5)[1] == 255 && pixel(&state, d5)[2] == 255);
+
+    // Gray goes through the gamma table
+    led_compositor_fill(&comp, LED_LAYER_PIECES, BB_SQUARE(d5), 0x808080);
+    CHECK(led_compositor_show(&comp, strip));
+    CHECK(pixel(&state, d5)[0] == comp.levels[0x80]);
+
+    if (failures) {
+        printf("%d checks failed\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("led compositor ok\n");
+    return EXIT_SUCCESS;
+}
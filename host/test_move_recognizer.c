@@ -0,0 +1,143 @@
+// Checks move recognition from occupancy changes, directly and through hall events fed to the game
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "game.h"
+#include "move_recognizer.h"
+#include "test_check.h"
+
+// Every legal move is found from the board it leaves, once its captured piece was lifted
+static void check_position(const char *fen)
+{
+    Chess_position_t pos;
+    Move_list_t list;
+    static Move_recognizer_t rec;
+    position_from_fen(&pos, fen);
+    move_recognizer_build(&rec, &pos);
+    generate_legal_moves(&pos, &list);
+
+    for (int i = 0; i < list.count; i++) {
+        Chess_move_t move = list.moves[i];
+        Chess_position_t child = pos;
+        make_move(&child, move);
+        Bitboard_t after = position_occupied(&child);
+        Bitboard_t vacated, filled;
+        move_occupancy_delta(move, &vacated, &filled);
+
+        char uci[6];
+        move_to_uci(move, uci);
+        if (after != ((position_occupied(&pos) & ~vacated) | filled)) {
+            printf("FAIL %s: delta of %s\n", fen, uci);
+            failures++;
+        }
+        const Chess_move_t *moves;
+        bool listed = false;
+        int count = move_recognizer_candidates(&rec, after, &moves);
+        for (int j = 0; j < count; j++) {
+            listed |= moves[j] == move;
+        }
+        // The promoted piece cannot be seen, it is a queen
+        Chess_move_t expected = MOVE_IS_PROMOTION(move)
+                                ? MOVE_MAKE(MOVE_FROM(move), MOVE_TO(move), (MOVE_FLAGS(move) & ~0x3) | (PIECE_QUEEN - PIECE_KNIGHT))
+                                : move;
+        Bitboard_t touched = vacated | BB_SQUARE(MOVE_TO(move));
+        if (!listed || move_recognizer_match(&rec, after, touched) != expected) {
+            printf("FAIL %s: %s not recognized\n", fen, uci);
+            failures++;
+        }
+        // Without the captured piece lifted a capture is not told apart from the other captures of its piece
+        if (MOVE_FLAGS(move) == MOVE_FLAG_CAPTURE && move_recognizer_match(&rec, after, vacated) != MOVE_NONE) {
+            printf("FAIL %s: %s recognized without its target\n", fen, uci);
+            failures++;
+        }
+    }
+    check(move_recognizer_match(&rec, position_occupied(&pos), 0) == MOVE_NONE, "unchanged board is no move");
+}
+
+// Events like "-e2 +e4", lifts and places
+static void feed(Game_t *game, const char *events)
+{
+    char token[4];
+    int length;
+    while (sscanf(events, "%3s%n", token, &length) == 1) {
+        events += length;
+        Hall_event_t event = {
+            .type = token[0] == '+' ? HALL_EVENT_PLACE : HALL_EVENT_LIFT,
+            .square = (uint8_t)SQUARE(token[2] - '1', token[1] - 'a'),
+        };
+        game_handle_event(game, &event);
+    }
+}
+
+static void check_last_move(const Game_t *game, int moves, const char *uci)
+{
+    char buf[6];
+    bool ok = game->record.count == (uint32_t)moves &&
+              strcmp(move_to_uci(game_record_get(&game->record, moves - 1), buf), uci) == 0;
+    if (!ok) {
+        printf("FAIL expected move %d to be %s\n", moves, uci);
+        failures++;
+    }
+}
+
+static void check_game(void)
+{
+    static Game_t game;
+    game_init(&game, false);
+    for (int sq = 0; sq < SQUARE_NB; sq++) {
+        if (position_occupied(&game.pos) & BB_SQUARE(sq)) {
+            Hall_event_t event = {.type = HALL_EVENT_PLACE, .square = (uint8_t)sq};
+            game_handle_event(&game, &event);
+        }
+    }
+
+    feed(&game, "-e2 +e4 -d7 +d5");
+    check_last_move(&game, 2, "d7d5");
+    // Capture, victim lifted first
+    feed(&game, "-d5 -e4 +d5");
+    check_last_move(&game, 3, "e4d5");
+    // A piece put back is no move
+    feed(&game, "-g8 +g8");
+    check(game.record.count == 3, "piece put back");
+    feed(&game, "-e7 +e5");
+    check_last_move(&game, 4, "e7e5");
+    // En passant, the taken pawn lifted last
+    feed(&game, "-d5 +e6 -e5");
+    check_last_move(&game, 5, "d5e6");
+    // Capture, own piece lifted first
+    feed(&game, "-f7 -e6 +e6");
+    check_last_move(&game, 6, "f7e6");
+    feed(&game, "-g1 +f3 -g8 +f6 -f1 +e2 -f8 +e7");
+    check_last_move(&game, 10, "f8e7");
+    // Castling, king first
+    feed(&game, "-e1 +g1 -h1 +f1");
+    check_last_move(&game, 11, "e1g1");
+    check(MOVE_IS_CASTLE(game_record_get(&game.record, 10)), "castling flag");
+    feed(&game, "-e8 +g8 -h8 +f8");
+    check_last_move(&game, 12, "e8g8");
+    game_free(&game);
+}
+
+int main(void)
+{
+    static const char *fens[] = {
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R b KQkq - 0 1",
+        "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 b kq - 0 1",
+        "rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3",
+        "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+        "n1n5/PPPk4/8/8/8/8/4Kppp/5N1N b - - 0 1",
+    };
+    for (size_t i = 0; i < sizeof(fens) / sizeof(fens[0]); i++) {
+        check_position(fens[i]);
+    }
+    check_game();
+
+    if (failures) {
+        printf("%d checks failed\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("move recognizer ok\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,113 @@
+// Checks the incrementally updated accumulator against a full refresh, and the network's symmetry
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "moves.h"
+#include "nnue.h"
+#include "test_check.h"
+
+// The same position with the colors swapped and the board flipped
+static void mirror(const Chess_position_t *pos, Chess_position_t *mirrored)
+{
+    memset(mirrored, 0, sizeof(*mirrored));
+    for (int sq = 0; sq < SQUARE_NB; sq++) {
+        Piece_type_t type = position_piece_at(pos, sq);
+        if (type != PIECE_NONE) {
+            position_put_piece(mirrored, sq ^ 56, !position_side_at(pos, sq), type);
+        }
+    }
+    mirrored->side_to_move = !pos->side_to_move;
+    mirrored->ep_square = SQUARE_NONE;
+}
+
+// Every update along the tree must give the accumulator a refresh gives, with the same score from both kernels
+static void check_tree(const Chess_position_t *pos, const Nnue_accumulator_t *acc, int depth)
+{
+    Nnue_accumulator_t refreshed;
+    nnue_refresh(&refreshed, pos);
+    char fen[POSITION_FEN_MAX];
+    if (memcmp(&refreshed, acc, sizeof(refreshed)) != 0) {
+        printf("FAIL accumulator of %s\n", position_to_fen(pos, fen));
+        failures++;
+        return;
+    }
+
+    int score = nnue_evaluate(acc, pos->side_to_move);
+    nnue_set_kernels(NNUE_KERNELS_SCALAR);
+    int scalar_score = nnue_evaluate(acc, pos->side_to_move);
+    nnue_set_kernels(NNUE_KERNELS_VECTOR);
+    Chess_position_t mirrored;
+    Nnue_accumulator_t mirrored_acc;
+    mirror(pos, &mirrored);
+    nnue_refresh(&mirrored_acc, &mirrored);
+    if (score != scalar_score || score != nnue_evaluate(&mirrored_acc, mirrored.side_to_move)) {
+        printf("FAIL score of %s: %d, scalar %d, mirrored %d\n", position_to_fen(pos, fen), score, scalar_score,
+               nnue_evaluate(&mirrored_acc, mirrored.side_to_move));
+        failures++;
+        return;
+    }
+    if (depth == 0) {
+        return;
+    }
+
+    Move_list_t list;
+    generate_legal_moves(pos, &list);
+    for (int i = 0; i < list.count && !failures; i++) {
+        Chess_position_t child = *pos;
+        Nnue_accumulator_t child_acc;
+        make_move(&child, list.moves[i]);
+        nnue_update(&child_acc, acc, pos, list.moves[i]);
+        check_tree(&child, &child_acc, depth - 1);
+    }
+}
+
+static int score_of(const char *fen)
+{
+    Chess_position_t pos;
+    Nnue_accumulator_t acc;
+    position_from_fen(&pos, fen);
+    nnue_refresh(&acc, &pos);
+    return nnue_evaluate(&acc, pos.side_to_move);
+}
+
+int main(void)
+{
+    static const char *fens[] = {
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+        "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+        "rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3",
+    };
+    for (size_t i = 0; i < sizeof(fens) / sizeof(fens[0]); i++) {
+        Chess_position_t pos;
+        Nnue_accumulator_t acc;
+        position_from_fen(&pos, fens[i]);
+        nnue_refresh(&acc, &pos);
+        check_tree(&pos, &acc, 3);
+    }
+
+    // An update in place, as a search reusing its accumulator would do
+    Chess_position_t pos;
+    Nnue_accumulator_t acc, refreshed;
+    position_from_fen(&pos, fens[1]);
+    nnue_refresh(&acc, &pos);
+    Chess_move_t castle = find_legal_move(&pos, SQUARE(0, 4), SQUARE(0, 6), PIECE_NONE);
+    nnue_update(&acc, &acc, &pos, castle);
+    make_move(&pos, castle);
+    nnue_refresh(&refreshed, &pos);
+    check(memcmp(&acc, &refreshed, sizeof(acc)) == 0, "update in place");
+
+    check(score_of(fens[0]) == 0, "start position is even");
+    check(score_of("rnb1kbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1") > 700, "queen up");
+    check(score_of("rnb1kbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR b KQkq - 0 1") < -700, "queen down");
+    check(score_of("4k3/8/8/8/3P4/8/8/4K3 w - - 0 1") > score_of("4k3/8/8/8/8/8/3P4/4K3 w - - 0 1"),
+          "advanced pawn is worth more");
+
+    if (failures) {
+        printf("%d checks failed\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("nnue ok\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,280 @@
+// Checks SAN formatting and parsing, FEN output, the chunked game record and the PGN writer and reader
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "game_record.h"
+#include "pgn.h"
+#include "test_check.h"
+
+static void check_san(const char *fen, const char *uci, const char *expected)
+{
+    Chess_position_t pos;
+    Move_list_t list;
+    char buf[6], san[MOVE_SAN_MAX];
+    position_from_fen(&pos, fen);
+    generate_legal_moves(&pos, &list);
+    for (int i = 0; i < list.count; i++) {
+        if (strcmp(move_to_uci(list.moves[i], buf), uci) == 0) {
+            move_to_san(&pos, list.moves[i], san);
+            if (strcmp(san, expected) != 0) {
+                printf("FAIL san %s in %s: got %s, expected %s\n", uci, fen, san, expected);
+                failures++;
+            }
+            if (move_from_san(&pos, expected, (int)strlen(expected)) != list.moves[i]) {
+                printf("FAIL san %s in %s is not read back\n", expected, fen);
+                failures++;
+            }
+            return;
+        }
+    }
+    printf("FAIL san %s is not legal in %s\n", uci, fen);
+    failures++;
+}
+
+// Every legal move's SAN names that move only
+static void check_san_round_trip(const char *fen)
+{
+    Chess_position_t pos;
+    Move_list_t list;
+    char san[MOVE_SAN_MAX];
+    position_from_fen(&pos, fen);
+    generate_legal_moves(&pos, &list);
+    for (int i = 0; i < list.count; i++) {
+        move_to_san(&pos, list.moves[i], san);
+        if (move_from_san(&pos, san, (int)strlen(san)) != list.moves[i]) {
+            printf("FAIL san %s in %s is not read back\n", san, fen);
+            failures++;
+        }
+    }
+}
+
+static void check_san_rejected(const char *fen, const char *san)
+{
+    Chess_position_t pos;
+    position_from_fen(&pos, fen);
+    if (move_from_san(&pos, san, (int)strlen(san)) != MOVE_NONE) {
+        printf("FAIL san %s is accepted in %s\n", san, fen);
+        failures++;
+    }
+}
+
+static void check_read(const char *text, Pgn_status_t status, size_t offset, int plies)
+{
+    Pgn_game_t game;
+    pgn_read_game(text, strlen(text), &game);
+    if (game.status != status || (status != PGN_OK && game.error_offset != offset) || game.plies != plies) {
+        printf("FAIL read %s: %s at %zu after %d plies, expected %s at %zu after %d\n", text,
+               pgn_status_name(game.status), game.error_offset, game.plies, pgn_status_name(status), offset, plies);
+        failures++;
+    }
+}
+
+// What the writer writes reads back to the same game
+static void check_write_read(const Game_record_t *record, const Chess_position_t *final)
+{
+    char *text;
+    size_t size;
+    FILE *out = open_memstream(&text, &size);
+    pgn_write(out, record, NULL);
+    fclose(out);
+    Pgn_game_t game;
+    pgn_read_game(text, size, &game);
+    if (game.status != PGN_OK || game.plies != (int)record->count || game.pos.key != final->key) {
+        printf("FAIL read back: %s after %d of %u plies\n", pgn_status_name(game.status), game.plies,
+               (unsigned int)record->count);
+        failures++;
+    }
+    free(text);
+}
+
+static void check_fen(const char *fen)
+{
+    Chess_position_t pos;
+    char buf[POSITION_FEN_MAX];
+    position_from_fen(&pos, fen);
+    if (strcmp(position_to_fen(&pos, buf), fen) != 0) {
+        printf("FAIL fen %s: got %s\n", fen, buf);
+        failures++;
+    }
+}
+
+// Play UCI moves into a record
+static void play(Game_record_t *record, Chess_position_t *pos, const char *moves)
+{
+    char uci[6];
+    int length;
+    while (sscanf(moves, "%5s%n", uci, &length) == 1) {
+        moves += length;
+        int from = SQUARE(uci[1] - '1', uci[0] - 'a');
+        int to = SQUARE(uci[3] - '1', uci[2] - 'a');
+        Chess_move_t move = find_legal_move(pos, from, to, PIECE_QUEEN);
+        if (move == MOVE_NONE) {
+            printf("FAIL %s is not legal\n", uci);
+            failures++;
+            return;
+        }
+        make_move(pos, move);
+        game_record_append(record, move, pos->key);
+    }
+}
+
+static void check_pgn(const Game_record_t *record, const char *expected)
+{
+    char *text;
+    size_t size;
+    FILE *out = open_memstream(&text, &size);
+    pgn_write(out, record, NULL);
+    fclose(out);
+    if (strcmp(text, expected) != 0) {
+        printf("FAIL pgn, got:\n%s\nexpected:\n%s\n", text, expected);
+        failures++;
+    }
+    free(text);
+}
+
+int main(void)
+{
+    check_san("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", "g1f3", "Nf3");
+    check_san("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", "e2e4", "e4");
+    check_san("r3k2r/8/8/8/8/8/8/R3K2R w KQkq - 0 1", "e1g1", "O-O");
+    check_san("r3k2r/8/8/8/8/8/8/R3K2R b KQkq - 0 1", "e8c8", "O-O-O");
+    check_san("4k3/8/8/8/8/8/8/RN2K1NR w - - 0 1", "g1e2", "Ne2");
+    check_san("4k3/8/8/8/8/8/8/1N2KN2 w - - 0 1", "b1d2", "Nbd2");
+    check_san("4k3/8/8/8/8/1N6/8/1N2K3 w - - 0 1", "b1d2", "N1d2");
+    check_san("3k4/8/8/8/8/8/8/R3K3 w Q - 0 1", "e1c1", "O-O-O+");
+    check_san("4k3/8/8/Q1Q5/8/Q7/8/4K3 w - - 0 1", "a5b4", "Qa5b4");
+    check_san("4k3/8/8/3pP3/8/8/8/4K3 w - d6 0 1", "e5d6", "exd6");
+    check_san("8/4P3/8/8/8/8/8/k3K3 w - - 0 1", "e7e8q", "e8=Q");
+    check_san("3r4/4P3/8/8/8/8/8/k3K3 w - - 0 1", "e7d8n", "exd8=N");
+    check_san("6k1/5ppp/8/8/8/8/8/R3K3 w - - 0 1", "a1a8", "Ra8#");
+    check_san_round_trip("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1");
+    check_san_round_trip("r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1");
+    check_san_round_trip("r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 b kq - 0 1");
+    check_san_round_trip("4k3/8/8/Q1Q5/8/Q7/8/4K3 w - - 0 1");
+    check_san_rejected("4k3/8/8/8/8/8/8/1N2KN2 w - - 0 1", "Nd2");        // Ambiguous
+    check_san_rejected("3r4/4P3/8/8/8/8/8/k3K3 w - - 0 1", "Rd8");        // No rook
+    check_san_rejected("3r4/4P3/8/8/8/8/8/k3K3 w - - 0 1", "e8");         // Promotion missing
+    check_san_rejected("3r4/4P3/8/8/8/8/8/k3K3 w - - 0 1", "ed8=Q");      // Capture not marked
+    check_san_rejected("6k1/5ppp/8/8/8/8/8/R3K3 w - - 0 1", "Rxa8");      // Not a capture
+    check_san_rejected("r3k2r/8/8/8/8/8/8/R3K2R w KQkq - 0 1", "Kg1");    // Castling is O-O
+    check_san_rejected("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", "e5");
+    Chess_position_t promotion;
+    position_from_fen(&promotion, "3r4/4P3/8/8/8/8/8/k3K3 w - - 0 1");
+    check(move_from_san(&promotion, "exd8Q+!", 7) == find_legal_move(&promotion, SQUARE(6, 4), SQUARE(7, 3), PIECE_QUEEN),
+          "promotion without =, with suffixes");
+
+    // Import format: comments, variations, NAGs, escapes and move numbers glued to moves
+    check_read("[Event \"a \\\"quoted\\\" name\"]\n[Result \"*\"]\n\n"
+               "1.e4 {best (by test)} e5 $1 2. Nf3 (2. f4 exf4 (2... d5)) 2... Nc6 ; rest of line\n"
+               "%escaped line\n3. Bb5!? a6 4. 0-0 *\n",
+               PGN_OK, 0, 7);
+    check_read("[Event \"?\"]\n\n1. e4 e5 2. Ke3 *\n", PGN_ILLEGAL_MOVE, 25, 2);
+    check_read("[Event \"?\"]\n\n1. e4 e5 3. Nf3 *\n", PGN_BAD_MOVE_NUMBER, 22, 2);
+    check_read("[Event \"?\"]\n\n1. e4 e5\n", PGN_NO_RESULT, 22, 2);
+    check_read("[Event \"?\"]\n\n1. e4 e5 * 2. Nf3\n", PGN_TEXT_AFTER_RESULT, 24, 2);
+    check_read("[Result \"1-0\"]\n\n1. e4 0-1\n", PGN_RESULT_MISMATCH, 22, 1);
+    check_read("[Event \"?\"]\n\n1. f3 e5 2. g4 Qh4# 1/2-1/2\n", PGN_WRONG_RESULT, 33, 4);
+    check_read("[Event \"?\"]\n\n1. e4 {open comment *\n", PGN_BAD_TOKEN, 19, 1);
+    check_read("[Event ?]\n\n1. e4 *\n", PGN_BAD_TAG, 0, 0);
+    check_read("[FEN \"8/8/8 w - - 0 1\"]\n\n*\n", PGN_BAD_FEN, 0, 0);
+    check_read("[FEN \"4k3/8/8/8/8/8/8/4K3 w K - 0 1\"]\n\n1. O-O Kd7 *\n", PGN_BAD_FEN, 0, 0);
+    check_read("[FEN \"1r2k3/8/8/8/8/8/8/4K3 w q - 0 1\"]\n\n*\n", PGN_BAD_FEN, 0, 0);
+    check_read("[FEN \"4k3/8/8/8/8/8/8/4K3 w - e6 0 1\"]\n\n*\n", PGN_BAD_FEN, 0, 0);
+    check_read("[FEN \"4k3/8/8/4p3/8/8/8/4K3 w - e3 0 1\"]\n\n*\n", PGN_BAD_FEN, 0, 0);
+    check_read("[FEN \"4k3/8/8/4p3/8/8/8/4K3 b - e6 0 1\"]\n\n*\n", PGN_BAD_FEN, 0, 0);
+    check_read("[FEN \"4k3/8/8/8/8/8/8/4R1K1 w - - 0 1\"]\n\n*\n", PGN_BAD_FEN, 0, 0);
+    check_read("[FEN \"4k3/18/8/8/8/8/8/4K3 w - - 0 1\"]\n\n*\n", PGN_BAD_FEN, 0, 0);
+    check_read("[FEN \"4k3/4/8/8/8/8/8/4K3 w - - 0 1\"]\n\n*\n", PGN_BAD_FEN, 0, 0);
+    check_read("[FEN \"4k3/8/8/8/8/8/8/4K3/8 w - - 0 1\"]\n\n*\n", PGN_BAD_FEN, 0, 0);
+    check_read("[FEN \"4k3/8/8/3Pp3/8/8/8/4K3 w - e6 0 1\"]\n\n1. dxe6 *\n", PGN_OK, 0, 1);
+    check_read("[FEN \"4k3/3p4/8/4P3/8/8/8/4K3 b - - 0 1\"]\n\n1... d5 2. exd6 Kf7 3. d7 Ke7 4. d8=Q+ Kxd8 1/2-1/2\n",
+               PGN_OK, 0, 7);
+
+    // Games start at a tag line after an empty line, not at the tags that follow it
+    const char *two_games = "[Event \"1\"]\n[Site \"?\"]\n\n1. e4 *\n\n[Event \"2\"]\r\n\r\n1. d4 *\r\n\r\n[Event \"3\"]\n";
+    size_t length = strlen(two_games);
+    check(pgn_next_game(two_games, length, 0) == 0, "first game at the start");
+    check(pgn_next_game(two_games, length, 1) == 33, "second game");
+    check(pgn_next_game(two_games, length, 34) == 59, "third game after CRLF lines");
+    check(pgn_next_game(two_games, length, 60) == length, "no more games");
+
+    check_fen("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+    check_fen("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1");
+    check_fen("rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3");
+    check_fen("8/8/8/8/8/8/8/k3K3 b - - 12 80");
+
+    // Fool's mate, the result comes from the final position
+    Chess_position_t pos;
+    Game_record_t record;
+    position_set_start(&pos);
+    game_record_init(&record, &pos);
+    play(&record, &pos, "f2f3 e7e5 g2g4 d8h4");
+    check_pgn(&record,
+              "[Event \"Casual game\"]\n[Site \"Chessy\"]\n[Date \"????.??.??\"]\n[Round \"-\"]\n"
+              "[White \"?\"]\n[Black \"?\"]\n[Result \"0-1\"]\n\n"
+              "1. f3 e5 2. g4 Qh4# 0-1\n\n");
+    check_write_read(&record, &pos);
+    game_record_clear(&record);
+
+    // Black to move from a set up position
+    position_from_fen(&pos, "4k3/8/8/8/8/8/8/4K2R b K - 0 40");
+    game_record_init(&record, &pos);
+    play(&record, &pos, "e8d7 e1g1");
+    check_pgn(&record,
+              "[Event \"Casual game\"]\n[Site \"Chessy\"]\n[Date \"????.??.??\"]\n[Round \"-\"]\n"
+              "[White \"?\"]\n[Black \"?\"]\n[Result \"*\"]\n"
+              "[SetUp \"1\"]\n[FEN \"4k3/8/8/8/8/8/8/4K2R b K - 0 40\"]\n\n"
+              "40... Kd7 41. O-O *\n\n");
+    check_write_read(&record, &pos);
+    game_record_clear(&record);
+
+    // Knights shuffling for many chunks, every move must come back in order
+    position_set_start(&pos);
+    game_record_init(&record, &pos);
+    const char *shuffle[] = {"g1f3", "g8f6", "f3g1", "f6g8"};
+    uint32_t plies = GAME_RECORD_CHUNK_MOVES * 5 + 3;
+    for (uint32_t i = 0; i < plies; i++) {
+        play(&record, &pos, shuffle[i % 4]);
+    }
+    Game_record_iter_t iter;
+    Chess_move_t move;
+    uint32_t walked = 0;
+    game_record_iter_init(&record, &iter);
+    while (game_record_next(&record, &iter, &move)) {
+        char uci[6];
+        if (strcmp(move_to_uci(move, uci), shuffle[walked % 4]) != 0 || game_record_get(&record, walked) != move) {
+            printf("FAIL record move %u\n", (unsigned int)walked);
+            failures++;
+            break;
+        }
+        walked++;
+    }
+    if (walked != plies || record.count != plies) {
+        printf("FAIL record walked %u of %u moves\n", (unsigned int)walked, (unsigned int)plies);
+        failures++;
+    }
+
+    // A long game still streams out, with no line over 79 characters
+    char *text;
+    size_t size;
+    FILE *out = open_memstream(&text, &size);
+    pgn_write(out, &record, NULL);
+    fclose(out);
+    for (char *line = strtok(text, "\n"); line; line = strtok(NULL, "\n")) {
+        if (strlen(line) > 79) {
+            printf("FAIL pgn line of %zu characters\n", strlen(line));
+            failures++;
+            break;
+        }
+    }
+    free(text);
+    check_write_read(&record, &pos);
+    game_record_clear(&record);
+
+    if (failures) {
+        printf("%d checks failed\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("pgn ok\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,202 @@
+// Checks the puzzle pack format, the mate solver against a plain minimax and the judging of moves
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "puzzle.h"
+#include "test_check.h"
+
+#define TABLE_ENTRIES 1024
+
+static Mate_entry_t table[TABLE_ENTRIES];
+static Mate_solver_t solver;
+
+static Chess_move_t find_move(const Chess_position_t *pos, const char *uci)
+{
+    Move_list_t list;
+    char text[6];
+    generate_legal_moves(pos, &list);
+    for (int i = 0; i < list.count; i++) {
+        if (strcmp(move_to_uci(list.moves[i], text), uci) == 0) {
+            return list.moves[i];
+        }
+    }
+    return MOVE_NONE;
+}
+
+// Every move and every reply, without tables or ordering
+static bool forces_mate(const Chess_position_t *pos, int moves)
+{
+    Move_list_t list;
+    generate_legal_moves(pos, &list);
+    for (int i = 0; i < list.count; i++) {
+        Chess_position_t child = *pos;
+        make_move(&child, list.moves[i]);
+        Move_list_t replies;
+        bool mated = true;
+        if (generate_legal_moves(&child, &replies) == 0) {
+            mated = is_in_check(&child);
+        } else if (moves == 1) {
+            mated = false;
+        }
+        for (int j = 0; mated && moves > 1 && j < replies.count; j++) {
+            Chess_position_t grandchild = child;
+            make_move(&grandchild, replies.moves[j]);
+            mated = forces_mate(&grandchild, moves - 1);
+        }
+        if (mated) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static const char *pack_fens[] = {
+    "r3k2r/pppq1ppp/2n2n2/3pp3/1b1PP3/2N2N2/PPPQ1PPP/R3K2R w KQkq d6 0 1",
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "8/8/8/8/4K3/4R3/8/5k2 b - - 0 1",
+};
+
+static void test_pack(void)
+{
+    static uint8_t image[PUZZLE_HEADER_SIZE + 3 * PUZZLE_RECORD_SIZE + 64];
+    const int count = sizeof(pack_fens) / sizeof(pack_fens[0]);
+    Puzzle_t puzzles[3];
+    memset(image, 0xFF, sizeof(image));   // Erased flash after the records
+    for (int i = 0; i < count; i++) {
+        check(position_from_fen(&puzzles[i].pos, pack_fens[i]), pack_fens[i]);
+        puzzles[i].mate_in = (uint8_t)(i + 1);
+        puzzles[i].solution = MOVE_MAKE(SQUARE(1, 4), SQUARE(3, 4), MOVE_FLAG_DOUBLE_PUSH);
+        puzzle_encode(image + PUZZLE_HEADER_SIZE + i * PUZZLE_RECORD_SIZE, &puzzles[i]);
+    }
+    puzzle_pack_header(image, image + PUZZLE_HEADER_SIZE, count);
+
+    Puzzle_pack_t pack;
+    check(puzzle_pack_open_memory(&pack, image, sizeof(image)) && pack.count == (size_t)count, "pack opens");
+    for (int i = 0; i < count; i++) {
+        Puzzle_t decoded;
+        char fen[POSITION_FEN_MAX];
+        check(puzzle_pack_read(&pack, i, &decoded), "record reads");
+        check(decoded.pos.key == puzzles[i].pos.key && decoded.mate_in == puzzles[i].mate_in &&
+              decoded.solution == puzzles[i].solution, "record round trip");
+        check(strcmp(position_to_fen(&decoded.pos, fen), pack_fens[i]) == 0, pack_fens[i]);
+    }
+
+    check(!puzzle_pack_open_memory(&pack, image, PUZZLE_HEADER_SIZE + PUZZLE_RECORD_SIZE) && pack.count == 0,
+          "truncated pack is rejected");
+    image[PUZZLE_HEADER_SIZE + 5] ^= 1;
+    check(!puzzle_pack_open_memory(&pack, image, sizeof(image)), "CRC mismatch is rejected");
+    image[PUZZLE_HEADER_SIZE + 5] ^= 1;
+    image[0] = 'X';
+    check(!puzzle_pack_open_memory(&pack, image, sizeof(image)), "bad magic is rejected");
+
+    // Black in check with white to move cannot come from a game
+    uint8_t record[PUZZLE_RECORD_SIZE];
+    Puzzle_t illegal = {.mate_in = 1};
+    position_from_fen(&illegal.pos, "7k/8/8/8/8/8/8/4K2R w - - 0 1");
+    puzzle_encode(record, &illegal);
+    Puzzle_pack_t single = {record, 1};
+    Puzzle_t decoded;
+    check(!puzzle_pack_read(&single, 0, &decoded), "side not to move in check is rejected");
+}
+
+typedef struct {
+    const char *fen;
+    int moves;   // Shortest mate, 0 for none within max
+    int max;
+} Mate_case_t;
+
+static const Mate_case_t mates[] = {
+    {"6k1/5ppp/8/8/8/8/5PPP/3R2K1 w - - 0 1", 1, 2},
+    {"3k4/8/8/8/8/8/8/R3K2R w KQ - 0 1", 2, 2},
+    {"kbK5/pp6/1P6/8/8/8/8/R7 w - - 0 1", 2, 2},
+    {"r2qkbnr/ppp2ppp/2np4/4N3/2B1P3/2N5/PPPP1PPP/R1BbK2R w KQkq - 0 6", 2, 2},
+    {"7k/8/5K2/8/8/8/8/6R1 w - - 0 1", 2, 3},
+    {"8/8/8/8/8/5K2/6R1/7k w - - 0 1", 3, 3},
+    {"k7/8/8/1K6/8/8/8/2Q5 w - - 0 1", 3, 3},
+    {"k7/2Q5/1K6/8/8/8/8/8 b - - 0 1", 0, 2},    // Stalemate
+    {"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 0, 2},
+    {"4k3/8/8/8/8/8/8/4K2R w K - 0 1", 0, 2},
+};
+
+static void test_mates(void)
+{
+    for (size_t i = 0; i < sizeof(mates) / sizeof(mates[0]); i++) {
+        const Mate_case_t *c = &mates[i];
+        Chess_position_t pos;
+        Mate_result_t result;
+        position_from_fen(&pos, c->fen);
+        mate_solver_clear(&solver);
+        mate_search(&solver, &pos, c->max, &result);
+        bool ok = c->moves ? result.status == MATE_FOUND && result.moves == c->moves :
+                  result.status == MATE_NONE;
+        // The plain minimax agrees on every length up to the limit
+        for (int n = 1; ok && n <= c->max; n++) {
+            ok = forces_mate(&pos, n) == (c->moves && n >= c->moves);
+        }
+        if (ok && c->moves) {
+            Chess_position_t after = pos;
+            make_move(&after, result.move);
+            mate_defend(&solver, &after, c->moves - 1, &result);
+            ok &= result.status == MATE_FOUND;
+        }
+        check(ok, c->fen);
+    }
+}
+
+static void test_session(void)
+{
+    Puzzle_t puzzle;
+    Puzzle_session_t session;
+    Chess_move_t reply;
+    position_from_fen(&puzzle.pos, "3k4/8/8/8/8/8/8/R3K2R w KQ - 0 1");
+    puzzle.mate_in = 2;
+    puzzle.solution = find_move(&puzzle.pos, "a1a7");
+
+    // A wrong move comes back with the defence refuting it, and the puzzle goes on
+    puzzle_session_start(&session, &puzzle, &solver);
+    check(puzzle_session_judge(&session, &puzzle.pos, find_move(&puzzle.pos, "e1g1"), &reply) == PUZZLE_MOVE_WRONG &&
+          reply != MOVE_NONE && session.moves_left == 2, "castling is wrong");
+
+    // The other rook mates as well
+    check(puzzle_session_judge(&session, &puzzle.pos, find_move(&puzzle.pos, "h1h7"), &reply) == PUZZLE_MOVE_CORRECT &&
+          reply != MOVE_NONE && session.moves_left == 1, "alternative solution");
+
+    // The pack's solution, then the reply and a mate
+    puzzle_session_start(&session, &puzzle, &solver);
+    Chess_position_t pos = puzzle.pos;
+    check(puzzle_session_judge(&session, &pos, puzzle.solution, &reply) == PUZZLE_MOVE_CORRECT && reply != MOVE_NONE,
+          "solution is correct");
+    make_move(&pos, puzzle.solution);
+    Chess_move_t unused;
+    check(puzzle_session_judge(&session, &pos, reply, &unused) == PUZZLE_MOVE_REPLY, "defence is a reply");
+    make_move(&pos, reply);
+    Mate_result_t result;
+    mate_search(&solver, &pos, 1, &result);
+    check(result.status == MATE_FOUND &&
+          puzzle_session_judge(&session, &pos, result.move, &reply) == PUZZLE_MOVE_SOLVED && session.moves_left == 0,
+          "mate solves the puzzle");
+
+    // Out of nodes, only the pack's solution is trusted
+    Mate_solver_t starved;
+    mate_solver_init(&starved, table, TABLE_ENTRIES, 1);
+    puzzle_session_start(&session, &puzzle, &starved);
+    check(puzzle_session_judge(&session, &puzzle.pos, find_move(&puzzle.pos, "h1h7"), &reply) == PUZZLE_MOVE_WRONG,
+          "unproven move is wrong");
+    check(puzzle_session_judge(&session, &puzzle.pos, puzzle.solution, &reply) == PUZZLE_MOVE_CORRECT,
+          "unproven solution is correct");
+    mate_solver_clear(&solver);
+}
+
+int main(void)
+{
+    mate_solver_init(&solver, table, TABLE_ENTRIES, 0);
+    test_pack();
+    test_mates();
+    test_session();
+    if (failures) {
+        printf("%d checks failed\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("puzzle ok\n");
+    return EXIT_SUCCESS;
+}
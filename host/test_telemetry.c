@@ -0,0 +1,207 @@
+// Checks the telemetry stream: COBS, deltas rebuilding the board, console text, overflows and damaged frames
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "telemetry.h"
+#include "telemetry_decoder.h"
+#include "sim_board.h"
+#include "host_util.h"
+#include "test_check.h"
+
+#define STEPS 3000
+
+static void check_cobs(void)
+{
+    static uint8_t in[700], encoded[720], decoded[700];
+    uint64_t seed = 3;
+    int bad = 0;
+    for (int round = 0; round < 2000; round++) {
+        size_t size = host_random(&seed) % sizeof(in);
+        int zeros = (int)(host_random(&seed) % 4);   // From none to one byte in two
+        for (size_t i = 0; i < size; i++) {
+            in[i] = zeros && host_random(&seed) % (zeros * 2) == 0 ? 0 : (uint8_t)(host_random(&seed) % 255 + 1);
+        }
+        size_t n = telemetry_cobs_encode(in, size, encoded);
+        bad += n > size + size / 254 + 1 || memchr(encoded, 0, n) != NULL;
+        bad += telemetry_cobs_decode(encoded, n, decoded, sizeof(decoded)) != size || memcmp(in, decoded, size) != 0;
+    }
+    check(bad == 0, "COBS round trip");
+
+    // Runs of exactly 254 bytes end a block without a zero
+    memset(in, 0x55, 254);
+    size_t n = telemetry_cobs_encode(in, 254, encoded);
+    check(n == 256 && telemetry_cobs_decode(encoded, n, decoded, sizeof(decoded)) == 254, "254 byte run");
+    encoded[0] = 200;
+    check(telemetry_cobs_decode(encoded, 10, decoded, sizeof(decoded)) == 0, "block past the end");
+    check(telemetry_cobs_decode(encoded, n, decoded, 100) == 0, "output too small");
+}
+
+// Moves, pieces lifted off the game, any state, LEDs and stats
+static const Sim_board_mix_t mix = {.move_percent = 34, .lift_percent = 30, .any_state = true, .leds = true};
+
+// Send what the ring holds in chunks of any size, with console lines between some frames
+static void drain(Telemetry_encoder_t *enc, Telemetry_decoder_t *decoder, uint64_t *seed, bool text)
+{
+    static const char line[] = "I (1234) CHESSY: moving P from e2 to e4\n";
+    const uint8_t *data;
+    size_t size;
+    while ((size = telemetry_ring_peek(&enc->ring, &data)) > 0) {
+        size_t chunk = host_random(seed) % 64 + 1;
+        size = size < chunk ? size : chunk;
+        telemetry_decoder_feed(decoder, data, size, NULL, NULL);
+        telemetry_ring_consume(&enc->ring, size);
+    }
+    if (text && host_random(seed) % 4 == 0) {
+        telemetry_decoder_feed(decoder, (const uint8_t *)line, sizeof(line) - 1, NULL, NULL);
+    }
+}
+
+static bool same_state(const Telemetry_decoder_t *decoder, const Telemetry_encoder_t *enc, const Sim_board_t *sim)
+{
+    return decoder->synced && decoder->has_position && decoder->pos.key == sim->board.pos.key &&
+           decoder->plies == sim->board.plies && decoder->state == sim->board.state &&
+           decoder->occupancy == sim->board.occupancy && memcmp(decoder->leds, sim->leds, sizeof(sim->leds)) == 0 &&
+           memcmp(&decoder->stats, &enc->stats, sizeof(enc->stats)) == 0;
+}
+
+static void check_stream(void)
+{
+    static Telemetry_encoder_t enc;
+    static Telemetry_decoder_t decoder;
+    static Sim_board_t sim;
+    uint64_t seed = 11;
+    int mismatches = 0;
+
+    telemetry_encoder_init(&enc);
+    telemetry_decoder_init(&decoder);
+    sim_board_init(&sim, &mix, &seed);
+    for (int step = 0; step < STEPS; step++) {
+        sim_board_step(&sim, &seed);
+        check(telemetry_encode(&enc, &sim.board, sim.leds, &sim.stats), "nothing dropped while drained");
+        drain(&enc, &decoder, &seed, true);
+        mismatches += !same_state(&decoder, &enc, &sim);
+    }
+    check(mismatches == 0, "every update rebuilds the board");
+    check(decoder.keyframes == 1 && decoder.lost_frames == 0 && decoder.desyncs == 0, "one keyframe, then deltas");
+    check(decoder.bad_frames > 0, "console text is skipped");
+
+    // A single move costs one small frame
+    uint64_t before = decoder.bytes;
+    Move_list_t list;
+    generate_legal_moves(&sim.board.pos, &list);
+    sim_board_move(&sim, list.moves[0]);
+    telemetry_encode(&enc, &sim.board, sim.leds, &sim.stats);
+    drain(&enc, &decoder, &seed, false);
+    check(same_state(&decoder, &enc, &sim) && decoder.bytes - before <= 20, "a move is under 20 bytes");
+}
+
+// Frames read one by one as the serial port sends them, console text between every two
+static void check_frames(void)
+{
+    static const char line[] = "I (1234) CHESSY: moving P from e2 to e4\n";
+    static Telemetry_encoder_t enc;
+    static Telemetry_decoder_t decoder;
+    static Sim_board_t sim;
+    uint8_t frame[TELEMETRY_ENCODED_MAX];
+    uint64_t seed = 13;
+    int mismatches = 0, bad = 0;
+
+    telemetry_encoder_init(&enc);
+    telemetry_decoder_init(&decoder);
+    sim_board_init(&sim, &mix, &seed);
+    for (int step = 0; step < STEPS; step++) {
+        // A few updates queue up before the port catches up, the ring wraps many times
+        for (int i = (int)(host_random(&seed) % 4); i >= 0; i--) {
+            sim_board_step(&sim, &seed);
+            telemetry_encode(&enc, &sim.board, sim.leds, &sim.stats);
+        }
+        size_t size;
+        while ((size = telemetry_ring_read_frame(&enc.ring, frame)) > 0) {
+            bad += frame[0] != 0 || frame[size - 1] != 0 || memchr(frame + 1, 0, size - 2) != NULL;
+            telemetry_decoder_feed(&decoder, frame, size, NULL, NULL);
+            telemetry_decoder_feed(&decoder, (const uint8_t *)line, sizeof(line) - 1, NULL, NULL);
+            telemetry_ring_consume(&enc.ring, size);
+        }
+        mismatches += !same_state(&decoder, &enc, &sim);
+    }
+    check(bad == 0 && telemetry_ring_read_frame(&enc.ring, frame) == 0, "frames read whole");
+    check(mismatches == 0 && enc.dropped == 0 && decoder.lost_frames == 0 && decoder.desyncs == 0 &&
+          decoder.keyframes == 1, "console text between frames breaks none");
+}
+
+// Frames that do not fit are dropped, and a keyframe brings the receiver back once the port catches up
+static void check_overflow(void)
+{
+    static Telemetry_encoder_t enc;
+    static Telemetry_decoder_t decoder;
+    static Sim_board_t sim;
+    uint64_t seed = 5;
+
+    telemetry_encoder_init(&enc);
+    telemetry_decoder_init(&decoder);
+    sim_board_init(&sim, &mix, &seed);
+    bool dropped = false;
+    for (int step = 0; step < 200; step++) {
+        sim_board_step(&sim, &seed);
+        memset(sim.leds, step, sizeof(sim.leds));   // Every pixel changes, a full LED frame each time
+        dropped |= !telemetry_encode(&enc, &sim.board, sim.leds, &sim.stats);
+    }
+    check(dropped && enc.dropped > 0 && telemetry_ring_free(&enc.ring) < TELEMETRY_ENCODED_MAX, "ring overflows");
+    drain(&enc, &decoder, &seed, false);
+    for (int step = 0; step < 3; step++) {
+        sim_board_step(&sim, &seed);
+        telemetry_encode(&enc, &sim.board, sim.leds, &sim.stats);
+        drain(&enc, &decoder, &seed, false);
+    }
+    check(same_state(&decoder, &enc, &sim) && decoder.keyframes == 2 && decoder.stats.tx_dropped == enc.dropped,
+          "keyframe after an overflow");
+}
+
+// A damaged frame is rejected, the next ones wait for a keyframe
+static void check_damage(void)
+{
+    static Telemetry_encoder_t enc;
+    static Telemetry_decoder_t decoder;
+    static Sim_board_t sim;
+    uint64_t seed = 17;
+
+    telemetry_encoder_init(&enc);
+    telemetry_decoder_init(&decoder);
+    sim_board_init(&sim, &mix, &seed);
+    telemetry_encode(&enc, &sim.board, sim.leds, &sim.stats);
+    drain(&enc, &decoder, &seed, false);
+
+    int desynced = 0;
+    for (int round = 0; round < 100; round++) {
+        sim_board_step(&sim, &seed);
+        sim.board.occupancy ^= 1;   // At least one frame
+        telemetry_encode(&enc, &sim.board, sim.leds, &sim.stats);
+        const uint8_t *data;
+        size_t size = telemetry_ring_peek(&enc.ring, &data);
+        enc.ring.bytes[(enc.ring.tail + 2 + host_random(&seed) % (size - 3)) % TELEMETRY_RING_SIZE] ^=
+            (uint8_t)(host_random(&seed) % 255 + 1);
+        drain(&enc, &decoder, &seed, false);
+        desynced += !decoder.synced || !same_state(&decoder, &enc, &sim);
+
+        telemetry_request_keyframe(&enc);
+        telemetry_encode(&enc, &sim.board, sim.leds, &sim.stats);
+        drain(&enc, &decoder, &seed, false);
+        check(same_state(&decoder, &enc, &sim), "keyframe after damage");
+    }
+    check(desynced > 90 && decoder.bad_frames + decoder.desyncs > 0, "damaged frames are not applied");
+}
+
+int main(void)
+{
+    check_cobs();
+    check_stream();
+    check_frames();
+    check_overflow();
+    check_damage();
+    if (failures) {
+        printf("%d checks failed\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("telemetry ok\n");
+    return EXIT_SUCCESS;
+}
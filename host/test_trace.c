@@ -0,0 +1,180 @@
+// Checks the trace rings: write order, overwriting, concurrent writers and the dump format
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "trace_decoder.h"
+#include "test_check.h"
+
+#define WRITERS 4
+#define WRITER_RECORDS 200000
+#define BENCH_RECORDS 1000000
+
+typedef struct {
+    uint32_t count;
+    uint32_t last_seq;
+    uint32_t first_arg1;
+    bool in_order;
+    bool torn;
+    uint32_t next[WRITERS];     // Per writer, the counter of its next record at the earliest
+} Drain_state_t;
+
+static void collect(int core, const Trace_record_t *record, void *ctx)
+{
+    Drain_state_t *state = ctx;
+    uint32_t seq = atomic_load(&record->seq);
+    if (core != 0) {
+        state->in_order = false;    // One ring off target
+    }
+    if (state->count == 0) {
+        state->first_arg1 = record->arg1;
+    } else if (seq != state->last_seq + 1) {
+        state->in_order = false;
+    }
+    state->last_seq = seq;
+    state->count++;
+
+    // Concurrent writers put their number in the low byte of arg0 and their counter in arg1
+    if (record->event == TRACE_HALL_EVENT) {
+        int writer = record->arg0 & 0xFF;
+        if (writer >= WRITERS || (record->arg0 >> 8) != (record->arg1 & 0xFF) || record->arg1 < state->next[writer]) {
+            state->torn = true;
+        } else {
+            state->next[writer] = record->arg1 + 1;
+        }
+    }
+}
+
+static void drain(Drain_state_t *state, uint32_t *lost)
+{
+    memset(state, 0, sizeof(*state));
+    state->in_order = true;
+    *lost = trace_drain(collect, state);
+}
+
+static _Atomic int writers_running;
+
+static void *writer(void *arg)
+{
+    int number = (int)(intptr_t)arg;
+    for (uint32_t i = 0; i < WRITER_RECORDS; i++) {
+        trace_write(TRACE_HALL_EVENT, (uint16_t)(number | (i & 0xFF) << 8), i);
+        if (i % 1000 == 0) {
+            sched_yield();
+        }
+    }
+    atomic_fetch_sub(&writers_running, 1);
+    return NULL;
+}
+
+// Writers preempting each other share a ring, each record is whole and each writer's records stay in order
+static void check_concurrent(void)
+{
+    pthread_t threads[WRITERS];
+    atomic_store(&writers_running, WRITERS);
+    for (int i = 0; i < WRITERS; i++) {
+        pthread_create(&threads[i], NULL, writer, (void *)(intptr_t)i);
+    }
+
+    Drain_state_t state = {.in_order = true};
+    uint64_t received = 0, lost = 0;
+    bool torn = false;
+    int running;
+    do {
+        running = atomic_load(&writers_running);
+        lost += trace_drain(collect, &state);
+        torn |= state.torn;
+    } while (running > 0);
+    for (int i = 0; i < WRITERS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    lost += trace_drain(collect, &state);
+    received = state.count;
+
+    printf("concurrent: %llu records drained, %llu overwritten\n", (unsigned long long)received,
+           (unsigned long long)lost);
+    check(!torn && !state.torn, "no torn or reordered records");
+    check(received + lost == (uint64_t)WRITERS * WRITER_RECORDS, "every record drained or counted lost");
+}
+
+static void check_dump(void)
+{
+    uint32_t lost;
+    Drain_state_t state;
+    drain(&state, &lost);
+    trace_write(TRACE_MOVE_PLAYED, 0x0c1c, 0x12345678);
+    trace_write(TRACE_SEARCH_DONE, 0x0c1c, 1500);
+
+    char *text;
+    size_t size;
+    FILE *dump = tmpfile();
+    trace_dump(dump);
+    fprintf(dump, "I (1234) chessy: console lines in between are skipped\n");
+    for (int i = 0; i < TRACE_RING_RECORDS + 5; i++) {
+        trace_write(TRACE_LED_FRAME, 0, 0);
+    }
+    trace_dump(dump);
+    rewind(dump);
+
+    FILE *out = open_memstream(&text, &size);
+    Trace_decoder_t decoder;
+    char line[256];
+    int trace_lines = 0;
+    trace_decoder_init(&decoder);
+    while (fgets(line, sizeof(line), dump)) {
+        trace_lines += trace_decoder_line(&decoder, line, out);
+    }
+    fclose(out);
+    fclose(dump);
+
+    check(decoder.cycles_per_us == trace_cycles_per_us(), "header rate");
+    check(decoder.records == 2 + TRACE_RING_RECORDS && decoder.lost == 5, "decoded record counts");
+    check(trace_lines == 2 + 2 + TRACE_RING_RECORDS + 1, "console line skipped");
+    check(strstr(text, "TRACE_MOVE_PLAYED      move 0x0c1c, key 0x12345678") != NULL, "move record text");
+    check(strstr(text, "TRACE_SEARCH_DONE      search move 0x0c1c in 1500 us") != NULL, "search record text");
+    check(strstr(text, "5 records overwritten") != NULL, "lost records reported");
+    free(text);
+}
+
+int main(void)
+{
+    uint32_t lost;
+    Drain_state_t state;
+
+    drain(&state, &lost);
+    check(state.count == 0 && lost == 0, "empty rings");
+    for (uint32_t i = 0; i < 10; i++) {
+        trace_write(TRACE_MOVEGEN, (uint16_t)i, i * 3);
+    }
+    drain(&state, &lost);
+    check(state.count == 10 && state.in_order && lost == 0 && state.first_arg1 == 0, "records drained in order");
+
+    // The oldest records are overwritten when the drainer falls behind
+    for (uint32_t i = 0; i < TRACE_RING_RECORDS + 100; i++) {
+        trace_write(TRACE_MOVEGEN, 0, i);
+    }
+    drain(&state, &lost);
+    check(state.count == TRACE_RING_RECORDS && lost == 100 && state.first_arg1 == 100, "overwritten records counted");
+
+    check_concurrent();
+    check_dump();
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (uint32_t i = 0; i < BENCH_RECORDS; i++) {
+        trace_write(TRACE_MOVEGEN, 0, i);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    drain(&state, &lost);
+    printf("trace_write: %.1f ns per record\n",
+           ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / BENCH_RECORDS);
+
+    if (failures) {
+        printf("%d checks failed\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("trace ok\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,320 @@
+// Checks the UCI link: lines split anywhere, positions rebuilt by the engine, hints only for the current position
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "uci.h"
+#include "uci_engine.h"
+#include "search.h"
+#include "sim_board.h"
+#include "host_util.h"
+#include "test_check.h"
+
+#define STEPS 3000
+
+static void count_line(char *line, void *ctx)
+{
+    int *count = ctx;
+    *count += strcmp(line, "isready") == 0 ? 1 : 100;
+}
+
+static void check_reader(void)
+{
+    static const char text[] = "isready\r\nisready\n\n\r\nisready\risready\n";
+    static Uci_reader_t reader;
+    uint64_t seed = 7;
+    int count = 0;
+
+    uci_reader_init(&reader);
+    for (int round = 0; round < 100; round++) {
+        for (size_t at = 0, chunk; at < sizeof(text) - 1; at += chunk) {
+            chunk = host_random(&seed) % 8 + 1;
+            chunk = chunk < sizeof(text) - 1 - at ? chunk : sizeof(text) - 1 - at;
+            uci_reader_feed(&reader, (const uint8_t *)text + at, chunk, count_line, &count);
+        }
+    }
+    check(count == 400 && reader.lines == 400, "lines split anywhere");
+
+    // A line too long for the reader is dropped whole, the next one is read
+    static uint8_t long_line[UCI_LINE_MAX + 100];
+    memset(long_line, 'x', sizeof(long_line));
+    long_line[sizeof(long_line) - 1] = '\n';
+    count = 0;
+    uci_reader_feed(&reader, long_line, sizeof(long_line), count_line, &count);
+    uci_reader_feed(&reader, (const uint8_t *)"isready\n", 8, count_line, &count);
+    check(count == 1 && reader.skipped == 1, "long line skipped");
+}
+
+static bool output_is(const Uci_output_t *out, const char *text)
+{
+    return out->size == strlen(text) && strncmp(out->text, text, out->size) == 0;
+}
+
+static bool output_has(const Uci_output_t *out, const char *text)
+{
+    char copy[UCI_OUTPUT_MAX + 1];
+    memcpy(copy, out->text, out->size);
+    copy[out->size] = '\0';
+    return strstr(copy, text) != NULL;
+}
+
+static void check_commands(void)
+{
+    static Uci_session_t session;
+    Uci_output_t out = {.size = 0};
+    Engine_report_t report;
+    Telemetry_board_t board = {.state = GAME_STATE_PLAYING};
+    char line[128];
+
+    uci_session_init(&session, 0);
+    strcpy(line, "uci");
+    check(!uci_session_handle(&session, line, &out, &report) && output_has(&out, "uciok\n"), "uci answered");
+    out.size = 0;
+    strcpy(line, "joho  isready");
+    check(!uci_session_handle(&session, line, &out, &report) && output_is(&out, "readyok\n"),
+          "unknown words skipped");
+
+    // The start position goes by name, a search runs until the next position
+    out.size = 0;
+    position_set_start(&board.pos);
+    board.start_key = board.pos.key;
+    uci_session_follow(&session, &board, &out);
+    check(output_is(&out, "position startpos\ngo infinite\n"), "start position");
+    out.size = 0;
+    uci_session_follow(&session, &board, &out);
+    check(out.size == 0, "nothing new, nothing sent");
+
+    strcpy(line, "info depth 12 seldepth 20 score mate 3 nodes 123456 pv g1f3 g8f6");
+    check(uci_session_handle(&session, line, &out, &report) && !report.done && report.depth == 12 &&
+          report.score == SEARCH_MATE - 5 && report.nodes == 123456 && report.key == board.pos.key &&
+          report.best_move == uci_parse_move(&board.pos, "g1f3"), "info pv is a hint");
+    strcpy(line, "info depth 13 score cp -40 pv e2e5");
+    check(!uci_session_handle(&session, line, &out, &report), "illegal pv ignored");
+    strcpy(line, "info string pv e2e4");
+    check(!uci_session_handle(&session, line, &out, &report), "info string ignored");
+
+    // A move stops the search, its bestmove does not show on the new position
+    Chess_move_t move = uci_parse_move(&board.pos, "e2e4");
+    make_move(&board.pos, move);
+    board.recent[board.plies++] = move;
+    uci_session_follow(&session, &board, &out);
+    check(output_is(&out, "stop\nposition startpos moves e2e4\ngo infinite\n"), "move sent");
+    strcpy(line, "bestmove g1f3 ponder g8f6");
+    check(!uci_session_handle(&session, line, &out, &report), "bestmove of the stopped search ignored");
+    strcpy(line, "bestmove e7e5");
+    check(uci_session_handle(&session, line, &out, &report) && report.done &&
+          report.best_move == uci_parse_move(&board.pos, "e7e5"), "bestmove is a hint");
+
+    // Back to setup, then a position that is not from the game
+    out.size = 0;
+    board.state = GAME_STATE_SETUP;
+    uci_session_follow(&session, &board, &out);
+    check(out.size == 0, "no search outside a game");
+    position_from_fen(&board.pos, "8/8/8/8/8/1k6/8/K1q5 w - - 0 1");
+    board.state = GAME_STATE_PLAYING;
+    uci_session_follow(&session, &board, &out);
+    check(out.size == 0, "no search when mated");
+    position_from_fen(&board.pos, "8/8/8/8/8/2k5/8/K7 w - - 0 1");
+    uci_session_follow(&session, &board, &out);
+    check(output_is(&out, "position fen 8/8/8/8/8/2k5/8/K7 w - - 0 1\ngo infinite\n"), "other positions by FEN");
+}
+
+// Mostly moves, playing or taking back
+static const Sim_board_mix_t mix = {.move_percent = 64};
+
+// Both ends of the link, the board's replies can lag a step behind
+typedef struct {
+    Uci_session_t session;
+    Uci_engine_t engine;
+    Uci_reader_t board_reader;
+    Uci_reader_t engine_reader;
+    Uci_output_t to_engine;
+    Uci_output_t to_board;
+    Uci_output_t held;
+    const Telemetry_board_t *board;
+    uint64_t *seed;
+    int hints;
+    int bestmoves;
+    int wrong_hints;
+} Link_t;
+
+static void feed(Uci_reader_t *reader, Uci_output_t *out, Uci_line_cb_t on_line, Link_t *link)
+{
+    for (size_t at = 0, chunk; at < out->size; at += chunk) {
+        chunk = host_random(link->seed) % 64 + 1;
+        chunk = chunk < out->size - at ? chunk : out->size - at;
+        uci_reader_feed(reader, (const uint8_t *)out->text + at, chunk, on_line, link);
+    }
+    out->size = 0;
+}
+
+static void engine_line(char *line, void *ctx)
+{
+    Link_t *link = ctx;
+    uci_engine_handle(&link->engine, line, &link->to_board);
+}
+
+// Every hint must be the engine's choice in the position on the board now
+static void board_line(char *line, void *ctx)
+{
+    Link_t *link = ctx;
+    Engine_report_t report;
+    if (uci_session_handle(&link->session, line, &link->to_engine, &report)) {
+        link->hints++;
+        link->bestmoves += report.done;
+        link->wrong_hints += report.key != link->board->pos.key ||
+                             report.best_move != uci_engine_choice(&link->board->pos);
+    }
+}
+
+static void exchange(Link_t *link, bool lag)
+{
+    feed(&link->engine_reader, &link->to_engine, engine_line, link);
+    if (lag) {
+        // What the engine said for the last position only comes now
+        Uci_output_t now = link->to_board;
+        link->to_board = link->held;
+        link->held = now;
+    } else {
+        feed(&link->board_reader, &link->held, board_line, link);
+    }
+    feed(&link->board_reader, &link->to_board, board_line, link);
+}
+
+static void check_games(uint32_t movetime_ms, bool lag, const char *what)
+{
+    static Link_t link;
+    static Sim_board_t sim;
+    uint64_t seed = 11 + movetime_ms + lag;
+    int mismatches = 0;
+    char text[128];
+
+    memset(&link, 0, sizeof(link));
+    uci_session_init(&link.session, movetime_ms);
+    uci_engine_init(&link.engine);
+    uci_reader_init(&link.board_reader);
+    uci_reader_init(&link.engine_reader);
+    link.board = &sim.board;
+    link.seed = &seed;
+    sim_board_init(&sim, &mix, &seed);
+    sim.board.state = GAME_STATE_PLAYING;
+    for (int step = 0; step < STEPS; step++) {
+        sim_board_step(&sim, &seed);
+        uci_session_follow(&link.session, &sim.board, &link.to_engine);
+        exchange(&link, lag && step % 3 != 0);
+        Move_list_t list;
+        if (sim.board.state == GAME_STATE_PLAYING && generate_legal_moves(&sim.board.pos, &list) > 0) {
+            mismatches += link.engine.pos.key != sim.board.pos.key;
+        }
+    }
+    snprintf(text, sizeof(text), "%s: the engine follows the board", what);
+    check(mismatches == 0 && link.engine.bad_lines == 0, text);
+    snprintf(text, sizeof(text), "%s: hints only for the position shown", what);
+    check(link.wrong_hints == 0 && link.hints > STEPS / 4, text);
+    snprintf(text, sizeof(text), "%s: bestmoves", what);
+    check(movetime_ms == 0 || link.bestmoves > STEPS / 4, text);
+    check(!lag || link.session.ignored > 0, "late reports ignored");
+}
+
+// A game longer than a command carries starts from a FEN of its older moves
+static void check_long_game(void)
+{
+    static const char *shuffle[] = {"g1f3", "g8f6", "f3g1", "f6g8"};
+    static Link_t link;
+    static Telemetry_board_t board;
+    uint64_t seed = 3;
+    int mismatches = 0;
+    size_t longest = 0;
+
+    memset(&link, 0, sizeof(link));
+    uci_session_init(&link.session, 10);
+    uci_engine_init(&link.engine);
+    link.board = &board;
+    link.seed = &seed;
+    board.state = GAME_STATE_PLAYING;
+    position_set_start(&board.pos);
+    board.start_key = board.pos.key;
+    for (int ply = 0; ply < 1000; ply++) {
+        Chess_move_t move = uci_parse_move(&board.pos, shuffle[ply % 4]);
+        make_move(&board.pos, move);
+        board.recent[board.plies++ % TELEMETRY_RECENT_MOVES] = move;
+        uci_session_follow(&link.session, &board, &link.to_engine);
+        longest = link.to_engine.size > longest ? link.to_engine.size : longest;
+        exchange(&link, false);
+        mismatches += link.engine.pos.key != board.pos.key;
+    }
+    check(mismatches == 0 && link.wrong_hints == 0 && link.bestmoves == 1000, "long game followed");
+    check(link.session.count <= UCI_MAX_PLIES && longest < UCI_OUTPUT_MAX, "long game folded into a FEN");
+}
+
+// A short write resends the position, a search the engine still runs is stopped first
+static void check_resend(void)
+{
+    static Link_t link;
+    static Telemetry_board_t board;
+    uint64_t seed = 5;
+
+    memset(&link, 0, sizeof(link));
+    uci_session_init(&link.session, 0);
+    uci_engine_init(&link.engine);
+    uci_reader_init(&link.board_reader);
+    uci_reader_init(&link.engine_reader);
+    link.board = &board;
+    link.seed = &seed;
+    board.state = GAME_STATE_PLAYING;
+    position_set_start(&board.pos);
+    board.start_key = board.pos.key;
+    uci_session_follow(&link.session, &board, &link.to_engine);
+    exchange(&link, false);
+
+    // Only the start of the stop reaches the engine, then the newline ending the torn line
+    Chess_move_t move = uci_parse_move(&board.pos, "e2e4");
+    make_move(&board.pos, move);
+    board.recent[board.plies++] = move;
+    uci_session_follow(&link.session, &board, &link.to_engine);
+    uci_session_resend(&link.session, &link.to_engine, 2);
+    link.to_engine.size = 3;
+    link.to_engine.text[2] = '\n';
+    exchange(&link, false);
+    check(link.engine.searching && link.session.pending == 1, "search still running after a short write");
+
+    uci_session_follow(&link.session, &board, &link.to_engine);
+    check(output_is(&link.to_engine, "stop\nposition startpos moves e2e4\ngo infinite\n"), "resend stops the search");
+    int hints = link.hints;
+    exchange(&link, false);
+    check(link.engine.pos.key == board.pos.key && link.hints > hints && link.wrong_hints == 0 &&
+          link.session.pending == 1, "hints for the resent position");
+
+    // A go cut before its name ends is not waited for
+    move = uci_parse_move(&board.pos, "e7e5");
+    make_move(&board.pos, move);
+    board.recent[board.plies++] = move;
+    uci_session_follow(&link.session, &board, &link.to_engine);
+    uci_session_resend(&link.session, &link.to_engine, link.to_engine.size - strlen("o infinite\n"));
+    link.to_engine.size -= strlen("o infinite\n");
+    link.to_engine.text[link.to_engine.size++] = '\n';
+    exchange(&link, false);
+    check(!link.engine.searching && link.session.pending == 0, "lost go not waited for");
+    uci_session_follow(&link.session, &board, &link.to_engine);
+    check(output_is(&link.to_engine, "position startpos moves e2e4 e7e5\ngo infinite\n"), "resend after a lost go");
+    exchange(&link, false);
+    check(link.engine.pos.key == board.pos.key && link.wrong_hints == 0 && link.session.pending == 1,
+          "hints after a lost go");
+}
+
+int main(void)
+{
+    check_reader();
+    check_commands();
+    check_games(0, false, "analysis");
+    check_games(0, true, "analysis with lag");
+    check_games(500, false, "movetime");
+    check_games(500, true, "movetime with lag");
+    check_long_game();
+    check_resend();
+    if (failures) {
+        printf("%d checks failed\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("uci ok\n");
+    return EXIT_SUCCESS;
+}
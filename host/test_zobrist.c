@@ -0,0 +1,176 @@
+// Checks incremental Zobrist keys against a full recompute and the draw rules on the game record
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "game_record.h"
+#include "pgn.h"
+#include "test_check.h"
+
+// Every make_move along the tree must leave the same key a full recompute gives,
+// and unmake_move must give back the position before it exactly
+static void check_tree(Chess_position_t *pos, int depth)
+{
+    if (pos->key != position_compute_key(pos)) {
+        char fen[POSITION_FEN_MAX];
+        printf("FAIL key of %s\n", position_to_fen(pos, fen));
+        failures++;
+        return;
+    }
+    if (depth == 0) {
+        return;
+    }
+    Move_list_t list;
+    generate_legal_moves(pos, &list);
+    for (int i = 0; i < list.count && !failures; i++) {
+        Chess_position_t before = *pos;
+        Move_undo_t undo;
+        make_move_undo(pos, list.moves[i], &undo);
+        check_tree(pos, depth - 1);
+        unmake_move(pos, list.moves[i], &undo);
+        if (memcmp(pos, &before, sizeof(before)) != 0) {
+            char fen[POSITION_FEN_MAX], uci[6];
+            printf("FAIL unmake %s in %s\n", move_to_uci(list.moves[i], uci), position_to_fen(&before, fen));
+            failures++;
+        }
+    }
+}
+
+static void play(Game_record_t *record, Chess_position_t *pos, const char *moves)
+{
+    char uci[6];
+    int length;
+    while (sscanf(moves, "%5s%n", uci, &length) == 1) {
+        moves += length;
+        Chess_move_t move = find_legal_move(pos, SQUARE(uci[1] - '1', uci[0] - 'a'), SQUARE(uci[3] - '1', uci[2] - 'a'),
+                                            PIECE_QUEEN);
+        if (move == MOVE_NONE) {
+            printf("FAIL %s is not legal\n", uci);
+            failures++;
+            return;
+        }
+        make_move(pos, move);
+        game_record_append(record, move, pos->key);
+    }
+}
+
+int main(void)
+{
+    static const char *fens[] = {
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+        "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+        "rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3",
+    };
+    for (size_t i = 0; i < sizeof(fens) / sizeof(fens[0]); i++) {
+        Chess_position_t pos;
+        position_from_fen(&pos, fens[i]);
+        check_tree(&pos, 4);
+    }
+
+    // Polyglot's published keys, played from the start so the incremental keys are checked too
+    static const struct {
+        const char *moves;
+        uint64_t key;
+    } polyglot[] = {
+        {"", 0x463B96181691FC9CULL},
+        {"e2e4", 0x823C9B50FD114196ULL},
+        {"e2e4 d7d5", 0x0756B94461C50FB0ULL},
+        {"e2e4 d7d5 e4e5", 0x662FAFB965DB29D4ULL},
+        {"e2e4 d7d5 e4e5 f7f5", 0x22A48B5A8E47FF78ULL},
+        {"e2e4 d7d5 e4e5 f7f5 e1e2", 0x652A607CA3F242C1ULL},
+        {"e2e4 d7d5 e4e5 f7f5 e1e2 e8f7", 0x00FDD303C946BDD9ULL},
+        {"a2a4 b7b5 h2h4 b5b4 c2c4", 0x3C8123EA7B067637ULL},
+        {"a2a4 b7b5 h2h4 b5b4 c2c4 b4c3 a1a3", 0x5C3F9B829B279560ULL},
+    };
+    for (size_t i = 0; i < sizeof(polyglot) / sizeof(polyglot[0]); i++) {
+        Chess_position_t pos;
+        Game_record_t moves;
+        char what[80];
+        position_set_start(&pos);
+        game_record_init(&moves, &pos);
+        play(&moves, &pos, polyglot[i].moves);
+        game_record_clear(&moves);
+        snprintf(what, sizeof(what), "Polyglot key after \"%s\"", polyglot[i].moves);
+        check(pos.key == polyglot[i].key && position_compute_key(&pos) == polyglot[i].key, what);
+    }
+
+    // Transpositions reach the same key, a different side to move or castling rights do not
+    Chess_position_t a, b;
+    Game_record_t record;
+    position_set_start(&a);
+    game_record_init(&record, &a);
+    play(&record, &a, "g1f3 g8f6 b1c3 b8c6");
+    game_record_clear(&record);
+    position_set_start(&b);
+    play(&record, &b, "b1c3 b8c6 g1f3 g8f6");
+    game_record_clear(&record);
+    check(a.key == b.key, "transposition has the same key");
+    position_from_fen(&b, "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR b KQkq - 0 1");
+    position_set_start(&a);
+    check(a.key != b.key, "side to move changes the key");
+    position_from_fen(&b, "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w Kkq - 0 1");
+    check(a.key != b.key, "castling rights change the key");
+
+    // An en passant square nobody can use does not make a new position
+    position_from_fen(&a, "rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 1");
+    position_from_fen(&b, "rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq - 0 1");
+    check(a.key == b.key, "unusable en passant square is ignored");
+    position_from_fen(&a, "rnbqkbnr/ppp1pppp/8/8/3pP3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 1");
+    position_from_fen(&b, "rnbqkbnr/ppp1pppp/8/8/3pP3/8/PPPP1PPP/RNBQKBNR b KQkq - 0 1");
+    check(a.key != b.key, "usable en passant square changes the key");
+
+    // Knights out and back twice, the start position comes back for the third time
+    position_set_start(&a);
+    game_record_init(&record, &a);
+    play(&record, &a, "g1f3 g8f6 f3g1 f6g8");
+    check(game_record_repetitions(&record, &a) == 1, "start position repeated once");
+    play(&record, &a, "g1f3 g8f6 f3g1");
+    check(game_record_repetitions(&record, &a) == 1, "position after f3g1 repeated once");
+    play(&record, &a, "f6g8");
+    check(game_record_repetitions(&record, &a) == 2, "threefold repetition");
+    check(strcmp(pgn_result(&record), "1/2-1/2") == 0, "threefold repetition is a draw");
+
+    // A pawn move makes the earlier positions unreachable
+    play(&record, &a, "e2e4 e7e5 g1f3 g8f6 f3g1 f6g8");
+    check(game_record_repetitions(&record, &a) == 1, "repetitions restart after a pawn move");
+    game_record_clear(&record);
+
+    // Over many chunks, every shuffle cycle repeats the position
+    position_set_start(&a);
+    game_record_init(&record, &a);
+    play(&record, &a, "e2e4 e7e5");
+    for (int i = 0; i < GAME_RECORD_CHUNK_MOVES; i++) {
+        play(&record, &a, "g1f3 g8f6 f3g1 f6g8");
+    }
+    check(a.halfmove_clock == UINT8_MAX, "halfmove clock saturates");
+    check(game_record_repetitions(&record, &a) == UINT8_MAX / 4, "repetitions across chunks");
+    // Taken back to the first chunk, the others are freed and appending reuses none of them
+    while (record.count > 2) {
+        game_record_pop(&record);
+    }
+    check(record.head == record.tail && record.tail->next == NULL, "takeback frees emptied chunks");
+    check(game_record_get(&record, 1) == MOVE_MAKE(SQUARE(6, 4), SQUARE(4, 4), MOVE_FLAG_DOUBLE_PUSH),
+          "takeback keeps earlier moves");
+    for (int i = 0; i < GAME_RECORD_CHUNK_MOVES; i++) {
+        game_record_append(&record, MOVE_NONE, 0);
+    }
+    check(record.count == GAME_RECORD_CHUNK_MOVES + 2 && record.tail != record.head, "append after takeback");
+    game_record_clear(&record);
+
+    // 50-move rule
+    position_from_fen(&a, "4k3/8/8/8/8/8/8/4K2R w - - 98 80");
+    game_record_init(&record, &a);
+    play(&record, &a, "h1h2");
+    check(strcmp(pgn_result(&record), "*") == 0, "99 plies is not a draw");
+    play(&record, &a, "e8d8");
+    check(strcmp(pgn_result(&record), "1/2-1/2") == 0, "100 plies is a draw");
+    game_record_clear(&record);
+
+    if (failures) {
+        printf("%d checks failed\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("zobrist ok\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,27 @@
+// Decodes trace records from a console log
+//
+// Usage: trace_decode [log]    reads stdin without a file, other console lines are skipped
+#include <stdio.h>
+#include <stdlib.h>
+#include "trace_decoder.h"
+
+int main(int argc, char *argv[])
+{
+    FILE *in = argc > 1 ? fopen(argv[1], "r") : stdin;
+    if (!in) {
+        perror(argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    Trace_decoder_t decoder;
+    char line[256];
+    trace_decoder_init(&decoder);
+    while (fgets(line, sizeof(line), in)) {
+        trace_decoder_line(&decoder, line, stdout);
+    }
+    if (in != stdin) {
+        fclose(in);
+    }
+    fprintf(stderr, "%llu records, %llu lost\n", (unsigned long long)decoder.records, (unsigned long long)decoder.lost);
+    return EXIT_SUCCESS;
+}
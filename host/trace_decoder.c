@@ -0,0 +1,98 @@
+#include <stdlib.h>
+#include <string.h>
+#include "trace_decoder.h"
+
+#define TRACE_EVENT_NAME(name, format) #name,
+#define TRACE_EVENT_FORMAT(name, format) format,
+
+static const char *event_names[] = {TRACE_EVENT_LIST(TRACE_EVENT_NAME)};
+static const char *event_formats[] = {TRACE_EVENT_LIST(TRACE_EVENT_FORMAT)};
+
+void trace_decoder_init(Trace_decoder_t *decoder)
+{
+    memset(decoder, 0, sizeof(*decoder));
+    decoder->cycles_per_us = 1;
+}
+
+static bool parse_hex(const char *hex, int digits, uint32_t *value)
+{
+    *value = 0;
+    for (int i = 0; i < digits; i++) {
+        char c = hex[i];
+        int nibble = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+        if (nibble < 0) {
+            return false;
+        }
+        *value = *value << 4 | (uint32_t)nibble;
+    }
+    return true;
+}
+
+bool trace_parse_record(const char *hex, Trace_record_t *record)
+{
+    uint32_t seq, cycles, event, arg0, arg1;
+    if (!parse_hex(hex, 8, &seq) || !parse_hex(hex + 8, 8, &cycles) || !parse_hex(hex + 16, 4, &event) ||
+            !parse_hex(hex + 20, 4, &arg0) || !parse_hex(hex + 24, 8, &arg1)) {
+        return false;
+    }
+    atomic_init(&record->seq, seq);
+    record->cycles = cycles;
+    record->event = (uint16_t)event;
+    record->arg0 = (uint16_t)arg0;
+    record->arg1 = arg1;
+    return true;
+}
+
+bool trace_decoder_line(Trace_decoder_t *decoder, const char *line, FILE *out)
+{
+    if (strncmp(line, "@T", 2) != 0) {
+        return false;
+    }
+    if (strncmp(line, "@TH ", 4) == 0) {
+        unsigned long rate = strtoul(line + 4, NULL, 10);
+        decoder->cycles_per_us = rate ? (uint32_t)rate : 1;
+        return true;
+    }
+    if (strncmp(line, "@TL ", 4) == 0) {
+        unsigned long lost = strtoul(line + 4, NULL, 10);
+        decoder->lost += lost;
+        if (out) {
+            fprintf(out, "*** %lu records overwritten before the drain\n", lost);
+        }
+        return true;
+    }
+
+    int core = line[2] - '0';
+    Trace_record_t record;
+    if (core < 0 || core >= TRACE_DECODER_MAX_CORES || line[3] != ' ' || !trace_parse_record(line + 4, &record)) {
+        if (out) {
+            fprintf(out, "*** bad trace line: %s", line);
+        }
+        return true;
+    }
+
+    // Cycle counters wrap, the records of a core are in order so every step is forward
+    uint32_t seq = atomic_load(&record.seq);
+    if (decoder->started[core]) {
+        decoder->elapsed[core] += record.cycles - decoder->last_cycles[core];
+        if (seq != decoder->last_seq[core] + 1 && out) {
+            fprintf(out, "*** core %d: %lu records missing\n", core, (unsigned long)(seq - decoder->last_seq[core] - 1));
+        }
+    }
+    decoder->started[core] = true;
+    decoder->last_seq[core] = seq;
+    decoder->last_cycles[core] = record.cycles;
+    decoder->records++;
+
+    if (out) {
+        fprintf(out, "%d %12.3f us  ", core, (double)decoder->elapsed[core] / decoder->cycles_per_us);
+        if (record.event < TRACE_EVENT_NB) {
+            fprintf(out, "%-22s ", event_names[record.event]);
+            fprintf(out, event_formats[record.event], (unsigned int)record.arg0, (unsigned int)record.arg1);
+            fputc('\n', out);
+        } else {
+            fprintf(out, "event %u: %u %lu\n", record.event, record.arg0, (unsigned long)record.arg1);
+        }
+    }
+    return true;
+}
@@ -0,0 +1,54 @@
+// Turns trace dumps back into text
+#ifndef TRACE_DECODER_H
+#define TRACE_DECODER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "trace.h"
+
+#define TRACE_DECODER_MAX_CORES 8
+
+/**
+ * @brief State carried from line to line of a dump
+ *
+ */
+typedef struct {
+    uint32_t cycles_per_us;
+    bool started[TRACE_DECODER_MAX_CORES];
+    uint32_t last_seq[TRACE_DECODER_MAX_CORES];
+    uint32_t last_cycles[TRACE_DECODER_MAX_CORES];
+    uint64_t elapsed[TRACE_DECODER_MAX_CORES];  // Cycles since the first record, unwrapped
+    uint64_t records;
+    uint64_t lost;
+} Trace_decoder_t;
+
+/**
+ * @brief Start decoding a new dump
+ *
+ * @param decoder The decoder
+ */
+void trace_decoder_init(Trace_decoder_t *decoder);
+
+/**
+ * @brief Decode one line of console output
+ *
+ * Lines not starting with "@T" are skipped.
+ *
+ * @param decoder The decoder
+ * @param line The line
+ * @param out Where the text goes, NULL to only count
+ * @return true if the line was a trace line
+ */
+bool trace_decoder_line(Trace_decoder_t *decoder, const char *line, FILE *out);
+
+/**
+ * @brief Parse the hex of a record line
+ *
+ * @param hex The 32 hex digits
+ * @param record The record to fill
+ * @return true on success
+ */
+bool trace_parse_record(const char *hex, Trace_record_t *record);
+
+#endif
@@ -0,0 +1,103 @@
+#include <stdio.h>
+#include <string.h>
+#include "uci_engine.h"
+
+#define UCI_SEPARATORS " \t"
+
+void uci_engine_init(Uci_engine_t *engine)
+{
+    memset(engine, 0, sizeof(*engine));
+}
+
+Chess_move_t uci_engine_choice(const Chess_position_t *pos)
+{
+    Move_list_t list;
+    int count = generate_legal_moves(pos, &list);
+    return count > 0 ? list.moves[count - 1] : MOVE_NONE;
+}
+
+bool uci_engine_parse_position(char *args, Chess_position_t *pos)
+{
+    char *save;
+    char *word = strtok_r(args, UCI_SEPARATORS, &save);
+    if (word && strcmp(word, "startpos") == 0) {
+        position_set_start(pos);
+        word = strtok_r(NULL, UCI_SEPARATORS, &save);
+    } else if (word && strcmp(word, "fen") == 0) {
+        // The FEN is every word up to moves
+        char fen[POSITION_FEN_MAX + 16] = "";
+        while ((word = strtok_r(NULL, UCI_SEPARATORS, &save)) != NULL && strcmp(word, "moves") != 0) {
+            if (strlen(fen) + strlen(word) + 2 > sizeof(fen)) {
+                return false;
+            }
+            strcat(fen, fen[0] ? " " : "");
+            strcat(fen, word);
+        }
+        if (!position_from_fen(pos, fen)) {
+            return false;
+        }
+    } else {
+        return false;
+    }
+    if (word && strcmp(word, "moves") == 0) {
+        while ((word = strtok_r(NULL, UCI_SEPARATORS, &save)) != NULL) {
+            Chess_move_t move = uci_parse_move(pos, word);
+            if (move == MOVE_NONE) {
+                return false;
+            }
+            make_move(pos, move);
+        }
+    }
+    return word == NULL;
+}
+
+static void append(Uci_output_t *out, const char *text)
+{
+    size_t size = strlen(text);
+    if (out->size + size <= sizeof(out->text)) {
+        memcpy(out->text + out->size, text, size);
+        out->size += size;
+    }
+}
+
+static void append_move(Uci_output_t *out, const char *format, Chess_move_t move)
+{
+    char text[64], uci[6];
+    snprintf(text, sizeof(text), format, move == MOVE_NONE ? "0000" : move_to_uci(move, uci));
+    append(out, text);
+}
+
+void uci_engine_handle(Uci_engine_t *engine, char *line, Uci_output_t *out)
+{
+    char *save;
+    char *word = strtok_r(line, UCI_SEPARATORS, &save);
+    if (!word) {
+        return;
+    }
+    if (strcmp(word, "position") == 0) {
+        char *args = strtok_r(NULL, "", &save);
+        engine->has_position = args && uci_engine_parse_position(args, &engine->pos);
+        engine->bad_lines += !engine->has_position;
+        engine->positions++;
+    } else if (strcmp(word, "go") == 0) {
+        if (!engine->has_position) {
+            engine->bad_lines++;
+            return;
+        }
+        Chess_move_t move = uci_engine_choice(&engine->pos);
+        append_move(out, "info depth 1 score cp 0 pv %s\n", move);
+        engine->searches++;
+        word = strtok_r(NULL, UCI_SEPARATORS, &save);
+        engine->searching = word && strcmp(word, "infinite") == 0;
+        if (!engine->searching) {
+            append_move(out, "bestmove %s\n", move);
+        }
+    } else if (strcmp(word, "stop") == 0) {
+        if (engine->searching) {
+            append_move(out, "bestmove %s\n", uci_engine_choice(&engine->pos));
+            engine->searching = false;
+        }
+    } else if (strcmp(word, "isready") == 0) {
+        append(out, "readyok\n");
+    }
+}
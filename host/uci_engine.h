@@ -0,0 +1,58 @@
+// A stand-in UCI engine that answers at once, for the tests and the loopback harness
+#ifndef UCI_ENGINE_H
+#define UCI_ENGINE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "uci.h"
+
+/**
+ * @brief What the board told the engine so far
+ *
+ * Every search suggests uci_engine_choice() of its position, with an info
+ * line when it starts and a bestmove when it ends: right away with a
+ * movetime, at stop for an infinite search.
+ */
+typedef struct {
+    Chess_position_t pos;
+    bool has_position;
+    bool searching;           // An infinite search waits for stop
+    uint32_t positions;
+    uint32_t searches;
+    uint32_t bad_lines;       // Position commands that do not parse, go without a position
+} Uci_engine_t;
+
+/**
+ * @brief Start without a position
+ *
+ * @param engine The engine
+ */
+void uci_engine_init(Uci_engine_t *engine);
+
+/**
+ * @brief Handle a command from the board
+ *
+ * @param engine The engine
+ * @param line The line, split in place
+ * @param out Replies are appended here
+ */
+void uci_engine_handle(Uci_engine_t *engine, char *line, Uci_output_t *out);
+
+/**
+ * @brief Read the arguments of a position command
+ *
+ * @param args What follows "position"
+ * @param pos Set to the position after the moves
+ * @return true if the position and every move are valid
+ */
+bool uci_engine_parse_position(char *args, Chess_position_t *pos);
+
+/**
+ * @brief The move the engine suggests in a position
+ *
+ * @param pos The position
+ * @return Chess_move_t The last legal move generated, MOVE_NONE if there is none
+ */
+Chess_move_t uci_engine_choice(const Chess_position_t *pos);
+
+#endif
@@ -0,0 +1,456 @@
+// Connects a board to a UCI engine, and times the link
+//
+// Usage: uci_host <port> <engine> [args...]   run the engine for the board, e.g. uci_host /dev/ttyACM0 stockfish
+//        uci_host <port> ping [count]          round trips of isready to the board
+//        uci_host loopback [moves]             round trips through the firmware's UCI code on a socket pair
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include "uci.h"
+#include "uci_engine.h"
+#include "serial_port.h"
+
+#define PING_TIMEOUT_MS 1000
+#define LOOPBACK_POLL_MS 5      // As CONFIG_CHESSY_UCI_POLL_MS
+#define LOOPBACK_MOVETIME_MS 1
+#define MAX_SAMPLES 100000
+
+static double now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static bool write_all(int fd, const char *text, size_t size)
+{
+    while (size > 0) {
+        ssize_t n = write(fd, text, size);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        text += n;
+        size -= (size_t)n;
+    }
+    return true;
+}
+
+static int compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static void print_latency(const char *what, double *samples, int count)
+{
+    if (count == 0) {
+        printf("%s: no samples\n", what);
+        return;
+    }
+    double sum = 0;
+    for (int i = 0; i < count; i++) {
+        sum += samples[i];
+    }
+    qsort(samples, (size_t)count, sizeof(samples[0]), compare_doubles);
+    printf("%s: %d round trips, min %.0f us, mean %.0f us, p99 %.0f us, max %.0f us\n", what, count, samples[0],
+           sum / count, samples[count * 99 / 100], samples[count - 1]);
+}
+
+// Bridge
+
+typedef struct {
+    int board_fd;
+    int engine_fd;
+} Bridge_t;
+
+static bool starts_with_word(const char *line, const char *const *words)
+{
+    for (; *words; words++) {
+        size_t size = strlen(*words);
+        if (strncmp(line, *words, size) == 0 && (line[size] == ' ' || line[size] == '\0')) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Commands go to the engine, console text from the board is only shown
+static void on_board_line(char *line, void *ctx)
+{
+    static const char *const commands[] = {"position", "go", "stop", "ucinewgame", NULL};
+    Bridge_t *bridge = ctx;
+    if (!starts_with_word(line, commands)) {
+        printf("board: %s\n", line);
+        return;
+    }
+    printf("> %s\n", line);
+    size_t size = strlen(line);
+    line[size] = '\n';
+    write_all(bridge->engine_fd, line, size + 1);
+}
+
+// Only what the board uses goes back, an engine sends far more info than a hint needs
+static void on_engine_line(char *line, void *ctx)
+{
+    static const char *const replies[] = {"bestmove", "info", NULL};
+    Bridge_t *bridge = ctx;
+    if (!starts_with_word(line, replies) || (strncmp(line, "info", 4) == 0 && !strstr(line, " pv "))) {
+        return;
+    }
+    printf("< %s\n", line);
+    size_t size = strlen(line);
+    line[size] = '\n';
+    write_all(bridge->board_fd, line, size + 1);
+}
+
+static int bridge(const char *port, char *engine_argv[])
+{
+    static Uci_reader_t board_reader, engine_reader;
+    Bridge_t bridge = {.board_fd = serial_port_open(port, O_RDWR)};
+    int to_engine[2], from_engine[2];
+    if (bridge.board_fd < 0 || pipe(to_engine) != 0 || pipe(from_engine) != 0) {
+        return EXIT_FAILURE;
+    }
+    signal(SIGPIPE, SIG_IGN);
+    pid_t pid = fork();
+    if (pid == 0) {
+        dup2(to_engine[0], STDIN_FILENO);
+        dup2(from_engine[1], STDOUT_FILENO);
+        close(to_engine[1]);
+        close(from_engine[0]);
+        execvp(engine_argv[0], engine_argv);
+        perror(engine_argv[0]);
+        _exit(EXIT_FAILURE);
+    }
+    close(to_engine[0]);
+    close(from_engine[1]);
+    bridge.engine_fd = to_engine[1];
+    write_all(bridge.engine_fd, "uci\nisready\n", 12);
+
+    uci_reader_init(&board_reader);
+    uci_reader_init(&engine_reader);
+    struct pollfd fds[2] = {{.fd = bridge.board_fd, .events = POLLIN}, {.fd = from_engine[0], .events = POLLIN}};
+    uint8_t buffer[4096];
+    while (1) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("poll");
+            return EXIT_FAILURE;
+        }
+        for (int i = 0; i < 2; i++) {
+            if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR))) {
+                continue;
+            }
+            ssize_t n = read(fds[i].fd, buffer, sizeof(buffer));
+            if (n <= 0) {
+                fprintf(stderr, "%s closed\n", i == 0 ? port : engine_argv[0]);
+                return i == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+            }
+            if (i == 0) {
+                uci_reader_feed(&board_reader, buffer, (size_t)n, on_board_line, &bridge);
+            } else {
+                uci_reader_feed(&engine_reader, buffer, (size_t)n, on_engine_line, &bridge);
+            }
+            fflush(stdout);
+        }
+    }
+}
+
+// Ping
+
+typedef struct {
+    bool ready;
+    Uci_engine_t *engine;     // Answers commands read while waiting, if not NULL
+    Uci_output_t out;
+} Ping_t;
+
+static void on_ping_line(char *line, void *ctx)
+{
+    Ping_t *ping = ctx;
+    if (strcmp(line, "readyok") == 0) {
+        ping->ready = true;
+    } else if (ping->engine) {
+        uci_engine_handle(ping->engine, line, &ping->out);
+    }
+}
+
+// Wait for lines until done is set, false on a timeout
+static bool read_until(int fd, Uci_reader_t *reader, Uci_line_cb_t on_line, void *ctx, const bool *done)
+{
+    uint8_t buffer[4096];
+    double deadline = now_us() + PING_TIMEOUT_MS * 1000.0;
+    while (!*done) {
+        struct pollfd pfd = {.fd = fd, .events = POLLIN};
+        int wait_ms = (int)((deadline - now_us()) / 1000);
+        if (wait_ms <= 0 || poll(&pfd, 1, wait_ms) <= 0) {
+            return false;
+        }
+        ssize_t n = read(fd, buffer, sizeof(buffer));
+        if (n <= 0) {
+            return false;
+        }
+        uci_reader_feed(reader, buffer, (size_t)n, on_line, ctx);
+    }
+    return true;
+}
+
+static int ping_fd(int fd, int count, double *samples, Uci_engine_t *engine)
+{
+    static Uci_reader_t reader;
+    static Ping_t ping;
+    int done = 0;
+    uci_reader_init(&reader);
+    memset(&ping, 0, sizeof(ping));
+    ping.engine = engine;
+    for (int i = 0; i < count; i++) {
+        ping.ready = false;
+        double start = now_us();
+        if (!write_all(fd, "isready\n", 8) || !read_until(fd, &reader, on_ping_line, &ping, &ping.ready)) {
+            fprintf(stderr, "no readyok within %d ms\n", PING_TIMEOUT_MS);
+            break;
+        }
+        samples[done++] = now_us() - start;
+        if (ping.out.size > 0) {
+            write_all(fd, ping.out.text, ping.out.size);
+            ping.out.size = 0;
+        }
+    }
+    return done;
+}
+
+static int ping(const char *port, int count)
+{
+    static double samples[MAX_SAMPLES];
+    int fd = serial_port_open(port, O_RDWR);
+    if (fd < 0) {
+        return EXIT_FAILURE;
+    }
+    count = count < MAX_SAMPLES ? count : MAX_SAMPLES;
+    int done = ping_fd(fd, count, samples, NULL);
+    print_latency("isready", samples, done);
+    return done == count ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// Loopback: the board side runs the firmware's session on a thread, as the UCI task does
+
+typedef struct {
+    int fd;                   // The board's end of the socket pair
+    int wake[2];              // A published board wakes the thread, as the task notification does
+    pthread_mutex_t lock;
+    pthread_cond_t hinted;
+    Telemetry_board_t board;  // The queue of one
+    bool have_board;
+    bool quit;
+    Engine_report_t hint;     // The last bestmove
+    double hint_us;
+    uint32_t hints;
+    Uci_session_t session;
+    Uci_reader_t reader;
+    Uci_output_t out;
+} Loop_board_t;
+
+static void on_loop_line(char *line, void *ctx)
+{
+    Loop_board_t *loop = ctx;
+    Engine_report_t report;
+    if (uci_session_handle(&loop->session, line, &loop->out, &report) && report.done) {
+        pthread_mutex_lock(&loop->lock);
+        loop->hint = report;
+        loop->hint_us = now_us();
+        loop->hints++;
+        pthread_cond_signal(&loop->hinted);
+        pthread_mutex_unlock(&loop->lock);
+    }
+}
+
+static void *loop_board_task(void *arg)
+{
+    Loop_board_t *loop = arg;
+    static Telemetry_board_t board;
+    uint8_t buffer[128];
+    bool have_board = false;
+
+    uci_session_init(&loop->session, LOOPBACK_MOVETIME_MS);
+    uci_reader_init(&loop->reader);
+    while (1) {
+        // Only a published board wakes the thread, what the host sends waits for the next poll as on the board
+        struct pollfd wake = {.fd = loop->wake[0], .events = POLLIN};
+        if (poll(&wake, 1, LOOPBACK_POLL_MS) > 0 && read(loop->wake[0], buffer, sizeof(buffer)) < 0) {
+            return NULL;
+        }
+        pthread_mutex_lock(&loop->lock);
+        if (loop->quit) {
+            pthread_mutex_unlock(&loop->lock);
+            return NULL;
+        }
+        if (loop->have_board) {
+            board = loop->board;
+            loop->have_board = false;
+            have_board = true;
+        }
+        pthread_mutex_unlock(&loop->lock);
+
+        ssize_t n;
+        while ((n = recv(loop->fd, buffer, sizeof(buffer), MSG_DONTWAIT)) > 0) {
+            uci_reader_feed(&loop->reader, buffer, (size_t)n, on_loop_line, loop);
+        }
+        if (have_board) {
+            uci_session_follow(&loop->session, &board, &loop->out);
+        }
+        write_all(loop->fd, loop->out.text, loop->out.size);
+        loop->out.size = 0;
+    }
+}
+
+static void loop_publish(Loop_board_t *loop, const Telemetry_board_t *board)
+{
+    pthread_mutex_lock(&loop->lock);
+    loop->board = *board;
+    loop->have_board = true;
+    pthread_mutex_unlock(&loop->lock);
+    write_all(loop->wake[1], "", 1);
+}
+
+// Wait for the bestmove of a position, false on a timeout
+static bool loop_wait_hint(Loop_board_t *loop, uint32_t hints, double *hint_us, Engine_report_t *hint)
+{
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += PING_TIMEOUT_MS / 1000;
+    pthread_mutex_lock(&loop->lock);
+    while (loop->hints == hints) {
+        if (pthread_cond_timedwait(&loop->hinted, &loop->lock, &deadline) != 0) {
+            break;
+        }
+    }
+    bool hinted = loop->hints != hints;
+    *hint_us = loop->hint_us;
+    *hint = loop->hint;
+    pthread_mutex_unlock(&loop->lock);
+    return hinted;
+}
+
+typedef struct {
+    Uci_engine_t engine;
+    Uci_reader_t reader;
+    Uci_output_t out;
+    bool searched;            // A go was answered
+} Loop_engine_t;
+
+static void on_engine_command(char *line, void *ctx)
+{
+    Loop_engine_t *host = ctx;
+    host->searched |= strncmp(line, "go", 2) == 0;
+    uci_engine_handle(&host->engine, line, &host->out);
+}
+
+static int loopback(int moves)
+{
+    static Loop_board_t loop;
+    static Loop_engine_t host;
+    static double samples[MAX_SAMPLES];
+    int fds[2];
+    pthread_t thread;
+    uint64_t seed = 1;
+    int done = 0, wrong = 0, searches = 0;
+
+    moves = moves < MAX_SAMPLES ? moves : MAX_SAMPLES;
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0 || pipe(loop.wake) != 0) {
+        perror("socketpair");
+        return EXIT_FAILURE;
+    }
+    loop.fd = fds[0];
+    pthread_mutex_init(&loop.lock, NULL);
+    pthread_cond_init(&loop.hinted, NULL);
+    uci_engine_init(&host.engine);
+    uci_reader_init(&host.reader);
+    pthread_create(&thread, NULL, loop_board_task, &loop);
+
+    // A move on the board, its position to the engine, the bestmove back as a hint
+    Telemetry_board_t board = {.state = GAME_STATE_PLAYING};
+    position_set_start(&board.pos);
+    board.start_key = board.pos.key;
+    for (int i = 0; i < moves; i++) {
+        Move_list_t list;
+        if (generate_legal_moves(&board.pos, &list) == 0 || board.plies >= 200) {
+            position_set_start(&board.pos);
+            board.plies = 0;
+            generate_legal_moves(&board.pos, &list);
+        }
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        Chess_move_t move = list.moves[seed % list.count];
+        make_move(&board.pos, move);
+        board.recent[board.plies++ % TELEMETRY_RECENT_MOVES] = move;
+        if (generate_legal_moves(&board.pos, &list) == 0) {
+            continue;   // Nothing to search, the next move starts a new game
+        }
+        searches++;
+
+        pthread_mutex_lock(&loop.lock);
+        uint32_t hints = loop.hints;
+        pthread_mutex_unlock(&loop.lock);
+        double start = now_us(), hint_us;
+        Engine_report_t hint;
+        host.searched = false;
+        loop_publish(&loop, &board);
+        if (!read_until(fds[1], &host.reader, on_engine_command, &host, &host.searched)) {
+            fprintf(stderr, "no go within %d ms\n", PING_TIMEOUT_MS);
+            break;
+        }
+        write_all(fds[1], host.out.text, host.out.size);
+        host.out.size = 0;
+        if (!loop_wait_hint(&loop, hints, &hint_us, &hint)) {
+            fprintf(stderr, "no bestmove within %d ms\n", PING_TIMEOUT_MS);
+            break;
+        }
+        wrong += hint.key != board.pos.key || hint.best_move != uci_engine_choice(&board.pos);
+        samples[done++] = hint_us - start;
+    }
+    print_latency("move to hint", samples, done);
+
+    int pings = ping_fd(fds[1], moves, samples, &host.engine);
+    print_latency("isready", samples, pings);
+
+    pthread_mutex_lock(&loop.lock);
+    loop.quit = true;
+    pthread_mutex_unlock(&loop.lock);
+    write_all(loop.wake[1], "", 1);
+    pthread_join(thread, NULL);
+    printf("%u positions, %u bestmoves, %u ignored, %d wrong hints, %u bad lines\n",
+           (unsigned int)loop.session.positions, (unsigned int)loop.session.bestmoves,
+           (unsigned int)loop.session.ignored, wrong, (unsigned int)host.engine.bad_lines);
+    return done == searches && pings == moves && wrong == 0 && host.engine.bad_lines == 0 ? EXIT_SUCCESS
+           : EXIT_FAILURE;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc >= 2 && strcmp(argv[1], "loopback") == 0) {
+        return loopback(argc >= 3 ? atoi(argv[2]) : 1000);
+    }
+    if (argc >= 3 && strcmp(argv[2], "ping") == 0) {
+        return ping(argv[1], argc >= 4 ? atoi(argv[3]) : 100);
+    }
+    if (argc >= 3) {
+        return bridge(argv[1], argv + 2);
+    }
+    fprintf(stderr, "Usage: %s <port> <engine> [args...]\n"
+                    "       %s <port> ping [count]\n"
+                    "       %s loopback [moves]\n", argv[0], argv[0], argv[0]);
+    return EXIT_FAILURE;
+}
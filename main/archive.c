@@ -0,0 +1,552 @@
+#include <string.h>
+#include "archive.h"
+#include "crc32.h"
+#include "flash_ring.h"
+#include "evaluate.h"
+
+#define ARCHIVE_MAGIC 0x43524143u     // "CARC"
+#define GAME_ERASED 0xFFFF
+#define FLAG_CUSTOM_START 0x01
+
+// Binary range coder with adaptive probabilities, as in LZMA
+#define PROB_BITS 11
+#define PROB_ONE (1 << PROB_BITS)
+#define PROB_SHIFT 5
+#define RANGE_TOP (1u << 24)
+#define RANK_UNARY 12                 // Ranks below are one adaptive decision each, the rest an 8-bit tree
+
+// Header fields
+#define HEADER_SIZE 0
+#define HEADER_PLIES 2
+#define HEADER_RESULT 4
+#define HEADER_FLAGS 5
+#define HEADER_DATE 6
+#define HEADER_OPENING 10
+#define HEADER_MOVES_CRC 18
+#define HEADER_CRC 22
+
+typedef struct {
+    uint16_t unary[2][RANK_UNARY];    // By whether the last move captured, recaptures are likely
+    uint16_t tail[256];
+} Rank_model_t;
+
+typedef struct {
+    uint64_t low;
+    uint32_t range;
+    uint8_t cache;
+    uint32_t pending;                 // Bytes waiting for a carry, the cache and 0xFF ones
+    bool started;                     // The first byte is always 0 and not stored
+    uint8_t *out;
+    size_t size;
+    size_t max;
+    bool overflow;
+} Encoder_t;
+
+typedef struct {
+    uint32_t range;
+    uint32_t code;
+    const uint8_t *data;
+    size_t size;
+    size_t pos;
+} Decoder_t;
+
+// A fixed guess of how likely a move is, the encoder and the decoder must agree on it
+static int guess_move(const Chess_position_t *pos, Chess_move_t move, Bitboard_t pawn_attacks, int last_to)
+{
+    int from = MOVE_FROM(move), to = MOVE_TO(move);
+    int flip = pos->side_to_move == SIDE_WHITE ? 0 : 56;
+    Piece_type_t type = position_piece_at(pos, from);
+    int score = evaluate_piece_square(type, to ^ flip) - evaluate_piece_square(type, from ^ flip);
+    if (MOVE_IS_CAPTURE(move)) {
+        Piece_type_t victim = MOVE_FLAGS(move) == MOVE_FLAG_EN_PASSANT ? PIECE_PAWN : position_piece_at(pos, to);
+        score += 2 * piece_values[victim] - piece_values[type] / 4 + (to == last_to ? 200 : 0);
+    }
+    if (MOVE_IS_PROMOTION(move)) {
+        score += MOVE_PROMOTION_PIECE(move) == PIECE_QUEEN ? 800 : -800;
+    }
+    if (pawn_attacks & BB_SQUARE(to)) {
+        score -= piece_values[type] / 2;
+    }
+    return score;
+}
+
+// Score every legal move, returns the number of moves
+static int score_moves(const Chess_position_t *pos, int last_to, Move_list_t *list, int16_t scores[MAX_MOVES])
+{
+    Side_t them = !pos->side_to_move;
+    Bitboard_t pawns = position_bb(pos, them, PIECE_PAWN), pawn_attacks = 0;
+    while (pawns) {
+        pawn_attacks |= pawn_attack_table[them][bb_pop_lsb(&pawns)];
+    }
+    generate_legal_moves(pos, list);
+    for (int i = 0; i < list->count; i++) {
+        scores[i] = (int16_t)guess_move(pos, list->moves[i], pawn_attacks, last_to);
+    }
+    return list->count;
+}
+
+// Higher scores first, ties by move value so the order is total
+static bool sorts_before(int score_a, Chess_move_t a, int score_b, Chess_move_t b)
+{
+    return score_a > score_b || (score_a == score_b && a < b);
+}
+
+static void model_init(Rank_model_t *model)
+{
+    for (int i = 0; i < RANK_UNARY; i++) {
+        model->unary[0][i] = PROB_ONE / 2;
+        model->unary[1][i] = PROB_ONE / 2;
+    }
+    for (int i = 0; i < 256; i++) {
+        model->tail[i] = PROB_ONE / 2;
+    }
+}
+
+static void put_byte(Encoder_t *enc, uint8_t byte)
+{
+    if (!enc->started) {
+        enc->started = true;
+        return;
+    }
+    if (enc->size == enc->max) {
+        enc->overflow = true;
+        return;
+    }
+    enc->out[enc->size++] = byte;
+}
+
+static void shift_low(Encoder_t *enc)
+{
+    if ((uint32_t)enc->low < 0xFF000000u || (enc->low >> 32) != 0) {
+        uint8_t carry = (uint8_t)(enc->low >> 32);
+        uint8_t byte = enc->cache;
+        do {
+            put_byte(enc, (uint8_t)(byte + carry));
+            byte = 0xFF;
+        } while (--enc->pending != 0);
+        enc->cache = (uint8_t)(enc->low >> 24);
+    }
+    enc->pending++;
+    enc->low = (enc->low & 0x00FFFFFFu) << 8;
+}
+
+static void encode_bit(Encoder_t *enc, uint16_t *prob, int bit)
+{
+    uint32_t bound = (enc->range >> PROB_BITS) * *prob;
+    if (!bit) {
+        enc->range = bound;
+        *prob += (PROB_ONE - *prob) >> PROB_SHIFT;
+    } else {
+        enc->low += bound;
+        enc->range -= bound;
+        *prob -= *prob >> PROB_SHIFT;
+    }
+    while (enc->range < RANGE_TOP) {
+        enc->range <<= 8;
+        shift_low(enc);
+    }
+}
+
+static void encode_rank(Encoder_t *enc, Rank_model_t *model, int context, int rank)
+{
+    for (int i = 0; i < RANK_UNARY; i++) {
+        encode_bit(enc, &model->unary[context][i], rank > i);
+        if (rank == i) {
+            return;
+        }
+    }
+    int tail = rank - RANK_UNARY, node = 1;
+    for (int bit = 7; bit >= 0; bit--) {
+        int value = tail >> bit & 1;
+        encode_bit(enc, &model->tail[node], value);
+        node = node << 1 | value;
+    }
+}
+
+// Trailing zero bytes are dropped, the decoder reads zeros past the end
+static void encoder_flush(Encoder_t *enc)
+{
+    for (int i = 0; i < 5; i++) {
+        shift_low(enc);
+    }
+    while (enc->size > 0 && enc->out[enc->size - 1] == 0) {
+        enc->size--;
+    }
+}
+
+static uint8_t next_byte(Decoder_t *dec)
+{
+    return dec->pos < dec->size ? dec->data[dec->pos++] : 0;
+}
+
+static void decoder_init(Decoder_t *dec, const uint8_t *data, size_t size)
+{
+    dec->data = data;
+    dec->size = size;
+    dec->pos = 0;
+    dec->range = 0xFFFFFFFFu;
+    dec->code = 0;
+    for (int i = 0; i < 4; i++) {
+        dec->code = dec->code << 8 | next_byte(dec);
+    }
+}
+
+static int decode_bit(Decoder_t *dec, uint16_t *prob)
+{
+    uint32_t bound = (dec->range >> PROB_BITS) * *prob;
+    int bit;
+    if (dec->code < bound) {
+        dec->range = bound;
+        *prob += (PROB_ONE - *prob) >> PROB_SHIFT;
+        bit = 0;
+    } else {
+        dec->code -= bound;
+        dec->range -= bound;
+        *prob -= *prob >> PROB_SHIFT;
+        bit = 1;
+    }
+    while (dec->range < RANGE_TOP) {
+        dec->range <<= 8;
+        dec->code = dec->code << 8 | next_byte(dec);
+    }
+    return bit;
+}
+
+static int decode_rank(Decoder_t *dec, Rank_model_t *model, int context)
+{
+    for (int i = 0; i < RANK_UNARY; i++) {
+        if (!decode_bit(dec, &model->unary[context][i])) {
+            return i;
+        }
+    }
+    int node = 1;
+    while (node < 256) {
+        node = node << 1 | decode_bit(dec, &model->tail[node]);
+    }
+    return RANK_UNARY + node - 256;
+}
+
+size_t archive_encode(const Game_record_t *record, Archive_result_t result, uint32_t date, uint8_t *out, size_t max)
+{
+    if (max > ARCHIVE_GAME_MAX) {
+        max = ARCHIVE_GAME_MAX;
+    }
+    if (max < ARCHIVE_GAME_HEADER_SIZE + POSITION_PACK_SIZE || record->count > UINT16_MAX) {
+        return 0;
+    }
+    Chess_position_t start;
+    position_set_start(&start);
+    bool custom_start = record->start.key != start.key;
+    size_t size = ARCHIVE_GAME_HEADER_SIZE;
+    if (custom_start) {
+        position_pack(&record->start, out + size);
+        size += POSITION_PACK_SIZE;
+    }
+
+    Rank_model_t model;
+    Encoder_t enc = {.range = 0xFFFFFFFFu, .pending = 1, .out = out + size, .max = max - size};
+    Chess_position_t pos = record->start;
+    uint64_t opening_key = pos.key;
+    Game_record_iter_t iter;
+    Chess_move_t move;
+    Move_list_t list;
+    int16_t scores[MAX_MOVES];
+    int last_to = SQUARE_NONE, context = 0;
+    model_init(&model);
+    game_record_iter_init(record, &iter);
+    for (uint32_t ply = 0; game_record_next(record, &iter, &move); ply++) {
+        int count = score_moves(&pos, last_to, &list, scores);
+        int index = -1, rank = 0;
+        for (int i = 0; i < count; i++) {
+            if (list.moves[i] == move) {
+                index = i;
+            }
+        }
+        if (index < 0) {
+            return 0;
+        }
+        for (int i = 0; i < count; i++) {
+            rank += sorts_before(scores[i], list.moves[i], scores[index], move);
+        }
+        // A forced move costs nothing
+        if (count > 1) {
+            encode_rank(&enc, &model, context, rank);
+        }
+        context = MOVE_IS_CAPTURE(move) ? 1 : 0;
+        last_to = MOVE_TO(move);
+        make_move(&pos, move);
+        if (ply + 1 == ARCHIVE_OPENING_PLIES) {
+            opening_key = pos.key;
+        }
+    }
+    if (record->count < ARCHIVE_OPENING_PLIES) {
+        opening_key = pos.key;
+    }
+    encoder_flush(&enc);
+    if (enc.overflow) {
+        return 0;
+    }
+    size += enc.size;
+
+    flash_ring_put_u16(out + HEADER_SIZE, (uint16_t)size);
+    flash_ring_put_u16(out + HEADER_PLIES, (uint16_t)record->count);
+    out[HEADER_RESULT] = (uint8_t)result;
+    out[HEADER_FLAGS] = custom_start ? FLAG_CUSTOM_START : 0;
+    flash_ring_put_u32(out + HEADER_DATE, date);
+    flash_ring_put_u64(out + HEADER_OPENING, opening_key);
+    flash_ring_put_u32(out + HEADER_MOVES_CRC,
+                       crc32_update(0, out + ARCHIVE_GAME_HEADER_SIZE, size - ARCHIVE_GAME_HEADER_SIZE));
+    flash_ring_put_u32(out + HEADER_CRC, crc32_update(0, out, HEADER_CRC));
+    return size;
+}
+
+// Check a header and fill its entry, the moves are not read
+static bool parse_header(const uint8_t header[ARCHIVE_GAME_HEADER_SIZE], uint32_t address, Archive_entry_t *entry)
+{
+    uint16_t size = flash_ring_get_u16(header + HEADER_SIZE);
+    if (size == GAME_ERASED || size < ARCHIVE_GAME_HEADER_SIZE || size > ARCHIVE_GAME_MAX ||
+            flash_ring_get_u32(header + HEADER_CRC) != crc32_update(0, header, HEADER_CRC) ||
+            header[HEADER_RESULT] > ARCHIVE_RESULT_DRAW) {
+        return false;
+    }
+    entry->date = flash_ring_get_u32(header + HEADER_DATE);
+    entry->opening_key = flash_ring_get_u64(header + HEADER_OPENING);
+    entry->plies = flash_ring_get_u16(header + HEADER_PLIES);
+    entry->result = header[HEADER_RESULT];
+    entry->custom_start = header[HEADER_FLAGS] & FLAG_CUSTOM_START;
+    entry->address = address;
+    entry->size = size;
+    return true;
+}
+
+bool archive_decode(const uint8_t *data, size_t size, Game_record_t *record, Archive_entry_t *entry)
+{
+    Archive_entry_t header;
+    Chess_position_t pos;
+    size_t offset = ARCHIVE_GAME_HEADER_SIZE;
+    position_set_start(&pos);
+    game_record_init(record, &pos);
+    if (size < ARCHIVE_GAME_HEADER_SIZE || !parse_header(data, 0, &header) || header.size != size ||
+            flash_ring_get_u32(data + HEADER_MOVES_CRC) != crc32_update(0, data + offset, size - offset)) {
+        return false;
+    }
+    if (header.custom_start) {
+        if (size < offset + POSITION_PACK_SIZE || !position_unpack(&pos, data + offset)) {
+            return false;
+        }
+        offset += POSITION_PACK_SIZE;
+        game_record_init(record, &pos);
+    }
+    if (entry) {
+        *entry = header;
+    }
+
+    Rank_model_t model;
+    Decoder_t dec;
+    Move_list_t list;
+    int16_t scores[MAX_MOVES];
+    int last_to = SQUARE_NONE, context = 0;
+    uint64_t opening_key = pos.key;
+    model_init(&model);
+    decoder_init(&dec, data + offset, size - offset);
+    for (int ply = 0; ply < header.plies; ply++) {
+        int count = score_moves(&pos, last_to, &list, scores);
+        int rank = count > 1 ? decode_rank(&dec, &model, context) : 0;
+        if (rank >= count) {
+            return false;
+        }
+        // Selection sort up to the rank, which is almost always small
+        for (int i = 0; i <= rank; i++) {
+            int best = i;
+            for (int j = i + 1; j < count; j++) {
+                if (sorts_before(scores[j], list.moves[j], scores[best], list.moves[best])) {
+                    best = j;
+                }
+            }
+            Chess_move_t move = list.moves[best];
+            int16_t score = scores[best];
+            list.moves[best] = list.moves[i];
+            scores[best] = scores[i];
+            list.moves[i] = move;
+            scores[i] = score;
+        }
+        Chess_move_t move = list.moves[rank];
+        context = MOVE_IS_CAPTURE(move) ? 1 : 0;
+        last_to = MOVE_TO(move);
+        make_move(&pos, move);
+        if (!game_record_append(record, move, pos.key)) {
+            return false;
+        }
+        if (ply + 1 == ARCHIVE_OPENING_PLIES) {
+            opening_key = pos.key;
+        }
+    }
+    if (header.plies < ARCHIVE_OPENING_PLIES) {
+        opening_key = pos.key;
+    }
+    return opening_key == header.opening_key;
+}
+
+static bool read_game_header(const Archive_t *archive, uint32_t sector, uint32_t offset, Archive_entry_t *entry)
+{
+    uint8_t header[ARCHIVE_GAME_HEADER_SIZE];
+    uint32_t address = sector * FLASH_RING_SECTOR_SIZE + offset;
+    return offset + ARCHIVE_GAME_HEADER_SIZE <= FLASH_RING_SECTOR_SIZE &&
+           archive->flash.read(archive->flash.ctx, address, header, sizeof(header)) == ESP_OK &&
+           parse_header(header, address, entry) && offset + entry->size <= FLASH_RING_SECTOR_SIZE;
+}
+
+void archive_init(Archive_t *archive, const Flash_ring_io_t *flash)
+{
+    memset(archive, 0, sizeof(*archive));
+    archive->flash = *flash;
+    archive->sector = flash_ring_sector_count(&archive->flash) - 1;   // The first game goes to sector 0
+    archive->needs_sector = true;
+
+    bool found = false;
+    for (uint32_t sector = 0; sector < flash_ring_sector_count(&archive->flash); sector++) {
+        uint32_t sequence;
+        if (flash_ring_read_header(&archive->flash, sector, ARCHIVE_MAGIC, &sequence) &&
+                (!found || flash_ring_sequence_after(sequence, archive->sequence))) {
+            found = true;
+            archive->sector = sector;
+            archive->sequence = sequence;
+        }
+    }
+    if (!found) {
+        return;
+    }
+
+    // Games go on after the last one, unless something torn follows it
+    Archive_entry_t entry;
+    uint32_t offset = ARCHIVE_SECTOR_HEADER_SIZE;
+    while (read_game_header(archive, archive->sector, offset, &entry)) {
+        offset += entry.size;
+    }
+    archive->offset = offset;
+    archive->needs_sector = !flash_ring_is_erased(&archive->flash, archive->sector, offset);
+}
+
+// Erase the oldest sector and start it with its header
+static esp_err_t open_sector(Archive_t *archive)
+{
+    uint32_t sector = (archive->sector + 1) % flash_ring_sector_count(&archive->flash);
+    uint32_t sequence = archive->sequence + 1;
+
+    esp_err_t err = archive->flash.erase_sector(archive->flash.ctx, sector * FLASH_RING_SECTOR_SIZE);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = flash_ring_write_header(&archive->flash, sector, ARCHIVE_MAGIC, sequence);
+    if (err != ESP_OK) {
+        return err;
+    }
+    archive->sector = sector;
+    archive->sequence = sequence;
+    archive->offset = ARCHIVE_SECTOR_HEADER_SIZE;
+    archive->needs_sector = false;
+    return ESP_OK;
+}
+
+esp_err_t archive_write(Archive_t *archive, const uint8_t *game, size_t size)
+{
+    if (size < ARCHIVE_GAME_HEADER_SIZE || size > ARCHIVE_GAME_MAX) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    esp_err_t err = ESP_OK;
+    if (archive->needs_sector || archive->offset + size > FLASH_RING_SECTOR_SIZE) {
+        err = open_sector(archive);
+    }
+
+    // The header goes last, a game torn before it is complete is never listed
+    uint32_t address = archive->sector * FLASH_RING_SECTOR_SIZE + archive->offset;
+    if (err == ESP_OK && size > ARCHIVE_GAME_HEADER_SIZE) {
+        err = archive->flash.write(archive->flash.ctx, address + ARCHIVE_GAME_HEADER_SIZE,
+                                   game + ARCHIVE_GAME_HEADER_SIZE, size - ARCHIVE_GAME_HEADER_SIZE);
+    }
+    if (err == ESP_OK) {
+        err = archive->flash.write(archive->flash.ctx, address, game, ARCHIVE_GAME_HEADER_SIZE);
+    }
+    if (err != ESP_OK) {
+        // Whatever reached the flash may be torn, the next game starts a new sector
+        archive->needs_sector = true;
+        return err;
+    }
+    archive->offset += size;
+    return ESP_OK;
+}
+
+esp_err_t archive_append(Archive_t *archive, const Game_record_t *record, Archive_result_t result, uint32_t date)
+{
+    size_t size = archive_encode(record, result, date, archive->buffer, sizeof(archive->buffer));
+    if (size == 0) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    return archive_write(archive, archive->buffer, size);
+}
+
+void archive_iter_init(const Archive_t *archive, Archive_iter_t *iter)
+{
+    iter->sectors_left = flash_ring_sector_count(&archive->flash);
+    iter->sector = (archive->sector + 1) % flash_ring_sector_count(&archive->flash);
+    iter->offset = 0;
+}
+
+bool archive_next(const Archive_t *archive, Archive_iter_t *iter, Archive_entry_t *entry)
+{
+    while (iter->sectors_left > 0) {
+        uint32_t sequence;
+        if (iter->offset == 0 && flash_ring_read_header(&archive->flash, iter->sector, ARCHIVE_MAGIC, &sequence)) {
+            iter->offset = ARCHIVE_SECTOR_HEADER_SIZE;
+        }
+        if (iter->offset != 0 && read_game_header(archive, iter->sector, iter->offset, entry)) {
+            iter->offset += entry->size;
+            return true;
+        }
+        iter->sector = (iter->sector + 1) % flash_ring_sector_count(&archive->flash);
+        iter->sectors_left--;
+        iter->offset = 0;
+    }
+    return false;
+}
+
+esp_err_t archive_load(Archive_t *archive, const Archive_entry_t *entry, Game_record_t *record)
+{
+    if (entry->size > sizeof(archive->buffer)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    esp_err_t err = archive->flash.read(archive->flash.ctx, entry->address, archive->buffer, entry->size);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (!archive_decode(archive->buffer, entry->size, record, NULL)) {
+        game_record_clear(record);
+        return ESP_ERR_INVALID_CRC;
+    }
+    return ESP_OK;
+}
+
+Archive_result_t archive_result_from_pgn(const char *pgn_result)
+{
+    if (strcmp(pgn_result, "1-0") == 0) {
+        return ARCHIVE_RESULT_WHITE_WINS;
+    }
+    if (strcmp(pgn_result, "0-1") == 0) {
+        return ARCHIVE_RESULT_BLACK_WINS;
+    }
+    if (strcmp(pgn_result, "1/2-1/2") == 0) {
+        return ARCHIVE_RESULT_DRAW;
+    }
+    return ARCHIVE_RESULT_UNFINISHED;
+}
+
+const char *archive_result_pgn(Archive_result_t result)
+{
+    static const char *const names[] = {
+        [ARCHIVE_RESULT_UNFINISHED] = "*",
+        [ARCHIVE_RESULT_WHITE_WINS] = "1-0",
+        [ARCHIVE_RESULT_BLACK_WINS] = "0-1",
+        [ARCHIVE_RESULT_DRAW] = "1/2-1/2",
+    };
+    return result <= ARCHIVE_RESULT_DRAW ? names[result] : "*";
+}
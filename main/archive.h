@@ -0,0 +1,186 @@
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "position.h"
+#include "moves.h"
+#include "game_record.h"
+#include "flash_ring.h"
+
+#define ARCHIVE_PARTITION_LABEL "archive"
+#define ARCHIVE_PARTITION_SUBTYPE 0x44
+#define ARCHIVE_OPENING_PLIES 10     // The opening key is the position after this many plies
+#define ARCHIVE_SECTOR_HEADER_SIZE FLASH_RING_HEADER_SIZE
+#define ARCHIVE_GAME_HEADER_SIZE 26
+#define ARCHIVE_GAME_MAX (FLASH_RING_SECTOR_SIZE - ARCHIVE_SECTOR_HEADER_SIZE)   // Header and moves of one game
+
+/**
+ * @brief How an archived game ended
+ *
+ */
+typedef enum {
+    ARCHIVE_RESULT_UNFINISHED = 0,
+    ARCHIVE_RESULT_WHITE_WINS,
+    ARCHIVE_RESULT_BLACK_WINS,
+    ARCHIVE_RESULT_DRAW,
+} Archive_result_t;
+
+/**
+ * @brief Index entry of an archived game, read without its moves
+ *
+ */
+typedef struct {
+    uint32_t date;            // Seconds since 1970, 0 if the board's clock was not set
+    uint64_t opening_key;     // Key after ARCHIVE_OPENING_PLIES plies, or of the final position of a shorter game
+    uint16_t plies;
+    uint8_t result;           // Archive_result_t
+    bool custom_start;        // Not from the initial position
+    uint32_t address;         // Of the game in the archive area, for archive_load()
+    uint16_t size;            // Header and moves
+} Archive_entry_t;
+
+/**
+ * @brief Finished games in a ring of flash sectors
+ *
+ * Each game is stored as a 26-byte header followed by its moves, a game
+ * never spans two sectors. A move is stored as its rank in the legal moves
+ * of its position, sorted by a fixed guess of how likely each one is
+ * (captures of valuable pieces, promotions, then piece-square gains). The
+ * move played is usually among the first few, and an adaptive binary range
+ * coder turns those small ranks into about half a byte per ply.
+ *
+ * The headers hold the index, so listing and searching only read 26 bytes
+ * per game. When the area is full the oldest sector is erased. The same
+ * flash access as the journal is used, and each game is written moves
+ * first and header last, so a game torn by a reset is never listed.
+ */
+typedef struct {
+    Flash_ring_io_t flash;
+    uint32_t sector;          // Sector being written
+    uint32_t sequence;        // Sequence number of that sector
+    uint32_t offset;          // Next free byte in that sector
+    bool needs_sector;        // The next game starts a new sector
+    uint8_t buffer[ARCHIVE_GAME_MAX];
+} Archive_t;
+
+/**
+ * @brief Walks the archived games, oldest first
+ *
+ */
+typedef struct {
+    uint32_t sectors_left;
+    uint32_t sector;
+    uint32_t offset;          // Of the next game in the sector, 0 before its header is read
+} Archive_iter_t;
+
+/**
+ * @brief Attach an archive to its flash and find where the next game goes
+ *
+ * @param archive The archive
+ * @param flash The flash access, copied
+ */
+void archive_init(Archive_t *archive, const Flash_ring_io_t *flash);
+
+/**
+ * @brief Encode a game as it is stored, header included
+ *
+ * @param record The game
+ * @param result How it ended
+ * @param date Seconds since 1970, 0 if unknown
+ * @param out The encoded game
+ * @param max Room in out, ARCHIVE_GAME_MAX at most is used
+ * @return size_t Size of the encoded game, 0 if it does not fit or a move is not legal
+ */
+size_t archive_encode(const Game_record_t *record, Archive_result_t result, uint32_t date, uint8_t *out, size_t max);
+
+/**
+ * @brief Decode a game encoded by archive_encode()
+ *
+ * @param data The encoded game
+ * @param size Its size
+ * @param record Initialized with the game, must not hold chunks, holds the moves decoded so far on failure
+ * @param entry Filled with its header, may be NULL
+ * @return true if the CRCs match and every move decodes to a legal one
+ */
+bool archive_decode(const uint8_t *data, size_t size, Game_record_t *record, Archive_entry_t *entry);
+
+/**
+ * @brief Write an encoded game after the newest one
+ *
+ * @param archive The archive
+ * @param game The encoded game
+ * @param size Its size
+ * @return esp_err_t ESP_OK, ESP_ERR_INVALID_SIZE if it is too long, or the flash error
+ */
+esp_err_t archive_write(Archive_t *archive, const uint8_t *game, size_t size);
+
+/**
+ * @brief Encode and write a game
+ *
+ * @param archive The archive, its buffer holds the encoding
+ * @param record The game
+ * @param result How it ended
+ * @param date Seconds since 1970, 0 if unknown
+ * @return esp_err_t ESP_OK, ESP_ERR_INVALID_SIZE if it is too long, or the flash error
+ */
+esp_err_t archive_append(Archive_t *archive, const Game_record_t *record, Archive_result_t result, uint32_t date);
+
+/**
+ * @brief Start walking the archive
+ *
+ * @param archive The archive
+ * @param iter The iterator to initialize
+ */
+void archive_iter_init(const Archive_t *archive, Archive_iter_t *iter);
+
+/**
+ * @brief Read the header of the next game
+ *
+ * Only the header is read. Searching by date, result or opening is a walk
+ * comparing the entries.
+ *
+ * @param archive The archive
+ * @param iter The iterator
+ * @param entry Filled with the header
+ * @return true if there was a game, false at the end of the archive
+ */
+bool archive_next(const Archive_t *archive, Archive_iter_t *iter, Archive_entry_t *entry);
+
+/**
+ * @brief Read and decode a listed game
+ *
+ * @param archive The archive, its buffer holds the game read
+ * @param entry The game, from archive_next()
+ * @param record Initialized with the game, must not hold chunks
+ * @return esp_err_t ESP_OK, ESP_ERR_INVALID_CRC if the game is damaged, or the flash error
+ */
+esp_err_t archive_load(Archive_t *archive, const Archive_entry_t *entry, Game_record_t *record);
+
+/**
+ * @brief Get the result of a game from its PGN result
+ *
+ * @param pgn_result "1-0", "0-1", "1/2-1/2" or anything else for a game not finished
+ * @return Archive_result_t The result
+ */
+Archive_result_t archive_result_from_pgn(const char *pgn_result);
+
+/**
+ * @brief Get the PGN result of a game
+ *
+ * @param result The result
+ * @return const char* "1-0", "0-1", "1/2-1/2" or "*"
+ */
+const char *archive_result_pgn(Archive_result_t result);
+
+/**
+ * @brief Open the archive partition
+ *
+ * @param flash Set to access the partition
+ * @return esp_err_t ESP_OK, or ESP_ERR_NOT_FOUND without an archive partition
+ */
+esp_err_t archive_open_partition(Flash_ring_io_t *flash);
+
+#endif
@@ -0,0 +1,87 @@
+#include <string.h>
+#include "bitbase.h"
+
+#define KPK_PAWNS 24
+#define TRIANGLE_SQUARES 10
+
+bool bitbase_open_memory(Bitbase_t *bitbase, const void *data, size_t size)
+{
+    memset(bitbase, 0, sizeof(*bitbase));
+    if (size < BITBASE_SIZE || memcmp(data, BITBASE_MAGIC, strlen(BITBASE_MAGIC)) != 0) {
+        return false;
+    }
+    const uint8_t *table = (const uint8_t *)data + BITBASE_HEADER_SIZE;
+    bitbase->tables[BITBASE_KPK] = table;
+    bitbase->tables[BITBASE_KRK] = table + BITBASE_KPK_BITS / 8;
+    bitbase->tables[BITBASE_KQK] = table + (BITBASE_KPK_BITS + BITBASE_PIECE_BITS) / 8;
+    return true;
+}
+
+static inline int transpose(int sq)
+{
+    return SQUARE(SQUARE_FILE(sq), SQUARE_RANK(sq));
+}
+
+int bitbase_index(Bitbase_ending_t ending, Side_t side_to_move, int strong_king, int weak_king, int piece)
+{
+    if (ending == BITBASE_KPK) {
+        // Mirror the pawn onto files a-d, it only stands on ranks 2-7
+        if (SQUARE_FILE(piece) > 3) {
+            strong_king ^= 7;
+            weak_king ^= 7;
+            piece ^= 7;
+        }
+        int pawn = (SQUARE_RANK(piece) - 1) * 4 + SQUARE_FILE(piece);
+        return ((side_to_move * KPK_PAWNS + pawn) * 64 + strong_king) * 64 + weak_king;
+    }
+
+    // Without pawns every board symmetry works, move the strong king to a1-d1-d4
+    if (SQUARE_FILE(strong_king) > 3) {
+        strong_king ^= 7;
+        weak_king ^= 7;
+        piece ^= 7;
+    }
+    if (SQUARE_RANK(strong_king) > 3) {
+        strong_king ^= 56;
+        weak_king ^= 56;
+        piece ^= 56;
+    }
+    if (SQUARE_RANK(strong_king) > SQUARE_FILE(strong_king)) {
+        strong_king = transpose(strong_king);
+        weak_king = transpose(weak_king);
+        piece = transpose(piece);
+    }
+    static const int8_t triangle_rank_start[4] = {0, 4, 7, 9};
+    int king = triangle_rank_start[SQUARE_RANK(strong_king)] + SQUARE_FILE(strong_king) - SQUARE_RANK(strong_king);
+    return ((side_to_move * TRIANGLE_SQUARES + king) * 64 + weak_king) * 64 + piece;
+}
+
+Bitbase_result_t bitbase_probe(const Bitbase_t *bitbase, const Chess_position_t *pos)
+{
+    Bitboard_t occupied = position_occupied(pos);
+    if (bb_popcount(occupied) != 3 || pos->castling) {
+        return BITBASE_NONE;
+    }
+    int piece = bb_lsb(occupied & ~pos->pieces[PIECE_KING]);
+    Bitbase_ending_t ending;
+    switch (position_piece_at(pos, piece)) {
+    case PIECE_PAWN: ending = BITBASE_KPK; break;
+    case PIECE_ROOK: ending = BITBASE_KRK; break;
+    case PIECE_QUEEN: ending = BITBASE_KQK; break;
+    default: return BITBASE_NONE;
+    }
+    if (!bitbase->tables[ending]) {
+        return BITBASE_NONE;
+    }
+
+    // Flip the board when black is the strong side
+    Side_t strong = position_side_at(pos, piece);
+    int flip = strong == SIDE_WHITE ? 0 : 56;
+    int index = bitbase_index(ending, pos->side_to_move == strong ? SIDE_WHITE : SIDE_BLACK,
+                              bb_lsb(position_bb(pos, strong, PIECE_KING)) ^ flip,
+                              bb_lsb(position_bb(pos, !strong, PIECE_KING)) ^ flip, piece ^ flip);
+    if (!(bitbase->tables[ending][index >> 3] & (1 << (index & 7)))) {
+        return BITBASE_DRAW;
+    }
+    return pos->side_to_move == strong ? BITBASE_WIN : BITBASE_LOSS;
+}
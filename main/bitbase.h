@@ -0,0 +1,91 @@
+#ifndef BITBASE_H
+#define BITBASE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "position.h"
+
+#define BITBASE_PARTITION_LABEL "bitbase"
+#define BITBASE_PARTITION_SUBTYPE 0x41
+#define BITBASE_MAGIC "CHESSYBB"
+#define BITBASE_HEADER_SIZE 16
+
+// One bit per position, set when the side with the extra piece wins
+#define BITBASE_KPK_BITS (2 * 24 * 64 * 64)    // Side to move, pawn on files a-d, both kings
+#define BITBASE_PIECE_BITS (2 * 10 * 64 * 64)  // Side to move, strong king in a1-d1-d4, weak king, piece
+#define BITBASE_SIZE (BITBASE_HEADER_SIZE + (BITBASE_KPK_BITS + 2 * BITBASE_PIECE_BITS) / 8)
+
+typedef enum {
+    BITBASE_KPK = 0,
+    BITBASE_KRK,
+    BITBASE_KQK,
+    BITBASE_ENDING_NB,
+} Bitbase_ending_t;
+
+/**
+ * @brief Probe result, for the side to move
+ *
+ */
+typedef enum {
+    BITBASE_NONE = 0,   // Not a bitbase ending
+    BITBASE_LOSS,
+    BITBASE_DRAW,
+    BITBASE_WIN,
+} Bitbase_result_t;
+
+/**
+ * @brief Win/draw bitbases of KPK, KRK and KQK
+ *
+ * The tables are stored with the strong side as white and reduced by
+ * symmetry: files for KPK, the eight board symmetries otherwise.
+ */
+typedef struct {
+    const uint8_t *tables[BITBASE_ENDING_NB];
+} Bitbase_t;
+
+/**
+ * @brief Use a memory region holding a bitbase image
+ *
+ * @param bitbase The bitbase, empty if the image is not valid
+ * @param data Start of the image
+ * @param size Size of the region
+ * @return true if the image is valid
+ */
+bool bitbase_open_memory(Bitbase_t *bitbase, const void *data, size_t size);
+
+/**
+ * @brief Map the bitbase partition into the data address space
+ *
+ * @param bitbase The bitbase, empty on failure
+ * @return esp_err_t ESP_OK, ESP_ERR_NOT_FOUND without a partition, ESP_ERR_INVALID_VERSION
+ *                   if it holds no valid image, or an mmap error
+ */
+esp_err_t bitbase_open_partition(Bitbase_t *bitbase);
+
+/**
+ * @brief Bit index of a position with white as the strong side
+ *
+ * @param ending The ending
+ * @param side_to_move The side to move
+ * @param strong_king Square of the white king
+ * @param weak_king Square of the black king
+ * @param piece Square of the white pawn, rook or queen
+ * @return int Index in the ending's table
+ */
+int bitbase_index(Bitbase_ending_t ending, Side_t side_to_move, int strong_king, int weak_king, int piece);
+
+/**
+ * @brief Look a position up
+ *
+ * Works for either color as the strong side. Positions with castling rights
+ * are not covered.
+ *
+ * @param bitbase The bitbase
+ * @param pos The position, it must be legal
+ * @return Bitbase_result_t The result for the side to move, BITBASE_NONE if not covered
+ */
+Bitbase_result_t bitbase_probe(const Bitbase_t *bitbase, const Chess_position_t *pos);
+
+#endif
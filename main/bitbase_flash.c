@@ -0,0 +1,30 @@
+#include <string.h>
+#include "esp_partition.h"
+#include "esp_log.h"
+#include "bitbase.h"
+
+static const char *TAG = "BITBASE";
+
+esp_err_t bitbase_open_partition(Bitbase_t *bitbase)
+{
+    static esp_partition_mmap_handle_t handle;
+    const void *data;
+
+    memset(bitbase, 0, sizeof(*bitbase));
+    const esp_partition_t *part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, BITBASE_PARTITION_SUBTYPE,
+                                                           BITBASE_PARTITION_LABEL);
+    if (!part) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    // Probes read single bytes through the flash cache
+    esp_err_t err = esp_partition_mmap(part, 0, part->size, ESP_PARTITION_MMAP_DATA, &data, &handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (!bitbase_open_memory(bitbase, data, part->size)) {
+        esp_partition_munmap(handle);
+        return ESP_ERR_INVALID_VERSION;
+    }
+    ESP_LOGI(TAG, "KPK, KRK and KQK bitbases mapped");
+    return ESP_OK;
+}
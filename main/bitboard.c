@@ -0,0 +1,105 @@
+#include <stdbool.h>
+#include "bitboard.h"
+
+Bitboard_t knight_attack_table[SQUARE_NB];
+Bitboard_t king_attack_table[SQUARE_NB];
+Bitboard_t pawn_attack_table[2][SQUARE_NB];
+Bitboard_t diagonal_mask_table[SQUARE_NB];
+Bitboard_t anti_diagonal_mask_table[SQUARE_NB];
+Bitboard_t fill_up_attack_table[8][64];
+Bitboard_t a_file_attack_table[8][64];
+
+static bool is_valid_square(int rank, int file)
+{
+    return rank >= 0 && rank < 8 && file >= 0 && file < 8;
+}
+
+static Bitboard_t step_attacks(int sq, const int *dr, const int *df, int count)
+{
+    Bitboard_t attacks = 0;
+    for (int i = 0; i < count; i++) {
+        int rank = SQUARE_RANK(sq) + dr[i];
+        int file = SQUARE_FILE(sq) + df[i];
+        if (is_valid_square(rank, file)) {
+            attacks |= BB_SQUARE(SQUARE(rank, file));
+        }
+    }
+    return attacks;
+}
+
+static Bitboard_t ray_mask(int sq, int dr, int df)
+{
+    Bitboard_t mask = 0;
+    for (int rank = SQUARE_RANK(sq) + dr, file = SQUARE_FILE(sq) + df;
+            is_valid_square(rank, file); rank += dr, file += df) {
+        mask |= BB_SQUARE(SQUARE(rank, file));
+    }
+    return mask;
+}
+
+// Attacks along a single line of 8 squares given the occupied bits of that line
+static uint8_t line_attacks(int pos, uint8_t occ)
+{
+    uint8_t attacks = 0;
+    for (int i = pos + 1; i < 8; i++) {
+        attacks |= 1 << i;
+        if (occ & (1 << i)) {
+            break;
+        }
+    }
+    for (int i = pos - 1; i >= 0; i--) {
+        attacks |= 1 << i;
+        if (occ & (1 << i)) {
+            break;
+        }
+    }
+    return attacks;
+}
+
+void bitboard_init(void)
+{
+    static bool initialized = false;
+    if (initialized) {
+        return;
+    }
+
+    const int knight_dr[] = {2, 2, -2, -2, 1, 1, -1, -1};
+    const int knight_df[] = {1, -1, 1, -1, 2, -2, 2, -2};
+    const int king_dr[] = {-1, -1, -1, 0, 0, 1, 1, 1};
+    const int king_df[] = {-1, 0, 1, -1, 1, -1, 0, 1};
+    const int pawn_dr[2][2] = {{1, 1}, {-1, -1}};
+    const int pawn_df[] = {-1, 1};
+
+    for (int sq = 0; sq < SQUARE_NB; sq++) {
+        knight_attack_table[sq] = step_attacks(sq, knight_dr, knight_df, 8);
+        king_attack_table[sq] = step_attacks(sq, king_dr, king_df, 8);
+        pawn_attack_table[0][sq] = step_attacks(sq, pawn_dr[0], pawn_df, 2);
+        pawn_attack_table[1][sq] = step_attacks(sq, pawn_dr[1], pawn_df, 2);
+        diagonal_mask_table[sq] = ray_mask(sq, 1, 1) | ray_mask(sq, -1, -1);
+        anti_diagonal_mask_table[sq] = ray_mask(sq, 1, -1) | ray_mask(sq, -1, 1);
+    }
+
+    for (int pos = 0; pos < 8; pos++) {
+        for (int idx = 0; idx < 64; idx++) {
+            // The 6-bit index holds the inner squares of the line, the edges never block
+            uint8_t attacks = line_attacks(pos, (uint8_t)(idx << 1));
+            fill_up_attack_table[pos][idx] = attacks * BB_FILE_A;
+
+            // Spread the same pattern over the a-file and let the lookup compute its index
+            Bitboard_t occ = 0;
+            Bitboard_t file_attacks = 0;
+            for (int rank = 0; rank < 8; rank++) {
+                if ((idx << 1) & (1 << rank)) {
+                    occ |= BB_SQUARE(SQUARE(rank, 0));
+                }
+                if (attacks & (1 << rank)) {
+                    file_attacks |= BB_SQUARE(SQUARE(rank, 0));
+                }
+            }
+            unsigned file_idx = (unsigned)((occ * 0x0004081020408000ULL) >> 58);
+            a_file_attack_table[pos][file_idx] = file_attacks;
+        }
+    }
+
+    initialized = true;
+}
@@ -0,0 +1,103 @@
+#ifndef BITBOARD_H
+#define BITBOARD_H
+
+#include <stdint.h>
+
+/**
+ * @brief A set of squares, one bit per square
+ *
+ * Bit index is rank * 8 + file, so bit 0 is a1 and bit 63 is h8. The rank
+ * is the row index of the char board (row 0 holds the white pieces) and the
+ * file is its column index.
+ */
+typedef uint64_t Bitboard_t;
+
+#define SQUARE_NB 64
+#define SQUARE_NONE 64
+
+#define SQUARE(rank, file) ((rank) * 8 + (file))
+#define SQUARE_RANK(sq) ((sq) >> 3)
+#define SQUARE_FILE(sq) ((sq) & 7)
+#define BB_SQUARE(sq) (1ULL << (sq))
+
+#define BB_FILE_A 0x0101010101010101ULL
+#define BB_FILE_H 0x8080808080808080ULL
+#define BB_RANK_1 0x00000000000000FFULL
+#define BB_RANK_8 0xFF00000000000000ULL
+
+/**
+ * @brief Precomputed attack tables, filled by bitboard_init()
+ *
+ */
+extern Bitboard_t knight_attack_table[SQUARE_NB];
+extern Bitboard_t king_attack_table[SQUARE_NB];
+extern Bitboard_t pawn_attack_table[2][SQUARE_NB];
+extern Bitboard_t diagonal_mask_table[SQUARE_NB];
+extern Bitboard_t anti_diagonal_mask_table[SQUARE_NB];
+extern Bitboard_t fill_up_attack_table[8][64];
+extern Bitboard_t a_file_attack_table[8][64];
+
+/**
+ * @brief Build the attack tables, safe to call more than once
+ *
+ */
+void bitboard_init(void);
+
+static inline int bb_popcount(Bitboard_t bb)
+{
+    return __builtin_popcountll(bb);
+}
+
+static inline int bb_lsb(Bitboard_t bb)
+{
+    return __builtin_ctzll(bb);
+}
+
+static inline int bb_pop_lsb(Bitboard_t *bb)
+{
+    int sq = __builtin_ctzll(*bb);
+    *bb &= *bb - 1;
+    return sq;
+}
+
+/*
+ * Slider lookups use kindergarten bitboards: the occupancy along a line is
+ * gathered into a 6-bit index with one multiply (a software PEXT) and looked
+ * up in 8x64 tables. The tables take 8 KB instead of the ~800 KB of fancy
+ * magics, which matters on a chip with 512 KB of SRAM and no PEXT.
+ */
+static inline Bitboard_t bb_line_attacks(int sq, Bitboard_t occ, Bitboard_t mask)
+{
+    unsigned idx = (unsigned)(((occ & mask) * 0x0202020202020202ULL) >> 58);
+    return mask & fill_up_attack_table[SQUARE_FILE(sq)][idx];
+}
+
+static inline Bitboard_t bb_rank_attacks(int sq, Bitboard_t occ)
+{
+    return bb_line_attacks(sq, occ, (BB_RANK_1 << (sq & 56)) ^ BB_SQUARE(sq));
+}
+
+static inline Bitboard_t bb_file_attacks(int sq, Bitboard_t occ)
+{
+    occ = BB_FILE_A & (occ >> SQUARE_FILE(sq));
+    unsigned idx = (unsigned)((occ * 0x0004081020408000ULL) >> 58);
+    return a_file_attack_table[SQUARE_RANK(sq)][idx] << SQUARE_FILE(sq);
+}
+
+static inline Bitboard_t bb_bishop_attacks(int sq, Bitboard_t occ)
+{
+    return bb_line_attacks(sq, occ, diagonal_mask_table[sq]) |
+           bb_line_attacks(sq, occ, anti_diagonal_mask_table[sq]);
+}
+
+static inline Bitboard_t bb_rook_attacks(int sq, Bitboard_t occ)
+{
+    return bb_rank_attacks(sq, occ) | bb_file_attacks(sq, occ);
+}
+
+static inline Bitboard_t bb_queen_attacks(int sq, Bitboard_t occ)
+{
+    return bb_bishop_attacks(sq, occ) | bb_rook_attacks(sq, occ);
+}
+
+#endif
@@ -1,20 +1,17 @@
 #include <stdio.h>
-#include <string.h>
 #include "board.h"
 
-void init_board(char board[8][8])
+void init_board(Chess_position_t *pos, char board[8][8])
 {
-    char temp[8][8] = {
-        {'R', 'N', 'B', 'Q', 'K', 'B', 'N', 'R'},
-        {'P', 'P', 'P', 'P', 'P', 'P', 'P', 'P'},
-        {' ', ' ', ' ', ' ', ' ', ' ', ' ', ' '},
-        {' ', ' ', ' ', ' ', ' ', ' ', ' ', ' '},
-        {' ', ' ', ' ', ' ', ' ', ' ', ' ', ' '},
-        {' ', ' ', ' ', ' ', ' ', ' ', ' ', ' '},
-        {'p', 'p', 'p', 'p', 'p', 'p', 'p', 'p'},
-        {'r', 'n', 'b', 'q', 'k', 'b', 'n', 'r'}
-    };
-    memcpy(board, temp, sizeof(temp));
+    position_set_start(pos);
+    board_from_position(pos, board);
+}
+
+void board_from_position(const Chess_position_t *pos, char board[8][8])
+{
+    for (int sq = 0; sq < SQUARE_NB; sq++) {
+        board[SQUARE_RANK(sq)][SQUARE_FILE(sq)] = position_char_at(pos, sq);
+    }
 }
 
 void print_board(const char board[8][8])
@@ -1,12 +1,23 @@
 #ifndef BOARD_H
 #define BOARD_H
 
+#include "position.h"
+
 /**
  * @brief Initialize the board to the starting position
  *
- * @param board The board to initialize
+ * @param pos The position to initialize
+ * @param board The char board view to fill from the position
+ */
+void init_board(Chess_position_t *pos, char board[8][8]);
+
+/**
+ * @brief Build the char board view of a position
+ *
+ * @param pos The position
+ * @param board The board to fill, indexed [rank][file]
  */
-void init_board(char board[8][8]);
+void board_from_position(const Chess_position_t *pos, char board[8][8]);
 
 /**
  * @brief Print the board
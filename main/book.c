@@ -0,0 +1,124 @@
+#include "book.h"
+
+#define BOOK_KEY_ERASED UINT64_MAX
+
+static uint64_t read_be(const uint8_t *p, int bytes)
+{
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; i++) {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
+
+static void write_be(uint8_t *p, uint64_t value, int bytes)
+{
+    for (int i = bytes - 1; i >= 0; i--) {
+        p[i] = (uint8_t)value;
+        value >>= 8;
+    }
+}
+
+static uint64_t entry_key(const Opening_book_t *book, size_t index)
+{
+    return read_be(book->data + index * BOOK_ENTRY_SIZE, 8);
+}
+
+// Index of the first entry whose key is not below the given one
+static size_t lower_bound(const Opening_book_t *book, size_t count, uint64_t key)
+{
+    size_t low = 0;
+    while (count > 0) {
+        size_t half = count / 2;
+        if (entry_key(book, low + half) < key) {
+            low += half + 1;
+            count -= half + 1;
+        } else {
+            count = half;
+        }
+    }
+    return low;
+}
+
+void book_open_memory(Opening_book_t *book, const void *data, size_t size)
+{
+    book->data = data;
+    book->size = size;
+    book->count = size / BOOK_ENTRY_SIZE;
+    // Erased flash sorts after every real key
+    book->count = lower_bound(book, book->count, BOOK_KEY_ERASED);
+}
+
+void book_read_entry(const Opening_book_t *book, size_t index, Book_entry_t *entry)
+{
+    const uint8_t *p = book->data + index * BOOK_ENTRY_SIZE;
+    entry->key = read_be(p, 8);
+    entry->move = (uint16_t)read_be(p + 8, 2);
+    entry->weight = (uint16_t)read_be(p + 10, 2);
+    entry->learn = (uint32_t)read_be(p + 12, 4);
+}
+
+void book_write_entry(uint8_t *out, const Book_entry_t *entry)
+{
+    write_be(out, entry->key, 8);
+    write_be(out + 8, entry->move, 2);
+    write_be(out + 10, entry->weight, 2);
+    write_be(out + 12, entry->learn, 4);
+}
+
+size_t book_find(const Opening_book_t *book, uint64_t key)
+{
+    size_t index = lower_bound(book, book->count, key);
+    return index < book->count && entry_key(book, index) == key ? index : book->count;
+}
+
+Chess_move_t book_move_to_chess(const Chess_position_t *pos, uint16_t book_move)
+{
+    int to = SQUARE((book_move >> 3) & 7, book_move & 7);
+    int from = SQUARE((book_move >> 9) & 7, (book_move >> 6) & 7);
+    int promotion = (book_move >> 12) & 7;
+
+    // King takes own rook is castling, the king lands two squares away
+    if (position_piece_at(pos, from) == PIECE_KING && (pos->colors[pos->side_to_move] & BB_SQUARE(to))) {
+        to = to > from ? from + 2 : from - 2;
+    }
+    return find_legal_move(pos, from, to, promotion ? (Piece_type_t)(PIECE_KNIGHT + promotion - 1) : PIECE_QUEEN);
+}
+
+uint16_t book_move_from_chess(Chess_move_t move)
+{
+    int from = MOVE_FROM(move);
+    int to = MOVE_TO(move);
+    if (MOVE_FLAGS(move) == MOVE_FLAG_KING_CASTLE) {
+        to = from + 3;
+    } else if (MOVE_FLAGS(move) == MOVE_FLAG_QUEEN_CASTLE) {
+        to = from - 4;
+    }
+    int promotion = MOVE_IS_PROMOTION(move) ? MOVE_PROMOTION_PIECE(move) - PIECE_KNIGHT + 1 : 0;
+    return (uint16_t)(SQUARE_FILE(to) | SQUARE_RANK(to) << 3 | SQUARE_FILE(from) << 6 | SQUARE_RANK(from) << 9 |
+                      promotion << 12);
+}
+
+Chess_move_t book_probe(const Opening_book_t *book, const Chess_position_t *pos, uint32_t random)
+{
+    size_t first = book_find(book, pos->key);
+    uint32_t total = 0;
+    Book_entry_t entry;
+    for (size_t i = first; i < book->count && entry_key(book, i) == pos->key; i++) {
+        book_read_entry(book, i, &entry);
+        total += entry.weight;
+    }
+    if (total == 0) {
+        return MOVE_NONE;
+    }
+
+    uint32_t pick = random % total;
+    for (size_t i = first; i < book->count; i++) {
+        book_read_entry(book, i, &entry);
+        if (pick < entry.weight) {
+            return book_move_to_chess(pos, entry.move);
+        }
+        pick -= entry.weight;
+    }
+    return MOVE_NONE;
+}
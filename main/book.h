@@ -0,0 +1,115 @@
+#ifndef BOOK_H
+#define BOOK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "position.h"
+#include "moves.h"
+
+// Polyglot entries: 16 bytes, big endian, sorted by key
+#define BOOK_ENTRY_SIZE 16
+#define BOOK_PARTITION_LABEL "book"
+#define BOOK_PARTITION_SUBTYPE 0x40
+
+/**
+ * @brief An opening book mapped in memory
+ *
+ * The entries are read in place, from a flash partition on the board or an
+ * mmap()ed file on the host.
+ */
+typedef struct {
+    const uint8_t *data;
+    size_t size;            // Mapped bytes, erased flash included
+    size_t count;           // Number of entries
+} Opening_book_t;
+
+/**
+ * @brief A decoded book entry
+ *
+ */
+typedef struct {
+    uint64_t key;
+    uint16_t move;          // Polyglot encoding, see book_move_to_chess()
+    uint16_t weight;
+    uint32_t learn;
+} Book_entry_t;
+
+/**
+ * @brief Use a memory region as a book
+ *
+ * Trailing erased flash (all 0xFF entries) is not counted as entries.
+ *
+ * @param book The book
+ * @param data Start of the entries
+ * @param size Size of the region, a partial entry at the end is ignored
+ */
+void book_open_memory(Opening_book_t *book, const void *data, size_t size);
+
+/**
+ * @brief Map the book partition into the data address space
+ *
+ * The mapping is kept for the lifetime of the application.
+ *
+ * @param book The book, empty on failure
+ * @return esp_err_t ESP_OK, ESP_ERR_NOT_FOUND without a book partition, or an mmap error
+ */
+esp_err_t book_open_partition(Opening_book_t *book);
+
+/**
+ * @brief Decode an entry
+ *
+ * @param book The book
+ * @param index The entry index, below count
+ * @param entry The entry to fill
+ */
+void book_read_entry(const Opening_book_t *book, size_t index, Book_entry_t *entry);
+
+/**
+ * @brief Encode an entry, for tools building a book
+ *
+ * @param out BOOK_ENTRY_SIZE bytes
+ * @param entry The entry
+ */
+void book_write_entry(uint8_t *out, const Book_entry_t *entry);
+
+/**
+ * @brief Binary search the first entry of a key
+ *
+ * @param book The book
+ * @param key The Zobrist key
+ * @return size_t Index of the first entry with the key, count if there is none
+ */
+size_t book_find(const Opening_book_t *book, uint64_t key);
+
+/**
+ * @brief Convert a Polyglot move to a legal move of a position
+ *
+ * Castling is stored as the king taking its own rook.
+ *
+ * @param pos The position the entry belongs to
+ * @param book_move The Polyglot move
+ * @return Chess_move_t The legal move, MOVE_NONE if the entry does not fit the position
+ */
+Chess_move_t book_move_to_chess(const Chess_position_t *pos, uint16_t book_move);
+
+/**
+ * @brief Encode a move the Polyglot way
+ *
+ * @param move The move
+ * @return uint16_t The Polyglot move
+ */
+uint16_t book_move_from_chess(Chess_move_t move);
+
+/**
+ * @brief Pick a book move, with a probability proportional to its weight
+ *
+ * @param book The book
+ * @param pos The position
+ * @param random Any random number
+ * @return Chess_move_t The move, MOVE_NONE if the position is not in the book
+ */
+Chess_move_t book_probe(const Opening_book_t *book, const Chess_position_t *pos, uint32_t random);
+
+#endif
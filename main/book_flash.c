@@ -0,0 +1,28 @@
+#include "esp_partition.h"
+#include "esp_log.h"
+#include "book.h"
+
+static const char *TAG = "BOOK";
+
+esp_err_t book_open_partition(Opening_book_t *book)
+{
+    static esp_partition_mmap_handle_t handle;
+    const void *data;
+
+    book->data = NULL;
+    book->size = 0;
+    book->count = 0;
+    const esp_partition_t *part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, BOOK_PARTITION_SUBTYPE,
+                                                           BOOK_PARTITION_LABEL);
+    if (!part) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    // Lookups read the entries through the flash cache, nothing is copied to RAM
+    esp_err_t err = esp_partition_mmap(part, 0, part->size, ESP_PARTITION_MMAP_DATA, &data, &handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+    book_open_memory(book, data, part->size);
+    ESP_LOGI(TAG, "%u book entries", (unsigned int)book->count);
+    return ESP_OK;
+}
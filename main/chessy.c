@@ -1,396 +1,418 @@
+#include <assert.h>
 #include <stdio.h>
-#include <string.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-#include "driver/gpio.h"
+#include "freertos/queue.h"
 #include "esp_log.h"
-#include "led_strip.h"
+#include "sdkconfig.h"
 #include "board.h"
 #include "moves.h"
+#include "hall_scan.h"
+#include "hall_events.h"
+#include "scan_policy.h"
+#include "game.h"
+#include "led_display.h"
+#include "engine.h"
+#include "game_journal.h"
+#include "game_archive.h"
+#include "puzzle.h"
+#include "trace.h"
+#if CONFIG_CHESSY_SCAN_LIGHT_SLEEP
+#include "esp_pm.h"
+#endif
+#if CONFIG_CHESSY_TELEMETRY
+#include "esp_timer.h"
+#include "telemetry_usb.h"
+#endif
+#if CONFIG_CHESSY_UCI
+#include "uci_usb.h"
+#endif
+
+#define HALL_EVENT_QUEUE_LEN 128
+#define LED_FRAME_TICKS (pdMS_TO_TICKS(1000 / CONFIG_CHESSY_LED_FPS) > 0 ? pdMS_TO_TICKS(1000 / CONFIG_CHESSY_LED_FPS) : 1)
+
+// Task layout, the scan task must never wait on the game or the LEDs
+#define SCAN_TASK_PRIORITY 20
+#define GAME_TASK_PRIORITY 5
+#define LED_TASK_PRIORITY 6
+#define SCAN_TASK_STACK 3072
+#define GAME_TASK_STACK 8192
+#define LED_TASK_STACK 3072
+#define TRACE_TASK_PRIORITY 1
+#define TRACE_TASK_STACK 3072
+
+#ifdef CONFIG_CHESSY_SKIP_SETUP_CHECK
+#define CHECK_SETUP false
+#else
+#define CHECK_SETUP true
+#endif
 
-#define HALL_COL_SW1 GPIO_NUM_39
-#define HALL_COL_SW2 GPIO_NUM_40
-#define HALL_COL_SW3 GPIO_NUM_41
-#define HALL_COL_SW4 GPIO_NUM_42
-#define HALL_COL_SW5 GPIO_NUM_4
-#define HALL_COL_SW6 GPIO_NUM_5
-#define HALL_COL_SW7 GPIO_NUM_6
-#define HALL_COL_SW8 GPIO_NUM_7
-#define HALL_ROW1 GPIO_NUM_14
-#define HALL_ROW2 GPIO_NUM_13
-#define HALL_ROW3 GPIO_NUM_21
-#define HALL_ROW4 GPIO_NUM_8
-#define HALL_ROW5 GPIO_NUM_15
-#define HALL_ROW6 GPIO_NUM_16
-#define HALL_ROW7 GPIO_NUM_17
-#define HALL_ROW8 GPIO_NUM_18
-#define LED_DATA_IN1 GPIO_NUM_38
-
-#define COL_NUM 8
-#define ROW_NUM 8
-#define LED_DELAY_MS 500
-
-static led_strip_handle_t led_strip;
 static const char *TAG = "CHESSY";
 
-// LED colors for different states
-#define COLOR_EMPTY 0x000000    // Black
-#define COLOR_SELECTED 0xFFFF00  // Yellow
-#define COLOR_VALID_MOVE 0x00FF00 // Green
-#define COLOR_INVALID_MOVE 0xFF0000 // Red
-#define COLOR_WHITE_PIECE 0xFFFFFF  // White
-#define COLOR_BLACK_PIECE 0x808080  // Gray
-#define COLOR_ERROR 0xFF0000    // Red for errors
+static QueueHandle_t hall_event_queue;  // Scan task -> game task, every debounced change
+static QueueHandle_t led_scene_queue;   // Game task -> LED task, only the latest scene matters
+static QueueHandle_t engine_report_queue;  // Engine task -> LED task, only the latest move matters
 
-static uint8_t led_get(int x, int y)
-{
-    // Leds are in zigzag pattern
-    if (y % 2 == 0) {
-        return y * 8 + x;
-    } else {
-        return y * 8 + (7 - x);
-    }
-}
+#if CONFIG_CHESSY_TELEMETRY
+// Each field is only written by one task, the telemetry task reads them once a second
+static Telemetry_stats_t stats;
+#define STATS_ADD(field, n) (stats.field += (n))
 
-static void led_set(int x, int y, uint32_t color)
+static void get_stats(Telemetry_stats_t *out)
 {
-    uint32_t red = (color >> 16) & 0xFF;
-    uint32_t green = (color >> 8) & 0xFF;
-    uint32_t blue = color & 0xFF;
-    led_strip_set_pixel(led_strip, led_get(x, y), red, green, blue);
+    *out = stats;
+    out->uptime_ms = (uint32_t)(esp_timer_get_time() / 1000);
 }
-
-static void led_clear(void)
+#else
+#define STATS_ADD(field, n) do {} while (0)
+#endif
+
+#if CONFIG_CHESSY_ENGINE_HINT
+#define ENGINE_ENABLED 1
+#define ENGINE_SEARCHES(pos) true
+#elif CONFIG_CHESSY_ENGINE_PLAYS_BLACK
+#define ENGINE_ENABLED 1
+#define ENGINE_SEARCHES(pos) ((pos)->side_to_move == SIDE_BLACK)
+#elif CONFIG_CHESSY_ENGINE_PLAYS_WHITE
+#define ENGINE_ENABLED 1
+#define ENGINE_SEARCHES(pos) ((pos)->side_to_move == SIDE_WHITE)
+#else
+#define ENGINE_ENABLED 0
+#define ENGINE_SEARCHES(pos) false
+#endif
+
+// Map a configured core to an affinity, cores the target does not have mean no affinity
+static BaseType_t task_core(int core)
 {
-    led_strip_clear(led_strip);
-    led_strip_refresh(led_strip);
+    return (core >= 0 && core < configNUMBER_OF_CORES) ? core : tskNO_AFFINITY;
 }
 
-static void led_refresh(void)
+static const Scan_adaptive_config_t scan_config = {
+    .burst_gap_us = 0,
+    .active_gap_us = CONFIG_CHESSY_SCAN_ACTIVE_GAP_US,
+    .idle_gap_us = CONFIG_CHESSY_SCAN_IDLE_GAP_MS * 1000,
+    .settle_us = (int64_t)CONFIG_CHESSY_SCAN_SETTLE_MS * 1000,
+    .idle_after_us = (int64_t)CONFIG_CHESSY_SCAN_IDLE_AFTER_S * 1000000,
+};
+
+static void scan_task(void *arg)
 {
-    led_strip_refresh(led_strip);
-}
+    Hall_debouncer_t debouncer;
+    Hall_event_t events[SQUARE_NB];
+    Hall_frame_t frame = {0};
+    uint32_t dropped = 0;
+    Scan_adaptive_t adaptive;
+    Scan_policy_t policy;
+    uint8_t mode = SCAN_MODE_BURST;
+    Bitboard_t last_occupancy = 0;
+
+    // Start from an empty board so the first frames report every piece as placed
+    hall_debouncer_init(&debouncer, CONFIG_CHESSY_HALL_DEBOUNCE_DEPTH, CONFIG_CHESSY_HALL_DEBOUNCE_VOTES, 0);
+    hall_scan_get_frame(&frame);
+    policy = scan_adaptive_init(&adaptive, &scan_config, frame.timestamp_us);
 
+    while (1) {
+        hall_scan_wait_frame(&frame, portMAX_DELAY);
+        int event_count = hall_debouncer_update(&debouncer, frame.occupancy, frame.timestamp_us, events);
+        STATS_ADD(scan_frames, 1);
+        STATS_ADD(hall_events, event_count);
+        for (int i = 0; i < event_count; i++) {
+            TRACE_DEBUG(TRACE_HALL_EVENT, events[i].square, events[i].type);
+            if (xQueueSend(hall_event_queue, &events[i], 0) != pdTRUE) {
+                TRACE_ERROR(TRACE_HALL_DROPPED, events[i].square, dropped + 1);
+                STATS_ADD(hall_dropped, 1);
+                if (dropped++ == 0) {
+                    ESP_LOGW(TAG, "Hall event queue full, dropping events");
+                }
+            }
+        }
 
-static void configure_led(void)
-{
-    ESP_LOGI(TAG, "Configuring LED strip");
-    led_strip_config_t strip_config = {
-        .strip_gpio_num = LED_DATA_IN1,
-        .max_leds = 64,
-    };
-    led_strip_rmt_config_t rmt_config = {
-        .resolution_hz = 10 * 1000 * 1000, // 10MHz
-        .flags.with_dma = false,
-    };
-    ESP_ERROR_CHECK(led_strip_new_rmt_device(&strip_config, &rmt_config, &led_strip));
-    led_clear();
+        // Any change, even one the debouncer has not confirmed yet, brings the next frames closer
+        Scan_sample_t sample = {
+            .timestamp_us = frame.timestamp_us,
+            .changed = frame.occupancy != last_occupancy || frame.occupancy != debouncer.stable,
+        };
+        last_occupancy = frame.occupancy;
+        Scan_step_t step = scan_policy_next(&policy, &sample);
+        if (step.mode != mode) {
+            TRACE_INFO(TRACE_SCAN_MODE, step.mode, step.gap_us);
+            mode = step.mode;
+        }
+#if CONFIG_CHESSY_SCAN_LIGHT_SLEEP
+        if (step.mode == SCAN_MODE_IDLE) {
+            // Nothing keeps the chip awake through the pause with the timer off
+            hall_scan_suspend();
+            vTaskDelay(pdMS_TO_TICKS(step.gap_us / 1000));
+            hall_scan_resume();
+            continue;
+        }
+#endif
+        hall_scan_set_gap(step.gap_us);
+    }
 }
 
-void hall_init(void)
+static void on_engine_report(const Engine_report_t *report, void *ctx)
 {
-    ESP_LOGI(TAG, "Initializing hall effect sensors");
-    gpio_config_t io_conf = {
-        .intr_type = GPIO_INTR_DISABLE,
-        .mode = GPIO_MODE_OUTPUT,
-        .pin_bit_mask = (1ULL << HALL_COL_SW1) | (1ULL << HALL_COL_SW2) |
-        (1ULL << HALL_COL_SW3) | (1ULL << HALL_COL_SW4) |
-        (1ULL << HALL_COL_SW5) | (1ULL << HALL_COL_SW6) |
-        (1ULL << HALL_COL_SW7) | (1ULL << HALL_COL_SW8),
-    };
-    ESP_ERROR_CHECK(gpio_config(&io_conf));
-
-    io_conf.mode = GPIO_MODE_INPUT;
-    io_conf.pin_bit_mask = (1ULL << HALL_ROW1) | (1ULL << HALL_ROW2) |
-                           (1ULL << HALL_ROW3) | (1ULL << HALL_ROW4) |
-                           (1ULL << HALL_ROW5) | (1ULL << HALL_ROW6) |
-                           (1ULL << HALL_ROW7) | (1ULL << HALL_ROW8);
-    ESP_ERROR_CHECK(gpio_config(&io_conf));
+    xQueueOverwrite(engine_report_queue, report);
 }
 
-// Read hall effect sensors
-void hall_read(uint8_t matrix[ROW_NUM][COL_NUM])
-{
-    static uint8_t col_pins[] = {
-        HALL_COL_SW1, HALL_COL_SW2, HALL_COL_SW3, HALL_COL_SW4,
-        HALL_COL_SW5, HALL_COL_SW6, HALL_COL_SW7, HALL_COL_SW8
-    };
-
-    static uint8_t row_pins[] = {
-        HALL_ROW1, HALL_ROW2, HALL_ROW3, HALL_ROW4,
-        HALL_ROW5, HALL_ROW6, HALL_ROW7, HALL_ROW8
-    };
-
-    // Clear matrix first
-    memset(matrix, 0, ROW_NUM * COL_NUM);
+#if CONFIG_CHESSY_PUZZLE_MODE
+static Mate_entry_t puzzle_table[1 << CONFIG_CHESSY_PUZZLE_TABLE_LOG2];
+static Mate_solver_t puzzle_solver;
+static Puzzle_pack_t puzzle_pack;
+static Puzzle_session_t puzzle_session;
+static size_t puzzle_index;
 
-    // Scan each column
-    for (int col = 0; col < COL_NUM; col++) {
-        gpio_set_level(col_pins[col], 1);
-        vTaskDelay(pdMS_TO_TICKS(10));
-
-        // Read each row
-        for (int row = 0; row < ROW_NUM; row++) {
-            matrix[row][col] = gpio_get_level(row_pins[row]);
+// Set up the next valid puzzle of the pack, the pieces must then be placed like it
+static bool puzzle_next(Game_t *game)
+{
+    Puzzle_t puzzle;
+    for (size_t tries = 0; tries < puzzle_pack.count; tries++) {
+        size_t index = puzzle_index++ % puzzle_pack.count;
+        if (!puzzle_pack_read(&puzzle_pack, index, &puzzle)) {
+            ESP_LOGW(TAG, "Puzzle %u is not valid", (unsigned int)index + 1);
+            continue;
         }
-
-        gpio_set_level(col_pins[col], 0);
+        Bitboard_t occupancy = game->occupancy;
+        game_free(game);
+        game_init_from(game, &puzzle.pos, true);
+        game->occupancy = occupancy;
+        game_verify_setup(game);
+        puzzle_session_start(&puzzle_session, &puzzle, &puzzle_solver);
+        ESP_LOGI(TAG, "Puzzle %u: %s mates in %d", (unsigned int)index + 1,
+                 puzzle.pos.side_to_move == SIDE_WHITE ? "white" : "black", puzzle.mate_in);
+        return true;
     }
+    return false;
 }
 
-// Verify that the physical board matches the expected state
-static bool verify_board_state(const char board[8][8], const uint8_t matrix[ROW_NUM][COL_NUM])
+static bool puzzle_start(Game_t *game)
 {
-    for (int row = 0; row < ROW_NUM; row++) {
-        for (int col = 0; col < COL_NUM; col++) {
-            printf("Debug: Checking square at %c%d hall_sensor: %d matrix: %c\n", 'a' + col, 8 - row, matrix[row][col], board[row][col]);
-            // If there's a piece in the board array, there should be a magnet detected
-            if (board[row][col] != ' ' && matrix[row][col]) {
-                printf("Error: Missing piece at %c%d\n", 'a' + col, 8 - row);
-                led_set(col, row, COLOR_ERROR);
-                led_refresh();
-                return false;
-            }
-            // If there's no piece in the board array, there should be no magnet detected
-            if (board[row][col] == ' ' && !matrix[row][col]) {
-                printf("Error: Extra piece at %c%d\n", 'a' + col, 8 - row);
-                led_set(col, row, COLOR_ERROR);
-                led_refresh();
-                return false;
-            }
-        }
+    mate_solver_init(&puzzle_solver, puzzle_table, sizeof(puzzle_table) / sizeof(puzzle_table[0]),
+                     CONFIG_CHESSY_PUZZLE_NODE_LIMIT);
+    esp_err_t err = puzzle_pack_open_partition(&puzzle_pack);
+    if (err != ESP_OK || !puzzle_next(game)) {
+        ESP_LOGE(TAG, "No puzzles (%s), playing a game instead", esp_err_to_name(err));
+        return false;
     }
     return true;
 }
 
-// Update LED display based on current board state and selected piece
-static void update_led_display(
-    const char board[8][8],
-    const uint8_t hall_matrix[ROW_NUM][COL_NUM],
-    const Position_t *selected_pos,
-    const Position_t *valid_moves,
-    int valid_move_count
-)
+// Judge the move just played from before, right away
+static void puzzle_on_move(Game_t *game, const Chess_position_t *before)
 {
-    led_clear();
-
-    // First, show all pieces on the board
-    for (int row = 0; row < ROW_NUM; row++) {
-        for (int col = 0; col < COL_NUM; col++) {
-            if (hall_matrix[row][col]) {
-                char piece = board[row][col];
-                uint32_t color = (piece >= 'a' && piece <= 'z') ?
-                                 COLOR_BLACK_PIECE : COLOR_WHITE_PIECE;
-                led_set(col, row, color);
-            }
-        }
+    Chess_move_t move = game->undo[(game->record.count - 1) % GAME_UNDO_PLIES].move;
+    Chess_move_t reply;
+    char uci[6];
+    switch (puzzle_session_judge(&puzzle_session, before, move, &reply)) {
+    case PUZZLE_MOVE_REPLY:
+        break;
+    case PUZZLE_MOVE_CORRECT: {
+        // The defence is shown like an engine hint, for the player to make
+        Engine_report_t report = {.key = game->pos.key, .best_move = reply, .done = true};
+        ESP_LOGI(TAG, "Correct, %d to go", puzzle_session.moves_left);
+        xQueueOverwrite(engine_report_queue, &report);
+        break;
     }
-
-    // Highlight selected piece
-    if (selected_pos) {
-        led_set(selected_pos->y, selected_pos->x, COLOR_SELECTED);
+    case PUZZLE_MOVE_SOLVED:
+        ESP_LOGI(TAG, "Solved!");
+        puzzle_next(game);
+        break;
+    case PUZZLE_MOVE_WRONG:
+        ESP_LOGI(TAG, "Wrong, %s escapes the mate", reply == MOVE_NONE ? "the defence" : move_to_uci(reply, uci));
+        game_takeback(game, 1);
+        break;
     }
+}
+#endif
 
-    // Show valid moves
-    for (int i = 0; i < valid_move_count; i++) {
-        led_set(valid_moves[i].y, valid_moves[i].x, COLOR_VALID_MOVE);
+// Hand the board to the telemetry or UCI task, and how long the last batch of events took
+static void publish_board(const Game_t *game, int64_t batch_start_us)
+{
+#if CONFIG_CHESSY_TELEMETRY
+    static Telemetry_board_t board;
+    uint32_t batch_us = (uint32_t)(esp_timer_get_time() - batch_start_us);
+    if (batch_us > stats.game_max_us) {
+        stats.game_max_us = batch_us;
     }
+    telemetry_board_from_game(&board, game);
+    telemetry_usb_publish_board(&board);
+#elif CONFIG_CHESSY_UCI
+    static Telemetry_board_t board;
+    telemetry_board_from_game(&board, game);
+    uci_usb_publish_board(&board);
+#endif
+}
 
-    led_refresh();
+static int64_t batch_start(void)
+{
+#if CONFIG_CHESSY_TELEMETRY
+    return esp_timer_get_time();
+#else
+    return 0;
+#endif
 }
 
-// Returns true if a piece movement was detected and stores the position in pos
-bool detect_piece_movement(Position_t *pos)
+static void game_task(void *arg)
 {
-    static uint8_t prev_matrix[ROW_NUM][COL_NUM] = {0};
-    uint8_t curr_matrix[ROW_NUM][COL_NUM] = {0};
-    bool movement_detected = false;
-
-    // Read current state
-    hall_read(curr_matrix);
-
-    // Compare with previous state to find piece movement
-    for (int i = 0; i < ROW_NUM; i++) {
-        for (int j = 0; j < COL_NUM; j++) {
-            if (prev_matrix[i][j] != curr_matrix[i][j]) {
-                pos->x = i;
-                pos->y = j;
-                movement_detected = true;
-                break;
-            }
-        }
-        if (movement_detected) {
-            break;
+    static Game_t game;
+    Led_scene_t scene;
+    Hall_event_t event;
+    uint64_t searched_key = 0;
+    bool puzzles = false;
+    bool archived = false;
+
+#if CONFIG_CHESSY_PUZZLE_MODE
+    // Puzzles are not journaled, a reset starts over from the first one
+    puzzles = puzzle_start(&game);
+#endif
+    if (!puzzles) {
+        // A game interrupted by a reset is resumed once the board shows its position
+        static Game_record_t journaled;
+        Chess_position_t journaled_pos;
+        game_init(&game, CHECK_SETUP);
+        if (game_journal_start(&journaled, &journaled_pos)) {
+            game_resume(&game, &journaled);
         }
+        game_record_clear(&journaled);
+        game_archive_start();
     }
+    game_take_scene(&game, &scene);
+    xQueueOverwrite(led_scene_queue, &scene);
+    publish_board(&game, batch_start());
 
-    // Update previous state
-    memcpy(prev_matrix, curr_matrix, sizeof(curr_matrix));
-
-    return movement_detected;
-}
-
-Move_t get_user_move(const char board[8][8])
-{
-    Position_t start = {-1, -1}, end = {-1, -1};
-    Position_t valid_moves[32];
-    int valid_move_count = 0;
-    bool move_completed = false;
-    bool invalid_move = false;
-    Position_t current_pos;
-
-    while (!move_completed) {
-        // Wait for piece selection
-        if (!invalid_move) {
-            while (!detect_piece_movement(&current_pos)) {
-                vTaskDelay(pdMS_TO_TICKS(100));
+    while (1) {
+        // Handle everything that is pending before redrawing once
+        xQueueReceive(hall_event_queue, &event, portMAX_DELAY);
+        int64_t start_us = batch_start();
+        do {
+#if CONFIG_CHESSY_PUZZLE_MODE
+            Chess_position_t before = game.pos;
+            uint32_t plies = game.record.count;
+            game_handle_event(&game, &event);
+            if (puzzles && game.record.count == plies + 1) {
+                puzzle_on_move(&game, &before);
             }
-            start = current_pos;
-
-            // Check if the move is valid
-            if (board[start.x][start.y] == ' ') {
-                printf("Error: No piece at that position\n");
-                start.x = start.y = -1;
-                continue;
+#else
+            game_handle_event(&game, &event);
+#endif
+        } while (xQueueReceive(hall_event_queue, &event, 0) == pdTRUE);
+
+        game_verify_setup(&game);
+        game_take_scene(&game, &scene);
+        xQueueOverwrite(led_scene_queue, &scene);
+        publish_board(&game, start_us);
+        if (game.state == GAME_STATE_PLAYING) {
+            if (!puzzles) {
+                game_journal_sync(&game.record);
+                // Each ending is archived once, taking it back and finishing again archives the new game
+                if (game.over && !archived) {
+                    game_archive_save(&game.record);
+                    archived = true;
+                } else if (!game.over) {
+                    archived = false;
+                }
             }
-
-            // Get and display valid moves
-            valid_move_count = get_available_moves(board, start.x, start.y, valid_moves);
-            uint8_t curr_matrix[ROW_NUM][COL_NUM];
-            hall_read(curr_matrix);
-            update_led_display(board, curr_matrix, &start, valid_moves, valid_move_count);
         } else {
-            printf("Please pick a valid move or return piece to the original position\n");
+            // A takeback can return to a position searched before, its hint is long gone
+            searched_key = 0;
         }
 
-        // Wait for move completion
-        while (!detect_piece_movement(&current_pos)) {
-            vTaskDelay(pdMS_TO_TICKS(100));
-        }
-        end = current_pos;
-
-        // Validate the move
-        if (is_valid_move(end, valid_moves, valid_move_count)) {
-            move_completed = true;
-            // Show success feedback
-            led_set(end.y, end.x, COLOR_VALID_MOVE);
-            led_refresh();
-            vTaskDelay(pdMS_TO_TICKS(LED_DELAY_MS));
-        } else if (end.x == start.x && end.y == start.y) {
-            move_completed = true;
-            invalid_move = false;
-            // Show cancel feedback
-            // TODO: return piece to original position
-            led_set(end.y, end.x, COLOR_EMPTY);
-            led_refresh();
-            vTaskDelay(pdMS_TO_TICKS(LED_DELAY_MS));
-        } else {
-            printf("Invalid move\n");
-            invalid_move = true;
-            // Show error feedback
-            led_set(end.y, end.x, COLOR_INVALID_MOVE);
-            led_refresh();
-            vTaskDelay(pdMS_TO_TICKS(LED_DELAY_MS));
-            start.x = start.y = -1;
+        // Search every new position the engine has to move in
+        if (ENGINE_ENABLED && game.state == GAME_STATE_PLAYING && ENGINE_SEARCHES(&game.pos) &&
+                game.pos.key != searched_key) {
+            engine_request(&game.record, &game.pos);
+            searched_key = game.pos.key;
         }
     }
-
-    return (Move_t) {
-        start, end
-    };
 }
 
-
-Move_t move_list[100];  // TODO: make this dynamic
-unsigned int move_count = 0;
-
-void print_move_list()
+static void led_task(void *arg)
 {
-    for (int i = 0; i < move_count; i++) {
-        printf("%d. %c%d->%c%d\n",
-               i + 1,
-               'a' + move_list[i].start.y,
-               8 - move_list[i].start.x,
-               'a' + move_list[i].end.y,
-               8 - move_list[i].end.x
-              );
-    }
-}
+    Led_scene_t scene;
+    Engine_report_t report;
+    TickType_t last_wake = xTaskGetTickCount();
 
-bool start_is_end(Move_t move)
-{
-    // Check if the start and end positions are the same
-    if (move.start.x == move.end.x && move.start.y == move.end.y) {
-        printf("Returning piece to original location, no move added to list.\n");
-        return true;
+    while (1) {
+        int64_t now_us = (int64_t)pdTICKS_TO_MS(xTaskGetTickCount()) * 1000;
+        // Only the latest scene matters, it is picked up at the next frame
+        if (xQueueReceive(led_scene_queue, &scene, 0) == pdTRUE) {
+            led_display_set_scene(&scene, now_us);
+        }
+        if (xQueueReceive(engine_report_queue, &report, 0) == pdTRUE) {
+            led_display_set_hint(report.key, report.best_move);
+        }
+
+        // Sends nothing unless the frame changed
+        if (led_display_show(now_us)) {
+            STATS_ADD(led_frames, 1);
+#if CONFIG_CHESSY_TELEMETRY
+            uint8_t colors[SQUARE_NB][3];
+            led_display_get_shown(colors);
+            telemetry_usb_publish_leds(colors);
+#endif
+        }
+        xTaskDelayUntil(&last_wake, LED_FRAME_TICKS);
     }
-    return false;
 }
 
-void add_move(char board[8][8], Move_t move)
+#if CONFIG_CHESSY_TRACE_LEVEL > 0 && CONFIG_CHESSY_TRACE_DRAIN_MS > 0
+// Console writes are slow, so the records are only printed from here, below every other task
+static void trace_task(void *arg)
 {
-    // Add the move to the move list and update the board
-    if (start_is_end(move)) {
-        return;
+    TickType_t last_wake = xTaskGetTickCount();
+    while (1) {
+        trace_dump(stdout);
+        xTaskDelayUntil(&last_wake, pdMS_TO_TICKS(CONFIG_CHESSY_TRACE_DRAIN_MS));
     }
-    move_list[move_count] = move;
-    move_count++;
-    printf("moving %c from %c%d to %c%d\n", board[move.start.x][move.start.y], 'a' + move.start.y, 8 - move.start.x, 'a' + move.end.y, 8 - move.end.x);
-    // Update the board
-    board[move.end.x][move.end.y] = board[move.start.x][move.start.y];
-    board[move.start.x][move.start.y] = ' ';
 }
+#endif
 
 int app_main(int argc, char *argv[])
 {
-    // Initialize hardware
-    hall_init();
-    configure_led();
-
-    // Initialize game
-    char board[8][8];
-    init_board(board);
-    print_board(board);
-
-    // Wait for initial board setup
-    uint8_t hall_matrix[ROW_NUM][COL_NUM];
-    bool board_ready = false;
-
-    while (!board_ready) {
-        // printf("Please set up the board according to the displayed state...\n");
-        hall_read(hall_matrix);
-        // print matrix
-        printf("Current matrix state:\n");
-        printf("  a b c d e f g h\n");
-        printf(" ┌────────────────┐\n");
-        for (int row = 0; row < ROW_NUM; row++) {
-            printf("%d│", 8 - row);
-            for (int col = 0; col < COL_NUM; col++) {
-                printf("%d ", hall_matrix[row][col]);
-            }
-            printf("│%d\n", 8 - row);
-        }
-        printf(" └────────────────┘\n");
-        printf("  a b c d e f g h\n");
+#if CONFIG_CHESSY_SCAN_LIGHT_SLEEP
+    // Light sleep whenever every task waits and no driver holds a lock, the scan only lets go when idle
+    esp_pm_config_t pm_config = {
+        .max_freq_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+        .min_freq_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+        .light_sleep_enable = true,
+    };
+    ESP_ERROR_CHECK(esp_pm_configure(&pm_config));
+#endif
 
-        if (verify_board_state(board, hall_matrix)) {
-            board_ready = true;
-            printf("Board setup verified!\n");
-            led_clear();
-        } else {
-            printf("Board setup incorrect. Please fix the highlighted positions.\n");
-            vTaskDelay(pdMS_TO_TICKS(LED_DELAY_MS));
-        }
+#if CONFIG_CHESSY_TELEMETRY
+    // The port carries frames now, only problems are still logged as text
+    esp_log_level_set("*", ESP_LOG_WARN);
+    ESP_ERROR_CHECK(telemetry_usb_start(get_stats));
+#endif
 
-        // debug mode, skip verification
-        led_clear();
-        board_ready = true;
+    // Initialize hardware
+    ESP_ERROR_CHECK(hall_scan_start());
+    led_display_init();
+
+    hall_event_queue = xQueueCreate(HALL_EVENT_QUEUE_LEN, sizeof(Hall_event_t));
+    led_scene_queue = xQueueCreate(1, sizeof(Led_scene_t));
+    engine_report_queue = xQueueCreate(1, sizeof(Engine_report_t));
+    assert(hall_event_queue && led_scene_queue && engine_report_queue);
+
+#if CONFIG_CHESSY_UCI
+    // Moves from the host engine are shown like the engine's, the port only carries problems besides commands
+    esp_log_level_set("*", ESP_LOG_WARN);
+    ESP_ERROR_CHECK(uci_usb_start(on_engine_report, NULL));
+#endif
+
+    if (ENGINE_ENABLED) {
+        ESP_ERROR_CHECK(engine_start(task_core(CONFIG_CHESSY_ENGINE_TASK_CORE), on_engine_report, NULL));
     }
 
-    while (1) {
-        // Get and process the move
-        Move_t move = get_user_move(board);
-        add_move(board, move);
-        print_board(board);
-    }
+    xTaskCreatePinnedToCore(led_task, "led", LED_TASK_STACK, NULL, LED_TASK_PRIORITY, NULL,
+                            task_core(CONFIG_CHESSY_LED_TASK_CORE));
+    xTaskCreatePinnedToCore(game_task, "game", GAME_TASK_STACK, NULL, GAME_TASK_PRIORITY, NULL,
+                            task_core(CONFIG_CHESSY_GAME_TASK_CORE));
+#if CONFIG_CHESSY_TRACE_LEVEL > 0 && CONFIG_CHESSY_TRACE_DRAIN_MS > 0
+    xTaskCreate(trace_task, "trace", TRACE_TASK_STACK, NULL, TRACE_TASK_PRIORITY, NULL);
+#endif
+    xTaskCreatePinnedToCore(scan_task, "scan", SCAN_TASK_STACK, NULL, SCAN_TASK_PRIORITY, NULL,
+                            task_core(CONFIG_CHESSY_SCAN_TASK_CORE));
+    return 0;
 }
@@ -0,0 +1,19 @@
+#ifndef CRC32_H
+#define CRC32_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Continue a CRC-32 (IEEE 802.3, reflected) over more bytes
+ *
+ * Start with 0, the result of one call is the crc to pass to the next.
+ *
+ * @param crc CRC of the bytes so far
+ * @param data The bytes
+ * @param size Number of bytes
+ * @return uint32_t CRC of all the bytes
+ */
+uint32_t crc32_update(uint32_t crc, const void *data, size_t size);
+
+#endif
@@ -0,0 +1,235 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+#include "engine.h"
+#include "book.h"
+#include "bitbase.h"
+#include "trace.h"
+
+#if CONFIG_IDF_TARGET_LINUX
+#include <stdlib.h>
+#include <time.h>
+#else
+#include "esp_timer.h"
+#include "esp_random.h"
+#endif
+
+#define ENGINE_TASK_PRIORITY 2   // Below the game and LED tasks
+#define ENGINE_TASK_STACK 8192
+#define ENGINE_YIELD_US 20000    // Let the idle task and equal priority tasks run this often
+#define ENGINE_HELPER_PRIORITY 1 // Only when the board is otherwise idle
+#define ENGINE_TT_ENTRIES (1 << CONFIG_CHESSY_ENGINE_TT_SIZE_LOG2)
+
+#if CONFIG_CHESSY_ENGINE_NNUE
+#define ENGINE_USE_NNUE true
+#else
+#define ENGINE_USE_NNUE false
+#endif
+
+typedef struct {
+    Chess_position_t pos;
+    int history_count;
+    uint64_t history[SEARCH_HISTORY_MAX];
+} Engine_request_t;
+
+static const char *TAG = "ENGINE";
+
+static QueueHandle_t request_queue;
+static Search_t search;              // Too big for the task stack
+static Engine_request_t request;
+static Opening_book_t book;
+static Bitbase_t bitbase;
+static Engine_report_cb_t report_cb;
+static void *report_ctx;
+static int64_t last_yield_us;
+static Tt_entry_t tt_entries[ENGINE_TT_ENTRIES];
+static Tt_t tt;
+
+#if CONFIG_CHESSY_ENGINE_HELPER
+static Search_t helper;              // Searches request.pos on the other core
+static TaskHandle_t helper_handle;
+static SemaphoreHandle_t helper_done;
+static int64_t helper_yield_us;
+#endif
+
+static int64_t engine_clock_us(void)
+{
+#if CONFIG_IDF_TARGET_LINUX
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#else
+    return esp_timer_get_time();
+#endif
+}
+
+// Called every SEARCH_POLL_NODES nodes, a new request replaces the current search
+static bool engine_poll(void *ctx)
+{
+    if (engine_clock_us() - last_yield_us >= ENGINE_YIELD_US) {
+        vTaskDelay(1);
+        last_yield_us = engine_clock_us();
+    }
+    return uxQueueMessagesWaiting(request_queue) > 0;
+}
+
+#if CONFIG_CHESSY_ENGINE_HELPER
+static bool helper_poll(void *ctx)
+{
+    if (engine_clock_us() - helper_yield_us >= ENGINE_YIELD_US) {
+        vTaskDelay(1);
+        helper_yield_us = engine_clock_us();
+    }
+    return false;
+}
+
+// Started by the engine task for every search, stopped by it once the main search is done
+static void helper_task(void *arg)
+{
+    helper.clock_us = engine_clock_us;
+    helper.poll = helper_poll;
+    helper.bitbase = &bitbase;
+    helper.tt = &tt;
+    helper.use_nnue = ENGINE_USE_NNUE;
+    helper.helper = 1;
+
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        helper_yield_us = engine_clock_us();
+        search_run(&helper, &request.pos);
+        xSemaphoreGive(helper_done);
+    }
+}
+
+static void helper_start(void)
+{
+    static const Search_limits_t no_limits;
+    search_init(&helper, &no_limits);
+    search_set_history(&helper, request.history, request.history_count);
+    xTaskNotifyGive(helper_handle);
+}
+
+static void helper_stop(void)
+{
+    helper.stop = true;
+    xSemaphoreTake(helper_done, portMAX_DELAY);
+}
+#endif
+
+static uint32_t engine_random(void)
+{
+#if CONFIG_IDF_TARGET_LINUX
+    return (uint32_t)rand();
+#else
+    return esp_random();
+#endif
+}
+
+static void engine_on_report(const Search_report_t *report, void *ctx)
+{
+    Engine_report_t out = {
+        .key = request.pos.key,
+        .best_move = report->best_move,
+        .score = (int16_t)report->score,
+        .depth = (uint8_t)report->depth,
+        .done = report->done,
+        .nodes = (uint32_t)report->nodes,
+    };
+    if (report->done) {
+        char uci[6];
+        ESP_LOGI(TAG, "bestmove %s score %d depth %d nodes %u in %d ms", move_to_uci(report->best_move, uci),
+                 report->score, report->depth, (unsigned int)report->nodes, (int)(report->elapsed_us / 1000));
+    }
+    report_cb(&out, report_ctx);
+}
+
+static void engine_task(void *arg)
+{
+    const Search_limits_t limits = {
+        .max_depth = 0,
+        .node_limit = CONFIG_CHESSY_ENGINE_NODE_LIMIT,
+        .time_limit_us = (int64_t)CONFIG_CHESSY_ENGINE_TIME_MS * 1000,
+    };
+    search.clock_us = engine_clock_us;
+    search.poll = engine_poll;
+    search.on_report = engine_on_report;
+    search.bitbase = &bitbase;
+    search.tt = &tt;
+    search.use_nnue = ENGINE_USE_NNUE;
+
+    while (1) {
+        xQueueReceive(request_queue, &request, portMAX_DELAY);
+
+        // A book move is played without searching
+        Chess_move_t book_move = book_probe(&book, &request.pos, engine_random());
+        if (book_move != MOVE_NONE) {
+            char uci[6];
+            ESP_LOGI(TAG, "bestmove %s from the book", move_to_uci(book_move, uci));
+            TRACE_INFO(TRACE_BOOK_MOVE, book_move, 0);
+            Engine_report_t out = {.key = request.pos.key, .best_move = book_move, .done = true};
+            report_cb(&out, report_ctx);
+            continue;
+        }
+
+        search_init(&search, &limits);
+        search_set_history(&search, request.history, request.history_count);
+        last_yield_us = engine_clock_us();
+#if CONFIG_CHESSY_ENGINE_HELPER
+        helper_start();
+        search_run(&search, &request.pos);
+        helper_stop();
+#else
+        search_run(&search, &request.pos);
+#endif
+    }
+}
+
+esp_err_t engine_start(int core, Engine_report_cb_t on_report, void *ctx)
+{
+    report_cb = on_report;
+    report_ctx = ctx;
+    if (book_open_partition(&book) != ESP_OK) {
+        ESP_LOGW(TAG, "No opening book");
+    }
+    if (bitbase_open_partition(&bitbase) != ESP_OK) {
+        ESP_LOGW(TAG, "No endgame bitbases");
+    }
+    tt_init(&tt, tt_entries, ENGINE_TT_ENTRIES);
+    request_queue = xQueueCreate(1, sizeof(Engine_request_t));
+    if (!request_queue) {
+        return ESP_ERR_NO_MEM;
+    }
+#if CONFIG_CHESSY_ENGINE_HELPER
+    helper_done = xSemaphoreCreateBinary();
+    if (!helper_done) {
+        return ESP_ERR_NO_MEM;
+    }
+    int helper_core = core == 0 ? 1 : core == 1 ? 0 : tskNO_AFFINITY;
+    if (xTaskCreatePinnedToCore(helper_task, "engine_helper", ENGINE_TASK_STACK, NULL, ENGINE_HELPER_PRIORITY,
+                                &helper_handle, helper_core) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+#endif
+    if (xTaskCreatePinnedToCore(engine_task, "engine", ENGINE_TASK_STACK, NULL, ENGINE_TASK_PRIORITY, NULL, core) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+void engine_request(const Game_record_t *record, const Chess_position_t *pos)
+{
+    // Static, the request is copied into the queue anyway
+    static Engine_request_t next;
+    next.pos = *pos;
+    next.history_count = game_record_recent_keys(record, pos, next.history, SEARCH_HISTORY_MAX);
+    xQueueOverwrite(request_queue, &next);
+}
+
+void engine_stop(void)
+{
+    search.stop = true;
+}
@@ -0,0 +1,55 @@
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "game_record.h"
+#include "search.h"
+
+/**
+ * @brief Best move found so far for a position
+ *
+ */
+typedef struct {
+    uint64_t key;            // Key of the searched position
+    Chess_move_t best_move;
+    int16_t score;
+    uint8_t depth;
+    bool done;               // The search is over, the move will not change
+    uint32_t nodes;
+} Engine_report_t;
+
+typedef void (*Engine_report_cb_t)(const Engine_report_t *report, void *ctx);
+
+/**
+ * @brief Start the engine task
+ *
+ * Positions found in the opening book partition are answered right away
+ * with a book move, and KPK, KRK and KQK endings are resolved from the
+ * bitbase partition. The task runs at a low priority with time and node
+ * budgets from Kconfig, and yields regularly so it never starves the tasks
+ * or the idle task of its core.
+ *
+ * @param core Core to pin the task to, or tskNO_AFFINITY
+ * @param on_report Called from the engine task with every improvement
+ * @param ctx Passed to on_report
+ * @return esp_err_t ESP_OK, or ESP_ERR_NO_MEM
+ */
+esp_err_t engine_start(int core, Engine_report_cb_t on_report, void *ctx);
+
+/**
+ * @brief Search a game position, replacing any search in progress
+ *
+ * @param record The game leading to the position, for repetitions
+ * @param pos The position
+ */
+void engine_request(const Game_record_t *record, const Chess_position_t *pos);
+
+/**
+ * @brief Stop the current search, its last report gets done set
+ *
+ */
+void engine_stop(void);
+
+#endif
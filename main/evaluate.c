@@ -0,0 +1,127 @@
+#include "evaluate.h"
+
+const int piece_values[PIECE_TYPE_NB] = {100, 320, 330, 500, 900, 0};
+
+// Piece-square tables from white's point of view, rank 8 first as printed
+static const int8_t pawn_table[SQUARE_NB] = {
+    0,   0,   0,   0,   0,   0,   0,   0,
+    50,  50,  50,  50,  50,  50,  50,  50,
+    10,  10,  20,  30,  30,  20,  10,  10,
+    5,   5,  10,  25,  25,  10,   5,   5,
+    0,   0,   0,  20,  20,   0,   0,   0,
+    5,  -5, -10,   0,   0, -10,  -5,   5,
+    5,  10,  10, -20, -20,  10,  10,   5,
+    0,   0,   0,   0,   0,   0,   0,   0,
+};
+
+static const int8_t knight_table[SQUARE_NB] = {
+    -50, -40, -30, -30, -30, -30, -40, -50,
+    -40, -20,   0,   0,   0,   0, -20, -40,
+    -30,   0,  10,  15,  15,  10,   0, -30,
+    -30,   5,  15,  20,  20,  15,   5, -30,
+    -30,   0,  15,  20,  20,  15,   0, -30,
+    -30,   5,  10,  15,  15,  10,   5, -30,
+    -40, -20,   0,   5,   5,   0, -20, -40,
+    -50, -40, -30, -30, -30, -30, -40, -50,
+};
+
+static const int8_t bishop_table[SQUARE_NB] = {
+    -20, -10, -10, -10, -10, -10, -10, -20,
+    -10,   0,   0,   0,   0,   0,   0, -10,
+    -10,   0,   5,  10,  10,   5,   0, -10,
+    -10,   5,   5,  10,  10,   5,   5, -10,
+    -10,   0,  10,  10,  10,  10,   0, -10,
+    -10,  10,  10,  10,  10,  10,  10, -10,
+    -10,   5,   0,   0,   0,   0,   5, -10,
+    -20, -10, -10, -10, -10, -10, -10, -20,
+};
+
+static const int8_t rook_table[SQUARE_NB] = {
+    0,   0,   0,   0,   0,   0,   0,   0,
+    5,  10,  10,  10,  10,  10,  10,   5,
+    -5,   0,   0,   0,   0,   0,   0,  -5,
+    -5,   0,   0,   0,   0,   0,   0,  -5,
+    -5,   0,   0,   0,   0,   0,   0,  -5,
+    -5,   0,   0,   0,   0,   0,   0,  -5,
+    -5,   0,   0,   0,   0,   0,   0,  -5,
+    0,   0,   0,   5,   5,   0,   0,   0,
+};
+
+static const int8_t queen_table[SQUARE_NB] = {
+    -20, -10, -10,  -5,  -5, -10, -10, -20,
+    -10,   0,   0,   0,   0,   0,   0, -10,
+    -10,   0,   5,   5,   5,   5,   0, -10,
+    -5,   0,   5,   5,   5,   5,   0,  -5,
+    0,   0,   5,   5,   5,   5,   0,  -5,
+    -10,   5,   5,   5,   5,   5,   0, -10,
+    -10,   0,   5,   0,   0,   0,   0, -10,
+    -20, -10, -10,  -5,  -5, -10, -10, -20,
+};
+
+static const int8_t king_middle_table[SQUARE_NB] = {
+    -30, -40, -40, -50, -50, -40, -40, -30,
+    -30, -40, -40, -50, -50, -40, -40, -30,
+    -30, -40, -40, -50, -50, -40, -40, -30,
+    -30, -40, -40, -50, -50, -40, -40, -30,
+    -20, -30, -30, -40, -40, -30, -30, -20,
+    -10, -20, -20, -20, -20, -20, -20, -10,
+    20,  20,   0,   0,   0,   0,  20,  20,
+    20,  30,  10,   0,   0,  10,  30,  20,
+};
+
+static const int8_t king_end_table[SQUARE_NB] = {
+    -50, -40, -30, -20, -20, -30, -40, -50,
+    -30, -20, -10,   0,   0, -10, -20, -30,
+    -30, -10,  20,  30,  30,  20, -10, -30,
+    -30, -10,  30,  40,  40,  30, -10, -30,
+    -30, -10,  30,  40,  40,  30, -10, -30,
+    -30, -10,  20,  30,  30,  20, -10, -30,
+    -30, -30,   0,   0,   0,   0, -30, -30,
+    -50, -30, -30, -30, -30, -30, -30, -50,
+};
+
+static const int8_t *const piece_tables[PIECE_KING] = {
+    pawn_table, knight_table, bishop_table, rook_table, queen_table,
+};
+
+// Game phase weights, 24 with every piece on the board
+static const int phase_weights[PIECE_TYPE_NB] = {0, 1, 1, 2, 4, 0};
+#define PHASE_MAX 24
+
+int evaluate(const Chess_position_t *pos)
+{
+    int score[2] = {0, 0};
+    int phase = 0;
+
+    for (int side = SIDE_WHITE; side <= SIDE_BLACK; side++) {
+        // The tables are printed rank 8 first, white squares need the flip
+        int flip = side == SIDE_WHITE ? 56 : 0;
+        for (int type = PIECE_PAWN; type < PIECE_KING; type++) {
+            Bitboard_t pieces = position_bb(pos, (Side_t)side, (Piece_type_t)type);
+            phase += phase_weights[type] * bb_popcount(pieces);
+            while (pieces) {
+                int sq = bb_pop_lsb(&pieces);
+                score[side] += piece_values[type] + piece_tables[type][sq ^ flip];
+            }
+        }
+    }
+
+    if (phase > PHASE_MAX) {
+        phase = PHASE_MAX;
+    }
+    for (int side = SIDE_WHITE; side <= SIDE_BLACK; side++) {
+        int sq = bb_lsb(position_bb(pos, (Side_t)side, PIECE_KING)) ^ (side == SIDE_WHITE ? 56 : 0);
+        score[side] += (king_middle_table[sq] * phase + king_end_table[sq] * (PHASE_MAX - phase)) / PHASE_MAX;
+    }
+
+    int white_score = score[SIDE_WHITE] - score[SIDE_BLACK];
+    return pos->side_to_move == SIDE_WHITE ? white_score : -white_score;
+}
+
+int evaluate_piece_square(Piece_type_t type, int sq)
+{
+    if (type == PIECE_KING) {
+        return king_middle_table[sq ^ 56];
+    }
+    return piece_values[type] + piece_tables[type][sq ^ 56];
+}
@@ -0,0 +1,29 @@
+#ifndef EVALUATE_H
+#define EVALUATE_H
+
+#include "position.h"
+
+// Material values in centipawns, indexed by Piece_type_t
+extern const int piece_values[PIECE_TYPE_NB];
+
+/**
+ * @brief Static evaluation of a position
+ *
+ * Material plus piece-square tables, the king table blends from middle game
+ * to endgame as pieces come off.
+ *
+ * @param pos The position
+ * @return int Score in centipawns from the point of view of the side to move
+ */
+int evaluate(const Chess_position_t *pos);
+
+/**
+ * @brief Material plus table value of one piece, the king with its middle game table
+ *
+ * @param type The piece type
+ * @param sq The square as seen by the piece's side, rank 1 being its back rank
+ * @return int Centipawns
+ */
+int evaluate_piece_square(Piece_type_t type, int sq);
+
+#endif
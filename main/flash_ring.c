@@ -0,0 +1,39 @@
+#include "flash_ring.h"
+#include "crc32.h"
+
+bool flash_ring_read_header(const Flash_ring_io_t *flash, uint32_t sector, uint32_t magic, uint32_t *sequence)
+{
+    uint8_t header[FLASH_RING_HEADER_SIZE];
+    if (flash->read(flash->ctx, sector * FLASH_RING_SECTOR_SIZE, header, sizeof(header)) != ESP_OK) {
+        return false;
+    }
+    *sequence = flash_ring_get_u32(header + 4);
+    return flash_ring_get_u32(header) == magic && flash_ring_get_u32(header + 8) == crc32_update(0, header, 8);
+}
+
+esp_err_t flash_ring_write_header(const Flash_ring_io_t *flash, uint32_t sector, uint32_t magic, uint32_t sequence)
+{
+    uint8_t header[FLASH_RING_HEADER_SIZE];
+    flash_ring_put_u32(header, magic);
+    flash_ring_put_u32(header + 4, sequence);
+    flash_ring_put_u32(header + 8, crc32_update(0, header, 8));
+    return flash->write(flash->ctx, sector * FLASH_RING_SECTOR_SIZE, header, sizeof(header));
+}
+
+bool flash_ring_is_erased(const Flash_ring_io_t *flash, uint32_t sector, uint32_t offset)
+{
+    uint8_t bytes[64];
+    while (offset < FLASH_RING_SECTOR_SIZE) {
+        uint32_t size = FLASH_RING_SECTOR_SIZE - offset < sizeof(bytes) ? FLASH_RING_SECTOR_SIZE - offset : sizeof(bytes);
+        if (flash->read(flash->ctx, sector * FLASH_RING_SECTOR_SIZE + offset, bytes, size) != ESP_OK) {
+            return false;
+        }
+        for (uint32_t i = 0; i < size; i++) {
+            if (bytes[i] != 0xFF) {
+                return false;
+            }
+        }
+        offset += size;
+    }
+    return true;
+}
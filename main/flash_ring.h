@@ -0,0 +1,113 @@
+#ifndef FLASH_RING_H
+#define FLASH_RING_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#define FLASH_RING_SECTOR_SIZE 4096
+#define FLASH_RING_HEADER_SIZE 12   // Magic, sequence, CRC of both, little endian
+
+/**
+ * @brief NOR flash access, a partition on the board or a file on the host
+ *
+ * The area is used as a ring of sectors, by the journal and the archive:
+ * each sector starts with a header holding the area's magic and an
+ * increasing sequence number, the newest one is written next. Writes can
+ * only clear bits, erasing a sector sets all of its bytes to 0xFF. Offsets
+ * are relative to the start of the area.
+ */
+typedef struct {
+    esp_err_t (*read)(void *ctx, uint32_t offset, void *data, size_t size);
+    esp_err_t (*write)(void *ctx, uint32_t offset, const void *data, size_t size);
+    esp_err_t (*erase_sector)(void *ctx, uint32_t offset);
+    void *ctx;
+    uint32_t size;          // A multiple of FLASH_RING_SECTOR_SIZE, two sectors at least
+} Flash_ring_io_t;
+
+static inline void flash_ring_put_u16(uint8_t *bytes, uint16_t value)
+{
+    bytes[0] = (uint8_t)value;
+    bytes[1] = (uint8_t)(value >> 8);
+}
+
+static inline uint16_t flash_ring_get_u16(const uint8_t *bytes)
+{
+    return (uint16_t)(bytes[0] | bytes[1] << 8);
+}
+
+static inline void flash_ring_put_u32(uint8_t *bytes, uint32_t value)
+{
+    bytes[0] = (uint8_t)value;
+    bytes[1] = (uint8_t)(value >> 8);
+    bytes[2] = (uint8_t)(value >> 16);
+    bytes[3] = (uint8_t)(value >> 24);
+}
+
+static inline uint32_t flash_ring_get_u32(const uint8_t *bytes)
+{
+    return bytes[0] | (uint32_t)bytes[1] << 8 | (uint32_t)bytes[2] << 16 | (uint32_t)bytes[3] << 24;
+}
+
+static inline void flash_ring_put_u64(uint8_t *bytes, uint64_t value)
+{
+    flash_ring_put_u32(bytes, (uint32_t)value);
+    flash_ring_put_u32(bytes + 4, (uint32_t)(value >> 32));
+}
+
+static inline uint64_t flash_ring_get_u64(const uint8_t *bytes)
+{
+    return flash_ring_get_u32(bytes) | (uint64_t)flash_ring_get_u32(bytes + 4) << 32;
+}
+
+// Sequence numbers wrap, the newer one is less than half the range ahead
+static inline bool flash_ring_sequence_after(uint32_t a, uint32_t b)
+{
+    return (int32_t)(a - b) > 0;
+}
+
+/**
+ * @brief Number of sectors in the area
+ *
+ * @param flash The flash area
+ * @return uint32_t Its size in FLASH_RING_SECTOR_SIZE sectors
+ */
+static inline uint32_t flash_ring_sector_count(const Flash_ring_io_t *flash)
+{
+    return flash->size / FLASH_RING_SECTOR_SIZE;
+}
+
+/**
+ * @brief Read the header of a sector
+ *
+ * @param flash The flash area
+ * @param sector The sector
+ * @param magic The magic of the area
+ * @param sequence Set to the sequence number read
+ * @return true if the header holds the magic and its CRC is right
+ */
+bool flash_ring_read_header(const Flash_ring_io_t *flash, uint32_t sector, uint32_t magic, uint32_t *sequence);
+
+/**
+ * @brief Write the header of an erased sector
+ *
+ * @param flash The flash area
+ * @param sector The sector
+ * @param magic The magic of the area
+ * @param sequence Sequence number of the sector
+ * @return esp_err_t The error of the write
+ */
+esp_err_t flash_ring_write_header(const Flash_ring_io_t *flash, uint32_t sector, uint32_t magic, uint32_t sequence);
+
+/**
+ * @brief Check that nothing was written from an offset to the end of a sector
+ *
+ * @param flash The flash area
+ * @param sector The sector
+ * @param offset Offset in the sector
+ * @return true if every byte is 0xFF, false if one is not or a read fails
+ */
+bool flash_ring_is_erased(const Flash_ring_io_t *flash, uint32_t sector, uint32_t offset);
+
+#endif
@@ -0,0 +1,337 @@
+#include <stdio.h>
+#include <string.h>
+#include "board.h"
+#include "game.h"
+#include "pgn.h"
+#include "trace.h"
+#include "sdkconfig.h"
+
+#if CONFIG_CHESSY_TELEMETRY
+// The console carries telemetry frames, tools follow the board from those
+#define print_board(board) ((void)(board))
+#endif
+
+// Verify that the physical board matches the expected state, errors gets every mismatching square
+static bool verify_board_state(const char board[8][8], Bitboard_t occupancy, Bitboard_t *errors)
+{
+    *errors = 0;
+    for (int row = 0; row < 8; row++) {
+        for (int col = 0; col < 8; col++) {
+            int sq = SQUARE(row, col);
+            bool magnet = occupancy & BB_SQUARE(sq);
+            // If there's a piece in the board array, there should be a magnet detected
+            if (board[row][col] != ' ' && !magnet) {
+                TRACE_INFO(TRACE_SETUP_MISSING, sq, 0);
+                *errors |= BB_SQUARE(sq);
+            }
+            // If there's no piece in the board array, there should be no magnet detected
+            if (board[row][col] == ' ' && magnet) {
+                TRACE_INFO(TRACE_SETUP_EXTRA, sq, 0);
+                *errors |= BB_SQUARE(sq);
+            }
+        }
+    }
+    return *errors == 0;
+}
+
+static void add_move(Game_t *game, Chess_move_t move)
+{
+    // Update the position, the char board is only a view of it
+    int from = MOVE_FROM(move), to = MOVE_TO(move);
+    printf("moving %c from %c%c to %c%c\n", game->board[SQUARE_RANK(from)][SQUARE_FILE(from)],
+           'a' + SQUARE_FILE(from), '1' + SQUARE_RANK(from), 'a' + SQUARE_FILE(to), '1' + SQUARE_RANK(to));
+    Game_undo_t *entry = &game->undo[game->record.count % GAME_UNDO_PLIES];
+    entry->move = move;
+    make_move_undo(&game->pos, move, &entry->undo);
+    TRACE_INFO(TRACE_MOVE_PLAYED, move, game->pos.key);
+    board_from_position(&game->pos, game->board);
+    move_recognizer_build(&game->recognizer, &game->pos);
+    if (!game_record_append(&game->record, move, game->pos.key)) {
+        printf("Error: Out of memory, move not recorded\n");
+        // The ring follows the record, it no longer does
+        game->undo_count = 0;
+    } else if (game->undo_count < GAME_UNDO_PLIES) {
+        game->undo_count++;
+    }
+
+    Move_list_t replies;
+    game->over = true;
+    if (generate_legal_moves(&game->pos, &replies) == 0) {
+        printf("Game over, %s\n", is_in_check(&game->pos) ? "checkmate" : "stalemate");
+        print_move_list(game);
+    } else if (game_record_repetitions(&game->record, &game->pos) >= 2) {
+        printf("Draw by threefold repetition\n");
+        print_move_list(game);
+    } else if (game->pos.halfmove_clock >= 100) {
+        printf("Draw by the 50-move rule\n");
+        print_move_list(game);
+    } else {
+        game->over = false;
+    }
+}
+
+static void update_scene(Game_t *game)
+{
+    Led_scene_t *scene = &game->scene;
+    scene->position_key = game->pos.key;
+    scene->occupancy = game->occupancy;
+    scene->black_pieces = game->pos.colors[SIDE_BLACK];
+    scene->selected = game->selected_sq >= 0 ? BB_SQUARE(game->selected_sq) : 0;
+    scene->targets = 0;
+    if (game->selected_sq >= 0) {
+        for (int i = 0; i < game->selected_moves.count; i++) {
+            scene->targets |= BB_SQUARE(MOVE_TO(game->selected_moves.moves[i]));
+        }
+    }
+    if (game->state == GAME_STATE_TAKEBACK) {
+        // Green where a piece goes back, red where one must be lifted
+        Bitboard_t occupied = position_occupied(&game->pos);
+        scene->targets = occupied & ~game->occupancy;
+        scene->errors = game->occupancy & ~occupied;
+    }
+}
+
+static void set_feedback(Game_t *game, Led_feedback_t feedback, int sq)
+{
+    game->scene.feedback = (uint8_t)feedback;
+    game->scene.feedback_square = (uint8_t)sq;
+}
+
+void game_init(Game_t *game, bool check_setup)
+{
+    Chess_position_t start;
+    position_set_start(&start);
+    game_init_from(game, &start, check_setup);
+}
+
+void game_init_from(Game_t *game, const Chess_position_t *pos, bool check_setup)
+{
+    memset(game, 0, sizeof(*game));
+    game->pos = *pos;
+    board_from_position(&game->pos, game->board);
+    game_record_init(&game->record, &game->pos);
+    move_recognizer_build(&game->recognizer, &game->pos);
+    print_board(game->board);
+    game->state = check_setup ? GAME_STATE_SETUP : GAME_STATE_PLAYING;
+    game->selected_sq = -1;
+    if (check_setup) {
+        game->scene.errors = position_occupied(&game->pos);
+    }
+    update_scene(game);
+}
+
+void game_resume(Game_t *game, Game_record_t *record)
+{
+    game_record_clear(&game->record);
+    game->record = *record;
+    record->head = NULL;
+    record->tail = NULL;
+    record->count = 0;
+    game->pos = record->start;
+
+    Chess_move_t move;
+    Game_record_iter_t iter;
+    uint32_t ply = 0;
+    game_record_iter_init(&game->record, &iter);
+    while (game_record_next(&game->record, &iter, &move)) {
+        Game_undo_t *entry = &game->undo[ply++ % GAME_UNDO_PLIES];
+        entry->move = move;
+        make_move_undo(&game->pos, move, &entry->undo);
+    }
+    game->undo_count = ply < GAME_UNDO_PLIES ? (int)ply : GAME_UNDO_PLIES;
+    board_from_position(&game->pos, game->board);
+    move_recognizer_build(&game->recognizer, &game->pos);
+    print_board(game->board);
+    game->state = GAME_STATE_RESUME;
+    game->selected_sq = -1;
+    game->touched = 0;
+    game->scene.errors = game->occupancy ^ position_occupied(&game->pos);
+    update_scene(game);
+}
+
+void game_free(Game_t *game)
+{
+    game_record_clear(&game->record);
+}
+
+// Play the move the board shows, as soon as it is the only one it can be
+static bool try_move(Game_t *game)
+{
+    Chess_move_t move = move_recognizer_match(&game->recognizer, game->occupancy, game->touched);
+    if (move == MOVE_NONE) {
+        return false;
+    }
+    add_move(game, move);
+    print_board(game->board);
+    set_feedback(game, LED_FEEDBACK_VALID, MOVE_TO(move));
+    game->selected_sq = -1;
+    game->touched = 0;
+    return true;
+}
+
+// The piece that made the last move put back on its from square, the rest of the move is guided by the LEDs
+static bool try_takeback(Game_t *game, int sq)
+{
+    if (game->undo_count == 0 || game->selected_sq >= 0) {
+        return false;
+    }
+    Chess_move_t last = game->undo[(game->record.count - 1) % GAME_UNDO_PLIES].move;
+    int from = MOVE_FROM(last), to = MOVE_TO(last);
+    Bitboard_t reversed = (position_occupied(&game->pos) & ~BB_SQUARE(to)) | BB_SQUARE(from);
+    if (sq != from || !(game->touched & BB_SQUARE(to)) || game->occupancy != reversed) {
+        return false;
+    }
+    game_takeback(game, 1);
+    set_feedback(game, LED_FEEDBACK_CANCEL, sq);
+    return true;
+}
+
+static void handle_lift(Game_t *game, int sq)
+{
+    game->touched |= BB_SQUARE(sq);
+    // Lifting the pawn taken en passant can be the last step of the move
+    if (try_move(game)) {
+        return;
+    }
+
+    // The first lifted piece of the side to move is the one moving,
+    // an opponent piece lifted before or after it is being captured
+    if (game->selected_sq >= 0) {
+        return;
+    }
+    if (game->board[SQUARE_RANK(sq)][SQUARE_FILE(sq)] == ' ') {
+        printf("Error: No piece at that position\n");
+        return;
+    }
+    if (!(game->pos.colors[game->pos.side_to_move] & BB_SQUARE(sq))) {
+        return;
+    }
+    game->selected_sq = sq;
+    generate_legal_moves_from(&game->pos, sq, &game->selected_moves);
+}
+
+static void handle_place(Game_t *game, int sq)
+{
+    if (try_move(game) || try_takeback(game, sq)) {
+        return;
+    }
+    // Ignore pieces put back before anything was picked up
+    if (game->selected_sq < 0) {
+        return;
+    }
+
+    bool target = false;
+    for (int i = 0; i < game->selected_moves.count; i++) {
+        target |= MOVE_TO(game->selected_moves.moves[i]) == sq;
+    }
+
+    if (sq == game->selected_sq) {
+        printf("Returning piece to original location, no move added to list.\n");
+        set_feedback(game, LED_FEEDBACK_CANCEL, sq);
+        game->selected_sq = -1;
+    } else if (!target) {
+        TRACE_INFO(TRACE_MOVE_REJECTED, sq, 0);
+        printf("Invalid move\n");
+        printf("Please pick a valid move or return piece to the original position\n");
+        set_feedback(game, LED_FEEDBACK_INVALID, sq);
+    }
+    // On a target square the rest of the move is still to come, the castling rook or the pawn taken en passant
+}
+
+void game_handle_event(Game_t *game, const Hall_event_t *event)
+{
+    if (event->type == HALL_EVENT_LIFT) {
+        game->occupancy &= ~BB_SQUARE(event->square);
+    } else {
+        game->occupancy |= BB_SQUARE(event->square);
+    }
+
+    if (game->state != GAME_STATE_PLAYING) {
+        // Checked by game_verify_setup() once the pending events are consumed
+        game->scene.errors = game->occupancy ^ position_occupied(&game->pos);
+    } else if (event->type == HALL_EVENT_LIFT) {
+        handle_lift(game, event->square);
+    } else {
+        handle_place(game, event->square);
+    }
+    // Back to the position, whatever was lifted did not lead to a move
+    if (game->occupancy == position_occupied(&game->pos)) {
+        game->touched = 0;
+    }
+
+    update_scene(game);
+}
+
+int game_takeback(Game_t *game, int plies)
+{
+    int taken = 0;
+    for (; taken < plies && game->undo_count > 0; taken++) {
+        const Game_undo_t *entry = &game->undo[(game->record.count - 1) % GAME_UNDO_PLIES];
+        unmake_move(&game->pos, entry->move, &entry->undo);
+        game_record_pop(&game->record);
+        game->undo_count--;
+        TRACE_INFO(TRACE_MOVE_TAKEN_BACK, entry->move, game->pos.key);
+    }
+    if (taken == 0) {
+        printf("No move to take back\n");
+        return 0;
+    }
+
+    printf("Took back %d %s\n", taken, taken == 1 ? "ply" : "plies");
+    game->over = false;
+    board_from_position(&game->pos, game->board);
+    move_recognizer_build(&game->recognizer, &game->pos);
+    print_board(game->board);
+    game->state = GAME_STATE_TAKEBACK;
+    game->selected_sq = -1;
+    game->touched = 0;
+    update_scene(game);
+    return taken;
+}
+
+bool game_verify_setup(Game_t *game)
+{
+    if (game->state == GAME_STATE_PLAYING) {
+        return true;
+    }
+    if (game->state == GAME_STATE_RESUME) {
+        Chess_position_t start;
+        position_set_start(&start);
+        // Pieces set up for a new game rather than the interrupted one
+        if (game->occupancy == position_occupied(&start) && game->occupancy != position_occupied(&game->pos)) {
+            Bitboard_t occupancy = game->occupancy;
+            printf("Starting a new game\n");
+            game_free(game);
+            game_init(game, false);
+            game->occupancy = occupancy;
+            update_scene(game);
+            return true;
+        }
+    }
+    if (verify_board_state(game->board, game->occupancy, &game->scene.errors)) {
+        static const char *const done[] = {
+            [GAME_STATE_SETUP] = "Board setup verified!",
+            [GAME_STATE_RESUME] = "Game resumed!",
+            [GAME_STATE_TAKEBACK] = "Takeback done!",
+        };
+        printf("%s\n", done[game->state]);
+        game->state = GAME_STATE_PLAYING;
+        update_scene(game);
+        return true;
+    }
+    printf("Board setup incorrect. Please fix the %d highlighted squares.\n", bb_popcount(game->scene.errors));
+    update_scene(game);
+    return false;
+}
+
+void game_take_scene(Game_t *game, Led_scene_t *scene)
+{
+    *scene = game->scene;
+    // Feedback is a one-shot flash, the next scene must not repeat it
+    set_feedback(game, LED_FEEDBACK_NONE, SQUARE_NONE);
+}
+
+void print_move_list(const Game_t *game)
+{
+    pgn_write(stdout, &game->record, NULL);
+}
@@ -0,0 +1,175 @@
+#ifndef GAME_H
+#define GAME_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "position.h"
+#include "moves.h"
+#include "game_record.h"
+#include "move_recognizer.h"
+#include "hall_events.h"
+
+// Plies that can be taken back, older ones are forgotten
+#define GAME_UNDO_PLIES 64
+
+/**
+ * @brief Short LED flash acknowledging a piece placement
+ *
+ */
+typedef enum {
+    LED_FEEDBACK_NONE = 0,
+    LED_FEEDBACK_VALID,    // The move was accepted
+    LED_FEEDBACK_CANCEL,   // The piece went back to where it came from
+    LED_FEEDBACK_INVALID,  // The piece was put on a square it cannot move to
+} Led_feedback_t;
+
+/**
+ * @brief Everything the LED task needs to draw the board
+ *
+ */
+typedef struct {
+    uint64_t position_key;    // Key of the position drawn, matches engine hints to it
+    Bitboard_t occupancy;     // Squares where a magnet is detected
+    Bitboard_t black_pieces;  // Squares holding a black piece in the position
+    Bitboard_t selected;      // The lifted piece
+    Bitboard_t targets;       // Legal destinations of the lifted piece
+    Bitboard_t errors;        // Squares that disagree with the position
+    uint8_t feedback;         // Led_feedback_t
+    uint8_t feedback_square;
+} Led_scene_t;
+
+/**
+ * @brief Game state machine states
+ *
+ */
+typedef enum {
+    GAME_STATE_SETUP = 0,  // Waiting for the pieces to match the starting position of the game
+    GAME_STATE_PLAYING,
+    GAME_STATE_RESUME,     // Waiting for the pieces to match a resumed game, or the starting position for a new one
+    GAME_STATE_TAKEBACK,   // Waiting for the pieces to match the position before the moves taken back
+} Game_state_t;
+
+/**
+ * @brief A move played and what it destroyed
+ *
+ */
+typedef struct {
+    Chess_move_t move;
+    Move_undo_t undo;
+} Game_undo_t;
+
+/**
+ * @brief The game logic, driven by debounced hall events
+ *
+ * It has no FreeRTOS or hardware dependency, so the same code runs in the
+ * game task and on the host.
+ */
+typedef struct {
+    Game_state_t state;
+    Chess_position_t pos;
+    char board[8][8];       // Char view of pos
+    Bitboard_t occupancy;   // Physical occupancy built from the events
+    Bitboard_t touched;     // Squares lifted since the last move, captures need their target here
+    Move_recognizer_t recognizer;  // Moves of pos by occupancy change
+    int selected_sq;        // Square of the lifted piece, -1 if none
+    Move_list_t selected_moves;
+    Game_record_t record;   // Moves played since game_init
+    Game_undo_t undo[GAME_UNDO_PLIES];  // Ring of the last plies, the last move at (record.count - 1) % GAME_UNDO_PLIES
+    int undo_count;         // Plies of the ring that can be taken back
+    bool over;              // The last move mated, stalemated or drew by repetition or the 50-move rule
+    Led_scene_t scene;
+} Game_t;
+
+/**
+ * @brief Start a new game from the initial position
+ *
+ * The game must not hold a record yet, see game_free().
+ * The physical occupancy starts empty and is filled by the PLACE events of
+ * the first scans.
+ *
+ * @param game The game
+ * @param check_setup Wait for the pieces to match the position before accepting moves
+ */
+void game_init(Game_t *game, bool check_setup);
+
+/**
+ * @brief Start a new game from any position, a puzzle for example
+ *
+ * Same as game_init() otherwise, the record starts at the position.
+ *
+ * @param game The game
+ * @param pos The starting position
+ * @param check_setup Wait for the pieces to match the position before accepting moves
+ */
+void game_init_from(Game_t *game, const Chess_position_t *pos, bool check_setup);
+
+/**
+ * @brief Continue a game recorded before a reset
+ *
+ * The game waits in GAME_STATE_RESUME for the board to show the position
+ * reached. A board set up in the starting position instead starts a new
+ * game.
+ *
+ * @param game A game from game_init()
+ * @param record The moves so far, the game takes over its chunks and leaves it empty
+ */
+void game_resume(Game_t *game, Game_record_t *record);
+
+/**
+ * @brief Release the memory of a game's record
+ *
+ * @param game The game
+ */
+void game_free(Game_t *game);
+
+/**
+ * @brief Feed one debounced lift or place
+ *
+ * @param game The game
+ * @param event The event
+ */
+void game_handle_event(Game_t *game, const Hall_event_t *event);
+
+/**
+ * @brief Take back the last moves
+ *
+ * Each ply is undone in constant time. The game then waits in
+ * GAME_STATE_TAKEBACK, the scene showing where pieces must go back and
+ * which squares must be cleared, until the board matches the position.
+ * Putting the last moved piece back on its from square takes the move
+ * back the same way.
+ *
+ * @param game The game
+ * @param plies Number of plies to take back
+ * @return int Number of plies taken back, fewer if the game or the undo ring is shorter
+ */
+int game_takeback(Game_t *game, int plies);
+
+/**
+ * @brief Check the physical board against the position to set up
+ *
+ * Prints the mismatching squares, and starts or continues the game once
+ * there are none.
+ * Does nothing once the game is playing.
+ *
+ * @param game The game
+ * @return true if the game is playing
+ */
+bool game_verify_setup(Game_t *game);
+
+/**
+ * @brief Copy the scene to draw and clear its one-shot feedback
+ *
+ * @param game The game
+ * @param scene The scene to fill
+ */
+void game_take_scene(Game_t *game, Led_scene_t *scene);
+
+/**
+ * @brief Print the moves played so far as a PGN game
+ *
+ * @param game The game
+ */
+void print_move_list(const Game_t *game);
+
+#endif
@@ -0,0 +1,95 @@
+#include <stdlib.h>
+#include <time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include "game_archive.h"
+#include "archive.h"
+#include "pgn.h"
+
+#define ARCHIVE_TASK_PRIORITY 2   // Below the journal, games only need to reach the flash eventually
+#define ARCHIVE_TASK_STACK 4096
+#define ARCHIVE_QUEUE_LEN 4
+#define ARCHIVE_DATE_MIN 1577836800   // 2020-01-01, an earlier clock was never set
+
+typedef struct {
+    uint8_t *data;            // Encoded game, freed by the archive task
+    size_t size;
+} Archive_message_t;
+
+static const char *TAG = "ARCHIVE";
+
+static QueueHandle_t message_queue;
+static Archive_t archive;         // Only touched by the archive task once it runs
+
+static void archive_task(void *arg)
+{
+    Archive_message_t message;
+    while (1) {
+        xQueueReceive(message_queue, &message, portMAX_DELAY);
+        esp_err_t err = archive_write(&archive, message.data, message.size);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Archive write failed: %s", esp_err_to_name(err));
+        }
+        free(message.data);
+    }
+}
+
+void game_archive_start(void)
+{
+    Flash_ring_io_t flash;
+    if (archive_open_partition(&flash) != ESP_OK) {
+        ESP_LOGW(TAG, "No archive partition, finished games are not kept");
+        return;
+    }
+    archive_init(&archive, &flash);
+
+    Archive_iter_t iter;
+    Archive_entry_t entry;
+    unsigned int count = 0;
+    archive_iter_init(&archive, &iter);
+    while (archive_next(&archive, &iter, &entry)) {
+        count++;
+    }
+    ESP_LOGI(TAG, "%u games archived", count);
+
+    message_queue = xQueueCreate(ARCHIVE_QUEUE_LEN, sizeof(Archive_message_t));
+    if (!message_queue ||
+            xTaskCreate(archive_task, "archive", ARCHIVE_TASK_STACK, NULL, ARCHIVE_TASK_PRIORITY, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "Cannot start the archive task");
+        message_queue = NULL;
+    }
+}
+
+bool game_archive_save(const Game_record_t *record)
+{
+    if (!message_queue) {
+        return false;
+    }
+    Archive_message_t message = {.data = malloc(ARCHIVE_GAME_MAX)};
+    if (!message.data) {
+        ESP_LOGW(TAG, "No memory to archive the game");
+        return false;
+    }
+    time_t now = time(NULL);
+    uint32_t date = now >= ARCHIVE_DATE_MIN ? (uint32_t)now : 0;
+    message.size = archive_encode(record, archive_result_from_pgn(pgn_result(record)), date, message.data,
+                                  ARCHIVE_GAME_MAX);
+    if (message.size == 0) {
+        ESP_LOGW(TAG, "Game of %u plies too long to archive", (unsigned int)record->count);
+        free(message.data);
+        return false;
+    }
+    // Only keep what the encoding needs while the game waits for the flash
+    uint8_t *shrunk = realloc(message.data, message.size);
+    if (shrunk) {
+        message.data = shrunk;
+    }
+    if (xQueueSend(message_queue, &message, 0) != pdTRUE) {
+        ESP_LOGW(TAG, "Archive queue full, game dropped");
+        free(message.data);
+        return false;
+    }
+    return true;
+}
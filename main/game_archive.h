@@ -0,0 +1,26 @@
+#ifndef GAME_ARCHIVE_H
+#define GAME_ARCHIVE_H
+
+#include <stdbool.h>
+#include "game_record.h"
+
+/**
+ * @brief Open the archive partition and start the task writing it
+ *
+ * Without an archive partition finished games are not archived.
+ */
+void game_archive_start(void);
+
+/**
+ * @brief Archive a finished game
+ *
+ * The game is encoded right away and a low priority task writes it, so the
+ * caller never waits on the flash. Never blocks: a game that does not fit
+ * the queue is dropped with a warning.
+ *
+ * @param record The game
+ * @return true if it was queued
+ */
+bool game_archive_save(const Game_record_t *record);
+
+#endif
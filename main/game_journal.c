@@ -0,0 +1,124 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+#include "game_journal.h"
+#include "journal.h"
+
+#define JOURNAL_TASK_PRIORITY 3   // Below the game and LED tasks, above the engine
+#define JOURNAL_TASK_STACK 4096
+#define JOURNAL_QUEUE_LEN 16
+#define JOURNAL_RETRY_MS 1000
+
+typedef enum {
+    JOURNAL_MESSAGE_NEW_GAME,
+    JOURNAL_MESSAGE_MOVE,
+} Journal_message_type_t;
+
+typedef struct {
+    Journal_message_type_t type;
+    Chess_move_t move;
+    Chess_position_t start;   // New games only
+} Journal_message_t;
+
+static const char *TAG = "JOURNAL";
+
+static QueueHandle_t message_queue;
+static Journal_t journal;         // Only touched by the journal task once it runs
+
+// What the journal was sent, only touched by the game task
+static uint64_t sent_start_key;
+static uint32_t sent_count;
+static bool sent_game;
+
+static void journal_task(void *arg)
+{
+    Journal_message_t message;
+    TickType_t first_pending = 0;
+
+    while (1) {
+        // Messages arriving within the flush delay of the first one share a flash write
+        TickType_t wait = portMAX_DELAY;
+        if (journal_pending(&journal)) {
+            TickType_t age = xTaskGetTickCount() - first_pending;
+            wait = age < pdMS_TO_TICKS(CONFIG_CHESSY_JOURNAL_FLUSH_MS) ? pdMS_TO_TICKS(CONFIG_CHESSY_JOURNAL_FLUSH_MS) - age : 0;
+        }
+        if (xQueueReceive(message_queue, &message, wait) == pdTRUE) {
+            if (!journal_pending(&journal)) {
+                first_pending = xTaskGetTickCount();
+            }
+            if (message.type == JOURNAL_MESSAGE_NEW_GAME) {
+                journal_new_game(&journal, &message.start);
+            } else {
+                journal_add_move(&journal, message.move);
+            }
+            continue;
+        }
+
+        esp_err_t err = journal_flush(&journal);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Journal write failed: %s", esp_err_to_name(err));
+            vTaskDelay(pdMS_TO_TICKS(JOURNAL_RETRY_MS));
+        }
+    }
+}
+
+bool game_journal_start(Game_record_t *record, Chess_position_t *pos)
+{
+    Flash_ring_io_t flash;
+    if (journal_open_partition(&flash) != ESP_OK) {
+        ESP_LOGW(TAG, "No journal partition, games are not resumed after a reset");
+        position_set_start(pos);
+        game_record_init(record, pos);
+        return false;
+    }
+
+    journal_init(&journal, &flash);
+    bool resumed = journal_replay(&journal, record, pos);
+    if (resumed) {
+        ESP_LOGI(TAG, "Resuming a game of %u moves from its journal", (unsigned int)record->count);
+    } else {
+        game_record_clear(record);
+        position_set_start(pos);
+        game_record_init(record, pos);
+    }
+    sent_game = resumed;
+    sent_start_key = record->start.key;
+    sent_count = record->count;
+
+    message_queue = xQueueCreate(JOURNAL_QUEUE_LEN, sizeof(Journal_message_t));
+    if (!message_queue ||
+            xTaskCreate(journal_task, "journal", JOURNAL_TASK_STACK, NULL, JOURNAL_TASK_PRIORITY, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "Cannot start the journal task");
+        message_queue = NULL;
+    }
+    return resumed;
+}
+
+void game_journal_sync(const Game_record_t *record)
+{
+    if (!message_queue) {
+        return;
+    }
+    Journal_message_t message;
+    if (!sent_game || record->start.key != sent_start_key || record->count < sent_count) {
+        message.type = JOURNAL_MESSAGE_NEW_GAME;
+        message.start = record->start;
+        if (xQueueSend(message_queue, &message, 0) != pdTRUE) {
+            return;
+        }
+        sent_game = true;
+        sent_start_key = record->start.key;
+        sent_count = 0;
+    }
+
+    message.type = JOURNAL_MESSAGE_MOVE;
+    while (sent_count < record->count) {
+        message.move = game_record_get(record, sent_count);
+        if (xQueueSend(message_queue, &message, 0) != pdTRUE) {
+            return;
+        }
+        sent_count++;
+    }
+}
@@ -0,0 +1,33 @@
+#ifndef GAME_JOURNAL_H
+#define GAME_JOURNAL_H
+
+#include <stdbool.h>
+#include "esp_err.h"
+#include "game_record.h"
+
+/**
+ * @brief Replay the journal partition and start the task writing it
+ *
+ * The game found in the journal is rebuilt synchronously, then a low
+ * priority task takes over the flash writes, so neither the game task nor
+ * the scan task ever waits on the flash. Without a journal partition
+ * nothing is replayed or recorded.
+ *
+ * @param record Initialized with the game in progress, or an empty game from the start position
+ * @param pos Set to the position reached
+ * @return true if a game in progress was found
+ */
+bool game_journal_start(Game_record_t *record, Chess_position_t *pos);
+
+/**
+ * @brief Queue the moves of a record not sent to the journal yet
+ *
+ * A record with another start, or fewer moves than already sent, is
+ * journaled as a new game. Never blocks: when the queue is full the
+ * remaining moves are sent by the next call.
+ *
+ * @param record The game
+ */
+void game_journal_sync(const Game_record_t *record);
+
+#endif
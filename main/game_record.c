@@ -0,0 +1,174 @@
+#include <stdlib.h>
+#include <string.h>
+#include "game_record.h"
+
+#ifdef ESP_PLATFORM
+#include "esp_heap_caps.h"
+#endif
+
+static Game_record_chunk_t *chunk_alloc(void)
+{
+#ifdef ESP_PLATFORM
+    // Internal RAM is kept for the tasks, falls back to it without PSRAM
+    return heap_caps_malloc_prefer(sizeof(Game_record_chunk_t), 2,
+                                   MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT, MALLOC_CAP_DEFAULT);
+#else
+    return malloc(sizeof(Game_record_chunk_t));
+#endif
+}
+
+static void chunk_free(Game_record_chunk_t *chunk)
+{
+#ifdef ESP_PLATFORM
+    heap_caps_free(chunk);
+#else
+    free(chunk);
+#endif
+}
+
+void game_record_init(Game_record_t *record, const Chess_position_t *start)
+{
+    memset(record, 0, sizeof(*record));
+    record->start = *start;
+}
+
+void game_record_clear(Game_record_t *record)
+{
+    Game_record_chunk_t *chunk = record->head;
+    while (chunk) {
+        Game_record_chunk_t *next = chunk->next;
+        chunk_free(chunk);
+        chunk = next;
+    }
+    record->head = NULL;
+    record->tail = NULL;
+    record->count = 0;
+}
+
+bool game_record_append(Game_record_t *record, Chess_move_t move, uint64_t key)
+{
+    uint32_t offset = record->count % GAME_RECORD_CHUNK_MOVES;
+    if (offset == 0) {
+        Game_record_chunk_t *chunk = chunk_alloc();
+        if (!chunk) {
+            return false;
+        }
+        chunk->next = NULL;
+        chunk->prev = record->tail;
+        if (record->tail) {
+            record->tail->next = chunk;
+        } else {
+            record->head = chunk;
+        }
+        record->tail = chunk;
+    }
+    record->tail->moves[offset] = move;
+    record->tail->keys[offset] = key;
+    record->count++;
+    return true;
+}
+
+bool game_record_pop(Game_record_t *record)
+{
+    if (record->count == 0) {
+        return false;
+    }
+    record->count--;
+    // The chunk a new move would start is allocated again by game_record_append()
+    if (record->count % GAME_RECORD_CHUNK_MOVES == 0) {
+        Game_record_chunk_t *chunk = record->tail;
+        record->tail = chunk->prev;
+        if (record->tail) {
+            record->tail->next = NULL;
+        } else {
+            record->head = NULL;
+        }
+        chunk_free(chunk);
+    }
+    return true;
+}
+
+Chess_move_t game_record_get(const Game_record_t *record, uint32_t index)
+{
+    const Game_record_chunk_t *chunk = record->head;
+    for (uint32_t i = index / GAME_RECORD_CHUNK_MOVES; i > 0; i--) {
+        chunk = chunk->next;
+    }
+    return chunk->moves[index % GAME_RECORD_CHUNK_MOVES];
+}
+
+int game_record_repetitions(const Game_record_t *record, const Chess_position_t *pos)
+{
+    // Ply distance back to the start position, then to the last irreversible move
+    int plies = record->count;
+    int limit = pos->halfmove_clock < plies ? pos->halfmove_clock : plies;
+    int repetitions = 0;
+
+    // Walk back from the position before the last move, chunk by chunk
+    const Game_record_chunk_t *chunk = record->tail;
+    int index = plies - 1;
+    for (int distance = 1; distance <= limit; distance++) {
+        index--;
+        if (index < 0) {
+            // The start position, only reached when the whole game is reversible
+            repetitions += distance % 2 == 0 && record->start.key == pos->key;
+            break;
+        }
+        if (index % GAME_RECORD_CHUNK_MOVES == GAME_RECORD_CHUNK_MOVES - 1) {
+            chunk = chunk->prev;
+        }
+        // The side to move has to match too
+        if (distance % 2 == 0 && chunk->keys[index % GAME_RECORD_CHUNK_MOVES] == pos->key) {
+            repetitions++;
+        }
+    }
+    return repetitions;
+}
+
+int game_record_recent_keys(const Game_record_t *record, const Chess_position_t *pos, uint64_t *keys, int max)
+{
+    int plies = record->count;
+    int count = pos->halfmove_clock < plies ? pos->halfmove_clock : plies;
+    if (count > max) {
+        count = max;
+    }
+
+    // Filled from the newest, at the end of the buffer
+    const Game_record_chunk_t *chunk = record->tail;
+    int index = plies - 1;
+    for (int i = count - 1; i >= 0; i--) {
+        index--;
+        if (index < 0) {
+            keys[i] = record->start.key;
+            break;
+        }
+        if (index % GAME_RECORD_CHUNK_MOVES == GAME_RECORD_CHUNK_MOVES - 1) {
+            chunk = chunk->prev;
+        }
+        keys[i] = chunk->keys[index % GAME_RECORD_CHUNK_MOVES];
+    }
+    return count;
+}
+
+void game_record_iter_init(const Game_record_t *record, Game_record_iter_t *iter)
+{
+    iter->chunk = record->head;
+    iter->index = 0;
+}
+
+bool game_record_next(const Game_record_t *record, Game_record_iter_t *iter, Chess_move_t *move)
+{
+    if (iter->index >= record->count) {
+        return false;
+    }
+    // Step to the next chunk lazily, so moves appended during the walk are seen
+    uint32_t offset = iter->index % GAME_RECORD_CHUNK_MOVES;
+    if (!iter->chunk) {
+        iter->chunk = record->head;
+    } else if (offset == 0 && iter->index > 0) {
+        iter->chunk = iter->chunk->next;
+    }
+    *move = iter->chunk->moves[offset];
+    iter->index++;
+    return true;
+}
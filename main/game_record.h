@@ -0,0 +1,126 @@
+#ifndef GAME_RECORD_H
+#define GAME_RECORD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "position.h"
+#include "moves.h"
+
+// 2.5 KB per chunk, about 128 moves per side
+#define GAME_RECORD_CHUNK_MOVES 256
+
+typedef struct Game_record_chunk {
+    struct Game_record_chunk *next;
+    struct Game_record_chunk *prev;
+    Chess_move_t moves[GAME_RECORD_CHUNK_MOVES];
+    uint64_t keys[GAME_RECORD_CHUNK_MOVES];  // Key of the position after each move
+} Game_record_chunk_t;
+
+/**
+ * @brief The moves of a game from its starting position
+ *
+ * Moves are stored in a linked list of fixed size chunks, allocated from
+ * PSRAM when the board has it. Appending is O(1) and never moves existing
+ * moves, so a game is only limited by the available memory. The key of
+ * every position is kept next to its move for the repetition rule.
+ */
+typedef struct {
+    Chess_position_t start;
+    Game_record_chunk_t *head;
+    Game_record_chunk_t *tail;
+    uint32_t count;
+} Game_record_t;
+
+/**
+ * @brief Walks the moves of a record in order
+ *
+ */
+typedef struct {
+    const Game_record_chunk_t *chunk;  // Chunk of the last move returned
+    uint32_t index;                    // Index of the next move
+} Game_record_iter_t;
+
+/**
+ * @brief Start an empty record
+ *
+ * @param record The record, must not hold chunks
+ * @param start The position the game starts from
+ */
+void game_record_init(Game_record_t *record, const Chess_position_t *start);
+
+/**
+ * @brief Free every chunk of a record, leaving it empty
+ *
+ * @param record The record
+ */
+void game_record_clear(Game_record_t *record);
+
+/**
+ * @brief Add a move at the end of the record
+ *
+ * @param record The record
+ * @param move The move
+ * @param key Key of the position after the move
+ * @return true if the move was added, false if no chunk could be allocated
+ */
+bool game_record_append(Game_record_t *record, Chess_move_t move, uint64_t key);
+
+/**
+ * @brief Remove the last move of the record, for a takeback
+ *
+ * @param record The record
+ * @return true if a move was removed, false if the record was empty
+ */
+bool game_record_pop(Game_record_t *record);
+
+/**
+ * @brief Get a move by index, O(index / GAME_RECORD_CHUNK_MOVES)
+ *
+ * @param record The record
+ * @param index The index, must be below count
+ * @return Chess_move_t The move
+ */
+Chess_move_t game_record_get(const Game_record_t *record, uint32_t index);
+
+/**
+ * @brief Count earlier occurrences of the current position
+ *
+ * Only the plies since the last capture or pawn move are looked at, since
+ * no position before them can come back.
+ *
+ * @param record The record
+ * @param pos The position after the last move of the record
+ * @return int Number of times the position occurred before, 2 means threefold repetition
+ */
+int game_record_repetitions(const Game_record_t *record, const Chess_position_t *pos);
+
+/**
+ * @brief Get the keys of the positions before the current one that can still repeat
+ *
+ * @param record The record
+ * @param pos The position after the last move of the record
+ * @param keys Filled oldest first
+ * @param max Room in keys, the most recent ones are kept
+ * @return int Number of keys
+ */
+int game_record_recent_keys(const Game_record_t *record, const Chess_position_t *pos, uint64_t *keys, int max);
+
+/**
+ * @brief Start walking a record
+ *
+ * @param record The record
+ * @param iter The iterator to initialize
+ */
+void game_record_iter_init(const Game_record_t *record, Game_record_iter_t *iter);
+
+/**
+ * @brief Get the next move of a walk
+ *
+ * @param record The record
+ * @param iter The iterator
+ * @param move Set to the next move
+ * @return true if there was a move, false at the end of the record
+ */
+bool game_record_next(const Game_record_t *record, Game_record_iter_t *iter, Chess_move_t *move);
+
+#endif
@@ -0,0 +1,87 @@
+#include <string.h>
+#include "hall_events.h"
+
+// Squares whose bit-sliced count is at least threshold
+static Bitboard_t count_at_least(const Bitboard_t count[4], int threshold)
+{
+    Bitboard_t greater = 0;
+    Bitboard_t equal = ~0ULL;
+    for (int bit = 3; bit >= 0; bit--) {
+        if (threshold & (1 << bit)) {
+            equal &= count[bit];
+        } else {
+            greater |= equal & count[bit];
+            equal &= ~count[bit];
+        }
+    }
+    return greater | equal;
+}
+
+static int emit_events(Bitboard_t squares, Hall_event_type_t type, int64_t timestamp_us, Hall_event_t *events)
+{
+    int event_count = 0;
+    while (squares) {
+        events[event_count++] = (Hall_event_t) {
+            .timestamp_us = timestamp_us,
+            .type = type,
+            .square = (uint8_t)bb_pop_lsb(&squares),
+        };
+    }
+    return event_count;
+}
+
+void hall_debouncer_init(Hall_debouncer_t *debouncer, int depth, int votes, Bitboard_t occupancy)
+{
+    if (depth < 1) {
+        depth = 1;
+    } else if (depth > HALL_DEBOUNCE_MAX_DEPTH) {
+        depth = HALL_DEBOUNCE_MAX_DEPTH;
+    }
+    // A majority is needed so that the set and clear conditions never overlap
+    if (votes <= depth / 2) {
+        votes = depth / 2 + 1;
+    } else if (votes > depth) {
+        votes = depth;
+    }
+
+    memset(debouncer, 0, sizeof(*debouncer));
+    debouncer->depth = (uint8_t)depth;
+    debouncer->votes = (uint8_t)votes;
+    for (int i = 0; i < depth; i++) {
+        debouncer->ring[i] = occupancy;
+    }
+    for (int bit = 0; bit < 4; bit++) {
+        debouncer->count[bit] = (depth & (1 << bit)) ? occupancy : 0;
+    }
+    debouncer->stable = occupancy;
+}
+
+int hall_debouncer_update(Hall_debouncer_t *debouncer, Bitboard_t occupancy, int64_t timestamp_us,
+                          Hall_event_t *events)
+{
+    Bitboard_t oldest = debouncer->ring[debouncer->head];
+    debouncer->ring[debouncer->head] = occupancy;
+    debouncer->head = (debouncer->head + 1) % debouncer->depth;
+
+    // Bit-sliced count += newest - oldest, squares present in both are left alone
+    Bitboard_t carry = occupancy & ~oldest;
+    Bitboard_t borrow = oldest & ~occupancy;
+    for (int bit = 0; bit < 4; bit++) {
+        Bitboard_t next_carry = debouncer->count[bit] & carry;
+        debouncer->count[bit] ^= carry;
+        carry = next_carry;
+        Bitboard_t next_borrow = ~debouncer->count[bit] & borrow;
+        debouncer->count[bit] ^= borrow;
+        borrow = next_borrow;
+    }
+
+    // N of M frames occupied sets a square, N of M frames empty clears it
+    Bitboard_t set = count_at_least(debouncer->count, debouncer->votes);
+    Bitboard_t clear = ~count_at_least(debouncer->count, debouncer->depth - debouncer->votes + 1);
+    Bitboard_t previous = debouncer->stable;
+    debouncer->stable = (previous | set) & ~clear;
+
+    int event_count = emit_events(previous & ~debouncer->stable, HALL_EVENT_LIFT, timestamp_us, events);
+    event_count += emit_events(debouncer->stable & ~previous, HALL_EVENT_PLACE, timestamp_us, events + event_count);
+    return event_count;
+}
@@ -0,0 +1,69 @@
+#ifndef HALL_EVENTS_H
+#define HALL_EVENTS_H
+
+#include <stdint.h>
+#include "bitboard.h"
+
+#define HALL_DEBOUNCE_MAX_DEPTH 15
+
+/**
+ * @brief Kind of physical change on a square
+ *
+ */
+typedef enum {
+    HALL_EVENT_LIFT = 0,   // A piece left the square
+    HALL_EVENT_PLACE = 1,  // A piece was put on the square
+} Hall_event_type_t;
+
+/**
+ * @brief A debounced change of one square
+ *
+ */
+typedef struct {
+    int64_t timestamp_us;  // Timestamp of the frame that confirmed the change
+    uint8_t type;          // Hall_event_type_t
+    uint8_t square;
+} Hall_event_t;
+
+/**
+ * @brief N-of-M vote over the last M frames of every square
+ *
+ * The number of frames in which each square was occupied is kept as four
+ * bit-sliced counters, so adding the newest frame and dropping the oldest is
+ * a few bitwise operations for all 64 squares at once.
+ */
+typedef struct {
+    Bitboard_t ring[HALL_DEBOUNCE_MAX_DEPTH];
+    Bitboard_t count[4];   // Bit planes of the per-square occupied count
+    Bitboard_t stable;     // Debounced occupancy
+    uint8_t depth;         // M, frames in the vote
+    uint8_t votes;         // N, frames needed to change state
+    uint8_t head;
+} Hall_debouncer_t;
+
+/**
+ * @brief Initialize the debouncer with a known occupancy
+ *
+ * @param debouncer The debouncer
+ * @param depth Number of frames voting, 1 to HALL_DEBOUNCE_MAX_DEPTH
+ * @param votes Frames that must agree to change a square, more than depth / 2
+ * @param occupancy Occupancy to start from, reported as stable right away
+ */
+void hall_debouncer_init(Hall_debouncer_t *debouncer, int depth, int votes, Bitboard_t occupancy);
+
+/**
+ * @brief Feed a frame and collect the resulting changes
+ *
+ * Events come out in a fixed order: all lifts, then all places, each by
+ * ascending square.
+ *
+ * @param debouncer The debouncer
+ * @param occupancy Raw occupancy of the new frame
+ * @param timestamp_us Timestamp of the new frame
+ * @param events Array of at least 64 events to fill
+ * @return int Number of events written
+ */
+int hall_debouncer_update(Hall_debouncer_t *debouncer, Bitboard_t occupancy, int64_t timestamp_us,
+                          Hall_event_t *events);
+
+#endif
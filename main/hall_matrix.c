@@ -0,0 +1,19 @@
+#include <string.h>
+#include "hall_matrix.h"
+
+void hall_decoder_init(Hall_row_decoder_t *decoder, const uint8_t row_pins[HALL_ROW_NUM], bool active_low)
+{
+    memset(decoder, 0, sizeof(*decoder));
+    for (int row = 0; row < HALL_ROW_NUM; row++) {
+        int byte = row_pins[row] / 8;
+        int bit = row_pins[row] % 8;
+        for (int value = 0; value < 256; value++) {
+            if (value & (1 << bit)) {
+                decoder->row_lut[byte][value] |= 1 << row;
+            }
+        }
+        if (active_low) {
+            decoder->invert_mask |= 1UL << row_pins[row];
+        }
+    }
+}
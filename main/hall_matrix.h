@@ -0,0 +1,66 @@
+#ifndef HALL_MATRIX_H
+#define HALL_MATRIX_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "bitboard.h"
+
+#define HALL_ROW_NUM 8
+#define HALL_COL_NUM 8
+
+/**
+ * @brief Lookup tables turning a GPIO input register value into a row byte
+ *
+ * The row pins are scattered over the register, so each of its four bytes
+ * indexes a table holding the row bits found in that byte.
+ */
+typedef struct {
+    uint8_t row_lut[4][256];
+    uint32_t invert_mask;  // Row pins to invert before lookup, for active low sensors
+} Hall_row_decoder_t;
+
+/**
+ * @brief Build the decoder for a set of row pins
+ *
+ * @param decoder The decoder to fill
+ * @param row_pins GPIO number of each row, all below 32
+ * @param active_low True if a sensor pulls its row low when a magnet is present
+ */
+void hall_decoder_init(Hall_row_decoder_t *decoder, const uint8_t row_pins[HALL_ROW_NUM], bool active_low);
+
+/**
+ * @brief Decode the rows of one column from a GPIO input register value
+ *
+ * @param decoder The decoder
+ * @param in_reg The GPIO input register, sampled while the column is driven
+ * @return uint8_t Bit n set if the sensor on row n sees a magnet
+ */
+static inline uint8_t hall_decode_rows(const Hall_row_decoder_t *decoder, uint32_t in_reg)
+{
+    in_reg ^= decoder->invert_mask;
+    return decoder->row_lut[0][in_reg & 0xFF] | decoder->row_lut[1][(in_reg >> 8) & 0xFF] |
+           decoder->row_lut[2][(in_reg >> 16) & 0xFF] | decoder->row_lut[3][in_reg >> 24];
+}
+
+/**
+ * @brief Turn column-major scan data into an occupancy bitboard
+ *
+ * The scan stores column c's row byte at bits 8c..8c+7; the occupancy uses
+ * bit row * 8 + col like the rest of the code, which is the transpose.
+ *
+ * @param columns Row bytes of all columns, column c in byte c
+ * @return Bitboard_t Occupancy, bit row * 8 + col set if a magnet is present
+ */
+static inline Bitboard_t hall_columns_to_occupancy(uint64_t columns)
+{
+    uint64_t t;
+    t = 0x0F0F0F0F00000000ULL & (columns ^ (columns << 28));
+    columns ^= t ^ (t >> 28);
+    t = 0x3333000033330000ULL & (columns ^ (columns << 14));
+    columns ^= t ^ (t >> 14);
+    t = 0x5500550055005500ULL & (columns ^ (columns << 7));
+    columns ^= t ^ (t >> 7);
+    return columns;
+}
+
+#endif
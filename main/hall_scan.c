@@ -0,0 +1,248 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "driver/gpio.h"
+#include "driver/gptimer.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "soc/gpio_reg.h"
+#include "sdkconfig.h"
+#include "hall_matrix.h"
+#include "hall_scan.h"
+
+#define HALL_COL_SW1 GPIO_NUM_39
+#define HALL_COL_SW2 GPIO_NUM_40
+#define HALL_COL_SW3 GPIO_NUM_41
+#define HALL_COL_SW4 GPIO_NUM_42
+#define HALL_COL_SW5 GPIO_NUM_4
+#define HALL_COL_SW6 GPIO_NUM_5
+#define HALL_COL_SW7 GPIO_NUM_6
+#define HALL_COL_SW8 GPIO_NUM_7
+#define HALL_ROW1 GPIO_NUM_14
+#define HALL_ROW2 GPIO_NUM_13
+#define HALL_ROW3 GPIO_NUM_21
+#define HALL_ROW4 GPIO_NUM_8
+#define HALL_ROW5 GPIO_NUM_15
+#define HALL_ROW6 GPIO_NUM_16
+#define HALL_ROW7 GPIO_NUM_17
+#define HALL_ROW8 GPIO_NUM_18
+
+#define HALL_TIMER_RESOLUTION_HZ (1000 * 1000)
+
+#ifdef CONFIG_CHESSY_HALL_ACTIVE_LOW
+#define HALL_ACTIVE_LOW true
+#else
+#define HALL_ACTIVE_LOW false
+#endif
+
+static const char *TAG = "HALL_SCAN";
+
+static const uint8_t col_pins[HALL_COL_NUM] = {
+    HALL_COL_SW1, HALL_COL_SW2, HALL_COL_SW3, HALL_COL_SW4,
+    HALL_COL_SW5, HALL_COL_SW6, HALL_COL_SW7, HALL_COL_SW8
+};
+
+static const uint8_t row_pins[HALL_ROW_NUM] = {
+    HALL_ROW1, HALL_ROW2, HALL_ROW3, HALL_ROW4,
+    HALL_ROW5, HALL_ROW6, HALL_ROW7, HALL_ROW8
+};
+
+// Output register masks driving each column, GPIO 0-31 and GPIO 32-53
+static uint32_t col_mask_lo[HALL_COL_NUM];
+static uint32_t col_mask_hi[HALL_COL_NUM];
+
+static Hall_row_decoder_t decoder;
+static gptimer_handle_t scan_timer;
+
+// Scan state, only touched by the timer ISR while the timer runs
+static int scan_col;
+static uint64_t scan_columns;
+static bool scan_paused;                 // Between frames, the alarm ends the pause
+static volatile uint32_t scan_gap_us;    // Pause after each frame, set by the scan task
+
+// Double buffered output, the ISR fills the back frame and flips the index under the lock
+static Hall_frame_t frames[2];
+static int front_frame;
+static uint32_t frame_sequence;
+static portMUX_TYPE frame_lock = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t waiting_task;
+
+static inline void IRAM_ATTR column_drive(int col, bool on)
+{
+    if (on) {
+        REG_WRITE(GPIO_OUT_W1TS_REG, col_mask_lo[col]);
+        REG_WRITE(GPIO_OUT1_W1TS_REG, col_mask_hi[col]);
+    } else {
+        REG_WRITE(GPIO_OUT_W1TC_REG, col_mask_lo[col]);
+        REG_WRITE(GPIO_OUT1_W1TC_REG, col_mask_hi[col]);
+    }
+}
+
+static void IRAM_ATTR set_alarm(gptimer_handle_t timer, uint32_t period_us)
+{
+    gptimer_alarm_config_t alarm_config = {
+        .alarm_count = period_us,
+        .reload_count = 0,
+        .flags.auto_reload_on_alarm = true,
+    };
+    gptimer_set_alarm_action(timer, &alarm_config);
+}
+
+static bool IRAM_ATTR hall_scan_on_alarm(gptimer_handle_t timer, const gptimer_alarm_event_data_t *edata, void *user_ctx)
+{
+    // End of the pause, power the first column for a settle period
+    if (scan_paused) {
+        scan_paused = false;
+        column_drive(scan_col, true);
+        set_alarm(timer, CONFIG_CHESSY_HALL_SETTLE_US);
+        return false;
+    }
+
+    // The column has been powered for a full settle period, sample every row at once
+    scan_columns |= (uint64_t)hall_decode_rows(&decoder, REG_READ(GPIO_IN_REG)) << (8 * scan_col);
+    column_drive(scan_col, false);
+    scan_col = (scan_col + 1) % HALL_COL_NUM;
+    if (scan_col != 0) {
+        column_drive(scan_col, true);
+        return false;
+    }
+
+    // The columns stay off through the pause
+    uint32_t gap_us = scan_gap_us;
+    if (gap_us > 0) {
+        scan_paused = true;
+        set_alarm(timer, gap_us);
+    } else {
+        column_drive(scan_col, true);
+    }
+
+    int back_frame = !front_frame;
+    frames[back_frame].occupancy = hall_columns_to_occupancy(scan_columns);
+    frames[back_frame].timestamp_us = esp_timer_get_time();
+    frames[back_frame].sequence = ++frame_sequence;
+    scan_columns = 0;
+
+    portENTER_CRITICAL_ISR(&frame_lock);
+    front_frame = back_frame;
+    TaskHandle_t task = waiting_task;
+    portEXIT_CRITICAL_ISR(&frame_lock);
+
+    BaseType_t woken = pdFALSE;
+    if (task) {
+        vTaskNotifyGiveFromISR(task, &woken);
+    }
+    return woken == pdTRUE;
+}
+
+esp_err_t hall_scan_start(void)
+{
+    ESP_LOGI(TAG, "Initializing hall effect sensors");
+    gpio_config_t io_conf = {
+        .intr_type = GPIO_INTR_DISABLE,
+        .mode = GPIO_MODE_OUTPUT,
+    };
+    for (int col = 0; col < HALL_COL_NUM; col++) {
+        io_conf.pin_bit_mask |= 1ULL << col_pins[col];
+        if (col_pins[col] < 32) {
+            col_mask_lo[col] = 1UL << col_pins[col];
+        } else {
+            col_mask_hi[col] = 1UL << (col_pins[col] - 32);
+        }
+    }
+    ESP_ERROR_CHECK(gpio_config(&io_conf));
+
+    io_conf.mode = GPIO_MODE_INPUT;
+    io_conf.pin_bit_mask = 0;
+    for (int row = 0; row < HALL_ROW_NUM; row++) {
+        io_conf.pin_bit_mask |= 1ULL << row_pins[row];
+    }
+    ESP_ERROR_CHECK(gpio_config(&io_conf));
+
+    hall_decoder_init(&decoder, row_pins, HALL_ACTIVE_LOW);
+    scan_col = 0;
+    column_drive(scan_col, true);
+
+    gptimer_config_t timer_config = {
+        .clk_src = GPTIMER_CLK_SRC_DEFAULT,
+        .direction = GPTIMER_COUNT_UP,
+        .resolution_hz = HALL_TIMER_RESOLUTION_HZ,
+    };
+    ESP_ERROR_CHECK(gptimer_new_timer(&timer_config, &scan_timer));
+
+    gptimer_event_callbacks_t callbacks = {
+        .on_alarm = hall_scan_on_alarm,
+    };
+    ESP_ERROR_CHECK(gptimer_register_event_callbacks(scan_timer, &callbacks, NULL));
+
+    gptimer_alarm_config_t alarm_config = {
+        .alarm_count = CONFIG_CHESSY_HALL_SETTLE_US,
+        .reload_count = 0,
+        .flags.auto_reload_on_alarm = true,
+    };
+    ESP_ERROR_CHECK(gptimer_set_alarm_action(scan_timer, &alarm_config));
+    ESP_ERROR_CHECK(gptimer_enable(scan_timer));
+    ESP_ERROR_CHECK(gptimer_start(scan_timer));
+
+    ESP_LOGI(TAG, "Scanning every %d us per column", CONFIG_CHESSY_HALL_SETTLE_US);
+    return ESP_OK;
+}
+
+void hall_scan_set_gap(uint32_t gap_us)
+{
+    scan_gap_us = gap_us;
+}
+
+void hall_scan_suspend(void)
+{
+    // Disabling the timer releases its power management lock
+    ESP_ERROR_CHECK(gptimer_stop(scan_timer));
+    ESP_ERROR_CHECK(gptimer_disable(scan_timer));
+    column_drive(scan_col, false);
+}
+
+void hall_scan_resume(void)
+{
+    // The ISR is not running, its state can be reset from here
+    scan_col = 0;
+    scan_columns = 0;
+    scan_paused = false;
+    column_drive(scan_col, true);
+    set_alarm(scan_timer, CONFIG_CHESSY_HALL_SETTLE_US);
+    ESP_ERROR_CHECK(gptimer_set_raw_count(scan_timer, 0));
+    ESP_ERROR_CHECK(gptimer_enable(scan_timer));
+    ESP_ERROR_CHECK(gptimer_start(scan_timer));
+}
+
+void hall_scan_get_frame(Hall_frame_t *frame)
+{
+    portENTER_CRITICAL(&frame_lock);
+    *frame = frames[front_frame];
+    portEXIT_CRITICAL(&frame_lock);
+}
+
+bool hall_scan_wait_frame(Hall_frame_t *frame, TickType_t timeout)
+{
+    uint32_t last_sequence = frame->sequence;
+    TickType_t start = xTaskGetTickCount();
+
+    portENTER_CRITICAL(&frame_lock);
+    waiting_task = xTaskGetCurrentTaskHandle();
+    portEXIT_CRITICAL(&frame_lock);
+
+    bool received = false;
+    for (;;) {
+        hall_scan_get_frame(frame);
+        if (frame->sequence != last_sequence) {
+            received = true;
+            break;
+        }
+        TickType_t elapsed = xTaskGetTickCount() - start;
+        if (elapsed >= timeout || !ulTaskNotifyTake(pdTRUE, timeout - elapsed)) {
+            break;
+        }
+    }
+
+    portENTER_CRITICAL(&frame_lock);
+    waiting_task = NULL;
+    portEXIT_CRITICAL(&frame_lock);
+    return received;
+}
@@ -0,0 +1,72 @@
+#ifndef HALL_SCAN_H
+#define HALL_SCAN_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_err.h"
+#include "bitboard.h"
+
+/**
+ * @brief One full scan of the hall sensor matrix
+ *
+ */
+typedef struct {
+    Bitboard_t occupancy;  // Bit row * 8 + col set if a magnet is present
+    int64_t timestamp_us;  // esp_timer time at which the last column was sampled
+    uint32_t sequence;     // Incremented for every published frame
+} Hall_frame_t;
+
+/**
+ * @brief Configure the matrix pins and start the timer driven scan
+ *
+ * A hardware timer strobes one column per CONFIG_CHESSY_HALL_SETTLE_US and
+ * samples all rows with a single input register read, so a full frame takes
+ * 8 settle periods.
+ *
+ * @return esp_err_t ESP_OK on success
+ */
+esp_err_t hall_scan_start(void);
+
+/**
+ * @brief Set the pause between the end of a frame and the start of the next
+ *
+ * The columns are off during the pause. It applies from the end of the
+ * frame being scanned.
+ *
+ * @param gap_us The pause, 0 to scan back to back
+ */
+void hall_scan_set_gap(uint32_t gap_us);
+
+/**
+ * @brief Stop scanning and release the timer, so the chip may light sleep
+ *
+ * A partly scanned frame is dropped.
+ */
+void hall_scan_suspend(void);
+
+/**
+ * @brief Start scanning again after hall_scan_suspend(), from the first column
+ *
+ */
+void hall_scan_resume(void);
+
+/**
+ * @brief Copy the most recent frame
+ *
+ * @param frame The frame to fill
+ */
+void hall_scan_get_frame(Hall_frame_t *frame);
+
+/**
+ * @brief Wait for a frame newer than the one passed in
+ *
+ * Only one task may wait at a time.
+ *
+ * @param frame The last frame seen by the caller, overwritten with the new one
+ * @param timeout Ticks to wait
+ * @return true if a new frame was received, false on timeout
+ */
+bool hall_scan_wait_frame(Hall_frame_t *frame, TickType_t timeout);
+
+#endif
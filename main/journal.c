@@ -0,0 +1,309 @@
+#include <string.h>
+#include "journal.h"
+#include "crc32.h"
+
+#define JOURNAL_MAGIC 0x324E4A43u     // "CJN2", snapshots packed by position_pack()
+#define RECORD_HEADER_SIZE 4          // Type, size, argument
+#define RECORD_CRC_SIZE 4
+#define SNAPSHOT_PAYLOAD_SIZE POSITION_PACK_SIZE
+#define MOVE_RECORD_SIZE (RECORD_HEADER_SIZE + RECORD_CRC_SIZE)
+#define SNAPSHOT_RECORD_SIZE (RECORD_HEADER_SIZE + SNAPSHOT_PAYLOAD_SIZE + RECORD_CRC_SIZE)
+
+typedef enum {
+    RECORD_SNAPSHOT = 'S',
+    RECORD_MOVE = 'M',
+    RECORD_END = 'E',
+    RECORD_ERASED = 0xFF,
+} Record_type_t;
+
+typedef enum {
+    SECTOR_NO_SNAPSHOT,     // Nothing to resume from, try an older sector
+    SECTOR_CLEAN,           // Ends in erased flash, records can be appended
+    SECTOR_TORN,            // Ends in a damaged record
+} Sector_result_t;
+
+// Encode a record at the end of a buffer, returns its size
+static uint32_t encode_record(uint8_t *out, Record_type_t type, uint16_t arg, const uint8_t *payload,
+                              uint32_t payload_size)
+{
+    uint32_t size = RECORD_HEADER_SIZE + payload_size + RECORD_CRC_SIZE;
+    out[0] = (uint8_t)type;
+    out[1] = (uint8_t)size;
+    out[2] = (uint8_t)arg;
+    out[3] = (uint8_t)(arg >> 8);
+    if (payload_size) {
+        memcpy(out + RECORD_HEADER_SIZE, payload, payload_size);
+    }
+    flash_ring_put_u32(out + size - RECORD_CRC_SIZE, crc32_update(0, out, size - RECORD_CRC_SIZE));
+    return size;
+}
+
+// Follow a move in the position and in the history a new sector starts from
+static void track_move(Journal_t *journal, Chess_move_t move)
+{
+    // A full history drops everything up to the last capture or pawn move, as no repetition reaches past it
+    if (journal->history_count == JOURNAL_HISTORY_MAX) {
+        int drop = journal->irreversible > 0 ? journal->irreversible : 1;
+        for (int i = 0; i < drop; i++) {
+            make_move(&journal->base, journal->history[i]);
+        }
+        journal->history_count -= drop;
+        memmove(journal->history, journal->history + drop, journal->history_count * sizeof(journal->history[0]));
+        journal->irreversible = 0;
+    }
+    journal->history[journal->history_count++] = move;
+    make_move(&journal->pos, move);
+    if (journal->pos.halfmove_clock == 0) {
+        journal->irreversible = journal->history_count;
+    }
+
+    Move_list_t replies;
+    journal->over = generate_legal_moves(&journal->pos, &replies) == 0;
+}
+
+static bool is_legal(const Chess_position_t *pos, Chess_move_t move)
+{
+    Move_list_t list;
+    generate_legal_moves(pos, &list);
+    for (int i = 0; i < list.count; i++) {
+        if (list.moves[i] == move) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static Sector_result_t replay_sector(Journal_t *journal, uint32_t sector, Game_record_t *record)
+{
+    uint32_t offset = FLASH_RING_HEADER_SIZE;
+    bool snapshot = false;
+    Sector_result_t result = SECTOR_TORN;
+
+    while (offset + MOVE_RECORD_SIZE <= FLASH_RING_SECTOR_SIZE) {
+        uint8_t bytes[SNAPSHOT_RECORD_SIZE];
+        uint32_t address = sector * FLASH_RING_SECTOR_SIZE + offset;
+        if (journal->flash.read(journal->flash.ctx, address, bytes, RECORD_HEADER_SIZE) != ESP_OK) {
+            break;
+        }
+        if (bytes[0] == RECORD_ERASED) {
+            result = flash_ring_is_erased(&journal->flash, sector, offset) ? SECTOR_CLEAN : SECTOR_TORN;
+            break;
+        }
+        uint32_t size = bytes[1];
+        uint32_t expected = bytes[0] == RECORD_SNAPSHOT ? SNAPSHOT_RECORD_SIZE : MOVE_RECORD_SIZE;
+        if (size != expected || offset + size > FLASH_RING_SECTOR_SIZE ||
+                journal->flash.read(journal->flash.ctx, address, bytes, size) != ESP_OK ||
+                flash_ring_get_u32(bytes + size - RECORD_CRC_SIZE) != crc32_update(0, bytes, size - RECORD_CRC_SIZE)) {
+            break;
+        }
+
+        Chess_move_t move = (Chess_move_t)(bytes[2] | bytes[3] << 8);
+        if (bytes[0] == RECORD_SNAPSHOT) {
+            Chess_position_t pos;
+            if (!position_unpack(&pos, bytes + RECORD_HEADER_SIZE)) {
+                break;
+            }
+            game_record_clear(record);
+            game_record_init(record, &pos);
+            journal->pos = pos;
+            journal->base = pos;
+            journal->history_count = 0;
+            journal->irreversible = 0;
+            journal->over = false;
+            snapshot = true;
+        } else if (bytes[0] == RECORD_MOVE && snapshot && !journal->over && is_legal(&journal->pos, move)) {
+            track_move(journal, move);
+            game_record_append(record, move, journal->pos.key);
+        } else if (bytes[0] == RECORD_END && snapshot) {
+            journal->over = true;
+        } else {
+            break;
+        }
+        offset += size;
+    }
+    journal->offset = offset;
+    return snapshot ? result : SECTOR_NO_SNAPSHOT;
+}
+
+void journal_init(Journal_t *journal, const Flash_ring_io_t *flash)
+{
+    memset(journal, 0, sizeof(*journal));
+    journal->flash = *flash;
+    journal->sector = flash_ring_sector_count(&journal->flash) - 1;   // The first game goes to sector 0
+    journal->needs_sector = true;
+}
+
+bool journal_replay(Journal_t *journal, Game_record_t *record, Chess_position_t *pos)
+{
+    uint32_t count = flash_ring_sector_count(&journal->flash);
+    bool newest_found = false, limited = false;
+    uint32_t newest = 0, limit = 0;
+    Sector_result_t result = SECTOR_NO_SNAPSHOT;
+
+    position_set_start(pos);
+    game_record_init(record, pos);
+    journal->active = false;
+    journal->over = false;
+    journal->batch_size = 0;
+    journal->needs_sector = true;
+
+    // Newest sector first, an older one only if the newer one has no snapshot
+    while (result == SECTOR_NO_SNAPSHOT) {
+        int best = -1;
+        uint32_t best_sequence = 0;
+        for (uint32_t sector = 0; sector < count; sector++) {
+            uint32_t sequence;
+            if (!flash_ring_read_header(&journal->flash, sector, JOURNAL_MAGIC, &sequence) ||
+                    (limited && !flash_ring_sequence_after(limit, sequence))) {
+                continue;
+            }
+            if (best < 0 || flash_ring_sequence_after(sequence, best_sequence)) {
+                best = (int)sector;
+                best_sequence = sequence;
+            }
+        }
+        if (best < 0) {
+            break;
+        }
+        if (!newest_found) {
+            newest_found = true;
+            newest = best_sequence;
+        }
+        result = replay_sector(journal, (uint32_t)best, record);
+        // A sector past a torn one is reused first, the one resumed from is kept intact
+        journal->sector = (uint32_t)best;
+        limit = best_sequence;
+        limited = true;
+    }
+    if (!newest_found) {
+        return false;
+    }
+
+    journal->sequence = newest;
+    journal->active = result != SECTOR_NO_SNAPSHOT;
+    // Appending goes on in the sector if it was the newest and ends cleanly
+    journal->needs_sector = result != SECTOR_CLEAN || limit != newest;
+    *pos = journal->pos;
+    return journal->active && !journal->over;
+}
+
+void journal_new_game(Journal_t *journal, const Chess_position_t *start)
+{
+    journal->pos = *start;
+    journal->base = *start;
+    journal->history_count = 0;
+    journal->irreversible = 0;
+    journal->batch_size = 0;
+    journal->active = true;
+    journal->over = false;
+    journal->needs_sector = true;
+}
+
+static void append_record(Journal_t *journal, Record_type_t type, uint16_t arg)
+{
+    if (journal->batch_size + MOVE_RECORD_SIZE > JOURNAL_BATCH_MAX) {
+        // The snapshot of a new sector holds the moves that did not fit
+        journal->needs_sector = true;
+        journal->batch_size = 0;
+        return;
+    }
+    journal->batch_size += encode_record(journal->batch + journal->batch_size, type, arg, NULL, 0);
+}
+
+void journal_add_move(Journal_t *journal, Chess_move_t move)
+{
+    if (!journal->active || journal->over) {
+        return;
+    }
+    track_move(journal, move);
+    if (journal->needs_sector) {
+        return;
+    }
+    append_record(journal, RECORD_MOVE, move);
+    if (journal->over) {
+        append_record(journal, RECORD_END, 0);
+    }
+}
+
+bool journal_pending(const Journal_t *journal)
+{
+    return journal->active && (journal->needs_sector || journal->batch_size > 0);
+}
+
+// Write a buffer at an offset of a sector, returns the new offset
+static esp_err_t write_at(Journal_t *journal, uint32_t sector, uint32_t *offset, const uint8_t *data, uint32_t size)
+{
+    esp_err_t err = journal->flash.write(journal->flash.ctx, sector * FLASH_RING_SECTOR_SIZE + *offset, data, size);
+    *offset += size;
+    return err;
+}
+
+// Erase the next sector and fill it with the snapshot and the history, the header goes last so a sector
+// torn before it is complete is never replayed
+static esp_err_t open_sector(Journal_t *journal)
+{
+    uint32_t sector = (journal->sector + 1) % flash_ring_sector_count(&journal->flash);
+    uint32_t sequence = journal->sequence + 1;
+    uint32_t offset = FLASH_RING_HEADER_SIZE;
+    uint8_t buffer[JOURNAL_BATCH_MAX];
+    uint8_t payload[SNAPSHOT_PAYLOAD_SIZE];
+
+    esp_err_t err = journal->flash.erase_sector(journal->flash.ctx, sector * FLASH_RING_SECTOR_SIZE);
+    journal->erases++;
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    position_pack(&journal->base, payload);
+    uint32_t size = encode_record(buffer, RECORD_SNAPSHOT, 0, payload, sizeof(payload));
+    for (int i = 0; i <= journal->history_count && err == ESP_OK; i++) {
+        if (i == journal->history_count || size + 2 * MOVE_RECORD_SIZE > sizeof(buffer)) {
+            if (i == journal->history_count && journal->over) {
+                size += encode_record(buffer + size, RECORD_END, 0, NULL, 0);
+            }
+            err = write_at(journal, sector, &offset, buffer, size);
+            size = 0;
+        }
+        if (i < journal->history_count) {
+            size += encode_record(buffer + size, RECORD_MOVE, journal->history[i], NULL, 0);
+        }
+    }
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    err = flash_ring_write_header(&journal->flash, sector, JOURNAL_MAGIC, sequence);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    journal->sector = sector;
+    journal->sequence = sequence;
+    journal->offset = offset;
+    journal->needs_sector = false;
+    journal->batch_size = 0;
+    return ESP_OK;
+}
+
+esp_err_t journal_flush(Journal_t *journal)
+{
+    if (!journal_pending(journal)) {
+        return ESP_OK;
+    }
+    if (journal->needs_sector || journal->offset + journal->batch_size > FLASH_RING_SECTOR_SIZE) {
+        esp_err_t err = open_sector(journal);
+        if (err != ESP_OK) {
+            journal->needs_sector = true;
+        }
+        return err;
+    }
+
+    esp_err_t err = write_at(journal, journal->sector, &journal->offset, journal->batch, journal->batch_size);
+    if (err != ESP_OK) {
+        // Whatever reached the flash may be torn, a new sector holds everything again
+        journal->needs_sector = true;
+        return err;
+    }
+    journal->batch_size = 0;
+    return ESP_OK;
+}
@@ -0,0 +1,122 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "position.h"
+#include "moves.h"
+#include "game_record.h"
+#include "flash_ring.h"
+
+#define JOURNAL_PARTITION_LABEL "journal"
+#define JOURNAL_PARTITION_SUBTYPE 0x42
+#define JOURNAL_BATCH_MAX 256      // Bytes of records waiting for journal_flush()
+#define JOURNAL_HISTORY_MAX 128    // Moves copied to a new sector, the last capture or pawn move within reach
+
+/**
+ * @brief An append-only log of the current game in flash
+ *
+ * The flash is used as a ring of sectors, each starting with a header
+ * holding an increasing sequence number. A sector holds a checksummed
+ * position snapshot followed by 8-byte move records, and ends the game with
+ * an end record after mate or stalemate. When a sector is full the next one
+ * (the oldest) is erased and starts with a snapshot of an earlier position
+ * plus up to JOURNAL_HISTORY_MAX moves since, going back at least to the
+ * last capture or pawn move, so repetitions are still detected after a
+ * resume. Every sector is erased in turn, which spreads the wear over the
+ * whole area.
+ *
+ * Moves are buffered in RAM and written in one go by journal_flush(). A
+ * record torn by a reset fails its checksum, replay stops before it and the
+ * next write starts a fresh sector.
+ */
+typedef struct {
+    Flash_ring_io_t flash;
+    uint32_t sector;                // Sector being written
+    uint32_t sequence;              // Sequence number of that sector
+    uint32_t offset;                // Next free byte in that sector
+    bool needs_sector;              // The next flush starts a new sector
+    bool active;                    // A game is being recorded
+    bool over;                      // The game ended, nothing more is recorded
+    Chess_position_t pos;           // Position after the last move added
+    Chess_position_t base;          // Snapshot of a new sector, the start until the history is full
+    Chess_move_t history[JOURNAL_HISTORY_MAX];  // Moves from base to pos
+    int history_count;
+    int irreversible;               // Moves of the history up to the last capture or pawn move
+    uint8_t batch[JOURNAL_BATCH_MAX];
+    uint32_t batch_size;
+    uint32_t erases;                // Sectors erased since journal_init()
+} Journal_t;
+
+/**
+ * @brief Attach a journal to its flash, nothing is read yet
+ *
+ * @param journal The journal
+ * @param flash The flash access, copied
+ */
+void journal_init(Journal_t *journal, const Flash_ring_io_t *flash);
+
+/**
+ * @brief Rebuild the game recorded in flash
+ *
+ * Starts from the snapshot of the newest valid sector and replays its moves
+ * up to the first torn or invalid record. Falls back to the previous sector
+ * when the newest one was torn before its snapshot was complete.
+ *
+ * @param journal The journal, ready to record the game further
+ * @param record Initialized with the game from its snapshot, must not hold chunks
+ * @param pos Set to the position after the last move
+ * @return true if a game in progress was found, false if the flash is empty or the game ended
+ */
+bool journal_replay(Journal_t *journal, Game_record_t *record, Chess_position_t *pos);
+
+/**
+ * @brief Start recording a new game
+ *
+ * The next flush erases a sector and writes the snapshot.
+ *
+ * @param journal The journal
+ * @param start The starting position
+ */
+void journal_new_game(Journal_t *journal, const Chess_position_t *start);
+
+/**
+ * @brief Add a move to the batch
+ *
+ * Moves after mate or stalemate, or without a game, are ignored.
+ *
+ * @param journal The journal
+ * @param move A legal move of the position after the previous one
+ */
+void journal_add_move(Journal_t *journal, Chess_move_t move);
+
+/**
+ * @brief Check whether records are waiting to be written
+ *
+ * @param journal The journal
+ * @return true if journal_flush() has something to write
+ */
+bool journal_pending(const Journal_t *journal);
+
+/**
+ * @brief Write the batch to flash
+ *
+ * One write per batch, plus a sector erase and snapshot when the batch does
+ * not fit the current sector or a new game started.
+ *
+ * @param journal The journal
+ * @return esp_err_t ESP_OK, or the flash error, the records are then kept for the next flush
+ */
+esp_err_t journal_flush(Journal_t *journal);
+
+/**
+ * @brief Open the journal partition
+ *
+ * @param flash Set to access the partition
+ * @return esp_err_t ESP_OK, or ESP_ERR_NOT_FOUND without a journal partition
+ */
+esp_err_t journal_open_partition(Flash_ring_io_t *flash);
+
+#endif
@@ -0,0 +1,39 @@
+#include "esp_partition.h"
+#include "esp_log.h"
+#include "journal.h"
+
+static const char *TAG = "JOURNAL";
+
+static esp_err_t partition_read(void *ctx, uint32_t offset, void *data, size_t size)
+{
+    return esp_partition_read(ctx, offset, data, size);
+}
+
+static esp_err_t partition_write(void *ctx, uint32_t offset, const void *data, size_t size)
+{
+    return esp_partition_write(ctx, offset, data, size);
+}
+
+static esp_err_t partition_erase_sector(void *ctx, uint32_t offset)
+{
+    return esp_partition_erase_range(ctx, offset, FLASH_RING_SECTOR_SIZE);
+}
+
+esp_err_t journal_open_partition(Flash_ring_io_t *flash)
+{
+    const esp_partition_t *part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, JOURNAL_PARTITION_SUBTYPE,
+                                                           JOURNAL_PARTITION_LABEL);
+    if (!part) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    // Reads and writes go through the SPI flash driver, the partition is not mapped
+    *flash = (Flash_ring_io_t) {
+        .read = partition_read,
+        .write = partition_write,
+        .erase_sector = partition_erase_sector,
+        .ctx = (void *)part,
+        .size = part->size / FLASH_RING_SECTOR_SIZE * FLASH_RING_SECTOR_SIZE,
+    };
+    ESP_LOGI(TAG, "%u journal sectors", (unsigned int)(flash->size / FLASH_RING_SECTOR_SIZE));
+    return ESP_OK;
+}
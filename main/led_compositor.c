@@ -0,0 +1,88 @@
+#include <string.h>
+#include "led_compositor.h"
+
+// WS2812 output is linear in PWM duty, this maps 8 bit colors to a gamma of 2.8
+static const uint8_t gamma_table[256] = {
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   1,   1,   1,   1,
+      1,   1,   1,   1,   1,   1,   1,   1,   1,   2,   2,   2,   2,   2,   2,   2,
+      2,   3,   3,   3,   3,   3,   3,   3,   4,   4,   4,   4,   4,   5,   5,   5,
+      5,   6,   6,   6,   6,   7,   7,   7,   7,   8,   8,   8,   9,   9,   9,  10,
+     10,  10,  11,  11,  11,  12,  12,  13,  13,  13,  14,  14,  15,  15,  16,  16,
+     17,  17,  18,  18,  19,  19,  20,  20,  21,  21,  22,  22,  23,  24,  24,  25,
+     25,  26,  27,  27,  28,  29,  29,  30,  31,  32,  32,  33,  34,  35,  35,  36,
+     37,  38,  39,  39,  40,  41,  42,  43,  44,  45,  46,  47,  48,  49,  50,  50,
+     51,  52,  54,  55,  56,  57,  58,  59,  60,  61,  62,  63,  64,  66,  67,  68,
+     69,  70,  72,  73,  74,  75,  77,  78,  79,  81,  82,  83,  85,  86,  87,  89,
+     90,  92,  93,  95,  96,  98,  99, 101, 102, 104, 105, 107, 109, 110, 112, 114,
+    115, 117, 119, 120, 122, 124, 126, 127, 129, 131, 133, 135, 137, 138, 140, 142,
+    144, 146, 148, 150, 152, 154, 156, 158, 160, 162, 164, 167, 169, 171, 173, 175,
+    177, 180, 182, 184, 186, 189, 191, 193, 196, 198, 200, 203, 205, 208, 210, 213,
+    215, 218, 220, 223, 225, 228, 231, 233, 236, 239, 241, 244, 247, 249, 252, 255,
+};
+
+void led_compositor_init(Led_compositor_t *comp, uint8_t brightness)
+{
+    memset(comp, 0, sizeof(*comp));
+    led_compositor_set_brightness(comp, brightness);
+}
+
+void led_compositor_set_brightness(Led_compositor_t *comp, uint8_t brightness)
+{
+    for (int i = 0; i < 256; i++) {
+        comp->levels[i] = (uint8_t)((gamma_table[i] * brightness + 127) / 255);
+    }
+}
+
+void led_compositor_clear_layer(Led_compositor_t *comp, Led_layer_t layer)
+{
+    comp->masks[layer] = 0;
+}
+
+void led_compositor_fill(Led_compositor_t *comp, Led_layer_t layer, Bitboard_t squares, uint32_t color)
+{
+    comp->masks[layer] |= squares;
+    while (squares) {
+        comp->colors[layer][bb_pop_lsb(&squares)] = color;
+    }
+}
+
+bool led_compositor_compose(Led_compositor_t *comp)
+{
+    // Squares no layer covers are off
+    memset(comp->frame, 0, sizeof(comp->frame));
+
+    // Lower layers first, each one overwrites what is below it
+    for (int layer = 0; layer < LED_LAYER_NB; layer++) {
+        Bitboard_t squares = comp->masks[layer];
+        while (squares) {
+            int sq = bb_pop_lsb(&squares);
+            uint32_t color = comp->colors[layer][sq];
+            uint8_t *pixel = comp->frame[led_strip_index(sq)];
+            pixel[0] = comp->levels[(color >> 16) & 0xFF];
+            pixel[1] = comp->levels[(color >> 8) & 0xFF];
+            pixel[2] = comp->levels[color & 0xFF];
+        }
+    }
+
+    return !comp->shown_valid || memcmp(comp->frame, comp->shown, sizeof(comp->frame)) != 0;
+}
+
+bool led_compositor_show(Led_compositor_t *comp, led_strip_handle_t strip)
+{
+    if (!led_compositor_compose(comp)) {
+        return false;
+    }
+
+    for (int i = 0; i < SQUARE_NB; i++) {
+        if (comp->shown_valid && memcmp(comp->frame[i], comp->shown[i], 3) == 0) {
+            continue;
+        }
+        led_strip_set_pixel(strip, i, comp->frame[i][0], comp->frame[i][1], comp->frame[i][2]);
+    }
+    memcpy(comp->shown, comp->frame, sizeof(comp->shown));
+    comp->shown_valid = true;
+
+    led_strip_refresh(strip);
+    return true;
+}
@@ -0,0 +1,105 @@
+#ifndef LED_COMPOSITOR_H
+#define LED_COMPOSITOR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "bitboard.h"
+#include "led_strip.h"
+
+/**
+ * @brief Compositor layers, a square takes its color from the highest layer covering it
+ *
+ */
+typedef enum {
+    LED_LAYER_PIECES = 0,
+    LED_LAYER_HINT,
+    LED_LAYER_SELECTION,
+    LED_LAYER_TARGETS,
+    LED_LAYER_ERRORS,
+    LED_LAYER_ANIMATION,
+    LED_LAYER_NB,
+} Led_layer_t;
+
+/**
+ * @brief 64 pixel framebuffer built from ordered layers
+ *
+ * Colors are 0xRRGGBB. The composed frame is kept gamma corrected and in
+ * strip order, next to the last frame sent, so a frame that did not change
+ * costs no strip transfer.
+ */
+typedef struct {
+    uint32_t colors[LED_LAYER_NB][SQUARE_NB];
+    Bitboard_t masks[LED_LAYER_NB];  // Squares covered by each layer
+    uint8_t levels[256];             // Gamma and brightness correction
+    uint8_t frame[SQUARE_NB][3];
+    uint8_t shown[SQUARE_NB][3];
+    bool shown_valid;                // False until the first frame is sent
+} Led_compositor_t;
+
+/**
+ * @brief Clear every layer and build the correction table
+ *
+ * @param comp The compositor
+ * @param brightness Output level of a full channel, 0-255
+ */
+void led_compositor_init(Led_compositor_t *comp, uint8_t brightness);
+
+/**
+ * @brief Rebuild the correction table for a new brightness
+ *
+ * @param comp The compositor
+ * @param brightness Output level of a full channel, 0-255
+ */
+void led_compositor_set_brightness(Led_compositor_t *comp, uint8_t brightness);
+
+/**
+ * @brief Remove every square from a layer
+ *
+ * @param comp The compositor
+ * @param layer The layer
+ */
+void led_compositor_clear_layer(Led_compositor_t *comp, Led_layer_t layer);
+
+/**
+ * @brief Cover squares of a layer with a color
+ *
+ * @param comp The compositor
+ * @param layer The layer
+ * @param squares The squares to cover
+ * @param color The color, black is drawn like any other color
+ */
+void led_compositor_fill(Led_compositor_t *comp, Led_layer_t layer, Bitboard_t squares, uint32_t color);
+
+/**
+ * @brief Compose the layers into the frame
+ *
+ * @param comp The compositor
+ * @return true if the frame differs from the last one sent
+ */
+bool led_compositor_compose(Led_compositor_t *comp);
+
+/**
+ * @brief Compose and send the frame if it changed
+ *
+ * Only the changed pixels are written to the strip buffer, followed by a
+ * single refresh.
+ *
+ * @param comp The compositor
+ * @param strip The strip
+ * @return true if the strip was refreshed
+ */
+bool led_compositor_show(Led_compositor_t *comp, led_strip_handle_t strip);
+
+/**
+ * @brief Strip index of a square, the LEDs run in a zigzag along the ranks
+ *
+ * @param sq The square
+ * @return int The strip index
+ */
+static inline int led_strip_index(int sq)
+{
+    int rank = SQUARE_RANK(sq);
+    return rank % 2 == 0 ? sq : rank * 8 + (7 - SQUARE_FILE(sq));
+}
+
+#endif
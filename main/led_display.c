@@ -0,0 +1,134 @@
+#include <stdint.h>
+#include <string.h>
+#include "esp_log.h"
+#include "sdkconfig.h"
+#include "led_strip.h"
+#include "led_compositor.h"
+#include "led_display.h"
+#include "trace.h"
+
+#if CONFIG_IDF_TARGET_LINUX
+#define LED_DATA_IN1 0  // The virtual strip has no pin
+#define LED_WITH_DMA 0
+#else
+#include "driver/gpio.h"
+#include "soc/soc_caps.h"
+#define LED_DATA_IN1 GPIO_NUM_38
+#define LED_WITH_DMA SOC_RMT_SUPPORT_DMA
+#endif
+
+// RMT symbols buffered per channel, DMA lets the whole strip go out in one transfer
+#if LED_WITH_DMA
+#define LED_RMT_MEM_SYMBOLS 1024
+#else
+#define LED_RMT_MEM_SYMBOLS 0  // Driver default
+#endif
+
+// LED colors for different states
+#define COLOR_EMPTY 0x000000    // Black
+#define COLOR_SELECTED 0xFFFF00  // Yellow
+#define COLOR_VALID_MOVE 0x00FF00 // Green
+#define COLOR_INVALID_MOVE 0xFF0000 // Red
+#define COLOR_WHITE_PIECE 0xFFFFFF  // White
+#define COLOR_BLACK_PIECE 0x808080  // Gray
+#define COLOR_ERROR 0xFF0000    // Red for errors
+#define COLOR_HINT_FROM 0x00FFFF  // Cyan
+#define COLOR_HINT_TO 0x0000FF    // Blue
+
+static const char *TAG = "LED_DISPLAY";
+static led_strip_handle_t led_strip;
+static Led_compositor_t compositor;
+static uint64_t scene_key;
+static uint64_t hint_key;
+static Chess_move_t hint_move = MOVE_NONE;
+static bool flashing;
+static int64_t flash_end_us;
+
+// The hint is only drawn on the position it was searched for
+static void update_hint_layer(void)
+{
+    led_compositor_clear_layer(&compositor, LED_LAYER_HINT);
+    if (hint_move == MOVE_NONE || hint_key != scene_key) {
+        return;
+    }
+    led_compositor_fill(&compositor, LED_LAYER_HINT, BB_SQUARE(MOVE_FROM(hint_move)), COLOR_HINT_FROM);
+    led_compositor_fill(&compositor, LED_LAYER_HINT, BB_SQUARE(MOVE_TO(hint_move)), COLOR_HINT_TO);
+}
+
+void led_display_init(void)
+{
+    ESP_LOGI(TAG, "Configuring LED strip");
+    led_strip_config_t strip_config = {
+        .strip_gpio_num = LED_DATA_IN1,
+        .max_leds = SQUARE_NB,
+    };
+    led_strip_rmt_config_t rmt_config = {
+        .resolution_hz = 10 * 1000 * 1000, // 10MHz
+        .mem_block_symbols = LED_RMT_MEM_SYMBOLS,
+        .flags.with_dma = LED_WITH_DMA,
+    };
+    ESP_ERROR_CHECK(led_strip_new_rmt_device(&strip_config, &rmt_config, &led_strip));
+    led_compositor_init(&compositor, CONFIG_CHESSY_LED_BRIGHTNESS);
+    flashing = false;
+    led_strip_clear(led_strip);
+}
+
+static void flash_feedback(const Led_scene_t *scene, int64_t now_us)
+{
+    static const uint32_t feedback_colors[] = {
+        [LED_FEEDBACK_VALID] = COLOR_VALID_MOVE,
+        [LED_FEEDBACK_CANCEL] = COLOR_EMPTY,
+        [LED_FEEDBACK_INVALID] = COLOR_INVALID_MOVE,
+    };
+    led_compositor_clear_layer(&compositor, LED_LAYER_ANIMATION);
+    led_compositor_fill(&compositor, LED_LAYER_ANIMATION, BB_SQUARE(scene->feedback_square),
+                        feedback_colors[scene->feedback]);
+    flashing = true;
+    flash_end_us = now_us + LED_FLASH_US;
+}
+
+void led_display_set_scene(const Led_scene_t *scene, int64_t now_us)
+{
+    static const Led_layer_t layers[] = {LED_LAYER_PIECES, LED_LAYER_SELECTION, LED_LAYER_TARGETS, LED_LAYER_ERRORS};
+    for (size_t i = 0; i < sizeof(layers) / sizeof(layers[0]); i++) {
+        led_compositor_clear_layer(&compositor, layers[i]);
+    }
+
+    led_compositor_fill(&compositor, LED_LAYER_PIECES, scene->occupancy & ~scene->black_pieces, COLOR_WHITE_PIECE);
+    led_compositor_fill(&compositor, LED_LAYER_PIECES, scene->occupancy & scene->black_pieces, COLOR_BLACK_PIECE);
+    led_compositor_fill(&compositor, LED_LAYER_SELECTION, scene->selected, COLOR_SELECTED);
+    led_compositor_fill(&compositor, LED_LAYER_TARGETS, scene->targets, COLOR_VALID_MOVE);
+    led_compositor_fill(&compositor, LED_LAYER_ERRORS, scene->errors, COLOR_ERROR);
+    scene_key = scene->position_key;
+    update_hint_layer();
+    if (scene->feedback != LED_FEEDBACK_NONE) {
+        flash_feedback(scene, now_us);
+    }
+}
+
+void led_display_set_hint(uint64_t position_key, Chess_move_t move)
+{
+    hint_key = position_key;
+    hint_move = move;
+    update_hint_layer();
+}
+
+bool led_display_show(int64_t now_us)
+{
+    if (flashing && now_us >= flash_end_us) {
+        led_compositor_clear_layer(&compositor, LED_LAYER_ANIMATION);
+        flashing = false;
+    }
+    if (!led_compositor_show(&compositor, led_strip)) {
+        return false;
+    }
+    TRACE_DEBUG(TRACE_LED_FRAME, 0, 0);
+    return true;
+}
+
+void led_display_get_shown(uint8_t colors[SQUARE_NB][3])
+{
+    for (int sq = 0; sq < SQUARE_NB; sq++) {
+        memcpy(colors[sq], compositor.shown[led_strip_index(sq)], 3);
+    }
+}
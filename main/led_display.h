@@ -0,0 +1,52 @@
+#ifndef LED_DISPLAY_H
+#define LED_DISPLAY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "game.h"
+
+#define LED_FLASH_US 500000  // How long a feedback flash stays on
+
+/**
+ * @brief Configure the LED strip and clear it
+ *
+ */
+void led_display_init(void);
+
+/**
+ * @brief Replace the board layers with a new scene
+ *
+ * The scene's feedback, if any, is flashed on top for LED_FLASH_US.
+ * Nothing is sent to the strip until led_display_show().
+ *
+ * @param scene The scene
+ * @param now_us Current time, starts the flash
+ */
+void led_display_set_scene(const Led_scene_t *scene, int64_t now_us);
+
+/**
+ * @brief Show a suggested move while its position is on the board
+ *
+ * @param position_key Key of the position the move is for
+ * @param move The move, MOVE_NONE to remove the hint
+ */
+void led_display_set_hint(uint64_t position_key, Chess_move_t move);
+
+/**
+ * @brief Send the composed frame to the strip if it changed
+ *
+ * A flash that is over is removed first.
+ *
+ * @param now_us Current time, on the same clock as led_display_set_scene()
+ * @return true if the strip was refreshed
+ */
+bool led_display_show(int64_t now_us);
+
+/**
+ * @brief Get the colors last sent to the strip
+ *
+ * @param colors Filled with the RGB of each square, after gamma and brightness correction
+ */
+void led_display_get_shown(uint8_t colors[SQUARE_NB][3]);
+
+#endif
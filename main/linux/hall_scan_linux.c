@@ -0,0 +1,136 @@
+// Virtual hall matrix for the linux target
+//
+// Frames come from a FreeRTOS task at the same rate as the real scanner. The
+// board starts in the initial position; typing a square name such as "e2" on
+// stdin toggles the magnet on that square.
+#include <fcntl.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+#include "hall_scan.h"
+
+#define HALL_FRAME_US (8 * CONFIG_CHESSY_HALL_SETTLE_US)
+#define HALL_FRAME_TICKS (pdMS_TO_TICKS(HALL_FRAME_US / 1000) > 0 ? pdMS_TO_TICKS(HALL_FRAME_US / 1000) : 1)
+
+static const char *TAG = "HALL_SCAN";
+
+static Bitboard_t virtual_occupancy = 0xFFFF00000000FFFFULL;
+static Hall_frame_t current_frame;
+static portMUX_TYPE frame_lock = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t waiting_task;
+static volatile uint32_t frame_gap_us;
+static volatile bool suspended;
+
+static int64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// Non-blocking, a blocking read would stall the whole simulated scheduler
+static void poll_stdin(void)
+{
+    static char line[16];
+    static int length;
+    char c;
+    while (read(STDIN_FILENO, &c, 1) == 1) {
+        if (c != '\n') {
+            if (length < (int)sizeof(line) - 1) {
+                line[length++] = c;
+            }
+            continue;
+        }
+        if (length >= 2 && line[0] >= 'a' && line[0] <= 'h' && line[1] >= '1' && line[1] <= '8') {
+            virtual_occupancy ^= BB_SQUARE(SQUARE(line[1] - '1', line[0] - 'a'));
+        }
+        length = 0;
+    }
+}
+
+static void virtual_scan_task(void *arg)
+{
+    while (1) {
+        if (suspended) {
+            vTaskDelay(HALL_FRAME_TICKS);
+            continue;
+        }
+        poll_stdin();
+
+        portENTER_CRITICAL(&frame_lock);
+        current_frame.occupancy = virtual_occupancy;
+        current_frame.timestamp_us = now_us();
+        current_frame.sequence++;
+        TaskHandle_t task = waiting_task;
+        portEXIT_CRITICAL(&frame_lock);
+
+        if (task) {
+            xTaskNotifyGive(task);
+        }
+        vTaskDelay(HALL_FRAME_TICKS + pdMS_TO_TICKS(frame_gap_us / 1000));
+    }
+}
+
+esp_err_t hall_scan_start(void)
+{
+    ESP_LOGI(TAG, "Starting virtual hall matrix, type a square name to toggle it");
+    fcntl(STDIN_FILENO, F_SETFL, fcntl(STDIN_FILENO, F_GETFL) | O_NONBLOCK);
+    if (xTaskCreate(virtual_scan_task, "hall_scan", 4096, NULL, configMAX_PRIORITIES - 1, NULL) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+void hall_scan_set_gap(uint32_t gap_us)
+{
+    frame_gap_us = gap_us;
+}
+
+void hall_scan_suspend(void)
+{
+    suspended = true;
+}
+
+void hall_scan_resume(void)
+{
+    suspended = false;
+}
+
+void hall_scan_get_frame(Hall_frame_t *frame)
+{
+    portENTER_CRITICAL(&frame_lock);
+    *frame = current_frame;
+    portEXIT_CRITICAL(&frame_lock);
+}
+
+bool hall_scan_wait_frame(Hall_frame_t *frame, TickType_t timeout)
+{
+    uint32_t last_sequence = frame->sequence;
+    TickType_t start = xTaskGetTickCount();
+
+    portENTER_CRITICAL(&frame_lock);
+    waiting_task = xTaskGetCurrentTaskHandle();
+    portEXIT_CRITICAL(&frame_lock);
+
+    bool received = false;
+    for (;;) {
+        hall_scan_get_frame(frame);
+        if (frame->sequence != last_sequence) {
+            received = true;
+            break;
+        }
+        TickType_t elapsed = xTaskGetTickCount() - start;
+        if (elapsed >= timeout || !ulTaskNotifyTake(pdTRUE, timeout - elapsed)) {
+            break;
+        }
+    }
+
+    portENTER_CRITICAL(&frame_lock);
+    waiting_task = NULL;
+    portEXIT_CRITICAL(&frame_lock);
+    return received;
+}
@@ -0,0 +1,102 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "led_strip.h"
+
+#define VIRTUAL_STRIP_MAX_LEDS 64
+
+struct led_strip_t {
+    uint32_t led_count;
+    uint8_t pixels[VIRTUAL_STRIP_MAX_LEDS][3];
+    uint8_t shown[VIRTUAL_STRIP_MAX_LEDS][3];
+};
+
+// Colors are gamma corrected and scaled, so they are told apart by their channels.
+// Gray pieces are the neutral pixels dimmer than the brightest neutral one.
+static char pixel_char(const uint8_t rgb[3], uint8_t white_level)
+{
+    bool red = rgb[0], green = rgb[1], blue = rgb[2];
+    if (!red && !green && !blue) {
+        return '.';
+    }
+    if (rgb[0] == rgb[1] && rgb[1] == rgb[2]) {
+        return rgb[0] == white_level ? 'W' : 'B';
+    }
+    if (red && green && !blue) {
+        return 'S';
+    }
+    if (green && !red && !blue) {
+        return '+';
+    }
+    if (red && !green && !blue) {
+        return 'X';
+    }
+    if (green && blue && !red) {
+        return 'h';
+    }
+    if (blue && !red && !green) {
+        return 'H';
+    }
+    return '?';
+}
+
+esp_err_t led_strip_new_rmt_device(const led_strip_config_t *led_config, const led_strip_rmt_config_t *rmt_config,
+                                   led_strip_handle_t *ret_strip)
+{
+    if (led_config->max_leds > VIRTUAL_STRIP_MAX_LEDS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    struct led_strip_t *strip = calloc(1, sizeof(*strip));
+    if (!strip) {
+        return ESP_ERR_NO_MEM;
+    }
+    strip->led_count = led_config->max_leds;
+    *ret_strip = strip;
+    return ESP_OK;
+}
+
+esp_err_t led_strip_set_pixel(led_strip_handle_t strip, uint32_t index, uint32_t red, uint32_t green, uint32_t blue)
+{
+    if (index >= strip->led_count) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    strip->pixels[index][0] = red;
+    strip->pixels[index][1] = green;
+    strip->pixels[index][2] = blue;
+    return ESP_OK;
+}
+
+esp_err_t led_strip_refresh(led_strip_handle_t strip)
+{
+    if (memcmp(strip->pixels, strip->shown, sizeof(strip->pixels)) == 0) {
+        return ESP_OK;
+    }
+    memcpy(strip->shown, strip->pixels, sizeof(strip->pixels));
+
+    uint8_t white_level = 0;
+    for (uint32_t i = 0; i < strip->led_count; i++) {
+        const uint8_t *rgb = strip->shown[i];
+        if (rgb[0] == rgb[1] && rgb[1] == rgb[2] && rgb[0] > white_level) {
+            white_level = rgb[0];
+        }
+    }
+
+    // Print the strip as an 8x8 grid, undoing the zigzag wiring
+    printf("LEDs:\n");
+    for (int y = 7; y >= 0; y--) {
+        printf("  ");
+        for (int x = 0; x < 8; x++) {
+            int index = (y % 2 == 0) ? y * 8 + x : y * 8 + (7 - x);
+            printf("%c ", pixel_char(strip->shown[index], white_level));
+        }
+        printf("\n");
+    }
+    return ESP_OK;
+}
+
+esp_err_t led_strip_clear(led_strip_handle_t strip)
+{
+    memset(strip->pixels, 0, sizeof(strip->pixels));
+    return led_strip_refresh(strip);
+}
@@ -0,0 +1,219 @@
+#include <string.h>
+#include "mate.h"
+
+static bool defend(Mate_solver_t *solver, Chess_position_t *pos, int moves, int ply);
+
+// False once the node limit is reached, the solve then unwinds without storing anything
+static inline bool count_node(Mate_solver_t *solver)
+{
+    solver->nodes++;
+    if (solver->node_limit && solver->nodes > solver->node_limit) {
+        solver->aborted = true;
+    }
+    return !solver->aborted;
+}
+
+static void swap_moves(Move_list_t *list, int a, int b)
+{
+    Chess_move_t move = list->moves[a];
+    list->moves[a] = list->moves[b];
+    list->moves[b] = move;
+}
+
+// Checks first, then captures. With checks_only the other moves are dropped, they cannot mate at once.
+static void order_moves(Chess_position_t *pos, Move_list_t *list, bool checks_only)
+{
+    int front = 0;
+    for (int i = 0; i < list->count; i++) {
+        Move_undo_t undo;
+        make_move_undo(pos, list->moves[i], &undo);
+        bool check = is_in_check(pos);
+        unmake_move(pos, list->moves[i], &undo);
+        if (check) {
+            swap_moves(list, front++, i);
+        }
+    }
+    if (checks_only) {
+        list->count = front;
+        return;
+    }
+    for (int i = front; i < list->count; i++) {
+        if (MOVE_IS_CAPTURE(list->moves[i])) {
+            swap_moves(list, front++, i);
+        }
+    }
+}
+
+// The side to move mates within moves
+static bool attack(Mate_solver_t *solver, Chess_position_t *pos, int moves, int ply)
+{
+    if (!count_node(solver)) {
+        return false;
+    }
+    uint64_t key = pos->key;
+    Mate_entry_t *entry = &solver->table[key & solver->mask];
+    if (entry->key == key) {
+        if (entry->mate && entry->mate <= moves) {
+            return true;
+        }
+        if (entry->no_mate >= moves) {
+            return false;
+        }
+    }
+
+    Move_list_t *list = &solver->lists[ply];
+    generate_legal_moves(pos, list);
+    order_moves(pos, list, moves == 1);
+    bool found = false;
+    Chess_move_t mating = MOVE_NONE;
+    for (int i = 0; i < list->count && !found; i++) {
+        Move_undo_t undo;
+        make_move_undo(pos, list->moves[i], &undo);
+        found = defend(solver, pos, moves - 1, ply + 1);
+        unmake_move(pos, list->moves[i], &undo);
+        if (solver->aborted) {
+            return false;
+        }
+        mating = list->moves[i];
+    }
+
+    // The slot may have been taken by a position further down
+    if (entry->key != key) {
+        memset(entry, 0, sizeof(*entry));
+        entry->key = key;
+    }
+    if (found) {
+        entry->mate = (uint8_t)moves;
+        entry->move = mating;
+    } else if (moves > entry->no_mate) {
+        entry->no_mate = (uint8_t)moves;
+    }
+    return found;
+}
+
+// The side to move is mated within moves of the other side, whatever it plays
+static bool defend(Mate_solver_t *solver, Chess_position_t *pos, int moves, int ply)
+{
+    if (!count_node(solver)) {
+        return false;
+    }
+    Move_list_t *list = &solver->lists[ply];
+    if (generate_legal_moves(pos, list) == 0) {
+        return is_in_check(pos);
+    }
+    if (moves == 0) {
+        return false;
+    }
+
+    // The reply that escaped last time at this ply often escapes again
+    for (int i = 1; i < list->count; i++) {
+        if (list->moves[i] == solver->killers[ply]) {
+            swap_moves(list, 0, i);
+            break;
+        }
+    }
+    for (int i = 0; i < list->count; i++) {
+        Move_undo_t undo;
+        make_move_undo(pos, list->moves[i], &undo);
+        bool mated = attack(solver, pos, moves, ply + 1);
+        unmake_move(pos, list->moves[i], &undo);
+        if (solver->aborted) {
+            return false;
+        }
+        if (!mated) {
+            solver->killers[ply] = list->moves[i];
+            return false;
+        }
+    }
+    return true;
+}
+
+static void start_solve(Mate_solver_t *solver, Mate_result_t *result)
+{
+    solver->nodes = 0;
+    solver->aborted = false;
+    memset(solver->killers, 0, sizeof(solver->killers));
+    result->status = MATE_NONE;
+    result->moves = 0;
+    result->move = MOVE_NONE;
+}
+
+void mate_solver_init(Mate_solver_t *solver, Mate_entry_t *table, size_t count, uint32_t node_limit)
+{
+    memset(solver, 0, sizeof(*solver));
+    solver->table = table;
+    solver->mask = (uint32_t)(count - 1);
+    solver->node_limit = node_limit;
+}
+
+void mate_solver_clear(Mate_solver_t *solver)
+{
+    memset(solver->table, 0, ((size_t)solver->mask + 1) * sizeof(solver->table[0]));
+}
+
+void mate_search(Mate_solver_t *solver, const Chess_position_t *pos, int max_moves, Mate_result_t *result)
+{
+    Chess_position_t root = *pos;
+    start_solve(solver, result);
+    if (max_moves > MATE_MAX_MOVES) {
+        max_moves = MATE_MAX_MOVES;
+    }
+    for (int moves = 1; moves <= max_moves; moves++) {
+        if (attack(solver, &root, moves, 0)) {
+            // Stored last, nothing can have replaced it
+            result->status = MATE_FOUND;
+            result->moves = moves;
+            result->move = solver->table[root.key & solver->mask].move;
+            break;
+        }
+        if (solver->aborted) {
+            result->status = MATE_UNKNOWN;
+            break;
+        }
+    }
+    result->nodes = solver->nodes;
+}
+
+void mate_defend(Mate_solver_t *solver, const Chess_position_t *pos, int max_moves, Mate_result_t *result)
+{
+    Chess_position_t root = *pos;
+    start_solve(solver, result);
+    if (max_moves > MATE_MAX_MOVES) {
+        max_moves = MATE_MAX_MOVES;
+    }
+    Move_list_t *list = &solver->lists[0];
+    if (generate_legal_moves(&root, list) == 0) {
+        result->status = is_in_check(&root) ? MATE_FOUND : MATE_NONE;
+        result->nodes = solver->nodes;
+        return;
+    }
+
+    // Look for an escape first, a wrong move is then refuted without measuring every mate
+    result->status = defend(solver, &root, max_moves, 0) ? MATE_FOUND : MATE_NONE;
+    if (solver->aborted) {
+        result->status = MATE_UNKNOWN;
+    } else if (result->status == MATE_NONE) {
+        result->move = solver->killers[0];
+    } else {
+        // Every reply is mated in time, the one lasting longest is the defence to show
+        generate_legal_moves(&root, list);
+        for (int i = 0; i < list->count && !solver->aborted; i++) {
+            Chess_move_t reply = list->moves[i];
+            Move_undo_t undo;
+            make_move_undo(&root, reply, &undo);
+            int moves = 1;
+            while (moves < max_moves && !attack(solver, &root, moves, 1) && !solver->aborted) {
+                moves++;
+            }
+            unmake_move(&root, reply, &undo);
+            if (moves > result->moves) {
+                result->moves = moves;
+                result->move = reply;
+            }
+        }
+        if (solver->aborted) {
+            result->status = MATE_UNKNOWN;
+        }
+    }
+    result->nodes = solver->nodes;
+}
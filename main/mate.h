@@ -0,0 +1,101 @@
+#ifndef MATE_H
+#define MATE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "position.h"
+#include "moves.h"
+
+#define MATE_MAX_MOVES 8   // Longest mate the solver looks for, in moves of the mating side
+
+/**
+ * @brief What the solver knows of a position with the mating side to move
+ *
+ */
+typedef struct {
+    uint64_t key;
+    Chess_move_t move;   // First move of the mate, when proven
+    uint8_t mate;        // Proven mate within this many moves, 0 if none is known
+    uint8_t no_mate;     // Proven no mate within this many moves
+} Mate_entry_t;
+
+/**
+ * @brief A mate-only solver with a bounded node table
+ *
+ * Depth-first proof search: the mating side needs one move after which every
+ * reply still loses, the defending side one reply that escapes. Checks are
+ * tried first, and a move of the last ply must be a check to mate. Proven
+ * and refuted positions are kept in the table, replacing whatever was in
+ * their slot, so the memory needed is fixed whatever the puzzle.
+ */
+typedef struct {
+    Mate_entry_t *table;
+    uint32_t mask;                          // Entry count - 1
+    uint32_t nodes;
+    uint32_t node_limit;                    // 0 for no limit
+    bool aborted;                           // The node limit was reached, nothing is proven
+    Chess_move_t killers[2 * MATE_MAX_MOVES + 1];  // Last escape found at each ply
+    Move_list_t lists[2 * MATE_MAX_MOVES + 1];     // Moves of each ply, kept off the task stack
+} Mate_solver_t;
+
+/**
+ * @brief Outcome of a solve
+ *
+ */
+typedef enum {
+    MATE_FOUND,      // Proven within the moves
+    MATE_NONE,       // Proven impossible within the moves
+    MATE_UNKNOWN,    // The node limit was reached first
+} Mate_status_t;
+
+typedef struct {
+    Mate_status_t status;
+    int moves;           // Moves of the mating side to mate against the best defence, when found
+    Chess_move_t move;   // See mate_search() and mate_defend()
+    uint32_t nodes;
+} Mate_result_t;
+
+/**
+ * @brief Use a zeroed array as the node table
+ *
+ * @param solver The solver
+ * @param table The entries, all zero
+ * @param count Number of entries, a power of two
+ * @param node_limit Nodes per solve, 0 for no limit
+ */
+void mate_solver_init(Mate_solver_t *solver, Mate_entry_t *table, size_t count, uint32_t node_limit);
+
+/**
+ * @brief Forget every entry, before a new puzzle
+ *
+ * Entries stay correct between solves of the same game.
+ *
+ * @param solver The solver
+ */
+void mate_solver_clear(Mate_solver_t *solver);
+
+/**
+ * @brief Find the shortest forced mate for the side to move
+ *
+ * Tries one move, then two and so on up to max_moves.
+ *
+ * @param solver The solver
+ * @param pos The position
+ * @param max_moves Longest mate looked for, at most MATE_MAX_MOVES
+ * @param result move is the first move of the mate when found
+ */
+void mate_search(Mate_solver_t *solver, const Chess_position_t *pos, int max_moves, Mate_result_t *result);
+
+/**
+ * @brief Check that the side to move is mated within max_moves whatever it plays
+ *
+ * @param solver The solver
+ * @param pos The position, the defending side to move
+ * @param max_moves Moves the mating side has left, 0 to check the side to move is checkmated
+ * @param result When found, move is the reply that delays the mate longest, MOVE_NONE if
+ *               already mated. Otherwise move is a reply escaping the mate.
+ */
+void mate_defend(Mate_solver_t *solver, const Chess_position_t *pos, int max_moves, Mate_result_t *result);
+
+#endif
@@ -0,0 +1,113 @@
+#include <string.h>
+#include "move_recognizer.h"
+
+#define DELTA_NONE 64
+
+// Up to two vacated and two filled squares, 7 bits each, 64 for none
+static uint32_t pack_delta(Bitboard_t vacated, Bitboard_t filled)
+{
+    if (bb_popcount(vacated) > 2 || bb_popcount(filled) > 2) {
+        return UINT32_MAX;
+    }
+    uint32_t squares[4];
+    squares[0] = vacated ? (uint32_t)bb_pop_lsb(&vacated) : DELTA_NONE;
+    squares[1] = vacated ? (uint32_t)bb_lsb(vacated) : DELTA_NONE;
+    squares[2] = filled ? (uint32_t)bb_pop_lsb(&filled) : DELTA_NONE;
+    squares[3] = filled ? (uint32_t)bb_lsb(filled) : DELTA_NONE;
+    return squares[0] | squares[1] << 7 | squares[2] << 14 | squares[3] << 21;
+}
+
+// Linear probing, the table is never more than half full
+static int find_slot(const Move_recognizer_t *rec, uint32_t delta)
+{
+    uint32_t index = (delta * 0x9E3779B1u) >> 23;
+    while (rec->slots[index].count && rec->slots[index].delta != delta) {
+        index = (index + 1) & (RECOGNIZER_SLOTS - 1);
+    }
+    return (int)index;
+}
+
+void move_occupancy_delta(Chess_move_t move, Bitboard_t *vacated, Bitboard_t *filled)
+{
+    int from = MOVE_FROM(move);
+    int to = MOVE_TO(move);
+    *vacated = BB_SQUARE(from);
+    *filled = MOVE_IS_CAPTURE(move) ? 0 : BB_SQUARE(to);
+
+    switch (MOVE_FLAGS(move)) {
+    case MOVE_FLAG_KING_CASTLE:
+        *vacated |= BB_SQUARE(from + 3);
+        *filled |= BB_SQUARE(from + 1);
+        break;
+    case MOVE_FLAG_QUEEN_CASTLE:
+        *vacated |= BB_SQUARE(from - 4);
+        *filled |= BB_SQUARE(from - 1);
+        break;
+    case MOVE_FLAG_EN_PASSANT:
+        // The captured pawn stands next to the from square
+        *vacated |= BB_SQUARE(SQUARE(SQUARE_RANK(from), SQUARE_FILE(to)));
+        *filled = BB_SQUARE(to);
+        break;
+    default:
+        break;
+    }
+}
+
+void move_recognizer_build(Move_recognizer_t *rec, const Chess_position_t *pos)
+{
+    Move_list_t list;
+    uint32_t deltas[MAX_MOVES];
+    generate_legal_moves(pos, &list);
+    memset(rec->slots, 0, sizeof(rec->slots));
+    rec->occupancy = position_occupied(pos);
+
+    // Count the moves of every change, then give each group its place in the move array
+    for (int i = 0; i < list.count; i++) {
+        Bitboard_t vacated, filled;
+        move_occupancy_delta(list.moves[i], &vacated, &filled);
+        deltas[i] = pack_delta(vacated, filled);
+        Recognizer_slot_t *slot = &rec->slots[find_slot(rec, deltas[i])];
+        slot->delta = deltas[i];
+        slot->count++;
+    }
+    int next = 0;
+    uint8_t placed[RECOGNIZER_SLOTS] = {0};
+    for (int i = 0; i < RECOGNIZER_SLOTS; i++) {
+        rec->slots[i].first = (uint8_t)next;
+        next += rec->slots[i].count;
+    }
+    for (int i = 0; i < list.count; i++) {
+        int index = find_slot(rec, deltas[i]);
+        rec->moves[rec->slots[index].first + placed[index]++] = list.moves[i];
+    }
+}
+
+int move_recognizer_candidates(const Move_recognizer_t *rec, Bitboard_t occupancy, const Chess_move_t **moves)
+{
+    uint32_t delta = pack_delta(rec->occupancy & ~occupancy, occupancy & ~rec->occupancy);
+    const Recognizer_slot_t *slot = &rec->slots[find_slot(rec, delta)];
+    *moves = &rec->moves[slot->first];
+    return slot->count;
+}
+
+Chess_move_t move_recognizer_match(const Move_recognizer_t *rec, Bitboard_t occupancy, Bitboard_t touched)
+{
+    const Chess_move_t *moves;
+    int count = move_recognizer_candidates(rec, occupancy, &moves);
+    Chess_move_t found = MOVE_NONE;
+    for (int i = 0; i < count; i++) {
+        Chess_move_t move = moves[i];
+        // The captured piece has to have been lifted, en passant shows in the occupancy already
+        if (MOVE_IS_CAPTURE(move) && MOVE_FLAGS(move) != MOVE_FLAG_EN_PASSANT && !(touched & BB_SQUARE(MOVE_TO(move)))) {
+            continue;
+        }
+        if (MOVE_IS_PROMOTION(move) && MOVE_PROMOTION_PIECE(move) != PIECE_QUEEN) {
+            continue;
+        }
+        if (found != MOVE_NONE) {
+            return MOVE_NONE;
+        }
+        found = move;
+    }
+    return found;
+}
@@ -0,0 +1,77 @@
+#ifndef MOVE_RECOGNIZER_H
+#define MOVE_RECOGNIZER_H
+
+#include <stdint.h>
+#include "position.h"
+#include "moves.h"
+
+#define RECOGNIZER_SLOTS 512   // Power of two, more than twice the 218 moves a position can have
+
+/**
+ * @brief Legal moves sharing one occupancy change
+ *
+ */
+typedef struct {
+    uint32_t delta;        // Packed vacated and filled squares
+    uint8_t first;         // First move of the group in the recognizer
+    uint8_t count;         // Moves in the group, 0 for an empty slot
+} Recognizer_slot_t;
+
+/**
+ * @brief Table from occupancy changes to the legal moves causing them
+ *
+ * Every legal move empties one to two squares and fills zero to two: a
+ * capture only empties its from square, castling moves two pieces and en
+ * passant empties the captured pawn's square too. The table is built once
+ * per position, after that recognizing a move is one hash lookup.
+ */
+typedef struct {
+    Bitboard_t occupancy;                 // Occupancy of the position
+    Chess_move_t moves[MAX_MOVES];        // Legal moves grouped by change
+    Recognizer_slot_t slots[RECOGNIZER_SLOTS];
+} Move_recognizer_t;
+
+/**
+ * @brief Build the table of a position
+ *
+ * @param rec The recognizer
+ * @param pos The position
+ */
+void move_recognizer_build(Move_recognizer_t *rec, const Chess_position_t *pos);
+
+/**
+ * @brief Squares a move empties and fills
+ *
+ * @param move The move
+ * @param vacated Squares occupied before and empty after
+ * @param filled Squares empty before and occupied after
+ */
+void move_occupancy_delta(Chess_move_t move, Bitboard_t *vacated, Bitboard_t *filled);
+
+/**
+ * @brief Every legal move leading to an occupancy
+ *
+ * Captures from the same square all look alike, and so do the four
+ * promotions of a pawn.
+ *
+ * @param rec The recognizer
+ * @param occupancy The occupancy of the board
+ * @param moves Set to the matching moves
+ * @return int Number of matching moves
+ */
+int move_recognizer_candidates(const Move_recognizer_t *rec, Bitboard_t occupancy, const Chess_move_t **moves);
+
+/**
+ * @brief The move leading to an occupancy, if there is exactly one
+ *
+ * A capture only matches if its target square was lifted. Promotions are
+ * to a queen.
+ *
+ * @param rec The recognizer
+ * @param occupancy The occupancy of the board
+ * @param touched Squares lifted since the position was reached
+ * @return Chess_move_t The move, MOVE_NONE if none or several match
+ */
+Chess_move_t move_recognizer_match(const Move_recognizer_t *rec, Bitboard_t occupancy, Bitboard_t touched);
+
+#endif
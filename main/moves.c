@@ -1,244 +1,615 @@
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include "moves.h"
 #include "board.h"
-#include <ctype.h>
+#include "trace.h"
 #include <stdbool.h>
-typedef int (*char_check_fn)(int);
 
-static char_check_fn get_enemy_check(char piece)
+#define MAX_PINS 8
+
+// Everything the generator needs to know about checks and pins, computed once per position
+typedef struct {
+    Side_t us;
+    int king_sq;
+    Bitboard_t occupied;
+    Bitboard_t checkers;
+    Bitboard_t check_mask;  // Squares a non-king move must land on
+    Bitboard_t danger;      // Squares attacked by the opponent, with our king removed
+    Bitboard_t pinned;
+    int pin_count;
+    uint8_t pin_squares[MAX_PINS];
+    Bitboard_t pin_rays[MAX_PINS];
+} Legal_info_t;
+
+// Castling rights lost when a move leaves from or lands on each square
+static const uint8_t castle_lost[SQUARE_NB] = {
+    [0] = CASTLE_WHITE_QUEEN,
+    [4] = CASTLE_WHITE_KING | CASTLE_WHITE_QUEEN,
+    [7] = CASTLE_WHITE_KING,
+    [56] = CASTLE_BLACK_QUEEN,
+    [60] = CASTLE_BLACK_KING | CASTLE_BLACK_QUEEN,
+    [63] = CASTLE_BLACK_KING,
+};
+
+// Squares strictly between two squares on a shared line, 0 if they are not aligned
+static Bitboard_t between(int a, int b)
+{
+    Bitboard_t rook = bb_rook_attacks(a, BB_SQUARE(b));
+    if (rook & BB_SQUARE(b)) {
+        return rook & bb_rook_attacks(b, BB_SQUARE(a));
+    }
+    Bitboard_t bishop = bb_bishop_attacks(a, BB_SQUARE(b));
+    if (bishop & BB_SQUARE(b)) {
+        return bishop & bb_bishop_attacks(b, BB_SQUARE(a));
+    }
+    return 0;
+}
+
+static Bitboard_t attackers_to(const Chess_position_t *pos, int sq, Side_t by, Bitboard_t occupied)
 {
-    return islower(piece) ? isupper : islower;
+    Bitboard_t queens = pos->pieces[PIECE_QUEEN];
+    return ((pawn_attack_table[!by][sq] & pos->pieces[PIECE_PAWN]) |
+            (knight_attack_table[sq] & pos->pieces[PIECE_KNIGHT]) |
+            (king_attack_table[sq] & pos->pieces[PIECE_KING]) |
+            (bb_bishop_attacks(sq, occupied) & (pos->pieces[PIECE_BISHOP] | queens)) |
+            (bb_rook_attacks(sq, occupied) & (pos->pieces[PIECE_ROOK] | queens))) & pos->colors[by];
 }
 
-static bool is_valid_position(int x, int y)
+static Bitboard_t attacked_squares(const Chess_position_t *pos, Side_t by, Bitboard_t occupied)
 {
-    return x >= 0 && x < 8 && y >= 0 && y < 8;
+    Bitboard_t pawns = position_bb(pos, by, PIECE_PAWN);
+    Bitboard_t attacks = (by == SIDE_WHITE) ?
+                         ((pawns & ~BB_FILE_A) << 7) | ((pawns & ~BB_FILE_H) << 9) :
+                         ((pawns & ~BB_FILE_H) >> 7) | ((pawns & ~BB_FILE_A) >> 9);
+
+    Bitboard_t pieces = position_bb(pos, by, PIECE_KNIGHT);
+    while (pieces) {
+        attacks |= knight_attack_table[bb_pop_lsb(&pieces)];
+    }
+    pieces = position_bb(pos, by, PIECE_BISHOP) | position_bb(pos, by, PIECE_QUEEN);
+    while (pieces) {
+        attacks |= bb_bishop_attacks(bb_pop_lsb(&pieces), occupied);
+    }
+    pieces = position_bb(pos, by, PIECE_ROOK) | position_bb(pos, by, PIECE_QUEEN);
+    while (pieces) {
+        attacks |= bb_rook_attacks(bb_pop_lsb(&pieces), occupied);
+    }
+    return attacks | king_attack_table[bb_lsb(position_bb(pos, by, PIECE_KING))];
 }
 
-static int pawn_moves(const char board[8][8], int x, int y, Position_t *moves)
+static void compute_legal_info(const Chess_position_t *pos, Legal_info_t *info)
 {
-    printf("pawn_moves\n");
-    int move_count = 0;
-    char piece = board[x][y];
-    int direction = (piece == 'p') ? -1 : 1;
-    int start_rank = (piece == 'p') ? 6 : 1;
-    char_check_fn is_enemy = get_enemy_check(piece);
+    Side_t us = pos->side_to_move;
+    Side_t them = !us;
+    int king_sq = bb_lsb(position_bb(pos, us, PIECE_KING));
+    Bitboard_t occupied = position_occupied(pos);
+    Bitboard_t queens = position_bb(pos, them, PIECE_QUEEN);
 
-    // Two square advance from starting position
-    if (x == start_rank) {
-        int two_ahead = x + (2 * direction);
-        if (two_ahead >= 0 && two_ahead < 8 && board[two_ahead][y] == ' ') {
-            moves[move_count++] = (Position_t) {
-                two_ahead, y
-            };
+    info->us = us;
+    info->king_sq = king_sq;
+    info->occupied = occupied;
+    info->danger = attacked_squares(pos, them, occupied ^ BB_SQUARE(king_sq));
+    info->checkers = ((pawn_attack_table[us][king_sq] & pos->pieces[PIECE_PAWN]) |
+                      (knight_attack_table[king_sq] & pos->pieces[PIECE_KNIGHT])) & pos->colors[them];
+    info->pinned = 0;
+    info->pin_count = 0;
+
+    // Enemy sliders that see the king through nothing but our own pieces
+    Bitboard_t snipers = (bb_bishop_attacks(king_sq, pos->colors[them]) &
+                          (position_bb(pos, them, PIECE_BISHOP) | queens)) |
+                         (bb_rook_attacks(king_sq, pos->colors[them]) &
+                          (position_bb(pos, them, PIECE_ROOK) | queens));
+    while (snipers) {
+        int sniper_sq = bb_pop_lsb(&snipers);
+        Bitboard_t ray = between(king_sq, sniper_sq);
+        Bitboard_t blockers = ray & occupied;
+        if (!blockers) {
+            info->checkers |= BB_SQUARE(sniper_sq);
+        } else if (!(blockers & (blockers - 1))) {
+            info->pinned |= blockers;
+            info->pin_squares[info->pin_count] = (uint8_t)bb_lsb(blockers);
+            info->pin_rays[info->pin_count] = ray | BB_SQUARE(sniper_sq);
+            info->pin_count++;
         }
     }
 
-    // One square advance
-    int one_ahead = x + direction;
-    if (one_ahead >= 0 && one_ahead < 8 && board[one_ahead][y] == ' ') {
-        moves[move_count++] = (Position_t) {
-            one_ahead, y
-        };
+    if (!info->checkers) {
+        info->check_mask = ~0ULL;
+    } else if (!(info->checkers & (info->checkers - 1))) {
+        int checker_sq = bb_lsb(info->checkers);
+        info->check_mask = between(king_sq, checker_sq) | info->checkers;
+    } else {
+        info->check_mask = 0;
     }
-    // Diagonal captures
-    for (int dy = -1; dy <= 1; dy += 2) {
-        if (y + dy >= 0 && y + dy < 8 && one_ahead >= 0 && one_ahead < 8) {
-            if (is_enemy(board[one_ahead][y + dy])) {
-                moves[move_count++] = (Position_t) {
-                    one_ahead, y + dy
-                };
-            }
+}
+
+// Destination squares allowed for a piece on sq by checks and pins
+static Bitboard_t legal_mask(const Legal_info_t *info, int sq)
+{
+    if (!(info->pinned & BB_SQUARE(sq))) {
+        return info->check_mask;
+    }
+    for (int i = 0; i < info->pin_count; i++) {
+        if (info->pin_squares[i] == sq) {
+            return info->check_mask & info->pin_rays[i];
+        }
+    }
+    return 0;
+}
+
+static void add_targets(Move_list_t *list, int from, Bitboard_t targets, Bitboard_t enemies)
+{
+    while (targets) {
+        int to = bb_pop_lsb(&targets);
+        int flags = (enemies & BB_SQUARE(to)) ? MOVE_FLAG_CAPTURE : MOVE_FLAG_QUIET;
+        list->moves[list->count++] = MOVE_MAKE(from, to, flags);
+    }
+}
+
+static void add_pawn_move(Move_list_t *list, int from, int to, int flags)
+{
+    if (BB_SQUARE(to) & (BB_RANK_1 | BB_RANK_8)) {
+        for (int piece = PIECE_QUEEN; piece >= PIECE_KNIGHT; piece--) {
+            list->moves[list->count++] = MOVE_MAKE(from, to, flags | MOVE_FLAG_PROMOTION | (piece - PIECE_KNIGHT));
         }
+    } else {
+        list->moves[list->count++] = MOVE_MAKE(from, to, flags);
     }
-    return move_count;
 }
 
-static int rook_moves(const char board[8][8], int x, int y, Position_t *moves)
+// An en passant capture removes two pawns from one rank, which no pin mask can describe
+static bool en_passant_is_legal(const Chess_position_t *pos, const Legal_info_t *info, int from, int captured_sq)
 {
-    // TODO: add a check for castling
-    printf("rook_moves\n");
-    int move_count = 0;
-    char_check_fn is_enemy = get_enemy_check(board[x][y]);
-    // Direction arrays for horizontal and vertical movement
-    const int dx[] = {0, 0, -1, 1};  // Left, right, up, down
-    const int dy[] = {-1, 1, 0, 0};
+    Side_t them = !info->us;
+    Bitboard_t occupied = (info->occupied ^ BB_SQUARE(from) ^ BB_SQUARE(captured_sq)) | BB_SQUARE(pos->ep_square);
+    Bitboard_t queens = position_bb(pos, them, PIECE_QUEEN);
+
+    // A knight or pawn check can only be answered by capturing the checker
+    Bitboard_t other_checkers = info->checkers & ~pos->pieces[PIECE_BISHOP] & ~pos->pieces[PIECE_ROOK] & ~queens;
+    if (other_checkers & ~BB_SQUARE(captured_sq)) {
+        return false;
+    }
+    return !((bb_bishop_attacks(info->king_sq, occupied) & (position_bb(pos, them, PIECE_BISHOP) | queens)) |
+             (bb_rook_attacks(info->king_sq, occupied) & (position_bb(pos, them, PIECE_ROOK) | queens)));
+}
 
-    // Check all four directions
-    for (int dir = 0; dir < 4; dir++) {
-        for (int i = 1; ; i++) {
-            int new_x = x + dx[dir] * i;
-            int new_y = y + dy[dir] * i;
+static void pawn_moves(const Chess_position_t *pos, const Legal_info_t *info, Bitboard_t from_mask, Move_list_t *list)
+{
+    TRACE_VERBOSE(TRACE_MOVEGEN, PIECE_PAWN, 0);
+    Side_t us = info->us;
+    Bitboard_t enemies = pos->colors[!us];
+    Bitboard_t empty = ~info->occupied;
+    int forward = (us == SIDE_WHITE) ? 8 : -8;
+    Bitboard_t double_rank = (us == SIDE_WHITE) ? 0x000000000000FF00ULL : 0x00FF000000000000ULL;
+    Bitboard_t pawns = position_bb(pos, us, PIECE_PAWN) & from_mask;
 
-            if (!is_valid_position(new_x, new_y)) {
-                break;  // Out of bounds
-            }
+    while (pawns) {
+        int from = bb_pop_lsb(&pawns);
+        Bitboard_t mask = legal_mask(info, from);
+        int one_ahead = from + forward;
 
-            if (board[new_x][new_y] != ' ') {
-                if (is_enemy(board[new_x][new_y])) {
-                    moves[move_count++] = (Position_t) {
-                        new_x, new_y
-                    };
-                }
-                break;  // Hit a piece
+        // One square advance, then a second one from the starting rank
+        if (empty & BB_SQUARE(one_ahead)) {
+            if (mask & BB_SQUARE(one_ahead)) {
+                add_pawn_move(list, from, one_ahead, MOVE_FLAG_QUIET);
             }
+            int two_ahead = one_ahead + forward;
+            if ((BB_SQUARE(from) & double_rank) && (empty & mask & BB_SQUARE(two_ahead))) {
+                list->moves[list->count++] = MOVE_MAKE(from, two_ahead, MOVE_FLAG_DOUBLE_PUSH);
+            }
+        }
+
+        // Diagonal captures
+        Bitboard_t captures = pawn_attack_table[us][from] & enemies & mask;
+        while (captures) {
+            add_pawn_move(list, from, bb_pop_lsb(&captures), MOVE_FLAG_CAPTURE);
+        }
 
-            moves[move_count++] = (Position_t) {
-                new_x, new_y
-            };
+        if (pos->ep_square != SQUARE_NONE && (pawn_attack_table[us][from] & BB_SQUARE(pos->ep_square)) &&
+                en_passant_is_legal(pos, info, from, pos->ep_square - forward)) {
+            list->moves[list->count++] = MOVE_MAKE(from, pos->ep_square, MOVE_FLAG_EN_PASSANT);
         }
     }
-    return move_count;
 }
 
-static int knight_moves(const char board[8][8], int x, int y, Position_t *moves)
+static void rook_moves(const Chess_position_t *pos, const Legal_info_t *info, Bitboard_t from_mask, Move_list_t *list)
 {
-    printf("knight_moves\n");
-    int move_count = 0;
-    char_check_fn is_enemy = get_enemy_check(board[x][y]);
-    // Direction arrays for the 8 possible knight moves
-    const int dx[] = {2, 2, -2, -2, 1, 1, -1, -1};
-    const int dy[] = {1, -1, 1, -1, 2, -2, 2, -2};
+    TRACE_VERBOSE(TRACE_MOVEGEN, PIECE_ROOK, 0);
+    Bitboard_t rooks = position_bb(pos, info->us, PIECE_ROOK) & from_mask;
+    while (rooks) {
+        int from = bb_pop_lsb(&rooks);
+        Bitboard_t targets = bb_rook_attacks(from, info->occupied) & ~pos->colors[info->us] & legal_mask(info, from);
+        add_targets(list, from, targets, pos->colors[!info->us]);
+    }
+}
 
-    // Check all possible knight moves
-    for (int i = 0; i < 8; i++) {
-        int new_x = x + dx[i];
-        int new_y = y + dy[i];
-        if (is_valid_position(new_x, new_y) &&
-                (board[new_x][new_y] == ' ' || is_enemy(board[new_x][new_y]))) {
-            moves[move_count++] = (Position_t) {
-                new_x, new_y
-            };
-        }
+static void knight_moves(const Chess_position_t *pos, const Legal_info_t *info, Bitboard_t from_mask, Move_list_t *list)
+{
+    TRACE_VERBOSE(TRACE_MOVEGEN, PIECE_KNIGHT, 0);
+    // A pinned knight can never stay on its pin ray
+    Bitboard_t knights = position_bb(pos, info->us, PIECE_KNIGHT) & from_mask & ~info->pinned;
+    while (knights) {
+        int from = bb_pop_lsb(&knights);
+        Bitboard_t targets = knight_attack_table[from] & ~pos->colors[info->us] & info->check_mask;
+        add_targets(list, from, targets, pos->colors[!info->us]);
     }
-    return move_count;
 }
 
-static int bishop_moves(const char board[8][8], int x, int y, Position_t *moves)
+static void bishop_moves(const Chess_position_t *pos, const Legal_info_t *info, Bitboard_t from_mask, Move_list_t *list)
 {
-    printf("bishop_moves\n");
-    int move_count = 0;
-    char_check_fn is_enemy = get_enemy_check(board[x][y]);
+    TRACE_VERBOSE(TRACE_MOVEGEN, PIECE_BISHOP, 0);
+    Bitboard_t bishops = position_bb(pos, info->us, PIECE_BISHOP) & from_mask;
+    while (bishops) {
+        int from = bb_pop_lsb(&bishops);
+        Bitboard_t targets = bb_bishop_attacks(from, info->occupied) & ~pos->colors[info->us] & legal_mask(info, from);
+        add_targets(list, from, targets, pos->colors[!info->us]);
+    }
+}
 
-    // Direction arrays for the four diagonals
-    const int dx[] = {-1, -1, 1, 1};
-    const int dy[] = {-1, 1, -1, 1};
+static void king_moves(const Chess_position_t *pos, const Legal_info_t *info, Bitboard_t from_mask, Move_list_t *list)
+{
+    TRACE_VERBOSE(TRACE_MOVEGEN, PIECE_KING, 0);
+    int from = info->king_sq;
+    if (!(from_mask & BB_SQUARE(from))) {
+        return;
+    }
+    Bitboard_t targets = king_attack_table[from] & ~pos->colors[info->us] & ~info->danger;
+    add_targets(list, from, targets, pos->colors[!info->us]);
 
-    // Check all four diagonal directions
-    for (int dir = 0; dir < 4; dir++) {
-        for (int i = x + dx[dir], j = y + dy[dir]; is_valid_position(i, j); i += dx[dir], j += dy[dir]) {
-            if (board[i][j] == ' ') {
-                moves[move_count++] = (Position_t) {
-                    i, j
-                };
-            } else if (is_enemy(board[i][j])) {
-                moves[move_count++] = (Position_t) {
-                    i, j
-                };
-                break;
-            } else {
-                break;
-            }
-        }
+    if (info->checkers) {
+        return;
+    }
+
+    // The king may not castle out of, through or into check
+    int rank_shift = (info->us == SIDE_WHITE) ? 0 : 56;
+    uint8_t king_side = (info->us == SIDE_WHITE) ? CASTLE_WHITE_KING : CASTLE_BLACK_KING;
+    uint8_t queen_side = (info->us == SIDE_WHITE) ? CASTLE_WHITE_QUEEN : CASTLE_BLACK_QUEEN;
+    if ((pos->castling & king_side) &&
+            !(info->occupied & (0x60ULL << rank_shift)) &&
+            !(info->danger & (0x60ULL << rank_shift))) {
+        list->moves[list->count++] = MOVE_MAKE(from, from + 2, MOVE_FLAG_KING_CASTLE);
+    }
+    if ((pos->castling & queen_side) &&
+            !(info->occupied & (0x0EULL << rank_shift)) &&
+            !(info->danger & (0x0CULL << rank_shift))) {
+        list->moves[list->count++] = MOVE_MAKE(from, from - 2, MOVE_FLAG_QUEEN_CASTLE);
+    }
+}
+
+static void queen_moves(const Chess_position_t *pos, const Legal_info_t *info, Bitboard_t from_mask, Move_list_t *list)
+{
+    TRACE_VERBOSE(TRACE_MOVEGEN, PIECE_QUEEN, 0);
+    Bitboard_t queens = position_bb(pos, info->us, PIECE_QUEEN) & from_mask;
+    while (queens) {
+        int from = bb_pop_lsb(&queens);
+        Bitboard_t targets = bb_queen_attacks(from, info->occupied) & ~pos->colors[info->us] & legal_mask(info, from);
+        add_targets(list, from, targets, pos->colors[!info->us]);
+    }
+}
+
+static int generate_moves(const Chess_position_t *pos, Bitboard_t from_mask, Move_list_t *list)
+{
+    Legal_info_t info;
+    compute_legal_info(pos, &info);
+    list->count = 0;
+
+    king_moves(pos, &info, from_mask, list);
+    // In double check only the king can move
+    if (info.checkers & (info.checkers - 1)) {
+        return list->count;
     }
-    return move_count;
+    pawn_moves(pos, &info, from_mask, list);
+    knight_moves(pos, &info, from_mask, list);
+    bishop_moves(pos, &info, from_mask, list);
+    rook_moves(pos, &info, from_mask, list);
+    queen_moves(pos, &info, from_mask, list);
+    return list->count;
 }
 
-static int king_moves(const char board[8][8], int x, int y, Position_t *moves)
+int generate_legal_moves(const Chess_position_t *pos, Move_list_t *list)
 {
-    printf("king_moves\n");
-    int move_count = 0;
-    char_check_fn is_enemy = get_enemy_check(board[x][y]);
+    return generate_moves(pos, ~0ULL, list);
+}
 
-    // Direction arrays for the eight possible king moves
-    const int dx[] = {-1, -1, -1, 0, 0, 1, 1, 1};
-    const int dy[] = {-1, 0, 1, -1, 1, -1, 0, 1};
+int generate_legal_moves_from(const Chess_position_t *pos, int sq, Move_list_t *list)
+{
+    return generate_moves(pos, BB_SQUARE(sq), list);
+}
 
-    // Check all 8 possible king moves
-    for (int i = 0; i < 8; i++) {
-        int new_x = x + dx[i];
-        int new_y = y + dy[i];
+bool is_in_check(const Chess_position_t *pos)
+{
+    Side_t us = pos->side_to_move;
+    int king_sq = bb_lsb(position_bb(pos, us, PIECE_KING));
+    return attackers_to(pos, king_sq, !us, position_occupied(pos)) != 0;
+}
 
-        if (is_valid_position(new_x, new_y) && (board[new_x][new_y] == ' ' || is_enemy(board[new_x][new_y]))) {
-            moves[move_count++] = (Position_t) {
-                new_x, new_y
-            };
+Chess_move_t find_legal_move(const Chess_position_t *pos, int from, int to, Piece_type_t promotion)
+{
+    Move_list_t list;
+    generate_legal_moves_from(pos, from, &list);
+    for (int i = 0; i < list.count; i++) {
+        Chess_move_t move = list.moves[i];
+        if (MOVE_TO(move) != to) {
+            continue;
+        }
+        if (!MOVE_IS_PROMOTION(move) || MOVE_PROMOTION_PIECE(move) == promotion) {
+            return move;
         }
     }
-    return move_count;
+    return MOVE_NONE;
 }
 
-static int queen_moves(const char board[8][8], int x, int y, Position_t *moves)
+// Piece updates of make_move, the types are known so the key is updated without lookups
+static inline void toggle_piece(Chess_position_t *pos, int sq, Side_t side, Piece_type_t type)
 {
-    printf("queen_moves\n");
-    int move_count = 0;
-    char_check_fn is_enemy = get_enemy_check(board[x][y]);
+    pos->pieces[type] ^= BB_SQUARE(sq);
+    pos->colors[side] ^= BB_SQUARE(sq);
+    pos->key ^= zobrist_piece_table[side][type][sq];
+}
 
-    // Direction arrays for all 8 directions (horizontal, vertical, diagonal)
-    const int dx[] = {-1, -1, -1, 0, 0, 1, 1, 1};
-    const int dy[] = {-1, 0, 1, -1, 1, -1, 0, 1};
+void make_move(Chess_position_t *pos, Chess_move_t move)
+{
+    Move_undo_t undo;
+    make_move_undo(pos, move, &undo);
+}
 
-    // Check all eight directions
-    for (int dir = 0; dir < 8; dir++) {
-        for (int i = 1; ; i++) {
-            int new_x = x + dx[dir] * i;
-            int new_y = y + dy[dir] * i;
+void make_move_undo(Chess_position_t *pos, Chess_move_t move, Move_undo_t *undo)
+{
+    Side_t us = pos->side_to_move;
+    Side_t them = !us;
+    int from = MOVE_FROM(move);
+    int to = MOVE_TO(move);
+    int flags = MOVE_FLAGS(move);
+    Piece_type_t type = position_piece_at(pos, from);
 
-            if (!is_valid_position(new_x, new_y)) {
-                break;  // Out of bounds
-            }
+    undo->key = pos->key;
+    undo->captured = PIECE_NONE;
+    undo->castling = pos->castling;
+    undo->ep_square = pos->ep_square;
+    undo->halfmove_clock = pos->halfmove_clock;
 
-            if (board[new_x][new_y] != ' ') {
-                if (is_enemy(board[new_x][new_y])) {
-                    moves[move_count++] = (Position_t) {
-                        new_x, new_y
-                    };
-                }
-                break;  // Hit a piece
-            }
+    // Take out the old rights, en passant and side, they are put back below
+    pos->key ^= zobrist_castling_table[pos->castling] ^ position_ep_key(pos) ^ zobrist_side_key;
+    if (pos->halfmove_clock < UINT8_MAX) {
+        pos->halfmove_clock++;
+    }
+    pos->ep_square = SQUARE_NONE;
 
-            moves[move_count++] = (Position_t) {
-                new_x, new_y
-            };
-        }
+    if (flags == MOVE_FLAG_EN_PASSANT) {
+        undo->captured = PIECE_PAWN;
+        toggle_piece(pos, (us == SIDE_WHITE) ? to - 8 : to + 8, them, PIECE_PAWN);
+    } else if (flags & MOVE_FLAG_CAPTURE) {
+        undo->captured = (uint8_t)position_piece_at(pos, to);
+        toggle_piece(pos, to, them, (Piece_type_t)undo->captured);
+    }
+    if ((flags & MOVE_FLAG_CAPTURE) || type == PIECE_PAWN) {
+        pos->halfmove_clock = 0;
+    }
+
+    toggle_piece(pos, from, us, type);
+    toggle_piece(pos, to, us, (flags & MOVE_FLAG_PROMOTION) ? MOVE_PROMOTION_PIECE(move) : type);
+
+    if (flags == MOVE_FLAG_DOUBLE_PUSH) {
+        pos->ep_square = (uint8_t)((from + to) / 2);
+    } else if (flags == MOVE_FLAG_KING_CASTLE) {
+        toggle_piece(pos, to + 1, us, PIECE_ROOK);
+        toggle_piece(pos, to - 1, us, PIECE_ROOK);
+    } else if (flags == MOVE_FLAG_QUEEN_CASTLE) {
+        toggle_piece(pos, to - 2, us, PIECE_ROOK);
+        toggle_piece(pos, to + 1, us, PIECE_ROOK);
+    }
+
+    pos->castling &= ~(castle_lost[from] | castle_lost[to]);
+    if (us == SIDE_BLACK) {
+        pos->fullmove_number++;
     }
-    return move_count;
+    pos->side_to_move = them;
+    pos->key ^= zobrist_castling_table[pos->castling] ^ position_ep_key(pos);
 }
 
-int get_available_moves(const char board[8][8], int x, int y, Position_t *moves)
+// Piece updates of unmake_move, the key is restored whole
+static inline void toggle_bits(Chess_position_t *pos, int sq, Side_t side, Piece_type_t type)
 {
-    switch (board[x][y]) {
-    case 'P':
-    case 'p':
-        return pawn_moves(board, x, y, moves);
-    case 'R':
-    case 'r':
-        return rook_moves(board, x, y, moves);
-    case 'N':
-    case 'n':
-        return knight_moves(board, x, y, moves);
-    case 'B':
-    case 'b':
-        return bishop_moves(board, x, y, moves);
-    case 'Q':
-    case 'q':
-        return queen_moves(board, x, y, moves);
-    case 'K':
-    case 'k':
-        return king_moves(board, x, y, moves);
-    default:
-        return 0;
+    pos->pieces[type] ^= BB_SQUARE(sq);
+    pos->colors[side] ^= BB_SQUARE(sq);
+}
+
+void unmake_move(Chess_position_t *pos, Chess_move_t move, const Move_undo_t *undo)
+{
+    Side_t them = pos->side_to_move;
+    Side_t us = !them;
+    int from = MOVE_FROM(move);
+    int to = MOVE_TO(move);
+    int flags = MOVE_FLAGS(move);
+    Piece_type_t placed = position_piece_at(pos, to);
+
+    toggle_bits(pos, to, us, placed);
+    toggle_bits(pos, from, us, (flags & MOVE_FLAG_PROMOTION) ? PIECE_PAWN : placed);
+    if (flags == MOVE_FLAG_EN_PASSANT) {
+        toggle_bits(pos, (us == SIDE_WHITE) ? to - 8 : to + 8, them, PIECE_PAWN);
+    } else if (flags & MOVE_FLAG_CAPTURE) {
+        toggle_bits(pos, to, them, (Piece_type_t)undo->captured);
+    } else if (flags == MOVE_FLAG_KING_CASTLE) {
+        toggle_bits(pos, to - 1, us, PIECE_ROOK);
+        toggle_bits(pos, to + 1, us, PIECE_ROOK);
+    } else if (flags == MOVE_FLAG_QUEEN_CASTLE) {
+        toggle_bits(pos, to + 1, us, PIECE_ROOK);
+        toggle_bits(pos, to - 2, us, PIECE_ROOK);
+    }
+
+    if (us == SIDE_BLACK) {
+        pos->fullmove_number--;
+    }
+    pos->side_to_move = us;
+    pos->castling = undo->castling;
+    pos->ep_square = undo->ep_square;
+    pos->halfmove_clock = undo->halfmove_clock;
+    pos->key = undo->key;
+}
+
+char *move_to_uci(Chess_move_t move, char *buf)
+{
+    static const char promotion_chars[] = "nbrq";
+    int from = MOVE_FROM(move);
+    int to = MOVE_TO(move);
+    char *p = buf;
+
+    *p++ = 'a' + SQUARE_FILE(from);
+    *p++ = '1' + SQUARE_RANK(from);
+    *p++ = 'a' + SQUARE_FILE(to);
+    *p++ = '1' + SQUARE_RANK(to);
+    if (MOVE_IS_PROMOTION(move)) {
+        *p++ = promotion_chars[MOVE_FLAGS(move) & 0x3];
+    }
+    *p = '\0';
+    return buf;
+}
+
+char *move_to_san(const Chess_position_t *pos, Chess_move_t move, char *buf)
+{
+    static const char piece_letters[] = "PNBRQK";
+    int from = MOVE_FROM(move);
+    int to = MOVE_TO(move);
+    Piece_type_t type = position_piece_at(pos, from);
+    char *p = buf;
+
+    if (MOVE_FLAGS(move) == MOVE_FLAG_KING_CASTLE) {
+        p += sprintf(p, "O-O");
+    } else if (MOVE_FLAGS(move) == MOVE_FLAG_QUEEN_CASTLE) {
+        p += sprintf(p, "O-O-O");
+    } else if (type == PIECE_PAWN) {
+        if (MOVE_IS_CAPTURE(move)) {
+            *p++ = 'a' + SQUARE_FILE(from);
+            *p++ = 'x';
+        }
+    } else {
+        *p++ = piece_letters[type];
+
+        // Other pieces of the same type that can reach the same square
+        Move_list_t list;
+        generate_legal_moves(pos, &list);
+        Bitboard_t others = 0;
+        for (int i = 0; i < list.count; i++) {
+            int other = MOVE_FROM(list.moves[i]);
+            if (MOVE_TO(list.moves[i]) == to && other != from && position_piece_at(pos, other) == type) {
+                others |= BB_SQUARE(other);
+            }
+        }
+        if (others) {
+            if (!(others & (BB_FILE_A << SQUARE_FILE(from)))) {
+                *p++ = 'a' + SQUARE_FILE(from);
+            } else if (!(others & (BB_RANK_1 << (8 * SQUARE_RANK(from))))) {
+                *p++ = '1' + SQUARE_RANK(from);
+            } else {
+                *p++ = 'a' + SQUARE_FILE(from);
+                *p++ = '1' + SQUARE_RANK(from);
+            }
+        }
+        if (MOVE_IS_CAPTURE(move)) {
+            *p++ = 'x';
+        }
     }
+
+    if (!MOVE_IS_CASTLE(move)) {
+        *p++ = 'a' + SQUARE_FILE(to);
+        *p++ = '1' + SQUARE_RANK(to);
+    }
+    if (MOVE_IS_PROMOTION(move)) {
+        *p++ = '=';
+        *p++ = piece_letters[MOVE_PROMOTION_PIECE(move)];
+    }
+
+    Chess_position_t after = *pos;
+    make_move(&after, move);
+    if (is_in_check(&after)) {
+        Move_list_t replies;
+        *p++ = generate_legal_moves(&after, &replies) ? '+' : '#';
+    }
+    *p = '\0';
+    return buf;
+}
+
+// Piece letter of SAN, pawns have none
+static Piece_type_t san_piece(char c)
+{
+    static const char letters[] = "NBRQK";
+    const char *found = c ? memchr(letters, c, sizeof(letters) - 1) : NULL;
+    return found ? (Piece_type_t)(PIECE_KNIGHT + (found - letters)) : PIECE_NONE;
 }
 
-bool is_valid_move(Position_t end, Position_t *moves, int move_count)
+// Parsed from the end: promotion, target square, capture mark, then what is left disambiguates
+Chess_move_t move_from_san(const Chess_position_t *pos, const char *san, int length)
 {
-    // Check if the end position matches any of the valid moves
-    for (int i = 0; i < move_count; i++) {
-        if (moves[i].x == end.x && moves[i].y == end.y) {
-            return true;
+    while (length > 0 && strchr("+#!?", san[length - 1])) {
+        length--;
+    }
+    int castle = 0;
+    if (length == 3 && (memcmp(san, "O-O", 3) == 0 || memcmp(san, "0-0", 3) == 0)) {
+        castle = MOVE_FLAG_KING_CASTLE;
+    } else if (length == 5 && (memcmp(san, "O-O-O", 5) == 0 || memcmp(san, "0-0-0", 5) == 0)) {
+        castle = MOVE_FLAG_QUEEN_CASTLE;
+    }
+
+    Piece_type_t type = PIECE_PAWN, promotion = PIECE_NONE;
+    int to = SQUARE_NONE, from_file = -1, from_rank = -1;
+    bool capture = false;
+    if (!castle) {
+        if (length > 0 && san_piece(san[0]) != PIECE_NONE) {
+            type = san_piece(san[0]);
+            san++;
+            length--;
+        }
+        if (type == PIECE_PAWN && length > 0 && san_piece(san[length - 1]) != PIECE_NONE) {
+            promotion = san_piece(san[--length]);
+            if (length > 0 && san[length - 1] == '=') {
+                length--;
+            }
+        }
+        if (length < 2 || san[length - 2] < 'a' || san[length - 2] > 'h' || san[length - 1] < '1' ||
+                san[length - 1] > '8') {
+            return MOVE_NONE;
+        }
+        to = SQUARE(san[length - 1] - '1', san[length - 2] - 'a');
+        length -= 2;
+        if (length > 0 && san[length - 1] == 'x') {
+            capture = true;
+            length--;
+        }
+        for (int i = 0; i < length; i++) {
+            if (san[i] >= 'a' && san[i] <= 'h' && from_file < 0 && from_rank < 0) {
+                from_file = san[i] - 'a';
+            } else if (san[i] >= '1' && san[i] <= '8' && from_rank < 0) {
+                from_rank = san[i] - '1';
+            } else {
+                return MOVE_NONE;
+            }
+        }
+        if (promotion == PIECE_KING || (type == PIECE_PAWN && capture != (from_file >= 0))) {
+            return MOVE_NONE;
+        }
+    }
+
+    Move_list_t list;
+    generate_legal_moves(pos, &list);
+    Chess_move_t found = MOVE_NONE;
+    for (int i = 0; i < list.count; i++) {
+        Chess_move_t move = list.moves[i];
+        int from = MOVE_FROM(move);
+        if (castle) {
+            if (MOVE_FLAGS(move) != castle) {
+                continue;
+            }
+        } else if (MOVE_TO(move) != to || MOVE_IS_CASTLE(move) || position_piece_at(pos, from) != type ||
+                   (from_file >= 0 && SQUARE_FILE(from) != from_file) ||
+                   (from_rank >= 0 && SQUARE_RANK(from) != from_rank) || !MOVE_IS_CAPTURE(move) != !capture ||
+                   (MOVE_IS_PROMOTION(move) ? MOVE_PROMOTION_PIECE(move) != promotion : promotion != PIECE_NONE)) {
+            continue;
+        }
+        if (found != MOVE_NONE) {
+            return MOVE_NONE;
         }
+        found = move;
     }
-    return false;
+    return found;
 }
@@ -2,46 +2,164 @@
 #define MOVES_H
 
 #include <stdbool.h>
-#include "board.h"
+#include <stdint.h>
+#include "position.h"
 
 /**
- * @brief A position on the board
+ * @brief A move packed into 16 bits
+ *
+ * Bits 0-5 hold the from square, bits 6-11 the to square and bits 12-15 the
+ * MOVE_FLAG_* value. Promotion flags carry the promoted piece in their low
+ * two bits.
+ */
+typedef uint16_t Chess_move_t;
+
+#define MOVE_NONE ((Chess_move_t)0)
+
+#define MOVE_FLAG_QUIET 0x0
+#define MOVE_FLAG_DOUBLE_PUSH 0x1
+#define MOVE_FLAG_KING_CASTLE 0x2
+#define MOVE_FLAG_QUEEN_CASTLE 0x3
+#define MOVE_FLAG_CAPTURE 0x4
+#define MOVE_FLAG_EN_PASSANT 0x5
+#define MOVE_FLAG_PROMOTION 0x8   // Or'ed with promoted piece - PIECE_KNIGHT
+
+#define MOVE_MAKE(from, to, flags) ((Chess_move_t)((from) | ((to) << 6) | ((flags) << 12)))
+#define MOVE_FROM(move) ((move) & 0x3F)
+#define MOVE_TO(move) (((move) >> 6) & 0x3F)
+#define MOVE_FLAGS(move) ((move) >> 12)
+#define MOVE_IS_CAPTURE(move) (MOVE_FLAGS(move) & MOVE_FLAG_CAPTURE)
+#define MOVE_IS_PROMOTION(move) (MOVE_FLAGS(move) & MOVE_FLAG_PROMOTION)
+#define MOVE_IS_CASTLE(move) (MOVE_FLAGS(move) == MOVE_FLAG_KING_CASTLE || MOVE_FLAGS(move) == MOVE_FLAG_QUEEN_CASTLE)
+#define MOVE_PROMOTION_PIECE(move) ((Piece_type_t)((MOVE_FLAGS(move) & 0x3) + PIECE_KNIGHT))
+
+// Longest SAN move with its terminating NUL, e.g. "Qa1xb2+"
+#define MOVE_SAN_MAX 8
+
+// No legal position has more than 218 moves
+#define MAX_MOVES 256
+
+/**
+ * @brief A list of generated moves
  *
  */
 typedef struct {
-    int x;
-    int y;
-} Position_t;
+    Chess_move_t moves[MAX_MOVES];
+    int count;
+} Move_list_t;
 
 /**
- * @brief A move on the board
+ * @brief What a move destroys, enough to take it back
  *
+ * The pieces a move displaces follow from the move itself, only the
+ * captured piece and the state that cannot be recomputed are kept.
  */
 typedef struct {
-    Position_t start;
-    Position_t end;
-} Move_t;
+    uint64_t key;              // Key before the move
+    uint8_t captured;          // Piece_type_t taken, PIECE_NONE if none
+    uint8_t castling;
+    uint8_t ep_square;
+    uint8_t halfmove_clock;
+} Move_undo_t;
+
+/**
+ * @brief Generate every legal move for the side to move
+ *
+ * Checkers, pin rays and the squares attacked by the opponent are computed
+ * once and used as masks, so no move has to be played to test it.
+ *
+ * @param pos The current position
+ * @param list The list to fill
+ * @return int Number of legal moves found
+ */
+int generate_legal_moves(const Chess_position_t *pos, Move_list_t *list);
+
+/**
+ * @brief Generate the legal moves of the piece on one square
+ *
+ * @param pos The current position
+ * @param sq The square of the piece, must belong to the side to move
+ * @param list The list to fill
+ * @return int Number of legal moves found
+ */
+int generate_legal_moves_from(const Chess_position_t *pos, int sq, Move_list_t *list);
+
+/**
+ * @brief Check if the side to move is in check
+ *
+ * @param pos The current position
+ * @return true if the king of the side to move is attacked
+ */
+bool is_in_check(const Chess_position_t *pos);
 
 /**
- * @brief Get the available moves for a piece based on the piece's position
+ * @brief Find the legal move matching a from and to square
  *
- * @param board The current board state
- * @param x The x coordinate of the piece
- * @param y The y coordinate of the piece
- * @param moves Array to store valid moves
- * @return int Number of valid moves found
+ * @param pos The current position
+ * @param from The from square
+ * @param to The to square
+ * @param promotion Piece to promote to if the move is a promotion
+ * @return Chess_move_t The legal move, MOVE_NONE if there is none
  */
-int get_available_moves(const char board[8][8], int x, int y, Position_t *moves);
+Chess_move_t find_legal_move(const Chess_position_t *pos, int from, int to, Piece_type_t promotion);
 
 /**
- * @brief Check if a move is valid
+ * @brief Play a move, updating castling rights, en passant square and clocks
+ *
+ * @param pos The position to update
+ * @param move A legal move for the side to move
+ */
+void make_move(Chess_position_t *pos, Chess_move_t move);
+
+/**
+ * @brief Play a move, saving what unmake_move() needs to take it back
+ *
+ * @param pos The position to update
+ * @param move A legal move for the side to move
+ * @param undo Filled with the state the move destroys
+ */
+void make_move_undo(Chess_position_t *pos, Chess_move_t move, Move_undo_t *undo);
+
+/**
+ * @brief Take back a move in constant time, restoring the position before it exactly
+ *
+ * @param pos The position after the move
+ * @param move The last move played
+ * @param undo The state saved by make_move_undo()
+ */
+void unmake_move(Chess_position_t *pos, Chess_move_t move, const Move_undo_t *undo);
+
+/**
+ * @brief Format a move in long algebraic notation, e.g. e2e4 or e7e8q
+ *
+ * @param move The move
+ * @param buf Buffer of at least 6 chars
+ * @return char* The buffer
+ */
+char *move_to_uci(Chess_move_t move, char *buf);
+
+/**
+ * @brief Format a move in standard algebraic notation, e.g. Nbd2, exd6 or e8=Q#
+ *
+ * @param pos The position before the move
+ * @param move A legal move for the side to move
+ * @param buf Buffer of at least MOVE_SAN_MAX chars
+ * @return char* The buffer
+ */
+char *move_to_san(const Chess_position_t *pos, Chess_move_t move, char *buf);
+
+/**
+ * @brief Find the legal move a SAN token names
+ *
+ * Check and annotation suffixes are ignored and castling may be written
+ * with zeros. A capture has to be marked with x, and a promotion with or
+ * without the =.
  *
- * @param end The end position of the move
- * @param moves Array of valid moves
- * @param move_count Number of valid moves
- * @return true if the move is valid
- * @return false if the move is invalid
+ * @param pos The position before the move
+ * @param san The token, not necessarily NUL terminated
+ * @param length Length of the token
+ * @return Chess_move_t The move, MOVE_NONE if the token is malformed, illegal or ambiguous
  */
-bool is_valid_move(Position_t end, Position_t *moves, int move_count);
+Chess_move_t move_from_san(const Chess_position_t *pos, const char *san, int length);
 
 #endif
@@ -0,0 +1,209 @@
+#include <string.h>
+#include "nnue.h"
+
+// The reference kernels stay scalar, so the benchmark shows what vectorizing gains
+#if defined(__GNUC__) && !defined(__clang__)
+#define SCALAR_KERNEL __attribute__((optimize("no-tree-vectorize")))
+#else
+#define SCALAR_KERNEL
+#endif
+
+// A move adds and removes at most two features per perspective, missing ones are this row
+static const int16_t zero_row[NNUE_HIDDEN];
+
+typedef struct {
+    // out = in + add[0] + add[1] - sub[0] - sub[1], out may be in
+    void (*update)(int16_t *out, const int16_t *in, const int16_t *const add[2], const int16_t *const sub[2]);
+    int (*evaluate)(const int16_t *us, const int16_t *them);
+} Kernels_t;
+
+static inline int feature_index(Side_t perspective, Side_t side, Piece_type_t type, int sq)
+{
+    int relative_sq = perspective == SIDE_WHITE ? sq : sq ^ 56;
+    return ((side != perspective) * PIECE_TYPE_NB + type) * SQUARE_NB + relative_sq;
+}
+
+static inline const int16_t *feature_row(Side_t perspective, Side_t side, Piece_type_t type, int sq)
+{
+    return nnue_net.ft_weights[feature_index(perspective, side, type, sq)];
+}
+
+static inline int output_cp(int32_t sum)
+{
+    return (sum * NNUE_CP_PER_UNIT) >> NNUE_WEIGHT_SHIFT;
+}
+
+SCALAR_KERNEL static int8_t clip_scalar(int32_t value)
+{
+    if (value < 0) {
+        return 0;
+    }
+    if (value > NNUE_CLAMP) {
+        return NNUE_CLAMP;
+    }
+    return (int8_t)value;
+}
+
+SCALAR_KERNEL static void update_scalar(int16_t *out, const int16_t *in, const int16_t *const add[2],
+                                        const int16_t *const sub[2])
+{
+    for (int i = 0; i < NNUE_HIDDEN; i++) {
+        out[i] = in[i];
+    }
+    for (int j = 0; j < 2; j++) {
+        for (int i = 0; i < NNUE_HIDDEN; i++) {
+            out[i] += add[j][i];
+        }
+        for (int i = 0; i < NNUE_HIDDEN; i++) {
+            out[i] -= sub[j][i];
+        }
+    }
+}
+
+SCALAR_KERNEL static void dense_scalar(int8_t *out, int out_count, const int8_t *in, int in_count,
+                                       const int8_t *weights, const int32_t *biases)
+{
+    for (int o = 0; o < out_count; o++) {
+        int32_t sum = biases[o];
+        for (int i = 0; i < in_count; i++) {
+            sum += weights[o * in_count + i] * in[i];
+        }
+        out[o] = clip_scalar(sum >> NNUE_WEIGHT_SHIFT);
+    }
+}
+
+SCALAR_KERNEL static int evaluate_scalar(const int16_t *us, const int16_t *them)
+{
+    int8_t input[2 * NNUE_HIDDEN], l1[NNUE_L1], l2[NNUE_L2];
+    for (int i = 0; i < NNUE_HIDDEN; i++) {
+        input[i] = clip_scalar(us[i]);
+        input[NNUE_HIDDEN + i] = clip_scalar(them[i]);
+    }
+    dense_scalar(l1, NNUE_L1, input, 2 * NNUE_HIDDEN, &nnue_net.l1_weights[0][0], nnue_net.l1_biases);
+    dense_scalar(l2, NNUE_L2, l1, NNUE_L1, &nnue_net.l2_weights[0][0], nnue_net.l2_biases);
+    int32_t sum = nnue_net.out_bias;
+    for (int i = 0; i < NNUE_L2; i++) {
+        sum += nnue_net.out_weights[i] * l2[i];
+    }
+    return output_cp(sum);
+}
+
+static inline int32_t clip_vector(int32_t value)
+{
+    value = value < 0 ? 0 : value;
+    return value > NNUE_CLAMP ? NNUE_CLAMP : value;
+}
+
+static void update_vector(int16_t *out, const int16_t *in, const int16_t *const add[2], const int16_t *const sub[2])
+{
+    const int16_t *restrict add0 = add[0], *restrict add1 = add[1];
+    const int16_t *restrict sub0 = sub[0], *restrict sub1 = sub[1];
+    for (int i = 0; i < NNUE_HIDDEN; i++) {
+        out[i] = (int16_t)(in[i] + add0[i] + add1[i] - sub0[i] - sub1[i]);
+    }
+}
+
+// Sizes are constants once inlined, so each layer is a fixed length int8 dot product
+static inline void dense_vector(int8_t *restrict out, int out_count, const int8_t *restrict in, int in_count,
+                                const int8_t *restrict weights, const int32_t *restrict biases)
+{
+    for (int o = 0; o < out_count; o++) {
+        int32_t sum = 0;
+        for (int i = 0; i < in_count; i++) {
+            sum += weights[o * in_count + i] * in[i];
+        }
+        out[o] = (int8_t)clip_vector((sum + biases[o]) >> NNUE_WEIGHT_SHIFT);
+    }
+}
+
+static int evaluate_vector(const int16_t *restrict us, const int16_t *restrict them)
+{
+    int8_t input[2 * NNUE_HIDDEN] __attribute__((aligned(16)));
+    int8_t l1[NNUE_L1] __attribute__((aligned(16)));
+    int8_t l2[NNUE_L2] __attribute__((aligned(16)));
+    for (int i = 0; i < NNUE_HIDDEN; i++) {
+        input[i] = (int8_t)clip_vector(us[i]);
+        input[NNUE_HIDDEN + i] = (int8_t)clip_vector(them[i]);
+    }
+    dense_vector(l1, NNUE_L1, input, 2 * NNUE_HIDDEN, &nnue_net.l1_weights[0][0], nnue_net.l1_biases);
+    dense_vector(l2, NNUE_L2, l1, NNUE_L1, &nnue_net.l2_weights[0][0], nnue_net.l2_biases);
+    int32_t sum = 0;
+    for (int i = 0; i < NNUE_L2; i++) {
+        sum += nnue_net.out_weights[i] * l2[i];
+    }
+    return output_cp(sum + nnue_net.out_bias);
+}
+
+static const Kernels_t scalar_kernels = {update_scalar, evaluate_scalar};
+static const Kernels_t vector_kernels = {update_vector, evaluate_vector};
+static const Kernels_t *kernels = &vector_kernels;
+
+void nnue_set_kernels(Nnue_kernels_t variant)
+{
+    kernels = variant == NNUE_KERNELS_SCALAR ? &scalar_kernels : &vector_kernels;
+}
+
+void nnue_refresh(Nnue_accumulator_t *acc, const Chess_position_t *pos)
+{
+    for (int perspective = SIDE_WHITE; perspective <= SIDE_BLACK; perspective++) {
+        int16_t *values = acc->values[perspective];
+        memcpy(values, nnue_net.ft_biases, sizeof(nnue_net.ft_biases));
+        // Two pieces per kernel call
+        const int16_t *add[2] = {zero_row, zero_row};
+        const int16_t *const sub[2] = {zero_row, zero_row};
+        int pending = 0;
+        for (int side = SIDE_WHITE; side <= SIDE_BLACK; side++) {
+            for (int type = PIECE_PAWN; type < PIECE_TYPE_NB; type++) {
+                Bitboard_t pieces = position_bb(pos, (Side_t)side, (Piece_type_t)type);
+                while (pieces) {
+                    add[pending++] = feature_row((Side_t)perspective, (Side_t)side, (Piece_type_t)type,
+                                                 bb_pop_lsb(&pieces));
+                    if (pending == 2) {
+                        kernels->update(values, values, add, sub);
+                        add[0] = add[1] = zero_row;
+                        pending = 0;
+                    }
+                }
+            }
+        }
+        if (pending) {
+            kernels->update(values, values, add, sub);
+        }
+    }
+}
+
+// The same piece changes as make_move()
+void nnue_update(Nnue_accumulator_t *child, const Nnue_accumulator_t *parent, const Chess_position_t *pos,
+                 Chess_move_t move)
+{
+    Side_t us = pos->side_to_move;
+    Side_t them = !us;
+    int from = MOVE_FROM(move);
+    int to = MOVE_TO(move);
+    int flags = MOVE_FLAGS(move);
+    Piece_type_t type = position_piece_at(pos, from);
+    Piece_type_t placed = (flags & MOVE_FLAG_PROMOTION) ? MOVE_PROMOTION_PIECE(move) : type;
+
+    for (int perspective = SIDE_WHITE; perspective <= SIDE_BLACK; perspective++) {
+        Side_t p = (Side_t)perspective;
+        const int16_t *add[2] = {feature_row(p, us, placed, to), zero_row};
+        const int16_t *sub[2] = {feature_row(p, us, type, from), zero_row};
+        if (flags == MOVE_FLAG_EN_PASSANT) {
+            sub[1] = feature_row(p, them, PIECE_PAWN, us == SIDE_WHITE ? to - 8 : to + 8);
+        } else if (flags & MOVE_FLAG_CAPTURE) {
+            sub[1] = feature_row(p, them, position_piece_at(pos, to), to);
+        } else if (flags == MOVE_FLAG_KING_CASTLE) {
+            add[1] = feature_row(p, us, PIECE_ROOK, to - 1);
+            sub[1] = feature_row(p, us, PIECE_ROOK, to + 1);
+        } else if (flags == MOVE_FLAG_QUEEN_CASTLE) {
+            add[1] = feature_row(p, us, PIECE_ROOK, to + 1);
+            sub[1] = feature_row(p, us, PIECE_ROOK, to - 2);
+        }
+        kernels->update(child->values[p], parent->values[p], add, sub);
+    }
+}
+
+int nnue_evaluate(const Nnue_accumulator_t *acc, Side_t side_to_move)
+{
+    return kernels->evaluate(acc->values[side_to_move], acc->values[!side_to_move]);
+}
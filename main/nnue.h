@@ -0,0 +1,90 @@
+#ifndef NNUE_H
+#define NNUE_H
+
+#include <stdint.h>
+#include "position.h"
+#include "moves.h"
+
+#define NNUE_FEATURES (2 * PIECE_TYPE_NB * SQUARE_NB)  // Own or enemy piece type on a square, per perspective
+#define NNUE_HIDDEN 32                                 // Accumulator width of one perspective
+#define NNUE_L1 16
+#define NNUE_L2 16
+#define NNUE_CLAMP 127                                 // Activations are clipped to 0..NNUE_CLAMP
+#define NNUE_WEIGHT_SHIFT 6                            // Dense weights are in 1/64
+#define NNUE_CP_PER_UNIT 4                             // Centipawns per output unit
+
+/**
+ * @brief Quantized network weights
+ *
+ * The feature transformer maps every piece of the board, seen from one side
+ * with the board flipped for black, to NNUE_HIDDEN int16 sums. Both
+ * perspectives, the side to move first, are clipped to int8 and go through
+ * two int8 dense layers with int32 sums, then a linear output.
+ */
+typedef struct {
+    int16_t ft_weights[NNUE_FEATURES][NNUE_HIDDEN];
+    int16_t ft_biases[NNUE_HIDDEN];
+    int8_t l1_weights[NNUE_L1][2 * NNUE_HIDDEN];
+    int32_t l1_biases[NNUE_L1];
+    int8_t l2_weights[NNUE_L2][NNUE_L1];
+    int32_t l2_biases[NNUE_L2];
+    int8_t out_weights[NNUE_L2];
+    int32_t out_bias;
+} Nnue_net_t;
+
+// Weights in flash, see nnue_weights.c
+extern const Nnue_net_t nnue_net;
+
+/**
+ * @brief Feature transformer sums of a position, per perspective
+ *
+ */
+typedef struct {
+    int16_t values[2][NNUE_HIDDEN] __attribute__((aligned(16)));  // Indexed by Side_t
+} Nnue_accumulator_t;
+
+/**
+ * @brief Kernel variants, they give the same results
+ *
+ */
+typedef enum {
+    NNUE_KERNELS_SCALAR,   // Reference loops, one element at a time
+    NNUE_KERNELS_VECTOR,   // Fixed sizes, restrict and branch free clamps for the compiler to vectorize
+} Nnue_kernels_t;
+
+/**
+ * @brief Select the kernels, the vector ones until then
+ *
+ * @param kernels The variant
+ */
+void nnue_set_kernels(Nnue_kernels_t kernels);
+
+/**
+ * @brief Compute the accumulator of a position from scratch
+ *
+ * @param acc The accumulator
+ * @param pos The position
+ */
+void nnue_refresh(Nnue_accumulator_t *acc, const Chess_position_t *pos);
+
+/**
+ * @brief Update an accumulator for a move, adding and removing only the features it changes
+ *
+ * @param child The accumulator after the move, may be the parent
+ * @param parent The accumulator of pos
+ * @param pos The position before the move
+ * @param move A legal move of pos
+ */
+void nnue_update(Nnue_accumulator_t *child, const Nnue_accumulator_t *parent, const Chess_position_t *pos,
+                 Chess_move_t move);
+
+/**
+ * @brief Run the dense layers
+ *
+ * @param acc The accumulator of the position
+ * @param side_to_move Side to move of the position
+ * @return int Score in centipawns for the side to move
+ */
+int nnue_evaluate(const Nnue_accumulator_t *acc, Side_t side_to_move);
+
+#endif
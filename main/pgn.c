@@ -0,0 +1,378 @@
+#include <ctype.h>
+#include <string.h>
+#include "pgn.h"
+
+// Export format lines are at most 79 characters
+#define PGN_LINE_MAX 79
+
+typedef struct {
+    FILE *out;
+    int column;
+} Pgn_writer_t;
+
+// Write one movetext token, wrapping the line before it if needed
+static void write_token(Pgn_writer_t *writer, const char *token)
+{
+    int length = (int)strlen(token);
+    if (writer->column > 0 && writer->column + 1 + length > PGN_LINE_MAX) {
+        fputc('\n', writer->out);
+        writer->column = 0;
+    }
+    if (writer->column > 0) {
+        fputc(' ', writer->out);
+        writer->column++;
+    }
+    fputs(token, writer->out);
+    writer->column += length;
+}
+
+static void replay(const Game_record_t *record, Chess_position_t *pos)
+{
+    Game_record_iter_t iter;
+    Chess_move_t move;
+    *pos = record->start;
+    game_record_iter_init(record, &iter);
+    while (game_record_next(record, &iter, &move)) {
+        make_move(pos, move);
+    }
+}
+
+const char *pgn_result(const Game_record_t *record)
+{
+    Chess_position_t pos;
+    Move_list_t list;
+    replay(record, &pos);
+    if (generate_legal_moves(&pos, &list)) {
+        bool draw = pos.halfmove_clock >= 100 || game_record_repetitions(record, &pos) >= 2;
+        return draw ? "1/2-1/2" : "*";
+    }
+    if (!is_in_check(&pos)) {
+        return "1/2-1/2";
+    }
+    return pos.side_to_move == SIDE_WHITE ? "0-1" : "1-0";
+}
+
+void pgn_write(FILE *out, const Game_record_t *record, const char *result)
+{
+    if (!result) {
+        result = pgn_result(record);
+    }
+
+    fprintf(out, "[Event \"Casual game\"]\n");
+    fprintf(out, "[Site \"Chessy\"]\n");
+    fprintf(out, "[Date \"????.??.??\"]\n");
+    fprintf(out, "[Round \"-\"]\n");
+    fprintf(out, "[White \"?\"]\n");
+    fprintf(out, "[Black \"?\"]\n");
+    fprintf(out, "[Result \"%s\"]\n", result);
+
+    Chess_position_t pos;
+    char start_fen[POSITION_FEN_MAX], fen[POSITION_FEN_MAX];
+    position_set_start(&pos);
+    if (strcmp(position_to_fen(&pos, start_fen), position_to_fen(&record->start, fen)) != 0) {
+        fprintf(out, "[SetUp \"1\"]\n");
+        fprintf(out, "[FEN \"%s\"]\n", fen);
+    }
+    fputc('\n', out);
+
+    Pgn_writer_t writer = {out, 0};
+    Game_record_iter_t iter;
+    Chess_move_t move;
+    pos = record->start;
+    game_record_iter_init(record, &iter);
+    while (game_record_next(record, &iter, &move)) {
+        char token[16];
+        // Black's first move gets a number too when the game starts with it
+        if (pos.side_to_move == SIDE_WHITE) {
+            snprintf(token, sizeof(token), "%u.", (unsigned int)pos.fullmove_number);
+            write_token(&writer, token);
+        } else if (iter.index == 1) {
+            snprintf(token, sizeof(token), "%u...", (unsigned int)pos.fullmove_number);
+            write_token(&writer, token);
+        }
+        write_token(&writer, move_to_san(&pos, move, token));
+        make_move(&pos, move);
+    }
+    write_token(&writer, result);
+    fputs("\n\n", out);
+}
+
+// Import format reader, over text that need not be NUL terminated
+
+#define PGN_TAG_VALUE_MAX 96
+
+typedef struct {
+    const char *text;
+    size_t length;
+    size_t at;
+} Pgn_reader_t;
+
+static const char *const status_names[PGN_STATUS_NB] = {
+    "ok", "bad tag", "bad FEN", "bad token", "illegal move", "wrong move number", "no result",
+    "text after the result", "result differs from the tag", "result contradicts the final position",
+};
+
+const char *pgn_status_name(Pgn_status_t status)
+{
+    return status < PGN_STATUS_NB ? status_names[status] : "?";
+}
+
+static bool is_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static void skip_spaces(Pgn_reader_t *reader)
+{
+    while (reader->at < reader->length && is_space(reader->text[reader->at])) {
+        reader->at++;
+    }
+}
+
+// Skip to a closing char, true if found
+static bool skip_past(Pgn_reader_t *reader, char end)
+{
+    const char *found = memchr(reader->text + reader->at, end, reader->length - reader->at);
+    if (!found) {
+        return false;
+    }
+    reader->at = found - reader->text + 1;
+    return true;
+}
+
+// A tag line at the start of the text or after an empty line
+static bool is_game_start(const char *text, size_t at)
+{
+    if (at == 0) {
+        return true;
+    }
+    if (text[--at] != '\n') {
+        return false;
+    }
+    if (at > 0 && text[at - 1] == '\r') {
+        at--;
+    }
+    return at == 0 || text[at - 1] == '\n';
+}
+
+size_t pgn_next_game(const char *text, size_t length, size_t from)
+{
+    while (from < length) {
+        const char *found = memchr(text + from, '[', length - from);
+        if (!found) {
+            break;
+        }
+        size_t at = found - text;
+        if (is_game_start(text, at)) {
+            return at;
+        }
+        from = at + 1;
+    }
+    return length;
+}
+
+// [Name "value"], keeping the value of the tags that matter
+static bool read_tag(Pgn_reader_t *reader, char *fen, char *result)
+{
+    const char *text = reader->text;
+    size_t at = reader->at + 1;
+    size_t name = at;
+    while (at < reader->length && (isalnum((unsigned char)text[at]) || text[at] == '_')) {
+        at++;
+    }
+    size_t name_length = at - name;
+    while (at < reader->length && text[at] == ' ') {
+        at++;
+    }
+    if (name_length == 0 || at >= reader->length || text[at] != '"') {
+        return false;
+    }
+    char *value = NULL;
+    size_t value_max = 0;
+    if (name_length == 3 && memcmp(text + name, "FEN", 3) == 0) {
+        value = fen;
+        value_max = POSITION_FEN_MAX;
+    } else if (name_length == 6 && memcmp(text + name, "Result", 6) == 0) {
+        value = result;
+        value_max = sizeof(((Pgn_game_t *)0)->result);
+    }
+    size_t value_length = 0;
+    for (at++; at < reader->length && text[at] != '"' && text[at] != '\n'; at++) {
+        if (text[at] == '\\' && at + 1 < reader->length) {
+            at++;
+        }
+        if (value && value_length + 1 < value_max) {
+            value[value_length++] = text[at];
+        }
+    }
+    if (value) {
+        value[value_length] = '\0';
+    }
+    if (at >= reader->length || text[at] != '"') {
+        return false;
+    }
+    for (at++; at < reader->length && text[at] == ' '; at++) {
+    }
+    if (at >= reader->length || text[at] != ']') {
+        return false;
+    }
+    reader->at = at + 1;
+    return true;
+}
+
+// Variations are skipped without checking their moves, comments in them may hold parentheses
+static bool skip_variation(Pgn_reader_t *reader)
+{
+    int depth = 0;
+    for (; reader->at < reader->length; reader->at++) {
+        char c = reader->text[reader->at];
+        if (c == '{') {
+            if (!skip_past(reader, '}')) {
+                return false;
+            }
+            reader->at--;
+        } else if (c == '(') {
+            depth++;
+        } else if (c == ')' && --depth == 0) {
+            reader->at++;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool is_result(const char *token, size_t length)
+{
+    return (length == 3 && (memcmp(token, "1-0", 3) == 0 || memcmp(token, "0-1", 3) == 0)) ||
+           (length == 7 && memcmp(token, "1/2-1/2", 7) == 0) || (length == 1 && token[0] == '*');
+}
+
+// A final checkmate or stalemate decides the game whatever the result says
+static bool result_agrees(const Chess_position_t *pos, const char *result)
+{
+    Move_list_t list;
+    if (strcmp(result, "*") == 0 || generate_legal_moves(pos, &list) > 0) {
+        return true;
+    }
+    if (!is_in_check(pos)) {
+        return strcmp(result, "1/2-1/2") == 0;
+    }
+    return strcmp(result, pos->side_to_move == SIDE_WHITE ? "0-1" : "1-0") == 0;
+}
+
+static void fail(Pgn_game_t *game, Pgn_status_t status, size_t offset)
+{
+    game->status = status;
+    game->error_offset = offset;
+}
+
+void pgn_read_game(const char *text, size_t length, Pgn_game_t *game)
+{
+    Pgn_reader_t reader = {text, length, 0};
+    char fen[POSITION_FEN_MAX] = "", tag_result[sizeof(game->result)] = "";
+    memset(game, 0, sizeof(*game));
+
+    for (skip_spaces(&reader); reader.at < length && text[reader.at] == '['; skip_spaces(&reader)) {
+        size_t start = reader.at;
+        if (!read_tag(&reader, fen, tag_result)) {
+            fail(game, PGN_BAD_TAG, start);
+            return;
+        }
+    }
+    if (fen[0]) {
+        if (!position_from_fen(&game->pos, fen)) {
+            fail(game, PGN_BAD_FEN, 0);
+            return;
+        }
+    } else {
+        position_set_start(&game->pos);
+    }
+
+    size_t result_offset = 0;
+    for (skip_spaces(&reader); reader.at < length; skip_spaces(&reader)) {
+        size_t start = reader.at;
+        char c = text[start];
+        bool line_start = start == 0 || text[start - 1] == '\n';
+        if (c == '{' || c == ';' || (c == '%' && line_start)) {
+            if (!skip_past(&reader, c == '{' ? '}' : '\n')) {
+                reader.at = length;
+                if (c == '{') {
+                    fail(game, PGN_BAD_TOKEN, start);
+                    return;
+                }
+            }
+            continue;
+        }
+        if (c == '(') {
+            if (!skip_variation(&reader)) {
+                fail(game, PGN_BAD_TOKEN, start);
+                return;
+            }
+            continue;
+        }
+        if (c == '$') {
+            for (reader.at++; reader.at < length && isdigit((unsigned char)text[reader.at]); reader.at++) {
+            }
+            continue;
+        }
+
+        size_t end = start;
+        while (end < length && !is_space(text[end]) && !strchr("{}();$", text[end])) {
+            end++;
+        }
+        if (end == start) {
+            fail(game, PGN_BAD_TOKEN, start);
+            return;
+        }
+        if (game->result[0]) {
+            fail(game, PGN_TEXT_AFTER_RESULT, start);
+            return;
+        }
+        if (is_result(text + start, end - start)) {
+            memcpy(game->result, text + start, end - start);
+            game->result[end - start] = '\0';
+            result_offset = start;
+            reader.at = end;
+            continue;
+        }
+
+        // A move number, maybe glued to the move after it
+        if (isdigit((unsigned char)c) && !(end - start >= 3 && memcmp(text + start, "0-0", 3) == 0)) {
+            unsigned int number = 0;
+            size_t at = start;
+            for (; at < end && isdigit((unsigned char)text[at]); at++) {
+                number = number * 10 + (text[at] - '0');
+            }
+            if (at == end || text[at] != '.') {
+                fail(game, PGN_BAD_TOKEN, start);
+                return;
+            }
+            while (at < end && text[at] == '.') {
+                at++;
+            }
+            if (number != game->pos.fullmove_number) {
+                fail(game, PGN_BAD_MOVE_NUMBER, start);
+                return;
+            }
+            reader.at = at;
+            continue;
+        }
+
+        Chess_move_t move = move_from_san(&game->pos, text + start, (int)(end - start));
+        if (move == MOVE_NONE) {
+            fail(game, PGN_ILLEGAL_MOVE, start);
+            return;
+        }
+        make_move(&game->pos, move);
+        game->plies++;
+        reader.at = end;
+    }
+
+    if (!game->result[0]) {
+        fail(game, PGN_NO_RESULT, length);
+    } else if (tag_result[0] && strcmp(tag_result, game->result) != 0) {
+        fail(game, PGN_RESULT_MISMATCH, result_offset);
+    } else if (!result_agrees(&game->pos, game->result)) {
+        fail(game, PGN_WRONG_RESULT, result_offset);
+    }
+}
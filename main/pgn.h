@@ -0,0 +1,94 @@
+#ifndef PGN_H
+#define PGN_H
+
+#include <stddef.h>
+#include <stdio.h>
+#include "game_record.h"
+
+/**
+ * @brief Outcome of reading a game
+ *
+ */
+typedef enum {
+    PGN_OK = 0,
+    PGN_BAD_TAG,           // Malformed tag pair
+    PGN_BAD_FEN,           // FEN tag that does not parse
+    PGN_BAD_TOKEN,         // Movetext that is neither a move, a move number, a comment nor a result
+    PGN_ILLEGAL_MOVE,      // Move that is illegal, ambiguous or malformed SAN
+    PGN_BAD_MOVE_NUMBER,   // Move number that does not match the position, as when moves went missing
+    PGN_NO_RESULT,         // Movetext without a result at its end
+    PGN_TEXT_AFTER_RESULT,
+    PGN_RESULT_MISMATCH,   // Result at the end of the movetext differs from the Result tag
+    PGN_WRONG_RESULT,      // Result contradicting a final checkmate or stalemate
+    PGN_STATUS_NB,
+} Pgn_status_t;
+
+/**
+ * @brief A game read back and replayed
+ *
+ */
+typedef struct {
+    Pgn_status_t status;
+    size_t error_offset;          // Of the token in error, from the start of the game
+    int plies;                    // Moves replayed, up to the error
+    Chess_position_t pos;         // Position reached
+    char result[8];               // Result at the end of the movetext, "" if none
+} Pgn_game_t;
+
+/**
+ * @brief Get the PGN result of the final position of a record
+ *
+ * @param record The record
+ * @return const char* "1-0", "0-1", "1/2-1/2" for stalemate, threefold repetition or
+ *         the 50-move rule, "*" if the game goes on
+ */
+const char *pgn_result(const Game_record_t *record);
+
+/**
+ * @brief Write a record as a PGN game
+ *
+ * The moves are replayed and written one at a time in SAN, so nothing but
+ * the current position is held in memory whatever the length of the game.
+ * Games that do not start from the initial position get SetUp and FEN tags.
+ *
+ * @param out The stream to write to
+ * @param record The record
+ * @param result The result tag, NULL to take it from the final position
+ */
+void pgn_write(FILE *out, const Game_record_t *record, const char *result);
+
+/**
+ * @brief Find where the next game starts
+ *
+ * A game starts with a tag line, a line beginning with '[', at the start of
+ * the text or after an empty line.
+ *
+ * @param text The text
+ * @param length Its length
+ * @param from Offset to search from
+ * @return size_t Offset of the game start, length if there is none
+ */
+size_t pgn_next_game(const char *text, size_t length, size_t from);
+
+/**
+ * @brief Read and replay one game
+ *
+ * Comments, variations and NAGs are skipped, every move is checked against
+ * the legal moves of the position, and reading stops at the first error.
+ * Nothing is allocated, so the text can be a memory mapped file.
+ *
+ * @param text The game, from its first tag to the start of the next one
+ * @param length Its length
+ * @param game Filled with the result
+ */
+void pgn_read_game(const char *text, size_t length, Pgn_game_t *game);
+
+/**
+ * @brief Describe a status
+ *
+ * @param status The status
+ * @return const char* A short lowercase description
+ */
+const char *pgn_status_name(Pgn_status_t status);
+
+#endif
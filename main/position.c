@@ -0,0 +1,356 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "position.h"
+
+static const char piece_chars[2][PIECE_TYPE_NB] = {
+    {'P', 'N', 'B', 'R', 'Q', 'K'},
+    {'p', 'n', 'b', 'r', 'q', 'k'},
+};
+
+void position_set_start(Chess_position_t *pos)
+{
+    bitboard_init();
+    zobrist_init();
+    memset(pos, 0, sizeof(*pos));
+
+    pos->pieces[PIECE_PAWN] = 0x00FF00000000FF00ULL;
+    pos->pieces[PIECE_KNIGHT] = 0x4200000000000042ULL;
+    pos->pieces[PIECE_BISHOP] = 0x2400000000000024ULL;
+    pos->pieces[PIECE_ROOK] = 0x8100000000000081ULL;
+    pos->pieces[PIECE_QUEEN] = 0x0800000000000008ULL;
+    pos->pieces[PIECE_KING] = 0x1000000000000010ULL;
+    pos->colors[SIDE_WHITE] = 0x000000000000FFFFULL;
+    pos->colors[SIDE_BLACK] = 0xFFFF000000000000ULL;
+    pos->side_to_move = SIDE_WHITE;
+    pos->castling = CASTLE_ALL;
+    pos->ep_square = SQUARE_NONE;
+    pos->halfmove_clock = 0;
+    pos->fullmove_number = 1;
+    pos->key = position_compute_key(pos);
+}
+
+// Whether a piece of side by attacks sq, for checking a FEN before the move generator can be used on it
+static bool square_attacked(const Chess_position_t *pos, int sq, Side_t by)
+{
+    Bitboard_t occ = position_occupied(pos);
+    Bitboard_t rooks = position_bb(pos, by, PIECE_ROOK) | position_bb(pos, by, PIECE_QUEEN);
+    Bitboard_t bishops = position_bb(pos, by, PIECE_BISHOP) | position_bb(pos, by, PIECE_QUEEN);
+    return (pawn_attack_table[!by][sq] & position_bb(pos, by, PIECE_PAWN)) ||
+           (knight_attack_table[sq] & position_bb(pos, by, PIECE_KNIGHT)) ||
+           (king_attack_table[sq] & position_bb(pos, by, PIECE_KING)) ||
+           (bb_rook_attacks(sq, occ) & rooks) || (bb_bishop_attacks(sq, occ) & bishops);
+}
+
+// Each castling right needs its king and rook still on their home squares
+static bool castling_valid(const Chess_position_t *pos)
+{
+    static const struct {
+        uint8_t right;
+        Side_t side;
+        uint8_t king;
+        uint8_t rook;
+    } homes[] = {
+        {CASTLE_WHITE_KING, SIDE_WHITE, SQUARE(0, 4), SQUARE(0, 7)},
+        {CASTLE_WHITE_QUEEN, SIDE_WHITE, SQUARE(0, 4), SQUARE(0, 0)},
+        {CASTLE_BLACK_KING, SIDE_BLACK, SQUARE(7, 4), SQUARE(7, 7)},
+        {CASTLE_BLACK_QUEEN, SIDE_BLACK, SQUARE(7, 4), SQUARE(7, 0)},
+    };
+    for (size_t i = 0; i < sizeof(homes) / sizeof(homes[0]); i++) {
+        if ((pos->castling & homes[i].right) &&
+                (!(position_bb(pos, homes[i].side, PIECE_KING) & BB_SQUARE(homes[i].king)) ||
+                 !(position_bb(pos, homes[i].side, PIECE_ROOK) & BB_SQUARE(homes[i].rook)))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// The en passant square is behind a pawn that just moved two squares, on the rank the side to move captures to
+static bool ep_square_valid(const Chess_position_t *pos, int sq)
+{
+    Side_t them = !pos->side_to_move;
+    int rank = pos->side_to_move == SIDE_WHITE ? 5 : 2;
+    int ahead = them == SIDE_BLACK ? -8 : 8;   // From the square towards the pawn
+    Bitboard_t occ = position_occupied(pos);
+    return SQUARE_RANK(sq) == rank && !(occ & BB_SQUARE(sq)) &&
+           (position_bb(pos, them, PIECE_PAWN) & BB_SQUARE(sq + ahead));
+}
+
+bool position_from_fen(Chess_position_t *pos, const char *fen)
+{
+    bitboard_init();
+    zobrist_init();
+    memset(pos, 0, sizeof(*pos));
+    pos->ep_square = SQUARE_NONE;
+    pos->fullmove_number = 1;
+
+    // Piece placement, from rank 8 down to rank 1
+    int rank = 7;
+    int file = 0;
+    for (; *fen && *fen != ' '; fen++) {
+        if (*fen == '/') {
+            // Every rank adds up to exactly eight files
+            if (file != 8 || rank == 0) {
+                return false;
+            }
+            rank--;
+            file = 0;
+        } else if (*fen >= '1' && *fen <= '8') {
+            file += *fen - '0';
+            if (file > 8) {
+                return false;
+            }
+        } else {
+            Side_t side = SIDE_WHITE;
+            const char *found = memchr(piece_chars[SIDE_WHITE], *fen, PIECE_TYPE_NB);
+            if (!found) {
+                side = SIDE_BLACK;
+                found = memchr(piece_chars[SIDE_BLACK], *fen, PIECE_TYPE_NB);
+            }
+            if (!found || rank < 0 || file >= 8) {
+                return false;
+            }
+            position_put_piece(pos, SQUARE(rank, file), side, (Piece_type_t)(found - piece_chars[side]));
+            file++;
+        }
+    }
+    if (rank != 0 || file != 8 || bb_popcount(position_bb(pos, SIDE_WHITE, PIECE_KING)) != 1 ||
+            bb_popcount(position_bb(pos, SIDE_BLACK, PIECE_KING)) != 1) {
+        return false;
+    }
+
+    // Side to move
+    while (*fen == ' ') {
+        fen++;
+    }
+    if (*fen != 'w' && *fen != 'b') {
+        return false;
+    }
+    pos->side_to_move = (*fen++ == 'w') ? SIDE_WHITE : SIDE_BLACK;
+
+    // Castling rights
+    while (*fen == ' ') {
+        fen++;
+    }
+    for (; *fen && *fen != ' '; fen++) {
+        switch (*fen) {
+        case 'K':
+            pos->castling |= CASTLE_WHITE_KING;
+            break;
+        case 'Q':
+            pos->castling |= CASTLE_WHITE_QUEEN;
+            break;
+        case 'k':
+            pos->castling |= CASTLE_BLACK_KING;
+            break;
+        case 'q':
+            pos->castling |= CASTLE_BLACK_QUEEN;
+            break;
+        case '-':
+            break;
+        default:
+            return false;
+        }
+    }
+
+    if (!castling_valid(pos)) {
+        return false;
+    }
+
+    // En passant square
+    while (*fen == ' ') {
+        fen++;
+    }
+    if (fen[0] >= 'a' && fen[0] <= 'h' && fen[1] >= '1' && fen[1] <= '8') {
+        pos->ep_square = (uint8_t)SQUARE(fen[1] - '1', fen[0] - 'a');
+        if (!ep_square_valid(pos, pos->ep_square)) {
+            return false;
+        }
+        fen += 2;
+    } else if (*fen == '-') {
+        fen++;
+    }
+
+    // Optional move clocks
+    char *end;
+    long halfmove = strtol(fen, &end, 10);
+    if (end != fen) {
+        pos->halfmove_clock = (uint8_t)(halfmove > 255 ? 255 : halfmove);
+        fen = end;
+        long fullmove = strtol(fen, &end, 10);
+        if (end != fen && fullmove > 0) {
+            pos->fullmove_number = (uint16_t)fullmove;
+        }
+    }
+
+    // The side that just moved cannot have left its king in check
+    Side_t them = !pos->side_to_move;
+    if (square_attacked(pos, bb_lsb(position_bb(pos, them, PIECE_KING)), pos->side_to_move)) {
+        return false;
+    }
+    pos->key = position_compute_key(pos);
+    return true;
+}
+
+char *position_to_fen(const Chess_position_t *pos, char *buf)
+{
+    char *p = buf;
+    for (int rank = 7; rank >= 0; rank--) {
+        int empty = 0;
+        for (int file = 0; file < 8; file++) {
+            char c = position_char_at(pos, SQUARE(rank, file));
+            if (c == ' ') {
+                empty++;
+                continue;
+            }
+            if (empty) {
+                *p++ = '0' + empty;
+                empty = 0;
+            }
+            *p++ = c;
+        }
+        if (empty) {
+            *p++ = '0' + empty;
+        }
+        *p++ = rank ? '/' : ' ';
+    }
+
+    *p++ = pos->side_to_move == SIDE_WHITE ? 'w' : 'b';
+    *p++ = ' ';
+    static const char castle_chars[] = "KQkq";
+    char *castling = p;
+    for (int i = 0; i < 4; i++) {
+        if (pos->castling & (1 << i)) {
+            *p++ = castle_chars[i];
+        }
+    }
+    if (p == castling) {
+        *p++ = '-';
+    }
+    *p++ = ' ';
+    if (pos->ep_square != SQUARE_NONE) {
+        *p++ = 'a' + SQUARE_FILE(pos->ep_square);
+        *p++ = '1' + SQUARE_RANK(pos->ep_square);
+    } else {
+        *p++ = '-';
+    }
+    sprintf(p, " %u %u", (unsigned int)pos->halfmove_clock, (unsigned int)pos->fullmove_number);
+    return buf;
+}
+
+Piece_type_t position_piece_at(const Chess_position_t *pos, int sq)
+{
+    Bitboard_t bit = BB_SQUARE(sq);
+    if (!(position_occupied(pos) & bit)) {
+        return PIECE_NONE;
+    }
+    for (int type = PIECE_PAWN; type < PIECE_TYPE_NB; type++) {
+        if (pos->pieces[type] & bit) {
+            return (Piece_type_t)type;
+        }
+    }
+    return PIECE_NONE;
+}
+
+char position_char_at(const Chess_position_t *pos, int sq)
+{
+    Piece_type_t type = position_piece_at(pos, sq);
+    if (type == PIECE_NONE) {
+        return ' ';
+    }
+    return piece_chars[position_side_at(pos, sq)][type];
+}
+
+uint64_t position_compute_key(const Chess_position_t *pos)
+{
+    uint64_t key = 0;
+    Bitboard_t occupied = position_occupied(pos);
+    while (occupied) {
+        int sq = bb_pop_lsb(&occupied);
+        key ^= zobrist_piece_table[position_side_at(pos, sq)][position_piece_at(pos, sq)][sq];
+    }
+    key ^= zobrist_castling_table[pos->castling];
+    key ^= position_ep_key(pos);
+    if (pos->side_to_move == SIDE_WHITE) {
+        key ^= zobrist_side_key;
+    }
+    return key;
+}
+
+// Only occupied squares take a nibble, so 32 pieces fit in 16 bytes
+void position_pack(const Chess_position_t *pos, uint8_t *out)
+{
+    memset(out, 0, POSITION_PACK_SIZE);
+    Bitboard_t occupied = position_occupied(pos);
+    for (int i = 0; i < 8; i++) {
+        out[i] = (uint8_t)(occupied >> (8 * i));
+    }
+    for (int n = 0; occupied; n++) {
+        int sq = bb_pop_lsb(&occupied);
+        uint8_t code = (uint8_t)(position_piece_at(pos, sq) | (position_side_at(pos, sq) == SIDE_BLACK ? 8 : 0));
+        out[8 + n / 2] |= (uint8_t)(code << (n % 2 * 4));
+    }
+    out[24] = (uint8_t)(pos->side_to_move | pos->castling << 1);
+    out[25] = pos->ep_square;
+    out[26] = pos->halfmove_clock;
+    out[27] = (uint8_t)pos->fullmove_number;
+    out[28] = (uint8_t)(pos->fullmove_number >> 8);
+}
+
+bool position_unpack(Chess_position_t *pos, const uint8_t *in)
+{
+    // Sets up the key tables, then the board is rebuilt from scratch
+    position_set_start(pos);
+    memset(pos->pieces, 0, sizeof(pos->pieces));
+    memset(pos->colors, 0, sizeof(pos->colors));
+    Bitboard_t occupied = 0;
+    for (int i = 0; i < 8; i++) {
+        occupied |= (Bitboard_t)in[i] << (8 * i);
+    }
+    if (bb_popcount(occupied) > 32) {
+        return false;
+    }
+    for (int n = 0; occupied; n++) {
+        int sq = bb_pop_lsb(&occupied);
+        int code = in[8 + n / 2] >> (n % 2 * 4) & 0x0F;
+        if ((code & 7) >= PIECE_TYPE_NB) {
+            return false;
+        }
+        position_put_piece(pos, sq, code & 8 ? SIDE_BLACK : SIDE_WHITE, (Piece_type_t)(code & 7));
+    }
+    pos->side_to_move = (in[24] & 1) ? SIDE_BLACK : SIDE_WHITE;
+    pos->castling = in[24] >> 1;
+    pos->ep_square = in[25];
+    pos->halfmove_clock = in[26];
+    pos->fullmove_number = (uint16_t)(in[27] | in[28] << 8);
+    if (pos->castling > CASTLE_ALL || (pos->ep_square != SQUARE_NONE && pos->ep_square >= SQUARE_NB) ||
+            bb_popcount(position_bb(pos, SIDE_WHITE, PIECE_KING)) != 1 ||
+            bb_popcount(position_bb(pos, SIDE_BLACK, PIECE_KING)) != 1) {
+        return false;
+    }
+    pos->key = position_compute_key(pos);
+    return true;
+}
+
+void position_put_piece(Chess_position_t *pos, int sq, Side_t side, Piece_type_t type)
+{
+    pos->key ^= zobrist_piece_table[side][type][sq];
+    pos->pieces[type] |= BB_SQUARE(sq);
+    pos->colors[side] |= BB_SQUARE(sq);
+}
+
+void position_remove_piece(Chess_position_t *pos, int sq)
+{
+    Piece_type_t type = position_piece_at(pos, sq);
+    if (type == PIECE_NONE) {
+        return;
+    }
+    pos->key ^= zobrist_piece_table[position_side_at(pos, sq)][type][sq];
+    Bitboard_t keep = ~BB_SQUARE(sq);
+    for (int type = PIECE_PAWN; type < PIECE_TYPE_NB; type++) {
+        pos->pieces[type] &= keep;
+    }
+    pos->colors[SIDE_WHITE] &= keep;
+    pos->colors[SIDE_BLACK] &= keep;
+}
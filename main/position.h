@@ -0,0 +1,183 @@
+#ifndef POSITION_H
+#define POSITION_H
+
+#include <stdbool.h>
+#include "bitboard.h"
+#include "zobrist.h"
+
+/**
+ * @brief Side to move, also used to index per-color tables
+ *
+ */
+typedef enum {
+    SIDE_WHITE = 0,
+    SIDE_BLACK = 1,
+} Side_t;
+
+/**
+ * @brief Piece type without color
+ *
+ */
+typedef enum {
+    PIECE_PAWN = 0,
+    PIECE_KNIGHT,
+    PIECE_BISHOP,
+    PIECE_ROOK,
+    PIECE_QUEEN,
+    PIECE_KING,
+    PIECE_TYPE_NB,
+    PIECE_NONE = PIECE_TYPE_NB,
+} Piece_type_t;
+
+/**
+ * @brief Castling rights bits
+ *
+ */
+#define CASTLE_WHITE_KING 0x01
+#define CASTLE_WHITE_QUEEN 0x02
+#define CASTLE_BLACK_KING 0x04
+#define CASTLE_BLACK_QUEEN 0x08
+#define CASTLE_ALL 0x0F
+
+/**
+ * @brief A chess position stored as bitboards
+ *
+ * Eight bitboards (64 bytes) hold every piece, so the whole position fits in
+ * two cache lines and move generation is a handful of mask operations.
+ * Positions with the same key are the same for the repetition rules.
+ */
+typedef struct {
+    Bitboard_t pieces[PIECE_TYPE_NB];  // Squares holding each piece type, both colors
+    Bitboard_t colors[2];              // Squares holding each side's pieces
+    uint64_t key;                      // Zobrist key, kept up to date by every change
+    Side_t side_to_move;
+    uint8_t castling;                  // CASTLE_* bits still available
+    uint8_t ep_square;                 // Square a pawn can capture en passant onto, or SQUARE_NONE
+    uint8_t halfmove_clock;            // Plies since the last capture or pawn move
+    uint16_t fullmove_number;          // Starts at 1, incremented after black moves
+} Chess_position_t;
+
+// Longest FEN with its terminating NUL
+#define POSITION_FEN_MAX 92
+#define POSITION_PACK_SIZE 29   // Occupancy, piece nibbles, state, en passant square and clocks
+
+/**
+ * @brief Set up the standard starting position
+ *
+ * @param pos The position to initialize
+ */
+void position_set_start(Chess_position_t *pos);
+
+/**
+ * @brief Set up a position from a FEN string
+ *
+ * Castling rights need their king and rook on their home squares, an en
+ * passant square the pawn that just moved two squares past it, and the
+ * side not to move must not be in check.
+ *
+ * @param pos The position to initialize
+ * @param fen The FEN string, the move clocks may be omitted
+ * @return true if the string was parsed, false if it is malformed or the position is not consistent
+ */
+bool position_from_fen(Chess_position_t *pos, const char *fen);
+
+/**
+ * @brief Format a position as a FEN string
+ *
+ * @param pos The position
+ * @param buf Buffer of at least POSITION_FEN_MAX chars
+ * @return char* The buffer
+ */
+char *position_to_fen(const Chess_position_t *pos, char *buf);
+
+/**
+ * @brief Get the piece type on a square
+ *
+ * @param pos The position
+ * @param sq The square index
+ * @return Piece_type_t The piece type, PIECE_NONE if the square is empty
+ */
+Piece_type_t position_piece_at(const Chess_position_t *pos, int sq);
+
+/**
+ * @brief Get the board character for a square, as used by the char board view
+ *
+ * @param pos The position
+ * @param sq The square index
+ * @return char 'PNBRQK' for white, 'pnbrqk' for black, ' ' if empty
+ */
+char position_char_at(const Chess_position_t *pos, int sq);
+
+/**
+ * @brief Compute the Zobrist key of a position from scratch
+ *
+ * @param pos The position
+ * @return uint64_t The key
+ */
+uint64_t position_compute_key(const Chess_position_t *pos);
+
+/**
+ * @brief Pack a position into POSITION_PACK_SIZE bytes, for records kept in flash
+ *
+ * The occupancy comes first, then a nibble per occupied piece, the side to
+ * move with the castling rights, the en passant square and the clocks.
+ *
+ * @param pos The position, at most 32 pieces
+ * @param out POSITION_PACK_SIZE bytes
+ */
+void position_pack(const Chess_position_t *pos, uint8_t *out);
+
+/**
+ * @brief Rebuild a position packed by position_pack()
+ *
+ * @param pos Set to the position
+ * @param in POSITION_PACK_SIZE bytes
+ * @return true if the bytes hold a position with one king per side
+ */
+bool position_unpack(Chess_position_t *pos, const uint8_t *in);
+
+/**
+ * @brief Put a piece on an empty square
+ *
+ * @param pos The position
+ * @param sq The square index
+ * @param side The color of the piece
+ * @param type The piece type
+ */
+void position_put_piece(Chess_position_t *pos, int sq, Side_t side, Piece_type_t type);
+
+/**
+ * @brief Remove whatever piece stands on a square
+ *
+ * @param pos The position
+ * @param sq The square index
+ */
+void position_remove_piece(Chess_position_t *pos, int sq);
+
+static inline Bitboard_t position_occupied(const Chess_position_t *pos)
+{
+    return pos->colors[SIDE_WHITE] | pos->colors[SIDE_BLACK];
+}
+
+static inline Side_t position_side_at(const Chess_position_t *pos, int sq)
+{
+    return (pos->colors[SIDE_WHITE] & BB_SQUARE(sq)) ? SIDE_WHITE : SIDE_BLACK;
+}
+
+// The en passant file is part of the key only if the side to move has a pawn to take with
+static inline uint64_t position_ep_key(const Chess_position_t *pos)
+{
+    if (pos->ep_square == SQUARE_NONE) {
+        return 0;
+    }
+    Side_t us = pos->side_to_move;
+    Bitboard_t takers = pawn_attack_table[!us][pos->ep_square] & pos->pieces[PIECE_PAWN] & pos->colors[us];
+    return takers ? zobrist_ep_file_table[SQUARE_FILE(pos->ep_square)] : 0;
+}
+
+static inline Bitboard_t position_bb(const Chess_position_t *pos, Side_t side, Piece_type_t type)
+{
+    return pos->pieces[type] & pos->colors[side];
+}
+
+#endif
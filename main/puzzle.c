@@ -0,0 +1,108 @@
+#include <string.h>
+#include "puzzle.h"
+#include "crc32.h"
+
+#define RECORD_MATE_IN POSITION_PACK_SIZE   // After the packed position
+#define RECORD_SOLUTION (RECORD_MATE_IN + 1)
+
+static void put_u32(uint8_t *bytes, uint32_t value)
+{
+    bytes[0] = (uint8_t)value;
+    bytes[1] = (uint8_t)(value >> 8);
+    bytes[2] = (uint8_t)(value >> 16);
+    bytes[3] = (uint8_t)(value >> 24);
+}
+
+static uint32_t get_u32(const uint8_t *bytes)
+{
+    return bytes[0] | (uint32_t)bytes[1] << 8 | (uint32_t)bytes[2] << 16 | (uint32_t)bytes[3] << 24;
+}
+
+bool puzzle_pack_open_memory(Puzzle_pack_t *pack, const void *data, size_t size)
+{
+    const uint8_t *bytes = data;
+    pack->records = NULL;
+    pack->count = 0;
+    if (size < PUZZLE_HEADER_SIZE || memcmp(bytes, PUZZLE_MAGIC, strlen(PUZZLE_MAGIC)) != 0) {
+        return false;
+    }
+    size_t count = get_u32(bytes + 8);
+    if (count > (size - PUZZLE_HEADER_SIZE) / PUZZLE_RECORD_SIZE ||
+            crc32_update(0, bytes + PUZZLE_HEADER_SIZE, count * PUZZLE_RECORD_SIZE) != get_u32(bytes + 12)) {
+        return false;
+    }
+    pack->records = bytes + PUZZLE_HEADER_SIZE;
+    pack->count = count;
+    return true;
+}
+
+void puzzle_encode(uint8_t *out, const Puzzle_t *puzzle)
+{
+    memset(out, 0, PUZZLE_RECORD_SIZE);
+    position_pack(&puzzle->pos, out);
+    out[RECORD_MATE_IN] = puzzle->mate_in;
+    out[RECORD_SOLUTION] = (uint8_t)puzzle->solution;
+    out[RECORD_SOLUTION + 1] = (uint8_t)(puzzle->solution >> 8);
+}
+
+void puzzle_pack_header(uint8_t *out, const uint8_t *records, size_t count)
+{
+    memcpy(out, PUZZLE_MAGIC, strlen(PUZZLE_MAGIC));
+    put_u32(out + 8, (uint32_t)count);
+    put_u32(out + 12, crc32_update(0, records, count * PUZZLE_RECORD_SIZE));
+}
+
+bool puzzle_pack_read(const Puzzle_pack_t *pack, size_t index, Puzzle_t *puzzle)
+{
+    const uint8_t *record = pack->records + index * PUZZLE_RECORD_SIZE;
+    Chess_position_t *pos = &puzzle->pos;
+    if (!position_unpack(pos, record)) {
+        return false;
+    }
+    puzzle->mate_in = record[RECORD_MATE_IN];
+    puzzle->solution = (Chess_move_t)(record[RECORD_SOLUTION] | record[RECORD_SOLUTION + 1] << 8);
+    if (puzzle->mate_in == 0 || puzzle->mate_in > MATE_MAX_MOVES) {
+        return false;
+    }
+    // The side that just moved cannot be left in check
+    Chess_position_t other = *pos;
+    other.side_to_move = !pos->side_to_move;
+    return !is_in_check(&other);
+}
+
+void puzzle_session_start(Puzzle_session_t *session, const Puzzle_t *puzzle, Mate_solver_t *solver)
+{
+    session->puzzle = *puzzle;
+    session->attacker = puzzle->pos.side_to_move;
+    session->moves_left = puzzle->mate_in;
+    session->solver = solver;
+    mate_solver_clear(solver);
+}
+
+Puzzle_verdict_t puzzle_session_judge(Puzzle_session_t *session, const Chess_position_t *before, Chess_move_t move,
+                                      Chess_move_t *reply)
+{
+    *reply = MOVE_NONE;
+    if (before->side_to_move != session->attacker) {
+        return PUZZLE_MOVE_REPLY;
+    }
+
+    Chess_position_t after = *before;
+    make_move(&after, move);
+    Mate_result_t result;
+    mate_defend(session->solver, &after, session->moves_left - 1, &result);
+    if (result.status == MATE_UNKNOWN) {
+        // Out of nodes, only the pack's own first move is known to be right
+        if (before->key != session->puzzle.pos.key || move != session->puzzle.solution) {
+            return PUZZLE_MOVE_WRONG;
+        }
+        session->moves_left--;
+        return PUZZLE_MOVE_CORRECT;
+    }
+    *reply = result.move;
+    if (result.status == MATE_NONE) {
+        return PUZZLE_MOVE_WRONG;
+    }
+    session->moves_left--;
+    return result.move == MOVE_NONE ? PUZZLE_MOVE_SOLVED : PUZZLE_MOVE_CORRECT;
+}
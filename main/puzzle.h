@@ -0,0 +1,133 @@
+#ifndef PUZZLE_H
+#define PUZZLE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "position.h"
+#include "moves.h"
+#include "mate.h"
+
+#define PUZZLE_PARTITION_LABEL "puzzles"
+#define PUZZLE_PARTITION_SUBTYPE 0x43
+#define PUZZLE_MAGIC "CHESSYPZ"
+#define PUZZLE_HEADER_SIZE 16    // Magic, record count and CRC-32 of the records, little endian
+#define PUZZLE_RECORD_SIZE 32
+
+/**
+ * @brief A mate-in-N puzzle
+ *
+ */
+typedef struct {
+    Chess_position_t pos;
+    uint8_t mate_in;          // Moves of the side to move to mate
+    Chess_move_t solution;    // First move of a mate, others may work too
+} Puzzle_t;
+
+/**
+ * @brief A puzzle pack mapped in memory
+ *
+ * Records are 32 bytes: the position packed by position_pack(), the mate
+ * length and the solution move. The records are read in place, from a flash partition on the board or a file
+ * on the host.
+ */
+typedef struct {
+    const uint8_t *records;
+    size_t count;
+} Puzzle_pack_t;
+
+/**
+ * @brief Verdict on a move played in a puzzle
+ *
+ */
+typedef enum {
+    PUZZLE_MOVE_REPLY,      // A move of the defending side, played on the board for the solver
+    PUZZLE_MOVE_CORRECT,    // The mate is still forced in time, reply is the defence to play
+    PUZZLE_MOVE_SOLVED,     // Checkmate
+    PUZZLE_MOVE_WRONG,      // The mate is gone, reply is a defence escaping it
+} Puzzle_verdict_t;
+
+/**
+ * @brief A puzzle being played on the board
+ *
+ */
+typedef struct {
+    Puzzle_t puzzle;
+    Side_t attacker;
+    int moves_left;           // Moves the attacker has left to mate
+    Mate_solver_t *solver;
+} Puzzle_session_t;
+
+/**
+ * @brief Use a memory region holding a puzzle pack image
+ *
+ * @param pack The pack, empty if the image is not valid
+ * @param data Start of the image
+ * @param size Size of the region, erased flash after the records is fine
+ * @return true if the header and the CRC of the records are valid
+ */
+bool puzzle_pack_open_memory(Puzzle_pack_t *pack, const void *data, size_t size);
+
+/**
+ * @brief Map the puzzle partition into the data address space
+ *
+ * @param pack The pack, empty on failure
+ * @return esp_err_t ESP_OK, ESP_ERR_NOT_FOUND without a partition, ESP_ERR_INVALID_VERSION
+ *                   if it holds no valid pack, or an mmap error
+ */
+esp_err_t puzzle_pack_open_partition(Puzzle_pack_t *pack);
+
+/**
+ * @brief Decode a puzzle
+ *
+ * @param pack The pack
+ * @param index Index of the puzzle, below count
+ * @param puzzle The puzzle to fill
+ * @return true if the record holds a valid position
+ */
+bool puzzle_pack_read(const Puzzle_pack_t *pack, size_t index, Puzzle_t *puzzle);
+
+/**
+ * @brief Encode a puzzle, for tools building a pack
+ *
+ * @param out PUZZLE_RECORD_SIZE bytes
+ * @param puzzle The puzzle, at most 32 pieces
+ */
+void puzzle_encode(uint8_t *out, const Puzzle_t *puzzle);
+
+/**
+ * @brief Fill the header of a pack, for tools building one
+ *
+ * @param out PUZZLE_HEADER_SIZE bytes
+ * @param records The encoded records
+ * @param count Number of records
+ */
+void puzzle_pack_header(uint8_t *out, const uint8_t *records, size_t count);
+
+/**
+ * @brief Start playing a puzzle
+ *
+ * @param session The session
+ * @param puzzle The puzzle
+ * @param solver Solver judging the moves, its table is cleared
+ */
+void puzzle_session_start(Puzzle_session_t *session, const Puzzle_t *puzzle, Mate_solver_t *solver);
+
+/**
+ * @brief Judge a move played on the board
+ *
+ * A move of the attacker is correct when the defender is mated in the
+ * moves left after it, whether it is the pack's solution or not. A wrong
+ * move must be taken back, it does not count.
+ *
+ * @param session The session
+ * @param before The position before the move
+ * @param move The move
+ * @param reply Set to the defence to show, or the one refuting a wrong move
+ * @return Puzzle_verdict_t The verdict
+ */
+Puzzle_verdict_t puzzle_session_judge(Puzzle_session_t *session, const Chess_position_t *before, Chess_move_t move,
+                                      Chess_move_t *reply);
+
+#endif
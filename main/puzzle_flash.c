@@ -0,0 +1,30 @@
+#include "esp_partition.h"
+#include "esp_log.h"
+#include "puzzle.h"
+
+static const char *TAG = "PUZZLE";
+
+esp_err_t puzzle_pack_open_partition(Puzzle_pack_t *pack)
+{
+    static esp_partition_mmap_handle_t handle;
+    const void *data;
+
+    pack->records = NULL;
+    pack->count = 0;
+    const esp_partition_t *part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, PUZZLE_PARTITION_SUBTYPE,
+                                                           PUZZLE_PARTITION_LABEL);
+    if (!part) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    // Puzzles are decoded from the flash cache one at a time
+    esp_err_t err = esp_partition_mmap(part, 0, part->size, ESP_PARTITION_MMAP_DATA, &data, &handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (!puzzle_pack_open_memory(pack, data, part->size)) {
+        esp_partition_munmap(handle);
+        return ESP_ERR_INVALID_VERSION;
+    }
+    ESP_LOGI(TAG, "%u puzzles", (unsigned int)pack->count);
+    return ESP_OK;
+}
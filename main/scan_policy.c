@@ -0,0 +1,37 @@
+#include "scan_policy.h"
+
+static Scan_step_t adaptive_next(void *ctx, const Scan_sample_t *sample)
+{
+    Scan_adaptive_t *adaptive = ctx;
+    const Scan_adaptive_config_t *config = &adaptive->config;
+    if (sample->changed) {
+        adaptive->last_change_us = sample->timestamp_us;
+    }
+
+    int64_t quiet_us = sample->timestamp_us - adaptive->last_change_us;
+    if (quiet_us < config->settle_us) {
+        return (Scan_step_t){.gap_us = config->burst_gap_us, .mode = SCAN_MODE_BURST};
+    }
+    if (quiet_us < config->idle_after_us) {
+        return (Scan_step_t){.gap_us = config->active_gap_us, .mode = SCAN_MODE_ACTIVE};
+    }
+    return (Scan_step_t){.gap_us = config->idle_gap_us, .mode = SCAN_MODE_IDLE};
+}
+
+Scan_policy_t scan_adaptive_init(Scan_adaptive_t *adaptive, const Scan_adaptive_config_t *config, int64_t now_us)
+{
+    adaptive->config = *config;
+    adaptive->last_change_us = now_us;
+    return (Scan_policy_t){.next = adaptive_next, .ctx = adaptive};
+}
+
+static Scan_step_t fixed_next(void *ctx, const Scan_sample_t *sample)
+{
+    (void)sample;
+    return (Scan_step_t){.gap_us = *(const uint32_t *)ctx, .mode = SCAN_MODE_ACTIVE};
+}
+
+Scan_policy_t scan_fixed_policy(const uint32_t *gap_us)
+{
+    return (Scan_policy_t){.next = fixed_next, .ctx = (void *)gap_us};
+}
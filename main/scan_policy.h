@@ -0,0 +1,98 @@
+#ifndef SCAN_POLICY_H
+#define SCAN_POLICY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @brief How eagerly the board is scanned
+ *
+ */
+typedef enum {
+    SCAN_MODE_BURST = 0,  // Something moved, frames back to back until the board settles
+    SCAN_MODE_ACTIVE,     // A game is going on, a frame every few milliseconds
+    SCAN_MODE_IDLE,       // Nobody touched the board for a while, the chip sleeps between frames
+    SCAN_MODE_NB,
+} Scan_mode_t;
+
+/**
+ * @brief What a frame showed, as the policy sees it
+ *
+ */
+typedef struct {
+    int64_t timestamp_us;
+    bool changed;         // The frame differs from the previous one or from the debounced occupancy
+} Scan_sample_t;
+
+/**
+ * @brief When to take the next frame
+ *
+ */
+typedef struct {
+    uint32_t gap_us;      // Pause between the end of this frame and the start of the next
+    uint8_t mode;         // Scan_mode_t, the chip may light sleep through the pause of SCAN_MODE_IDLE
+} Scan_step_t;
+
+/**
+ * @brief A latency versus power policy, called after every frame
+ *
+ * The policy sees nothing but its samples and the time in them, so the
+ * same code runs in the scan task and in the host simulator.
+ */
+typedef struct {
+    Scan_step_t (*next)(void *ctx, const Scan_sample_t *sample);
+    void *ctx;
+} Scan_policy_t;
+
+/**
+ * @brief Settings of the adaptive policy
+ *
+ */
+typedef struct {
+    uint32_t burst_gap_us;
+    uint32_t active_gap_us;
+    uint32_t idle_gap_us;
+    int64_t settle_us;        // Quiet time that ends a burst
+    int64_t idle_after_us;    // Quiet time before going idle
+} Scan_adaptive_config_t;
+
+/**
+ * @brief Burst on any change, active while the board was touched lately, idle after a long quiet
+ *
+ */
+typedef struct {
+    Scan_adaptive_config_t config;
+    int64_t last_change_us;
+} Scan_adaptive_t;
+
+/**
+ * @brief Start the adaptive policy in a burst
+ *
+ * @param adaptive The policy state
+ * @param config The settings, copied
+ * @param now_us Current time
+ * @return Scan_policy_t The policy, using adaptive as its context
+ */
+Scan_policy_t scan_adaptive_init(Scan_adaptive_t *adaptive, const Scan_adaptive_config_t *config, int64_t now_us);
+
+/**
+ * @brief The same pause after every frame, the behavior before adaptive scanning
+ *
+ * @param gap_us The pause, must outlive the policy
+ * @return Scan_policy_t The policy, never idle
+ */
+Scan_policy_t scan_fixed_policy(const uint32_t *gap_us);
+
+/**
+ * @brief Ask a policy for the next step
+ *
+ * @param policy The policy
+ * @param sample The frame just taken
+ * @return Scan_step_t When to take the next frame
+ */
+static inline Scan_step_t scan_policy_next(const Scan_policy_t *policy, const Scan_sample_t *sample)
+{
+    return policy->next(policy->ctx, sample);
+}
+
+#endif
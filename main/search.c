@@ -0,0 +1,474 @@
+#include <stdlib.h>
+#include <string.h>
+#include "evaluate.h"
+#include "search.h"
+#include "trace.h"
+
+// Move ordering scores, the previous PV move first, then the table's move, captures, killers and history
+#define ORDER_PV 30000
+#define ORDER_TT 29000
+#define ORDER_CAPTURE 20000
+#define ORDER_PROMOTION 19000
+#define ORDER_KILLER 18000
+#define HISTORY_MAX 16000
+
+void search_init(Search_t *search, const Search_limits_t *limits)
+{
+    search->limits = *limits;
+    search->stop = false;
+    search->nodes = 0;
+    search->move_top = 0;
+    search->key_count = 0;
+    memset(search->killers, 0, sizeof(search->killers));
+    memset(search->history, 0, sizeof(search->history));
+    memset(&search->report, 0, sizeof(search->report));
+}
+
+void search_set_history(Search_t *search, const uint64_t *keys, int count)
+{
+    if (count > SEARCH_HISTORY_MAX) {
+        keys += count - SEARCH_HISTORY_MAX;
+        count = SEARCH_HISTORY_MAX;
+    }
+    memcpy(search->keys, keys, count * sizeof(keys[0]));
+    search->key_count = count;
+}
+
+static void publish(Search_t *search)
+{
+    Search_report_t *report = &search->report;
+    report->nodes = search->nodes;
+    report->elapsed_us = search->clock_us ? search->clock_us() - search->start_us : 0;
+    if (search->on_report) {
+        search->on_report(report, search->ctx);
+    }
+}
+
+// Budgets are only checked once depth 1 is done, so there is always a move
+static bool should_stop(Search_t *search)
+{
+    if (search->stop || (search->nodes & (SEARCH_POLL_NODES - 1)) != 0) {
+        return search->stop;
+    }
+    const Search_limits_t *limits = &search->limits;
+    if (search->root_depth > 1) {
+        if (limits->node_limit && search->nodes >= limits->node_limit) {
+            search->stop = true;
+        }
+        if (limits->time_limit_us && search->clock_us() - search->start_us >= limits->time_limit_us) {
+            search->stop = true;
+        }
+    }
+    if (search->poll && search->poll(search->ctx)) {
+        search->stop = true;
+    }
+    return search->stop;
+}
+
+// A position seen before since the last irreversible move is scored as a draw
+static bool is_draw(const Search_t *search, const Chess_position_t *pos)
+{
+    if (pos->halfmove_clock >= 100) {
+        return true;
+    }
+    for (int i = search->key_count - 3, distance = 2; i >= 0 && distance <= pos->halfmove_clock; i -= 2, distance += 2) {
+        if (search->keys[i] == pos->key) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// 0 in the center, 6 in the corners
+static int center_distance(int sq)
+{
+    int file = SQUARE_FILE(sq) < 4 ? 3 - SQUARE_FILE(sq) : SQUARE_FILE(sq) - 4;
+    int rank = SQUARE_RANK(sq) < 4 ? 3 - SQUARE_RANK(sq) : SQUARE_RANK(sq) - 4;
+    return file + rank;
+}
+
+static int king_distance(int a, int b)
+{
+    int files = abs(SQUARE_FILE(a) - SQUARE_FILE(b));
+    int ranks = abs(SQUARE_RANK(a) - SQUARE_RANK(b));
+    return files > ranks ? files : ranks;
+}
+
+// A bitbase win still has to be converted: promote, push the pawn, or corner the bare king with ours close by
+static int bitbase_score(const Chess_position_t *pos, Bitbase_result_t result)
+{
+    if (result == BITBASE_DRAW) {
+        return 0;
+    }
+    Side_t strong = result == BITBASE_WIN ? pos->side_to_move : !pos->side_to_move;
+    int strong_king = bb_lsb(position_bb(pos, strong, PIECE_KING));
+    int weak_king = bb_lsb(position_bb(pos, !strong, PIECE_KING));
+    int score = SEARCH_KNOWN_WIN + 20 * center_distance(weak_king) + 10 * (7 - king_distance(strong_king, weak_king));
+    int piece = bb_lsb(pos->colors[strong] & ~pos->pieces[PIECE_KING]);
+    score += piece_values[position_piece_at(pos, piece)];
+    if (position_piece_at(pos, piece) == PIECE_PAWN) {
+        score += 50 * (strong == SIDE_WHITE ? SQUARE_RANK(piece) : 7 - SQUARE_RANK(piece));
+    }
+    return result == BITBASE_WIN ? score : -score;
+}
+
+static inline int evaluate_node(const Search_t *search, const Chess_position_t *pos, int ply)
+{
+    return search->use_nnue ? nnue_evaluate(&search->accumulators[ply], pos->side_to_move) : evaluate(pos);
+}
+
+// The child's accumulator follows from the parent's by the features the move changes
+static inline void play_move(Search_t *search, const Chess_position_t *pos, Chess_position_t *child,
+                             Chess_move_t move, int ply)
+{
+    *child = *pos;
+    make_move(child, move);
+    if (search->use_nnue) {
+        nnue_update(&search->accumulators[ply + 1], &search->accumulators[ply], pos, move);
+    }
+}
+
+// Generate onto the move stack, the list only lives in this frame
+static bool push_moves(Search_t *search, const Chess_position_t *pos, int *base, int *count)
+{
+    Move_list_t list;
+    generate_legal_moves(pos, &list);
+    if (search->move_top + list.count > SEARCH_MOVE_STACK) {
+        return false;
+    }
+    *base = search->move_top;
+    *count = list.count;
+    memcpy(&search->move_stack[*base], list.moves, list.count * sizeof(list.moves[0]));
+    search->move_top += list.count;
+    return true;
+}
+
+static void score_moves(Search_t *search, const Chess_position_t *pos, int base, int count, int ply,
+                        Chess_move_t pv_move, Chess_move_t tt_move)
+{
+    Side_t us = pos->side_to_move;
+    for (int i = base; i < base + count; i++) {
+        Chess_move_t move = search->move_stack[i];
+        int score;
+        if (move == pv_move) {
+            score = ORDER_PV;
+        } else if (move == tt_move) {
+            score = ORDER_TT;
+        } else if (MOVE_IS_CAPTURE(move)) {
+            // MVV-LVA, the most valuable victim first, then the least valuable attacker
+            Piece_type_t victim = MOVE_FLAGS(move) == MOVE_FLAG_EN_PASSANT ? PIECE_PAWN : position_piece_at(pos, MOVE_TO(move));
+            score = ORDER_CAPTURE + 100 * victim - position_piece_at(pos, MOVE_FROM(move));
+        } else if (MOVE_IS_PROMOTION(move)) {
+            score = ORDER_PROMOTION + MOVE_PROMOTION_PIECE(move);
+        } else if (move == search->killers[ply][0]) {
+            score = ORDER_KILLER;
+        } else if (move == search->killers[ply][1]) {
+            score = ORDER_KILLER - 1;
+        } else {
+            score = search->history[us][position_piece_at(pos, MOVE_FROM(move))][MOVE_TO(move)];
+        }
+        search->score_stack[i] = (int16_t)score;
+    }
+}
+
+// Mate scores are stored relative to the position, not to the root
+static int score_to_tt(int score, int ply)
+{
+    if (score > SEARCH_MATE - SEARCH_MAX_PLY) {
+        return score + ply;
+    }
+    if (score < -SEARCH_MATE + SEARCH_MAX_PLY) {
+        return score - ply;
+    }
+    return score;
+}
+
+static int score_from_tt(int score, int ply)
+{
+    if (score > SEARCH_MATE - SEARCH_MAX_PLY) {
+        return score - ply;
+    }
+    if (score < -SEARCH_MATE + SEARCH_MAX_PLY) {
+        return score + ply;
+    }
+    return score;
+}
+
+// Selection sort step, moves are picked lazily since most nodes cut off early
+static Chess_move_t pick_move(Search_t *search, int index, int end)
+{
+    int best = index;
+    for (int i = index + 1; i < end; i++) {
+        if (search->score_stack[i] > search->score_stack[best]) {
+            best = i;
+        }
+    }
+    Chess_move_t move = search->move_stack[best];
+    int16_t score = search->score_stack[best];
+    search->move_stack[best] = search->move_stack[index];
+    search->score_stack[best] = search->score_stack[index];
+    search->move_stack[index] = move;
+    search->score_stack[index] = score;
+    return move;
+}
+
+static void update_quiet_stats(Search_t *search, const Chess_position_t *pos, Chess_move_t move, int depth, int ply)
+{
+    if (search->killers[ply][0] != move) {
+        search->killers[ply][1] = search->killers[ply][0];
+        search->killers[ply][0] = move;
+    }
+
+    int16_t *entry = &search->history[pos->side_to_move][position_piece_at(pos, MOVE_FROM(move))][MOVE_TO(move)];
+    int bonus = depth * depth;
+    if (*entry + bonus > HISTORY_MAX) {
+        // Age every entry so recent cutoffs weigh more
+        int16_t *history = &search->history[0][0][0];
+        for (size_t i = 0; i < sizeof(search->history) / sizeof(history[0]); i++) {
+            history[i] /= 2;
+        }
+    }
+    *entry += bonus;
+}
+
+static int quiescence(Search_t *search, const Chess_position_t *pos, int alpha, int beta, int ply)
+{
+    search->nodes++;
+    if (should_stop(search)) {
+        return 0;
+    }
+    if (ply >= SEARCH_MAX_PLY - 1) {
+        return evaluate_node(search, pos, ply);
+    }
+
+    // Out of check the side to move may stand pat, in check every evasion is searched
+    bool in_check = is_in_check(pos);
+    int best = -SEARCH_INFINITE;
+    if (!in_check) {
+        best = evaluate_node(search, pos, ply);
+        if (best >= beta) {
+            return best;
+        }
+        if (best > alpha) {
+            alpha = best;
+        }
+    }
+
+    int base, count;
+    if (!push_moves(search, pos, &base, &count)) {
+        return evaluate_node(search, pos, ply);
+    }
+    if (count == 0) {
+        search->move_top = base;
+        return in_check ? -SEARCH_MATE + ply : 0;
+    }
+    score_moves(search, pos, base, count, ply, MOVE_NONE, MOVE_NONE);
+
+    for (int i = base; i < base + count; i++) {
+        Chess_move_t move = pick_move(search, i, base + count);
+        bool noisy = MOVE_IS_CAPTURE(move) || (MOVE_IS_PROMOTION(move) && MOVE_PROMOTION_PIECE(move) == PIECE_QUEEN);
+        if (!in_check && !noisy) {
+            continue;
+        }
+
+        Chess_position_t child;
+        play_move(search, pos, &child, move, ply);
+        int score = -quiescence(search, &child, -beta, -alpha, ply + 1);
+        if (search->stop) {
+            break;
+        }
+        if (score > best) {
+            best = score;
+            if (score > alpha) {
+                alpha = score;
+                if (score >= beta) {
+                    break;
+                }
+            }
+        }
+    }
+
+    search->move_top = base;
+    return best;
+}
+
+static int alpha_beta(Search_t *search, const Chess_position_t *pos, int depth, int alpha, int beta, int ply)
+{
+    search->pv_length[ply] = ply;
+    if (ply > 0 && is_draw(search, pos)) {
+        return 0;
+    }
+    // Positions in check are searched, so the mate itself is still found
+    bool in_check = is_in_check(pos);
+    if (ply > 0 && !in_check && search->bitbase) {
+        Bitbase_result_t result = bitbase_probe(search->bitbase, pos);
+        if (result != BITBASE_NONE) {
+            search->nodes++;
+            return bitbase_score(pos, result);
+        }
+    }
+    if (in_check) {
+        depth++;
+    }
+    if (depth <= 0) {
+        return quiescence(search, pos, alpha, beta, ply);
+    }
+
+    search->nodes++;
+    if (should_stop(search)) {
+        return 0;
+    }
+    if (ply >= SEARCH_MAX_PLY - 1) {
+        return evaluate_node(search, pos, ply);
+    }
+
+    // Null window nodes take a deep enough bound from the table, PV nodes only its move
+    Chess_move_t tt_move = MOVE_NONE;
+    Tt_hit_t hit;
+    if (search->tt && tt_probe(search->tt, pos->key, &hit)) {
+        tt_move = hit.move;
+        int score = score_from_tt(hit.score, ply);
+        if (ply > 0 && beta - alpha == 1 && hit.depth >= depth &&
+                (hit.bound == TT_BOUND_EXACT || (hit.bound == TT_BOUND_LOWER && score >= beta) ||
+                 (hit.bound == TT_BOUND_UPPER && score <= alpha))) {
+            return score;
+        }
+    }
+
+    int base, count;
+    if (!push_moves(search, pos, &base, &count)) {
+        return evaluate_node(search, pos, ply);
+    }
+    if (count == 0) {
+        search->move_top = base;
+        return in_check ? -SEARCH_MATE + ply : 0;
+    }
+    Chess_move_t pv_move = ply < search->report.pv_length ? search->report.pv[ply] : MOVE_NONE;
+    score_moves(search, pos, base, count, ply, pv_move, tt_move);
+
+    int alpha_start = alpha;
+    int best = -SEARCH_INFINITE;
+    Chess_move_t best_move = MOVE_NONE;
+    for (int i = base; i < base + count; i++) {
+        Chess_move_t move = pick_move(search, i, base + count);
+        Chess_position_t child;
+        play_move(search, pos, &child, move, ply);
+        search->keys[search->key_count++] = child.key;
+
+        // The first move gets the full window, the others have to prove they are better
+        int score;
+        if (i == base) {
+            score = -alpha_beta(search, &child, depth - 1, -beta, -alpha, ply + 1);
+        } else {
+            score = -alpha_beta(search, &child, depth - 1, -alpha - 1, -alpha, ply + 1);
+            if (score > alpha && score < beta && !search->stop) {
+                score = -alpha_beta(search, &child, depth - 1, -beta, -alpha, ply + 1);
+            }
+        }
+        search->key_count--;
+        if (search->stop) {
+            break;
+        }
+
+        if (score > best) {
+            best = score;
+            if (score > alpha) {
+                alpha = score;
+                best_move = move;
+                search->pv[ply][ply] = move;
+                for (int j = ply + 1; j < search->pv_length[ply + 1]; j++) {
+                    search->pv[ply][j] = search->pv[ply + 1][j];
+                }
+                search->pv_length[ply] = search->pv_length[ply + 1] > ply + 1 ? search->pv_length[ply + 1] : ply + 1;
+
+                if (ply == 0) {
+                    // Publish a new best root move right away, the LEDs can show it early
+                    Search_report_t *report = &search->report;
+                    bool changed = report->best_move != move;
+                    report->best_move = move;
+                    report->score = score;
+                    if (changed && i != base) {
+                        publish(search);
+                    }
+                }
+                if (score >= beta) {
+                    if (!MOVE_IS_CAPTURE(move) && !MOVE_IS_PROMOTION(move)) {
+                        update_quiet_stats(search, pos, move, depth, ply);
+                    }
+                    break;
+                }
+            }
+        }
+    }
+
+    search->move_top = base;
+    if (search->tt && !search->stop) {
+        Tt_bound_t bound = best >= beta ? TT_BOUND_LOWER : best > alpha_start ? TT_BOUND_EXACT : TT_BOUND_UPPER;
+        tt_store(search->tt, pos->key, best_move, score_to_tt(best, ply), depth, bound);
+    }
+    return best;
+}
+
+const Search_report_t *search_run(Search_t *search, const Chess_position_t *pos)
+{
+    Search_report_t *report = &search->report;
+    search->start_us = search->clock_us ? search->clock_us() : 0;
+    search->root_depth = 0;
+    memset(report, 0, sizeof(*report));
+
+    Move_list_t list;
+    if (generate_legal_moves(pos, &list) == 0) {
+        report->score = is_in_check(pos) ? -SEARCH_MATE : 0;
+        report->done = true;
+        publish(search);
+        return report;
+    }
+    report->best_move = list.moves[0];
+    search->keys[search->key_count++] = pos->key;
+    if (search->tt && search->helper == 0) {
+        tt_new_search(search->tt);
+    }
+    if (search->use_nnue) {
+        nnue_refresh(&search->accumulators[0], pos);
+    }
+
+    int max_depth = search->limits.max_depth;
+    if (max_depth <= 0 || max_depth > SEARCH_MAX_PLY - 1) {
+        max_depth = SEARCH_MAX_PLY - 1;
+    }
+    // Helpers start an odd or even depth ahead, so the threads spread over two iterations
+    for (int depth = 1 + search->helper % 2; depth <= max_depth; depth++) {
+        search->root_depth = depth;
+        int score = alpha_beta(search, pos, depth, -SEARCH_INFINITE, SEARCH_INFINITE, 0);
+
+        // An interrupted iteration still counts for the root moves it finished
+        if (search->pv_length[0] > 0) {
+            report->depth = depth;
+            report->pv_length = search->pv_length[0];
+            memcpy(report->pv, search->pv[0], report->pv_length * sizeof(report->pv[0]));
+            if (!search->stop) {
+                report->score = score;
+            }
+        }
+        if (search->stop) {
+            break;
+        }
+        TRACE_DEBUG(TRACE_SEARCH_ITERATION, depth, search->nodes);
+        publish(search);
+
+        // No need to look deeper than a forced mate, or to start an iteration that cannot finish
+        if (SEARCH_IS_MATE(score) && SEARCH_MATE - (score > 0 ? score : -score) <= depth) {
+            break;
+        }
+        if (search->limits.time_limit_us &&
+                search->clock_us() - search->start_us > search->limits.time_limit_us / 2) {
+            break;
+        }
+    }
+
+    search->key_count--;
+    report->done = true;
+    publish(search);
+    TRACE_INFO(TRACE_SEARCH_DONE, report->best_move, report->elapsed_us);
+    return report;
+}
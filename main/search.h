@@ -0,0 +1,123 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "position.h"
+#include "moves.h"
+#include "bitbase.h"
+#include "tt.h"
+#include "nnue.h"
+
+#define SEARCH_MAX_PLY 64
+#define SEARCH_MOVE_STACK 4096      // Generated moves of every ply of the current line
+#define SEARCH_HISTORY_MAX 100      // Earlier game positions looked at for repetitions
+
+#define SEARCH_INFINITE 32000
+#define SEARCH_MATE 31000           // Mate scores are SEARCH_MATE - plies to mate
+#define SEARCH_KNOWN_WIN 20000     // Bitbase wins, plus progress towards mate
+#define SEARCH_IS_MATE(score) ((score) > SEARCH_MATE - SEARCH_MAX_PLY || (score) < -SEARCH_MATE + SEARCH_MAX_PLY)
+
+/**
+ * @brief Budget of one search, zero means no limit
+ *
+ */
+typedef struct {
+    int max_depth;
+    uint64_t node_limit;
+    int64_t time_limit_us;
+} Search_limits_t;
+
+/**
+ * @brief Progress of a search, published after every iteration and root move change
+ *
+ */
+typedef struct {
+    Chess_move_t best_move;
+    int score;                      // Centipawns for the side to move, see SEARCH_MATE
+    int depth;                      // Last depth searched
+    uint64_t nodes;
+    int64_t elapsed_us;
+    bool done;                      // Last report of the search
+    int pv_length;
+    Chess_move_t pv[SEARCH_MAX_PLY];
+} Search_report_t;
+
+typedef void (*Search_report_cb_t)(const Search_report_t *report, void *ctx);
+typedef bool (*Search_poll_cb_t)(void *ctx);   // Return true to stop the search
+typedef int64_t (*Search_clock_cb_t)(void);    // Monotonic microseconds
+
+/**
+ * @brief State of an iterative deepening alpha-beta search
+ *
+ * Principal variation search with quiescence and a transposition table,
+ * moves ordered by the previous PV, the table, MVV-LVA, killers and history.
+ * About 38 KB, so it is kept out of task stacks. Set the callbacks before
+ * search_run(), the rest is internal.
+ */
+typedef struct {
+    Search_limits_t limits;
+    Search_report_cb_t on_report;   // Optional
+    Search_poll_cb_t poll;          // Optional, called every SEARCH_POLL_NODES nodes
+    Search_clock_cb_t clock_us;     // Required for time limits and reports
+    void *ctx;
+    const Bitbase_t *bitbase;       // Optional, resolves KPK, KRK and KQK without searching
+    Tt_t *tt;                       // Optional, may be shared with helper searches
+    int helper;                     // 0 for the main search, else the helper number, see search_run()
+    bool use_nnue;                  // Evaluate with the network instead of the piece-square tables
+    volatile bool stop;             // May be set from another task
+
+    // Internal
+    uint64_t nodes;
+    int64_t start_us;
+    int root_depth;
+    int move_top;
+    Chess_move_t move_stack[SEARCH_MOVE_STACK];
+    int16_t score_stack[SEARCH_MOVE_STACK];
+    Chess_move_t killers[SEARCH_MAX_PLY][2];
+    int16_t history[2][PIECE_TYPE_NB][SQUARE_NB];
+    int pv_length[SEARCH_MAX_PLY];
+    Chess_move_t pv[SEARCH_MAX_PLY][SEARCH_MAX_PLY];
+    int key_count;                  // Game history first, then the current line
+    uint64_t keys[SEARCH_HISTORY_MAX + SEARCH_MAX_PLY];
+    Nnue_accumulator_t accumulators[SEARCH_MAX_PLY];  // Of the current line, with use_nnue
+    Search_report_t report;
+} Search_t;
+
+#define SEARCH_POLL_NODES 1024
+
+/**
+ * @brief Reset a search and set its budget
+ *
+ * @param search The search
+ * @param limits The budget
+ */
+void search_init(Search_t *search, const Search_limits_t *limits);
+
+/**
+ * @brief Give the keys of the positions before the root, for repetition draws
+ *
+ * @param search The search
+ * @param keys Keys oldest first, only the ones since the last irreversible move matter
+ * @param count Number of keys, the oldest ones past SEARCH_HISTORY_MAX are dropped
+ */
+void search_set_history(Search_t *search, const uint64_t *keys, int count);
+
+/**
+ * @brief Search a position until the budget runs out or the search is stopped
+ *
+ * At least depth 1 is always completed, so a legal move is returned as long
+ * as there is one.
+ *
+ * Lazy SMP: helper searches of the same position on other threads share the
+ * main search's table and only fill it, the main search reads their results
+ * as cutoffs and move ordering. Helpers run without limits until their stop
+ * flag is set, and the main search ages the table when it starts.
+ *
+ * @param search The search
+ * @param pos The root position
+ * @return const Search_report_t* The final report, best_move is MOVE_NONE without legal moves
+ */
+const Search_report_t *search_run(Search_t *search, const Chess_position_t *pos);
+
+#endif
@@ -0,0 +1,352 @@
+#include <string.h>
+#include "telemetry.h"
+#include "crc32.h"
+
+_Static_assert((TELEMETRY_RING_SIZE & (TELEMETRY_RING_SIZE - 1)) == 0, "telemetry ring size must be a power of two");
+
+// Every section at its largest, after the board's: a position, or the moves and the state
+#define OTHER_SECTIONS_MAX ((2 + 8) + (2 + 8 + SQUARE_NB * 3) + (2 + 1 + TELEMETRY_STATS_NB * 4))
+_Static_assert(2 + 1 + (2 + 3 + POSITION_FEN_MAX) + OTHER_SECTIONS_MAX + 4 <= TELEMETRY_FRAME_MAX, "a position fits");
+_Static_assert(2 + TELEMETRY_RECENT_MOVES * (2 + 6) + (2 + 1) + OTHER_SECTIONS_MAX + 4 <= TELEMETRY_FRAME_MAX,
+               "moves fit");
+
+typedef struct {
+    uint8_t bytes[TELEMETRY_FRAME_MAX - 6];
+    size_t size;
+} Frame_t;
+
+static void put_u16(uint8_t *bytes, uint16_t value)
+{
+    bytes[0] = (uint8_t)value;
+    bytes[1] = (uint8_t)(value >> 8);
+}
+
+static void put_u32(uint8_t *bytes, uint32_t value)
+{
+    bytes[0] = (uint8_t)value;
+    bytes[1] = (uint8_t)(value >> 8);
+    bytes[2] = (uint8_t)(value >> 16);
+    bytes[3] = (uint8_t)(value >> 24);
+}
+
+static void put_u64(uint8_t *bytes, uint64_t value)
+{
+    put_u32(bytes, (uint32_t)value);
+    put_u32(bytes + 4, (uint32_t)(value >> 32));
+}
+
+size_t telemetry_cobs_encode(const uint8_t *in, size_t size, uint8_t *out)
+{
+    // Each block is a length code followed by up to 254 non-zero bytes, the code stands for the zero after them
+    size_t code_at = 0, n = 1;
+    uint8_t code = 1;
+    for (size_t i = 0; i < size; i++) {
+        if (in[i] != 0) {
+            out[n++] = in[i];
+            code++;
+        }
+        if (in[i] == 0 || code == 0xFF) {
+            out[code_at] = code;
+            code = 1;
+            code_at = n++;
+        }
+    }
+    out[code_at] = code;
+    return n;
+}
+
+size_t telemetry_cobs_decode(const uint8_t *in, size_t size, uint8_t *out, size_t max)
+{
+    size_t n = 0, i = 0;
+    while (i < size) {
+        uint8_t code = in[i++];
+        if (code == 0 || i + code - 1 > size || n + code - 1 > max) {
+            return 0;
+        }
+        for (int j = 1; j < code; j++) {
+            if (in[i] == 0) {
+                return 0;
+            }
+            out[n++] = in[i++];
+        }
+        // A full block has no zero after it, nor does the last one
+        if (code != 0xFF && i < size) {
+            if (n == max) {
+                return 0;
+            }
+            out[n++] = 0;
+        }
+    }
+    return n;
+}
+
+void telemetry_ring_clear(Telemetry_ring_t *ring)
+{
+    atomic_store_explicit(&ring->tail, atomic_load_explicit(&ring->head, memory_order_acquire), memory_order_release);
+}
+
+size_t telemetry_ring_free(const Telemetry_ring_t *ring)
+{
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    return TELEMETRY_RING_SIZE - (head - tail);
+}
+
+size_t telemetry_ring_peek(Telemetry_ring_t *ring, const uint8_t **data)
+{
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    uint32_t start = tail & (TELEMETRY_RING_SIZE - 1);
+    uint32_t size = head - tail;
+    *data = ring->bytes + start;
+    return size < TELEMETRY_RING_SIZE - start ? size : TELEMETRY_RING_SIZE - start;
+}
+
+void telemetry_ring_consume(Telemetry_ring_t *ring, size_t size)
+{
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    atomic_store_explicit(&ring->tail, tail + (uint32_t)size, memory_order_release);
+}
+
+size_t telemetry_ring_read_frame(const Telemetry_ring_t *ring, uint8_t *out)
+{
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    // COBS leaves no zero inside a frame, the first one after its opening zero closes it
+    for (uint32_t i = 0; tail + i != head && i < TELEMETRY_ENCODED_MAX; i++) {
+        out[i] = ring->bytes[(tail + i) & (TELEMETRY_RING_SIZE - 1)];
+        if (i > 0 && out[i] == 0) {
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+static void ring_write(Telemetry_ring_t *ring, const uint8_t *data, size_t size)
+{
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint32_t start = head & (TELEMETRY_RING_SIZE - 1);
+    size_t first = size < TELEMETRY_RING_SIZE - start ? size : TELEMETRY_RING_SIZE - start;
+    memcpy(ring->bytes + start, data, first);
+    memcpy(ring->bytes, data + first, size - first);
+    atomic_store_explicit(&ring->head, head + (uint32_t)size, memory_order_release);
+}
+
+// Frame the sections and queue them whole, or drop them and owe the receiver a keyframe
+static bool put_frame(Telemetry_encoder_t *enc, Telemetry_frame_type_t type, const Frame_t *frame)
+{
+    uint8_t raw[TELEMETRY_FRAME_MAX];
+    uint8_t encoded[TELEMETRY_ENCODED_MAX];
+    raw[0] = (uint8_t)type;
+    raw[1] = enc->seq;
+    memcpy(raw + 2, frame->bytes, frame->size);
+    put_u32(raw + 2 + frame->size, crc32_update(0, raw, 2 + frame->size));
+
+    // A zero before the frame ends whatever console text came before it
+    size_t n = 0;
+    encoded[n++] = 0;
+    n += telemetry_cobs_encode(raw, frame->size + 6, encoded + n);
+    encoded[n++] = 0;
+    if (telemetry_ring_free(&enc->ring) < n) {
+        enc->dropped++;
+        enc->keyframe_due = true;
+        return false;
+    }
+    ring_write(&enc->ring, encoded, n);
+    enc->seq++;
+    enc->frames++;
+    return true;
+}
+
+// Reserve a section, the sizes are bounded so a frame never overflows
+static uint8_t *add_section(Frame_t *frame, Telemetry_section_t tag, size_t size)
+{
+    uint8_t *section = frame->bytes + frame->size;
+    section[0] = (uint8_t)tag;
+    section[1] = (uint8_t)size;
+    frame->size += 2 + size;
+    return section + 2;
+}
+
+static bool is_legal(const Chess_position_t *pos, Chess_move_t move)
+{
+    Move_list_t list;
+    generate_legal_moves(pos, &list);
+    for (int i = 0; i < list.count; i++) {
+        if (list.moves[i] == move) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void add_position(Frame_t *frame, const Telemetry_board_t *board)
+{
+    char fen[POSITION_FEN_MAX];
+    position_to_fen(&board->pos, fen);
+    size_t length = strlen(fen);
+    uint8_t *section = add_section(frame, TELEMETRY_SECTION_POSITION, 3 + length);
+    section[0] = board->state;
+    put_u16(section + 1, (uint16_t)board->plies);
+    memcpy(section + 3, fen, length);
+}
+
+static void encode_board(Telemetry_encoder_t *enc, Frame_t *frame, const Telemetry_board_t *board, bool keyframe)
+{
+    Telemetry_board_t *sent = &enc->board;
+
+    // New moves of the same game go one by one, a takeback or a new game as the whole position
+    Chess_move_t moves[TELEMETRY_RECENT_MOVES];
+    uint32_t keys[TELEMETRY_RECENT_MOVES];
+    int count = 0;
+    bool follows = !keyframe && board->start_key == sent->start_key && board->plies >= sent->plies &&
+                   board->plies - sent->plies <= TELEMETRY_RECENT_MOVES;
+    Chess_position_t pos = sent->pos;
+    for (uint32_t ply = sent->plies + 1; follows && ply <= board->plies; ply++) {
+        Chess_move_t move = board->recent[(ply - 1) % TELEMETRY_RECENT_MOVES];
+        follows = is_legal(&pos, move);
+        if (follows) {
+            make_move(&pos, move);
+            moves[count] = move;
+            keys[count++] = (uint32_t)pos.key;
+        }
+    }
+    follows = follows && pos.key == board->pos.key;
+
+    if (!follows) {
+        add_position(frame, board);
+    } else {
+        for (int i = 0; i < count; i++) {
+            uint8_t *section = add_section(frame, TELEMETRY_SECTION_MOVE, 6);
+            put_u16(section, moves[i]);
+            put_u32(section + 2, keys[i]);
+        }
+        if (board->state != sent->state) {
+            *add_section(frame, TELEMETRY_SECTION_STATE, 1) = board->state;
+        }
+    }
+
+    // A piece lifted or put down is one square
+    Bitboard_t changed = board->occupancy ^ sent->occupancy;
+    int squares = bb_popcount(changed);
+    if (squares > 0 && squares < 8) {
+        uint8_t *section = add_section(frame, TELEMETRY_SECTION_SQUARES, (size_t)squares);
+        while (changed) {
+            *section++ = (uint8_t)bb_pop_lsb(&changed);
+        }
+    } else if (squares >= 8) {
+        put_u64(add_section(frame, TELEMETRY_SECTION_OCCUPANCY, 8), changed);
+    }
+    *sent = *board;
+}
+
+static void encode_leds(Telemetry_encoder_t *enc, Frame_t *frame, const uint8_t leds[SQUARE_NB][3])
+{
+    Bitboard_t changed = 0;
+    for (int sq = 0; sq < SQUARE_NB; sq++) {
+        if (memcmp(leds[sq], enc->leds[sq], 3) != 0) {
+            changed |= BB_SQUARE(sq);
+        }
+    }
+    // A square byte per pixel until the mask is shorter
+    int pixels = bb_popcount(changed);
+    uint8_t *section;
+    if (pixels == 0) {
+        return;
+    } else if (pixels < 8) {
+        section = add_section(frame, TELEMETRY_SECTION_PIXELS, (size_t)pixels * 4);
+    } else {
+        section = add_section(frame, TELEMETRY_SECTION_LEDS, 8 + (size_t)pixels * 3);
+        put_u64(section, changed);
+        section += 8;
+    }
+    while (changed) {
+        int sq = bb_pop_lsb(&changed);
+        if (pixels < 8) {
+            *section++ = (uint8_t)sq;
+        }
+        memcpy(section, leds[sq], 3);
+        section += 3;
+    }
+    memcpy(enc->leds, leds, sizeof(enc->leds));
+}
+
+static void encode_stats(Telemetry_encoder_t *enc, Frame_t *frame, const Telemetry_stats_t *stats)
+{
+    const uint32_t *now = (const uint32_t *)stats;
+    const uint32_t *sent = (const uint32_t *)&enc->stats;
+    uint8_t changed = 0;
+    int count = 0;
+    for (int i = 0; i < TELEMETRY_STATS_NB; i++) {
+        if (now[i] != sent[i]) {
+            changed |= (uint8_t)(1 << i);
+            count++;
+        }
+    }
+    if (!changed) {
+        return;
+    }
+    uint8_t *section = add_section(frame, TELEMETRY_SECTION_STATS, 1 + (size_t)count * 4);
+    *section++ = changed;
+    for (int i = 0; i < TELEMETRY_STATS_NB; i++) {
+        if (changed & (1 << i)) {
+            put_u32(section, now[i]);
+            section += 4;
+        }
+    }
+    enc->stats = *stats;
+}
+
+void telemetry_encoder_init(Telemetry_encoder_t *enc)
+{
+    memset(enc, 0, sizeof(*enc));
+    enc->keyframe_due = true;
+}
+
+void telemetry_request_keyframe(Telemetry_encoder_t *enc)
+{
+    enc->keyframe_due = true;
+}
+
+bool telemetry_encode(Telemetry_encoder_t *enc, const Telemetry_board_t *board, const uint8_t leds[SQUARE_NB][3],
+                      const Telemetry_stats_t *stats)
+{
+    Frame_t frame = {.size = 0};
+    Telemetry_frame_type_t type = TELEMETRY_FRAME_DELTA;
+    Telemetry_stats_t now = *stats;
+    now.tx_dropped = enc->dropped;
+    bool keyframe = enc->keyframe_due;
+    if (keyframe) {
+        // Deltas are no use to a receiver waiting for a keyframe, so nothing goes until one fits
+        if (telemetry_ring_free(&enc->ring) < TELEMETRY_ENCODED_MAX) {
+            return true;
+        }
+        enc->keyframe_due = false;
+        type = TELEMETRY_FRAME_KEYFRAME;
+        frame.bytes[frame.size++] = TELEMETRY_VERSION;
+        // The sections are changes from the state the keyframe resets to
+        memset(&enc->board, 0, sizeof(enc->board));
+        memset(enc->leds, 0, sizeof(enc->leds));
+        memset(&enc->stats, 0, sizeof(enc->stats));
+    }
+    encode_board(enc, &frame, board, keyframe);
+    encode_leds(enc, &frame, leds);
+    encode_stats(enc, &frame, &now);
+    if (!keyframe && frame.size == 0) {
+        return true;
+    }
+    return put_frame(enc, type, &frame);
+}
+
+void telemetry_board_from_game(Telemetry_board_t *board, const Game_t *game)
+{
+    board->state = (uint8_t)game->state;
+    board->occupancy = game->occupancy;
+    board->pos = game->pos;
+    board->start_key = game->record.start.key;
+    board->plies = game->record.count;
+    uint32_t first = board->plies > TELEMETRY_RECENT_MOVES ? board->plies - TELEMETRY_RECENT_MOVES : 0;
+    for (uint32_t ply = first; ply < board->plies; ply++) {
+        board->recent[ply % TELEMETRY_RECENT_MOVES] = game_record_get(&game->record, ply);
+    }
+}
@@ -0,0 +1,213 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "bitboard.h"
+#include "position.h"
+#include "moves.h"
+#include "game.h"
+
+#define TELEMETRY_VERSION 1
+#define TELEMETRY_RING_SIZE 4096      // Bytes, a power of two
+#define TELEMETRY_FRAME_MAX 352       // Type, sequence, sections and CRC, a keyframe with every LED lit is the largest
+#define TELEMETRY_ENCODED_MAX (TELEMETRY_FRAME_MAX + TELEMETRY_FRAME_MAX / 254 + 3)   // COBS and both delimiters
+#define TELEMETRY_RECENT_MOVES 8      // Moves a board snapshot carries, more at once are sent as a position
+#define TELEMETRY_STATS_NB 7
+
+/**
+ * @brief Frame types, the first byte of a frame, the sequence number is the second
+ *
+ * A keyframe starts with the version, then resets the receiver to an
+ * empty board, blank LEDs and zero stats before its sections are applied.
+ * A delta frame's sections are applied to the state before it.
+ */
+typedef enum {
+    TELEMETRY_FRAME_KEYFRAME = 'K',
+    TELEMETRY_FRAME_DELTA = 'D',
+} Telemetry_frame_type_t;
+
+/**
+ * @brief Sections of a frame, each a tag, its length and its data
+ *
+ * Small changes are lists of squares, larger ones bitmasks.
+ */
+typedef enum {
+    TELEMETRY_SECTION_POSITION = 'P',   // Game state, plies u16, FEN without its NUL
+    TELEMETRY_SECTION_MOVE = 'M',       // Next ply: move u16, low half of the key after it u32
+    TELEMETRY_SECTION_STATE = 'S',      // Game state
+    TELEMETRY_SECTION_SQUARES = 'O',    // Squares whose occupancy changed, a byte each
+    TELEMETRY_SECTION_OCCUPANCY = 'B',  // Mask of the squares whose occupancy changed u64
+    TELEMETRY_SECTION_PIXELS = 'L',     // Square and RGB of each pixel that changed
+    TELEMETRY_SECTION_LEDS = 'F',       // Mask of the pixels that changed u64, then their RGB in square order
+    TELEMETRY_SECTION_STATS = 'T',      // Mask of the stats that changed u8, then each of them u32 in field order
+} Telemetry_section_t;
+
+/**
+ * @brief What the game task shows of the board
+ *
+ */
+typedef struct {
+    uint8_t state;            // Game_state_t
+    Bitboard_t occupancy;     // Debounced hall sensors
+    Chess_position_t pos;
+    uint64_t start_key;       // Start of the game, a new game is sent as a position
+    uint32_t plies;
+    Chess_move_t recent[TELEMETRY_RECENT_MOVES];   // Ply p at recent[(p - 1) % TELEMETRY_RECENT_MOVES]
+} Telemetry_board_t;
+
+/**
+ * @brief Counters and timings, sent in this order
+ *
+ */
+typedef struct {
+    uint32_t uptime_ms;
+    uint32_t scan_frames;     // Hall matrix frames read
+    uint32_t hall_events;     // Debounced changes
+    uint32_t hall_dropped;    // Changes the game task missed
+    uint32_t led_frames;      // Frames sent to the strip
+    uint32_t game_max_us;     // Longest handling of a batch of hall events
+    uint32_t tx_dropped;      // Telemetry frames that did not fit the ring
+} Telemetry_stats_t;
+
+_Static_assert(sizeof(Telemetry_stats_t) == TELEMETRY_STATS_NB * sizeof(uint32_t), "stats are only u32 fields");
+
+/**
+ * @brief Encoded frames waiting for the serial port
+ *
+ * One writer and one reader, which may run on different tasks. Frames go
+ * in whole or not at all, so the reader can send any part of it.
+ */
+typedef struct {
+    _Atomic uint32_t head;    // Next byte written, only moved by the encoder
+    _Atomic uint32_t tail;    // Next byte sent, only moved by the reader
+    uint8_t bytes[TELEMETRY_RING_SIZE];
+} Telemetry_ring_t;
+
+/**
+ * @brief Turns board snapshots into frames
+ *
+ * Each call sends at most one frame with everything that changed. Frames
+ * are COBS encoded with a CRC-32, between zero bytes, so a receiver finds
+ * the next frame after any garbage or console text and rejects damaged
+ * ones. Each frame carries a sequence number: a receiver that misses one
+ * waits for the next keyframe, sent on connection, after a frame did not
+ * fit the ring and whenever telemetry_request_keyframe() is called.
+ */
+typedef struct {
+    Telemetry_ring_t ring;
+    uint8_t seq;              // Of the next frame
+    bool keyframe_due;
+    Telemetry_board_t board;  // As the receiver knows it
+    uint8_t leds[SQUARE_NB][3];
+    Telemetry_stats_t stats;
+    uint32_t dropped;         // Frames that did not fit the ring
+    uint32_t frames;          // Frames written to the ring
+} Telemetry_encoder_t;
+
+/**
+ * @brief COBS encode bytes, no zero byte is left in the output
+ *
+ * @param in The bytes
+ * @param size Number of bytes
+ * @param out size + size / 254 + 1 bytes at most
+ * @return size_t Size written
+ */
+size_t telemetry_cobs_encode(const uint8_t *in, size_t size, uint8_t *out);
+
+/**
+ * @brief Decode bytes encoded by telemetry_cobs_encode(), without the delimiters
+ *
+ * @param in The encoded bytes
+ * @param size Number of bytes
+ * @param out size bytes at most, may be in
+ * @param max Room in out
+ * @return size_t Size decoded, 0 if the input is not valid COBS or does not fit
+ */
+size_t telemetry_cobs_decode(const uint8_t *in, size_t size, uint8_t *out, size_t max);
+
+/**
+ * @brief Empty the ring
+ *
+ * @param ring The ring
+ */
+void telemetry_ring_clear(Telemetry_ring_t *ring);
+
+/**
+ * @brief Bytes that can be written to the ring
+ *
+ * @param ring The ring
+ * @return size_t The free room
+ */
+size_t telemetry_ring_free(const Telemetry_ring_t *ring);
+
+/**
+ * @brief Get the next bytes to send, without removing them
+ *
+ * @param ring The ring
+ * @param data Set to the first byte
+ * @return size_t Contiguous bytes from there, 0 if the ring is empty
+ */
+size_t telemetry_ring_peek(Telemetry_ring_t *ring, const uint8_t **data);
+
+/**
+ * @brief Remove bytes that were sent
+ *
+ * @param ring The ring
+ * @param size Number of bytes, at most what telemetry_ring_peek() returned
+ */
+void telemetry_ring_consume(Telemetry_ring_t *ring, size_t size);
+
+/**
+ * @brief Copy the next frame out of the ring, without removing it
+ *
+ * Frames are queued whole and sent whole by the serial port task, each in
+ * a single write, so console text from other tasks only lands between
+ * them. Remove the frame with telemetry_ring_consume() once it is sent.
+ *
+ * @param ring The ring, read from a frame boundary
+ * @param out TELEMETRY_ENCODED_MAX bytes
+ * @return size_t Size of the frame with both delimiters, 0 if the ring is empty
+ */
+size_t telemetry_ring_read_frame(const Telemetry_ring_t *ring, uint8_t *out);
+
+/**
+ * @brief Start with an empty ring and a keyframe due
+ *
+ * @param enc The encoder
+ */
+void telemetry_encoder_init(Telemetry_encoder_t *enc);
+
+/**
+ * @brief Send the whole state with the next telemetry_encode()
+ *
+ * @param enc The encoder
+ */
+void telemetry_request_keyframe(Telemetry_encoder_t *enc);
+
+/**
+ * @brief Write a frame with what changed since the last call
+ *
+ * Never blocks. A frame that does not fit the ring is dropped, and the
+ * next frame that fits is a keyframe.
+ *
+ * @param enc The encoder
+ * @param board The board now
+ * @param leds The LED colors now, by square
+ * @param stats The stats now, tx_dropped is filled in by the encoder
+ * @return true unless a frame was dropped
+ */
+bool telemetry_encode(Telemetry_encoder_t *enc, const Telemetry_board_t *board, const uint8_t leds[SQUARE_NB][3],
+                      const Telemetry_stats_t *stats);
+
+/**
+ * @brief Take a board snapshot of a game
+ *
+ * @param board The snapshot
+ * @param game The game
+ */
+void telemetry_board_from_game(Telemetry_board_t *board, const Game_t *game);
+
+#endif
@@ -0,0 +1,119 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "driver/usb_serial_jtag.h"
+#include "driver/usb_serial_jtag_vfs.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+#include "telemetry_usb.h"
+
+#define TELEMETRY_TASK_PRIORITY 1   // With the trace drain, below everything that moves pieces or LEDs
+#define TELEMETRY_TASK_STACK 4096
+#define TELEMETRY_STATS_MS 1000
+#define TELEMETRY_DRIVER_TX_BUFFER 1024
+#define TELEMETRY_WRITE_TIMEOUT_MS 20
+
+typedef struct {
+    uint8_t colors[SQUARE_NB][3];
+} Telemetry_leds_t;
+
+static const char *TAG = "TELEMETRY";
+
+// Only the latest snapshots matter, a frame carries everything that changed since the last one
+static QueueHandle_t board_queue;
+static QueueHandle_t leds_queue;
+static Telemetry_stats_cb_t stats_cb;
+static Telemetry_encoder_t encoder;   // Only touched by the telemetry task
+
+static void telemetry_task(void *arg)
+{
+    static Telemetry_board_t board;
+    static Telemetry_leds_t leds;
+    Telemetry_stats_t stats = {0};
+    bool connected = false, have_board = false;
+    TickType_t last_wake = xTaskGetTickCount();
+    TickType_t last_stats = last_wake, last_keyframe = last_wake;
+
+    telemetry_encoder_init(&encoder);
+    while (1) {
+        have_board |= xQueueReceive(board_queue, &board, 0) == pdTRUE;
+        xQueueReceive(leds_queue, &leds, 0);
+        TickType_t now = xTaskGetTickCount();
+        if (now - last_stats >= pdMS_TO_TICKS(TELEMETRY_STATS_MS)) {
+            stats_cb(&stats);
+            last_stats = now;
+        }
+
+        // Nothing piles up while no host listens, a host that connects starts from a keyframe
+        if (!have_board || !usb_serial_jtag_is_connected()) {
+            connected = false;
+            telemetry_ring_clear(&encoder.ring);
+        } else {
+            // A receiver that lost a frame waits for the next keyframe, so one comes regularly
+            if (!connected || now - last_keyframe >= pdMS_TO_TICKS(CONFIG_CHESSY_TELEMETRY_KEYFRAME_S * 1000)) {
+                telemetry_request_keyframe(&encoder);
+                last_keyframe = now;
+            }
+            connected = true;
+            telemetry_encode(&encoder, &board, leds.colors, &stats);
+
+            // Each frame is one write, console text from other tasks cannot land inside it
+            static uint8_t frame[TELEMETRY_ENCODED_MAX];
+            size_t size;
+            while ((size = telemetry_ring_read_frame(&encoder.ring, frame)) > 0) {
+                int written = usb_serial_jtag_write_bytes(frame, size, pdMS_TO_TICKS(TELEMETRY_WRITE_TIMEOUT_MS));
+                if (written <= 0) {
+                    break;   // The driver's buffer stays full, the frame goes next period
+                }
+                telemetry_ring_consume(&encoder.ring, size);
+                if ((size_t)written != size) {
+                    // The receiver drops the torn frame, a keyframe brings it back at once
+                    telemetry_request_keyframe(&encoder);
+                }
+            }
+        }
+        xTaskDelayUntil(&last_wake, pdMS_TO_TICKS(CONFIG_CHESSY_TELEMETRY_PERIOD_MS));
+    }
+}
+
+esp_err_t telemetry_usb_start(Telemetry_stats_cb_t get_stats)
+{
+    usb_serial_jtag_driver_config_t config = USB_SERIAL_JTAG_DRIVER_CONFIG_DEFAULT();
+    config.tx_buffer_size = TELEMETRY_DRIVER_TX_BUFFER;
+    esp_err_t err = usb_serial_jtag_driver_install(&config);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Cannot install the USB serial driver: %s", esp_err_to_name(err));
+        return err;
+    }
+    // Console writes go through the driver too, each frame is written in one go so they land between frames
+    usb_serial_jtag_vfs_use_driver();
+
+    stats_cb = get_stats;
+    board_queue = xQueueCreate(1, sizeof(Telemetry_board_t));
+    leds_queue = xQueueCreate(1, sizeof(Telemetry_leds_t));
+    if (!board_queue || !leds_queue ||
+            xTaskCreate(telemetry_task, "telemetry", TELEMETRY_TASK_STACK, NULL, TELEMETRY_TASK_PRIORITY, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "Cannot start the telemetry task");
+        board_queue = NULL;
+        leds_queue = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+void telemetry_usb_publish_board(const Telemetry_board_t *board)
+{
+    if (board_queue) {
+        xQueueOverwrite(board_queue, board);
+    }
+}
+
+void telemetry_usb_publish_leds(const uint8_t leds[SQUARE_NB][3])
+{
+    if (leds_queue) {
+        Telemetry_leds_t snapshot;
+        memcpy(snapshot.colors, leds, sizeof(snapshot.colors));
+        xQueueOverwrite(leds_queue, &snapshot);
+    }
+}
@@ -0,0 +1,41 @@
+#ifndef TELEMETRY_USB_H
+#define TELEMETRY_USB_H
+
+#include "esp_err.h"
+#include "telemetry.h"
+
+/**
+ * @brief Fill the stats, called by the telemetry task once a second
+ *
+ * @param stats The stats, tx_dropped is filled in by the encoder
+ */
+typedef void (*Telemetry_stats_cb_t)(Telemetry_stats_t *stats);
+
+/**
+ * @brief Take over the USB-Serial-JTAG port and start the telemetry task
+ *
+ * The task runs below every other one. While a host is connected it
+ * encodes the latest board and LED snapshots every
+ * CONFIG_CHESSY_TELEMETRY_PERIOD_MS and hands the ring to the driver
+ * without waiting, console output keeps going through the same driver.
+ *
+ * @param get_stats Fills the stats
+ * @return esp_err_t ESP_OK, or the driver error
+ */
+esp_err_t telemetry_usb_start(Telemetry_stats_cb_t get_stats);
+
+/**
+ * @brief Replace the board snapshot, never blocks
+ *
+ * @param board The board
+ */
+void telemetry_usb_publish_board(const Telemetry_board_t *board);
+
+/**
+ * @brief Replace the LED snapshot, never blocks
+ *
+ * @param leds The colors shown, by square
+ */
+void telemetry_usb_publish_leds(const uint8_t leds[SQUARE_NB][3]);
+
+#endif
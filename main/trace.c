@@ -0,0 +1,116 @@
+#include <string.h>
+#include "trace.h"
+
+#if defined(ESP_PLATFORM) && !CONFIG_IDF_TARGET_LINUX
+#include "esp_cpu.h"
+#else
+#include <time.h>
+#endif
+
+_Static_assert(sizeof(Trace_record_t) == 16, "trace records are 16 bytes");
+_Static_assert((TRACE_RING_RECORDS & (TRACE_RING_RECORDS - 1)) == 0, "trace ring size must be a power of two");
+
+typedef struct {
+    _Atomic uint32_t head;  // Next index to write
+    uint32_t tail;          // Next index to drain, only used by the drainer
+    Trace_record_t records[TRACE_RING_RECORDS];
+} Trace_ring_t;
+
+static Trace_ring_t rings[TRACE_CORES];
+
+static inline uint32_t trace_cycles(void)
+{
+#if defined(ESP_PLATFORM) && !CONFIG_IDF_TARGET_LINUX
+    return esp_cpu_get_cycle_count();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec);
+#endif
+}
+
+static inline int trace_core(void)
+{
+#if defined(ESP_PLATFORM) && !CONFIG_IDF_TARGET_LINUX
+    return esp_cpu_get_core_id();
+#else
+    return 0;
+#endif
+}
+
+uint32_t trace_cycles_per_us(void)
+{
+#if defined(ESP_PLATFORM) && !CONFIG_IDF_TARGET_LINUX
+    return CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ;
+#else
+    return 1000;
+#endif
+}
+
+void trace_write(Trace_event_t event, uint16_t arg0, uint32_t arg1)
+{
+    Trace_ring_t *ring = &rings[trace_core()];
+    uint32_t index = atomic_fetch_add_explicit(&ring->head, 1, memory_order_relaxed);
+    Trace_record_t *record = &ring->records[index & (TRACE_RING_RECORDS - 1)];
+
+    // Invalidate first, a drainer reading the slot meanwhile sees it incomplete
+    atomic_store_explicit(&record->seq, 0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    record->cycles = trace_cycles();
+    record->event = (uint16_t)event;
+    record->arg0 = arg0;
+    record->arg1 = arg1;
+    atomic_store_explicit(&record->seq, index + 1, memory_order_release);
+}
+
+uint32_t trace_drain(Trace_record_cb_t on_record, void *ctx)
+{
+    uint32_t lost = 0;
+    for (int core = 0; core < TRACE_CORES; core++) {
+        Trace_ring_t *ring = &rings[core];
+        uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+        if (head - ring->tail > TRACE_RING_RECORDS) {
+            lost += head - ring->tail - TRACE_RING_RECORDS;
+            ring->tail = head - TRACE_RING_RECORDS;
+        }
+
+        while (ring->tail != head) {
+            Trace_record_t *slot = &ring->records[ring->tail & (TRACE_RING_RECORDS - 1)];
+            uint32_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+            if (seq == 0 || seq - 1 - ring->tail > UINT32_MAX / 2) {
+                break;   // Still being written, picked up by the next drain
+            }
+            Trace_record_t copy;
+            atomic_init(&copy.seq, seq);
+            copy.cycles = slot->cycles;
+            copy.event = slot->event;
+            copy.arg0 = slot->arg0;
+            copy.arg1 = slot->arg1;
+            atomic_thread_fence(memory_order_acquire);
+            // A writer that lapped the ring changed the slot while it was copied
+            if (seq != ring->tail + 1 || atomic_load_explicit(&slot->seq, memory_order_relaxed) != seq) {
+                lost++;
+            } else {
+                on_record(core, &copy, ctx);
+            }
+            ring->tail++;
+        }
+    }
+    return lost;
+}
+
+static void dump_record(int core, const Trace_record_t *record, void *ctx)
+{
+    fprintf((FILE *)ctx, "@T%d %08lx%08lx%04x%04x%08lx\n", core, (unsigned long)atomic_load(&record->seq),
+            (unsigned long)record->cycles, record->event, record->arg0, (unsigned long)record->arg1);
+}
+
+void trace_dump(FILE *out)
+{
+    fprintf(out, "@TH %lu %d\n", (unsigned long)trace_cycles_per_us(), TRACE_CORES);
+    uint32_t lost = trace_drain(dump_record, out);
+    if (lost) {
+        fprintf(out, "@TL %lu\n", (unsigned long)lost);
+    }
+    fflush(out);
+}
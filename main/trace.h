@@ -0,0 +1,117 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "trace_events.h"
+#ifdef ESP_PLATFORM
+#include "sdkconfig.h"
+#endif
+
+#define TRACE_LEVEL_OFF 0
+#define TRACE_LEVEL_ERROR 1
+#define TRACE_LEVEL_INFO 2
+#define TRACE_LEVEL_DEBUG 3
+#define TRACE_LEVEL_VERBOSE 4
+
+// Compile time verbosity, trace points above it are not compiled in
+#ifndef TRACE_LEVEL
+#ifdef CONFIG_CHESSY_TRACE_LEVEL
+#define TRACE_LEVEL CONFIG_CHESSY_TRACE_LEVEL
+#else
+#define TRACE_LEVEL TRACE_LEVEL_OFF
+#endif
+#endif
+
+#ifdef CONFIG_CHESSY_TRACE_RECORDS
+#define TRACE_RING_RECORDS CONFIG_CHESSY_TRACE_RECORDS
+#else
+#define TRACE_RING_RECORDS 1024
+#endif
+
+#if defined(ESP_PLATFORM) && !CONFIG_IDF_TARGET_LINUX
+#define TRACE_CORES CONFIG_FREERTOS_NUMBER_OF_CORES
+#else
+#define TRACE_CORES 1
+#endif
+
+/**
+ * @brief One trace record, 16 bytes
+ *
+ */
+typedef struct {
+    _Atomic uint32_t seq;   // Write index + 1, stored last so a drainer can tell complete records
+    uint32_t cycles;        // CPU cycle counter, nanoseconds off target
+    uint16_t event;         // Trace_event_t
+    uint16_t arg0;
+    uint32_t arg1;
+} Trace_record_t;
+
+typedef void (*Trace_record_cb_t)(int core, const Trace_record_t *record, void *ctx);
+
+/**
+ * @brief Append a record to the ring of the current core
+ *
+ * Lock free: a slot is reserved with an atomic increment, so tasks
+ * preempting each other on a core cannot mix records. When the drainer
+ * falls behind the oldest records are overwritten. Use the TRACE_*
+ * macros, they compile to nothing above TRACE_LEVEL.
+ *
+ * @param event The event
+ * @param arg0 First argument
+ * @param arg1 Second argument
+ */
+void trace_write(Trace_event_t event, uint16_t arg0, uint32_t arg1);
+
+/**
+ * @brief Hand every complete record written since the last drain to a callback
+ *
+ * Only one task may drain.
+ *
+ * @param on_record Called for each record, in write order per core
+ * @param ctx Passed to on_record
+ * @return uint32_t Records overwritten before they could be drained
+ */
+uint32_t trace_drain(Trace_record_cb_t on_record, void *ctx);
+
+/**
+ * @brief Drain the rings as hex lines for the host decoder
+ *
+ * Writes "@TH <cycles per us> <cores>", then "@T<core> <record hex>" per
+ * record and "@TL <count>" if records were lost. Console logs can be mixed
+ * in, the decoder only reads the lines starting with "@T".
+ *
+ * @param out The stream
+ */
+void trace_dump(FILE *out);
+
+/**
+ * @brief Cycles per microsecond of the timestamps
+ *
+ * @return uint32_t The rate
+ */
+uint32_t trace_cycles_per_us(void);
+
+#if TRACE_LEVEL >= TRACE_LEVEL_ERROR
+#define TRACE_ERROR(event, arg0, arg1) trace_write(event, (uint16_t)(arg0), (uint32_t)(arg1))
+#else
+#define TRACE_ERROR(event, arg0, arg1) do {} while (0)
+#endif
+#if TRACE_LEVEL >= TRACE_LEVEL_INFO
+#define TRACE_INFO(event, arg0, arg1) trace_write(event, (uint16_t)(arg0), (uint32_t)(arg1))
+#else
+#define TRACE_INFO(event, arg0, arg1) do {} while (0)
+#endif
+#if TRACE_LEVEL >= TRACE_LEVEL_DEBUG
+#define TRACE_DEBUG(event, arg0, arg1) trace_write(event, (uint16_t)(arg0), (uint32_t)(arg1))
+#else
+#define TRACE_DEBUG(event, arg0, arg1) do {} while (0)
+#endif
+#if TRACE_LEVEL >= TRACE_LEVEL_VERBOSE
+#define TRACE_VERBOSE(event, arg0, arg1) trace_write(event, (uint16_t)(arg0), (uint32_t)(arg1))
+#else
+#define TRACE_VERBOSE(event, arg0, arg1) do {} while (0)
+#endif
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef TRACE_EVENTS_H
+#define TRACE_EVENTS_H
+
+/**
+ * @brief Every trace event with a printf format for its two arguments
+ *
+ * Shared by the firmware and the host decoder, which passes both arguments
+ * as unsigned ints. Add new events at the end so older dumps still decode.
+ */
+#define TRACE_EVENT_LIST(X) \
+    X(TRACE_MOVEGEN, "generate moves of piece type %u") \
+    X(TRACE_HALL_EVENT, "square %u, type %u (0 lift, 1 place)") \
+    X(TRACE_HALL_DROPPED, "event queue full, square %u dropped, %u so far") \
+    X(TRACE_SETUP_MISSING, "setup: missing piece on square %u") \
+    X(TRACE_SETUP_EXTRA, "setup: extra piece on square %u") \
+    X(TRACE_MOVE_PLAYED, "move %#06x, key %#010x") \
+    X(TRACE_MOVE_REJECTED, "invalid placement on square %u") \
+    X(TRACE_SEARCH_ITERATION, "search depth %u, %u nodes") \
+    X(TRACE_SEARCH_DONE, "search move %#06x in %u us") \
+    X(TRACE_BOOK_MOVE, "book move %#06x") \
+    X(TRACE_LED_FRAME, "LED frame sent") \
+    X(TRACE_SCAN_MODE, "scan mode %u (0 burst, 1 active, 2 idle), pause %u us") \
+    X(TRACE_MOVE_TAKEN_BACK, "move %#06x taken back, key %#010x")
+
+#define TRACE_EVENT_ENUM(name, format) name,
+
+typedef enum {
+    TRACE_EVENT_LIST(TRACE_EVENT_ENUM)
+    TRACE_EVENT_NB,
+} Trace_event_t;
+
+#endif
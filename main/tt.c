@@ -0,0 +1,65 @@
+#include <string.h>
+#include "tt.h"
+
+// Data layout: move in bits 0-15, score 16-31, depth 32-39, bound 40-41, generation 48-55
+#define DATA_MOVE(data) ((Chess_move_t)((data) & 0xFFFF))
+#define DATA_SCORE(data) ((int16_t)(((data) >> 16) & 0xFFFF))
+#define DATA_DEPTH(data) ((int8_t)(((data) >> 32) & 0xFF))
+#define DATA_BOUND(data) ((uint8_t)(((data) >> 40) & 0x3))
+#define DATA_GENERATION(data) ((uint8_t)(((data) >> 48) & 0xFF))
+
+static inline uint64_t data_make(Chess_move_t move, int score, int depth, Tt_bound_t bound, uint8_t generation)
+{
+    return (uint64_t)move | (uint64_t)(uint16_t)score << 16 | (uint64_t)(uint8_t)depth << 32 |
+           (uint64_t)bound << 40 | (uint64_t)generation << 48;
+}
+
+void tt_init(Tt_t *tt, Tt_entry_t *entries, size_t count)
+{
+    tt->entries = entries;
+    tt->mask = count - 1;
+    tt->generation = 0;
+}
+
+void tt_clear(Tt_t *tt)
+{
+    memset(tt->entries, 0, (tt->mask + 1) * sizeof(tt->entries[0]));
+    tt->generation = 0;
+}
+
+void tt_new_search(Tt_t *tt)
+{
+    tt->generation++;
+}
+
+// Other threads may write the entry at any time, each word is read once
+bool tt_probe(const Tt_t *tt, uint64_t key, Tt_hit_t *hit)
+{
+    const volatile Tt_entry_t *entry = &tt->entries[key & tt->mask];
+    uint64_t data = entry->data;
+    uint64_t check = entry->check;
+    if ((check ^ data) != key || data == 0) {
+        return false;
+    }
+    hit->move = DATA_MOVE(data);
+    hit->score = DATA_SCORE(data);
+    hit->depth = DATA_DEPTH(data);
+    hit->bound = DATA_BOUND(data);
+    return true;
+}
+
+void tt_store(Tt_t *tt, uint64_t key, Chess_move_t move, int score, int depth, Tt_bound_t bound)
+{
+    volatile Tt_entry_t *entry = &tt->entries[key & tt->mask];
+    uint64_t old = entry->data;
+    bool same = (entry->check ^ old) == key;
+    if (!same && old != 0 && DATA_GENERATION(old) == tt->generation && DATA_DEPTH(old) > depth) {
+        return;
+    }
+    if (same && move == MOVE_NONE) {
+        move = DATA_MOVE(old);
+    }
+    uint64_t data = data_make(move, score, depth, bound, tt->generation);
+    entry->data = data;
+    entry->check = key ^ data;
+}
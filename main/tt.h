@@ -0,0 +1,101 @@
+#ifndef TT_H
+#define TT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "moves.h"
+
+/**
+ * @brief Kind of score stored, from the window it was searched with
+ *
+ */
+typedef enum {
+    TT_BOUND_NONE = 0,
+    TT_BOUND_UPPER,   // Failed low, the score is at most this
+    TT_BOUND_LOWER,   // Failed high, the score is at least this
+    TT_BOUND_EXACT,
+} Tt_bound_t;
+
+/**
+ * @brief One slot, 16 bytes
+ *
+ * The key is stored XORed with the data, so an entry torn by two searches
+ * writing it at once, or read half written, fails the check and is a miss.
+ * No lock is needed, even on a target without 64-bit atomic stores.
+ */
+typedef struct {
+    uint64_t check;   // key ^ data
+    uint64_t data;    // Move, score, depth, bound and generation, see tt.c
+} Tt_entry_t;
+
+/**
+ * @brief What a probe found
+ *
+ */
+typedef struct {
+    Chess_move_t move;
+    int16_t score;
+    int8_t depth;
+    uint8_t bound;    // Tt_bound_t
+} Tt_hit_t;
+
+/**
+ * @brief Transposition table shared by every search thread
+ *
+ */
+typedef struct {
+    Tt_entry_t *entries;
+    uint64_t mask;       // Entry count - 1
+    uint8_t generation;  // Bumped for every new search, older entries are replaced first
+} Tt_t;
+
+/**
+ * @brief Use a zeroed array as a table
+ *
+ * @param tt The table
+ * @param entries The entries, all zero
+ * @param count Number of entries, a power of two
+ */
+void tt_init(Tt_t *tt, Tt_entry_t *entries, size_t count);
+
+/**
+ * @brief Forget every entry
+ *
+ * @param tt The table
+ */
+void tt_clear(Tt_t *tt);
+
+/**
+ * @brief Age the entries before a new search
+ *
+ * @param tt The table
+ */
+void tt_new_search(Tt_t *tt);
+
+/**
+ * @brief Look a position up
+ *
+ * @param tt The table
+ * @param key Key of the position
+ * @param hit Filled if found
+ * @return true if the position was found
+ */
+bool tt_probe(const Tt_t *tt, uint64_t key, Tt_hit_t *hit);
+
+/**
+ * @brief Store a search result
+ *
+ * An entry of another position is replaced when it is from an older search
+ * or was not searched deeper.
+ *
+ * @param tt The table
+ * @param key Key of the position
+ * @param move Best move, MOVE_NONE keeps the move already stored for the position
+ * @param score Score, mate scores relative to the position
+ * @param depth Depth searched
+ * @param bound Kind of score
+ */
+void tt_store(Tt_t *tt, uint64_t key, Chess_move_t move, int score, int depth, Tt_bound_t bound);
+
+#endif
@@ -0,0 +1,283 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "uci.h"
+#include "game.h"
+#include "search.h"
+
+#define UCI_SEPARATORS " \t"
+
+void uci_reader_init(Uci_reader_t *reader)
+{
+    memset(reader, 0, sizeof(*reader));
+}
+
+void uci_reader_feed(Uci_reader_t *reader, const uint8_t *bytes, size_t size, Uci_line_cb_t on_line, void *ctx)
+{
+    for (size_t i = 0; i < size; i++) {
+        char c = (char)bytes[i];
+        if (c != '\n' && c != '\r') {
+            if (reader->size < sizeof(reader->line) - 1) {
+                reader->line[reader->size++] = c;
+            } else {
+                reader->overflow = true;
+            }
+            continue;
+        }
+        if (reader->overflow) {
+            reader->skipped++;
+        } else if (reader->size > 0) {
+            reader->line[reader->size] = '\0';
+            reader->lines++;
+            on_line(reader->line, ctx);
+        }
+        reader->size = 0;
+        reader->overflow = false;
+    }
+}
+
+// Commands are only ever appended whole, one that does not fit is dropped
+static void append(Uci_output_t *out, const char *text)
+{
+    size_t size = strlen(text);
+    if (out->size + size <= sizeof(out->text)) {
+        memcpy(out->text + out->size, text, size);
+        out->size += size;
+    }
+}
+
+void uci_session_init(Uci_session_t *session, uint32_t movetime_ms)
+{
+    memset(session, 0, sizeof(*session));
+    session->movetime_ms = movetime_ms;
+}
+
+void uci_session_restart(Uci_session_t *session)
+{
+    session->resend = true;
+    session->pending = 0;
+}
+
+void uci_session_resend(Uci_session_t *session, const Uci_output_t *out, size_t written)
+{
+    // A go the engine did not read starts no search, its bestmove never comes
+    for (size_t start = 0, i = 0; i < out->size; i++) {
+        if (out->text[i] != '\n') {
+            continue;
+        }
+        if (written < start + 2 && i - start >= 2 && strncmp(out->text + start, "go", 2) == 0 &&
+                session->pending > 0) {
+            session->pending--;
+        }
+        start = i + 1;
+    }
+    session->resend = true;
+}
+
+Chess_move_t uci_parse_move(const Chess_position_t *pos, const char *text)
+{
+    Move_list_t list;
+    char uci[6];
+    if (strlen(text) > 5) {
+        return MOVE_NONE;
+    }
+    int count = generate_legal_moves(pos, &list);
+    for (int i = 0; i < count; i++) {
+        if (strcmp(move_to_uci(list.moves[i], uci), text) == 0) {
+            return list.moves[i];
+        }
+    }
+    return MOVE_NONE;
+}
+
+// Keep the last half of the moves, the first half goes into the starting position
+static void fold_moves(Uci_session_t *session)
+{
+    uint32_t folded = UCI_MAX_PLIES / 2;
+    for (uint32_t i = 0; i < folded; i++) {
+        make_move(&session->start, session->moves[i]);
+    }
+    session->count -= folded;
+    memmove(session->moves, session->moves + folded, session->count * sizeof(session->moves[0]));
+}
+
+// Bring the moves to the board, true if its position is reached
+static bool follow_moves(Uci_session_t *session, const Telemetry_board_t *board)
+{
+    if (!session->sent || board->start_key != session->start_key) {
+        return false;
+    }
+    if (board->plies < session->plies) {
+        // A takeback within the moves sent
+        uint32_t back = session->plies - board->plies;
+        if (back > session->count) {
+            return false;
+        }
+        session->count -= back;
+        Chess_position_t pos = session->start;
+        for (uint32_t i = 0; i < session->count; i++) {
+            make_move(&pos, session->moves[i]);
+        }
+        return pos.key == board->pos.key;
+    }
+    if (board->plies - session->plies > TELEMETRY_RECENT_MOVES) {
+        return false;
+    }
+    Chess_position_t pos = session->pos;
+    for (uint32_t ply = session->plies + 1; ply <= board->plies; ply++) {
+        Chess_move_t move = board->recent[(ply - 1) % TELEMETRY_RECENT_MOVES];
+        Move_list_t list;
+        int i = 0, count = generate_legal_moves(&pos, &list);
+        while (i < count && list.moves[i] != move) {
+            i++;
+        }
+        if (i == count) {
+            return false;
+        }
+        if (session->count == UCI_MAX_PLIES) {
+            fold_moves(session);
+        }
+        make_move(&pos, move);
+        session->moves[session->count++] = move;
+    }
+    return pos.key == board->pos.key;
+}
+
+static void send_position(Uci_session_t *session, Uci_output_t *out)
+{
+    char text[UCI_OUTPUT_MAX];
+    char fen[POSITION_FEN_MAX];
+    Chess_position_t initial;
+    position_set_start(&initial);
+    size_t size = initial.key == session->start.key ? (size_t)snprintf(text, sizeof(text), "position startpos")
+                  : (size_t)snprintf(text, sizeof(text), "position fen %s", position_to_fen(&session->start, fen));
+    if (session->count > 0) {
+        size += (size_t)snprintf(text + size, sizeof(text) - size, " moves");
+    }
+    for (uint32_t i = 0; i < session->count; i++) {
+        char uci[6];
+        size += (size_t)snprintf(text + size, sizeof(text) - size, " %s", move_to_uci(session->moves[i], uci));
+    }
+    snprintf(text + size, sizeof(text) - size, "\n");
+    append(out, text);
+    session->positions++;
+}
+
+void uci_session_follow(Uci_session_t *session, const Telemetry_board_t *board, Uci_output_t *out)
+{
+    bool playing = board->state == GAME_STATE_PLAYING;
+    if (!session->resend && session->sent && board->pos.key == session->pos.key &&
+            board->plies == session->plies && playing == session->active) {
+        return;
+    }
+
+    // New moves of the same game and takebacks keep the history, anything else starts over from the position
+    if (!follow_moves(session, board)) {
+        session->start = board->pos;
+        session->count = 0;
+    }
+    session->pos = board->pos;
+    session->start_key = board->start_key;
+    session->plies = board->plies;
+    session->sent = true;
+    session->resend = false;
+
+    // The bestmove answering the stop is told apart by the number of searches pending
+    if (session->active && session->pending > 0) {
+        append(out, "stop\n");
+    }
+    session->active = playing;
+    Move_list_t list;
+    if (!playing || generate_legal_moves(&board->pos, &list) == 0) {
+        return;
+    }
+    send_position(session, out);
+    char go[32];
+    if (session->movetime_ms > 0) {
+        snprintf(go, sizeof(go), "go movetime %u\n", (unsigned int)session->movetime_ms);
+    } else {
+        snprintf(go, sizeof(go), "go infinite\n");
+    }
+    append(out, go);
+    session->pending++;
+}
+
+static int16_t parse_score(const char *kind, const char *value)
+{
+    long n = value ? strtol(value, NULL, 10) : 0;
+    if (kind && strcmp(kind, "mate") == 0) {
+        // Mate in n moves is 2n - 1 plies for the side to move, mated in n is 2n
+        return (int16_t)(n > 0 ? SEARCH_MATE - (2 * n - 1) : -SEARCH_MATE - 2 * n);
+    }
+    return (int16_t)(n > SEARCH_MATE - SEARCH_MAX_PLY ? SEARCH_MATE - SEARCH_MAX_PLY
+                     : n < -SEARCH_MATE + SEARCH_MAX_PLY ? -SEARCH_MATE + SEARCH_MAX_PLY : n);
+}
+
+// Fill the report from an info line, true if it has a pv
+static bool parse_info(Uci_session_t *session, char **save, Engine_report_t *report)
+{
+    bool has_move = false;
+    char *word;
+    while ((word = strtok_r(NULL, UCI_SEPARATORS, save)) != NULL) {
+        if (strcmp(word, "depth") == 0) {
+            char *value = strtok_r(NULL, UCI_SEPARATORS, save);
+            report->depth = value ? (uint8_t)atoi(value) : 0;
+        } else if (strcmp(word, "nodes") == 0) {
+            char *value = strtok_r(NULL, UCI_SEPARATORS, save);
+            report->nodes = value ? (uint32_t)strtoul(value, NULL, 10) : 0;
+        } else if (strcmp(word, "score") == 0) {
+            char *kind = strtok_r(NULL, UCI_SEPARATORS, save);
+            report->score = parse_score(kind, strtok_r(NULL, UCI_SEPARATORS, save));
+        } else if (strcmp(word, "pv") == 0) {
+            char *move = strtok_r(NULL, UCI_SEPARATORS, save);
+            report->best_move = move ? uci_parse_move(&session->pos, move) : MOVE_NONE;
+            has_move = true;
+            break;   // The rest of the line is the pv
+        } else if (strcmp(word, "string") == 0) {
+            break;
+        }
+    }
+    return has_move;
+}
+
+bool uci_session_handle(Uci_session_t *session, char *line, Uci_output_t *out, Engine_report_t *report)
+{
+    char *save;
+    memset(report, 0, sizeof(*report));
+    report->key = session->pos.key;
+    // Unknown words are skipped until a command is found
+    for (char *word = strtok_r(line, UCI_SEPARATORS, &save); word; word = strtok_r(NULL, UCI_SEPARATORS, &save)) {
+        if (strcmp(word, "uci") == 0) {
+            append(out, "id name Chessy\nid author esp-chessy\nuciok\n");
+            return false;
+        } else if (strcmp(word, "isready") == 0) {
+            append(out, "readyok\n");
+            return false;
+        } else if (strcmp(word, "info") == 0) {
+            // Only the latest search is shown, an older one may still report until its bestmove
+            if (!parse_info(session, &save, report)) {
+                return false;
+            }
+            if (!session->active || session->pending != 1 || report->best_move == MOVE_NONE) {
+                session->ignored++;
+                return false;
+            }
+            return true;
+        } else if (strcmp(word, "bestmove") == 0) {
+            char *move = strtok_r(NULL, UCI_SEPARATORS, &save);
+            bool current = session->pending == 1 && session->active;
+            if (session->pending > 0) {
+                session->pending--;
+            }
+            report->best_move = move && current ? uci_parse_move(&session->pos, move) : MOVE_NONE;
+            report->done = true;
+            if (report->best_move == MOVE_NONE) {
+                session->ignored++;
+                return false;
+            }
+            session->bestmoves++;
+            return true;
+        }
+    }
+    return false;
+}
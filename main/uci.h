@@ -0,0 +1,155 @@
+#ifndef UCI_H
+#define UCI_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "position.h"
+#include "moves.h"
+#include "engine.h"
+#include "telemetry.h"
+
+#define UCI_LINE_MAX 2048     // Longer received lines are skipped, a position command fits
+#define UCI_MAX_PLIES 256     // Moves a position command carries, older ones are folded into its FEN
+#define UCI_OUTPUT_MAX 2048   // Commands waiting to be sent, a position with every move fits
+
+/**
+ * @brief Assembles lines from bytes received in chunks of any size
+ *
+ */
+typedef struct {
+    char line[UCI_LINE_MAX];
+    size_t size;
+    bool overflow;            // The line is too long, skipped up to its end
+    uint32_t lines;
+    uint32_t skipped;
+} Uci_reader_t;
+
+/**
+ * @brief Called for each line received
+ *
+ * @param line The line without its end, can be modified
+ * @param ctx As passed to uci_reader_feed()
+ */
+typedef void (*Uci_line_cb_t)(char *line, void *ctx);
+
+/**
+ * @brief Commands to send, each ending with a newline
+ *
+ */
+typedef struct {
+    char text[UCI_OUTPUT_MAX];
+    size_t size;
+} Uci_output_t;
+
+/**
+ * @brief The board acting as a UCI GUI for an engine on the host
+ *
+ * Each new position of the game is sent right away as a position command
+ * with the moves that led to it, followed by go. The first move of each
+ * info pv and the bestmove that ends the search are returned as hints for
+ * that position. A search replaced by a newer position is stopped, its
+ * late info and bestmove are ignored.
+ */
+typedef struct {
+    Chess_position_t start;   // Position the moves sent start from
+    Chess_move_t moves[UCI_MAX_PLIES];
+    uint32_t count;
+    Chess_position_t pos;     // After the moves, the position searched
+    uint64_t start_key;       // Of the game followed
+    uint32_t plies;           // Of the game at pos
+    bool sent;                // The moves lead to pos
+    bool resend;              // Send pos even if it did not change
+    bool active;              // The game is playing, reports are for pos
+    uint32_t pending;         // Searches sent whose bestmove did not come yet
+    uint32_t movetime_ms;     // 0 searches until the next position
+    uint32_t positions;       // Position commands sent
+    uint32_t bestmoves;       // Accepted
+    uint32_t ignored;         // Reports of replaced searches, or with moves that are not legal
+} Uci_session_t;
+
+/**
+ * @brief Start with an empty line
+ *
+ * @param reader The reader
+ */
+void uci_reader_init(Uci_reader_t *reader);
+
+/**
+ * @brief Split received bytes into lines
+ *
+ * Lines end with LF, CR or both, empty lines are dropped.
+ *
+ * @param reader The reader
+ * @param bytes The bytes
+ * @param size Number of bytes
+ * @param on_line Called for each complete line
+ * @param ctx Passed to on_line
+ */
+void uci_reader_feed(Uci_reader_t *reader, const uint8_t *bytes, size_t size, Uci_line_cb_t on_line, void *ctx);
+
+/**
+ * @brief Start a session, the first board sent to uci_session_follow() is sent as a position
+ *
+ * @param session The session
+ * @param movetime_ms Time of each search, 0 to search until the next position
+ */
+void uci_session_init(Uci_session_t *session, uint32_t movetime_ms);
+
+/**
+ * @brief Send the position again with the next uci_session_follow(), for a host that just connected
+ *
+ * The moves are kept, searches sent before are forgotten.
+ *
+ * @param session The session
+ */
+void uci_session_restart(Uci_session_t *session);
+
+/**
+ * @brief Send the position again with the next uci_session_follow(), after output was cut short
+ *
+ * The engine is the same, so a search it still runs is stopped first.
+ * Searches whose go did not reach it are no longer waited for.
+ *
+ * @param session The session
+ * @param out The commands that were being sent
+ * @param written Bytes of them the host received, the rest is lost
+ */
+void uci_session_resend(Uci_session_t *session, const Uci_output_t *out, size_t written);
+
+/**
+ * @brief Queue the commands for a new board position
+ *
+ * Does nothing unless the position or the game state changed. A game
+ * that stops playing stops the search.
+ *
+ * @param session The session
+ * @param board The board now
+ * @param out Commands are appended here
+ */
+void uci_session_follow(Uci_session_t *session, const Telemetry_board_t *board, Uci_output_t *out);
+
+/**
+ * @brief Handle a line from the host
+ *
+ * bestmove and info are taken from the engine, uci and isready are answered
+ * so a host can find the board and time it. Other commands are ignored.
+ *
+ * @param session The session
+ * @param line The line, split in place
+ * @param out Replies are appended here
+ * @param report Set to the hint when true is returned, done for a bestmove
+ * @return true if report holds a move to show
+ */
+bool uci_session_handle(Uci_session_t *session, char *line, Uci_output_t *out, Engine_report_t *report);
+
+/**
+ * @brief Find a legal move from its long algebraic notation
+ *
+ * @param pos The position
+ * @param text The move, e.g. e2e4 or e7e8q
+ * @return Chess_move_t The move, MOVE_NONE if it is not legal
+ */
+Chess_move_t uci_parse_move(const Chess_position_t *pos, const char *text);
+
+#endif
@@ -0,0 +1,132 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "driver/usb_serial_jtag.h"
+#include "driver/usb_serial_jtag_vfs.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+#include "uci.h"
+#include "uci_usb.h"
+
+#define UCI_TASK_PRIORITY 2   // Above the telemetry and trace drains, below everything that moves pieces or LEDs
+#define UCI_TASK_STACK 6144   // A position command is built on the stack
+#define UCI_DRIVER_TX_BUFFER (UCI_OUTPUT_MAX + 256)   // The longest position command goes in one write
+#define UCI_DRIVER_RX_BUFFER 1024
+#define UCI_WRITE_TIMEOUT_MS 50
+
+static const char *TAG = "UCI";
+
+static QueueHandle_t board_queue;   // Only the latest position matters, the moves are in its snapshot
+static TaskHandle_t uci_task_handle;
+static Engine_report_cb_t hint_cb;
+static void *hint_ctx;
+
+// Only touched by the UCI task
+static Uci_session_t session;
+static Uci_reader_t reader;
+static Uci_output_t out;
+
+static void on_line(char *line, void *ctx)
+{
+    Engine_report_t report;
+    if (uci_session_handle(&session, line, &out, &report)) {
+        hint_cb(&report, hint_ctx);
+    }
+}
+
+// Each line is one write, so console lines from other tasks only land between them
+static void send_output(void)
+{
+    static bool torn = false;   // A line was cut short, the engine must see it end before the next one
+    size_t start = 0;
+    for (size_t i = 0; i < out.size; i++) {
+        if (out.text[i] != '\n') {
+            continue;
+        }
+        if (torn) {
+            torn = usb_serial_jtag_write_bytes("\n", 1, pdMS_TO_TICKS(UCI_WRITE_TIMEOUT_MS)) != 1;
+        }
+        int size = (int)(i + 1 - start);
+        int written = 0;
+        if (!torn) {
+            written = usb_serial_jtag_write_bytes(out.text + start, size, pdMS_TO_TICKS(UCI_WRITE_TIMEOUT_MS));
+        }
+        if (written != size) {
+            // The rest would not follow from what the engine got, the full position goes again
+            ESP_LOGW(TAG, "Short write, resending the position");
+            uci_session_resend(&session, &out, start + (written > 0 ? (size_t)written : 0));
+            torn = true;
+            break;
+        }
+        start = i + 1;
+    }
+    out.size = 0;
+}
+
+static void uci_task(void *arg)
+{
+    static Telemetry_board_t board;
+    uint8_t rx[128];
+    bool connected = false, have_board = false;
+
+    uci_session_init(&session, CONFIG_CHESSY_UCI_MOVETIME_MS);
+    uci_reader_init(&reader);
+    while (1) {
+        // A published board wakes the task right away, the receive side is polled
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(CONFIG_CHESSY_UCI_POLL_MS));
+        have_board |= xQueueReceive(board_queue, &board, 0) == pdTRUE;
+        if (!usb_serial_jtag_is_connected()) {
+            connected = false;
+            continue;
+        }
+        if (!connected) {
+            // The engine on the other side may have been started since, it gets the position again
+            uci_session_restart(&session);
+            uci_reader_init(&reader);
+            connected = true;
+        }
+
+        int n;
+        while ((n = usb_serial_jtag_read_bytes(rx, sizeof(rx), 0)) > 0) {
+            uci_reader_feed(&reader, rx, (size_t)n, on_line, NULL);
+        }
+        if (have_board) {
+            uci_session_follow(&session, &board, &out);
+        }
+        send_output();
+    }
+}
+
+esp_err_t uci_usb_start(Engine_report_cb_t on_hint, void *ctx)
+{
+    usb_serial_jtag_driver_config_t config = USB_SERIAL_JTAG_DRIVER_CONFIG_DEFAULT();
+    config.tx_buffer_size = UCI_DRIVER_TX_BUFFER;
+    config.rx_buffer_size = UCI_DRIVER_RX_BUFFER;
+    esp_err_t err = usb_serial_jtag_driver_install(&config);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Cannot install the USB serial driver: %s", esp_err_to_name(err));
+        return err;
+    }
+    // Console writes go through the driver too, so they land between commands rather than inside them
+    usb_serial_jtag_vfs_use_driver();
+
+    hint_cb = on_hint;
+    hint_ctx = ctx;
+    board_queue = xQueueCreate(1, sizeof(Telemetry_board_t));
+    if (!board_queue ||
+            xTaskCreate(uci_task, "uci", UCI_TASK_STACK, NULL, UCI_TASK_PRIORITY, &uci_task_handle) != pdPASS) {
+        ESP_LOGE(TAG, "Cannot start the UCI task");
+        board_queue = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+void uci_usb_publish_board(const Telemetry_board_t *board)
+{
+    if (board_queue) {
+        xQueueOverwrite(board_queue, board);
+        xTaskNotifyGive(uci_task_handle);
+    }
+}
@@ -0,0 +1,30 @@
+#ifndef UCI_USB_H
+#define UCI_USB_H
+
+#include "esp_err.h"
+#include "engine.h"
+#include "telemetry.h"
+
+/**
+ * @brief Take over the USB-Serial-JTAG port and start the UCI task
+ *
+ * The task runs below every task that moves pieces or LEDs. It sends each
+ * new position as soon as it is published, and reads the host's replies
+ * from the driver's receive ring every CONFIG_CHESSY_UCI_POLL_MS without
+ * waiting. Console output keeps going through the same driver, a line at
+ * a time.
+ *
+ * @param on_hint Called from the UCI task with each move the host engine suggests
+ * @param ctx Passed to on_hint
+ * @return esp_err_t ESP_OK, or the driver error
+ */
+esp_err_t uci_usb_start(Engine_report_cb_t on_hint, void *ctx);
+
+/**
+ * @brief Replace the board snapshot and wake the UCI task, never blocks
+ *
+ * @param board The board
+ */
+void uci_usb_publish_board(const Telemetry_board_t *board);
+
+#endif
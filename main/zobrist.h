@@ -0,0 +1,26 @@
+#ifndef ZOBRIST_H
+#define ZOBRIST_H
+
+#include <stdint.h>
+#include "bitboard.h"
+
+/**
+ * @brief Random keys xor'ed together into a 64-bit position key
+ *
+ * The key covers the pieces, the side to move, the castling rights and the
+ * en passant file, the last one only when a pawn can actually capture. The
+ * keys and rules are Polyglot's, so standard opening books match.
+ */
+extern uint64_t zobrist_piece_table[2][6][SQUARE_NB];
+extern uint64_t zobrist_castling_table[16];  // One key per combination of CASTLE_* bits
+extern uint64_t zobrist_ep_file_table[8];
+extern uint64_t zobrist_side_key;            // Xor'ed in when white is to move, as in Polyglot
+
+/**
+ * @brief Fill the key tables, safe to call more than once
+ *
+ * The keys are copied from Polyglot's Random64 table.
+ */
+void zobrist_init(void);
+
+#endif